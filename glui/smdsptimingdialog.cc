@@ -0,0 +1,134 @@
+// Licensed GNU LGPL v2.1 or later: http://www.gnu.org/licenses/lgpl-2.1.html
+
+#include "smdsptimingdialog.hh"
+#include "smfixedgrid.hh"
+#include "smbutton.hh"
+#include "smtimer.hh"
+
+#include <algorithm>
+
+using namespace SpectMorph;
+
+using std::string;
+using std::vector;
+
+DSPTimingDialog::DSPTimingDialog (Window *window, MorphPlanPtr morph_plan, SynthInterface *synth_interface) :
+  Dialog (window),
+  morph_plan (morph_plan),
+  synth_interface (synth_interface)
+{
+  FixedGrid grid;
+
+  auto title_label = new Label (this, "DSP Timing");
+  title_label->set_bold (true);
+  title_label->set_align (TextAlign::CENTER);
+
+  grid.add_widget (title_label, 0, 0, 40, 4);
+
+  double yoffset = 4;
+
+  process_label = new Label (this, "Total: -");
+  grid.add_widget (process_label, 3, yoffset, 34, 3);
+  yoffset += 3;
+
+  for (int stage = 0; stage < int (DSPStage::COUNT); stage++)
+    {
+      auto name_label = new Label (this, DSPTimers::stage_name (DSPStage (stage)));
+      auto percent_label = new Label (this, "-");
+      percent_label->set_align (TextAlign::RIGHT);
+
+      grid.add_widget (name_label, 5, yoffset, 20, 2.5);
+      grid.add_widget (percent_label, 25, yoffset, 10, 2.5);
+      stage_labels.push_back (percent_label);
+      yoffset += 2.5;
+    }
+  yoffset += 1;
+
+  auto op_title_label = new Label (this, "Operators");
+  grid.add_widget (op_title_label, 3, yoffset, 34, 3);
+  yoffset += 3;
+
+  for (int i = 0; i < MAX_OPS; i++)
+    {
+      auto name_label = new Label (this, "");
+      auto percent_label = new Label (this, "");
+      percent_label->set_align (TextAlign::RIGHT);
+
+      grid.add_widget (name_label, 5, yoffset, 20, 2.5);
+      grid.add_widget (percent_label, 25, yoffset, 10, 2.5);
+      op_name_labels.push_back (name_label);
+      op_percent_labels.push_back (percent_label);
+      yoffset += 2.5;
+    }
+  yoffset += 1;
+
+  auto ok_button = new Button (this, "Ok");
+  grid.add_widget (ok_button, 15, yoffset, 10, 3);
+  connect (ok_button->signal_clicked, this, &Dialog::on_accept);
+  yoffset += 4;
+
+  grid.add_widget (this, 0, 0, 40, yoffset);
+
+  Timer *timer = new Timer (this);
+  connect (timer->signal_timeout, this, &DSPTimingDialog::on_timer);
+  timer->start (0);
+
+  /* timing is only measured while the dialog is visible */
+  synth_interface->emit_set_dsp_timing (true);
+}
+
+DSPTimingDialog::~DSPTimingDialog()
+{
+  synth_interface->emit_set_dsp_timing (false);
+}
+
+void
+DSPTimingDialog::on_timer()
+{
+  DSPTimingReport report;
+  if (synth_interface->take_dsp_timing_report (report))
+    on_report (&report);
+}
+
+void
+DSPTimingDialog::on_report (const DSPTimingReport *report)
+{
+  process_label->set_text (string_printf ("Total: %.1f%% cpu", report->process_percent));
+
+  for (size_t stage = 0; stage < stage_labels.size(); stage++)
+    {
+      if (stage < report->stage_percent.size())
+        stage_labels[stage]->set_text (string_printf ("%.1f%%", report->stage_percent[stage]));
+    }
+
+  /* show the most expensive operators first */
+  struct OpTime
+  {
+    string name;
+    float  percent;
+  };
+  vector<OpTime> op_times;
+  for (size_t i = 0; i < report->op_ptr_id.size(); i++)
+    {
+      for (auto op : morph_plan->operators())
+        {
+          if (op->ptr_id() == report->op_ptr_id[i])
+            op_times.push_back ({ op->name(), report->op_percent[i] });
+        }
+    }
+  std::sort (op_times.begin(), op_times.end(), [] (const OpTime& a, const OpTime& b) { return a.percent > b.percent; });
+
+  for (int i = 0; i < MAX_OPS; i++)
+    {
+      if (size_t (i) < op_times.size())
+        {
+          op_name_labels[i]->set_text (op_times[i].name);
+          op_percent_labels[i]->set_text (string_printf ("%.1f%%", op_times[i].percent));
+        }
+      else
+        {
+          op_name_labels[i]->set_text ("");
+          op_percent_labels[i]->set_text ("");
+        }
+    }
+}
@@ -0,0 +1,35 @@
+// Licensed GNU LGPL v2.1 or later: http://www.gnu.org/licenses/lgpl-2.1.html
+
+#ifndef SPECTMORPH_DSP_TIMING_DIALOG_HH
+#define SPECTMORPH_DSP_TIMING_DIALOG_HH
+
+#include "smdialog.hh"
+#include "smlabel.hh"
+#include "smmorphplan.hh"
+#include "smsynthinterface.hh"
+
+namespace SpectMorph
+{
+
+class DSPTimingDialog : public Dialog
+{
+  static constexpr int MAX_OPS = 8;
+
+  MorphPlanPtr        morph_plan;
+  SynthInterface     *synth_interface = nullptr;
+
+  Label              *process_label = nullptr;
+  std::vector<Label *> stage_labels;
+  std::vector<Label *> op_name_labels;
+  std::vector<Label *> op_percent_labels;
+
+  void on_timer();
+  void on_report (const DSPTimingReport *report);
+public:
+  DSPTimingDialog (Window *window, MorphPlanPtr morph_plan, SynthInterface *synth_interface);
+  ~DSPTimingDialog();
+};
+
+}
+
+#endif
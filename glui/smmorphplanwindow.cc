@@ -3,6 +3,7 @@
 #include "smmorphplanwindow.hh"
 #include "smstdioout.hh"
 #include "smaboutdialog.hh"
+#include "smdsptimingdialog.hh"
 #include "smmessagebox.hh"
 #include "smeventloop.hh"
 #include "smconfig.hh"
@@ -59,6 +60,9 @@ MorphPlanWindow::MorphPlanWindow (EventLoop& event_loop,
   add_op_menu_item (op_menu, "Grid Morph", "SpectMorph::MorphGrid");
   add_op_menu_item (op_menu, "LFO", "SpectMorph::MorphLFO");
 
+  MenuItem *dsp_timing_item = help_menu->add_item ("DSP Timing...");
+  connect (dsp_timing_item->signal_clicked, this, &MorphPlanWindow::on_dsp_timing_clicked);
+
   MenuItem *about_item = help_menu->add_item ("About...");
   connect (about_item->signal_clicked, this, &MorphPlanWindow::on_about_clicked);
 
@@ -230,6 +234,14 @@ MorphPlanWindow::on_about_clicked()
   dialog->run();
 }
 
+void
+MorphPlanWindow::on_dsp_timing_clicked()
+{
+  auto dialog = new DSPTimingDialog (this, m_morph_plan, m_synth_interface);
+
+  dialog->run();
+}
+
 SynthInterface*
 MorphPlanWindow::synth_interface()
 {
@@ -52,6 +52,7 @@ public:
   void on_file_import_clicked();
   void on_file_export_clicked();
   void on_about_clicked();
+  void on_dsp_timing_clicked();
 };
 
 }
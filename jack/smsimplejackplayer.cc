@@ -18,8 +18,8 @@ public:
   Source (Audio *my_audio);
 
   void retrigger (int, float, int, float);
-  Audio* audio();
-  AudioBlock* audio_block (size_t index);
+  const Audio* audio();
+  const AudioBlock* audio_block (size_t index);
 };
 
 Source::Source (Audio *audio) :
@@ -32,13 +32,13 @@ Source::retrigger (int, float, int, float)
 {
 }
 
-Audio *
+const Audio *
 Source::audio()
 {
   return my_audio;
 }
 
-AudioBlock *
+const AudioBlock *
 Source::audio_block (size_t index)
 {
   if (my_audio && index < my_audio->contents.size())
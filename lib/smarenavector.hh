@@ -0,0 +1,348 @@
+// Licensed GNU LGPL v2.1 or later: http://www.gnu.org/licenses/lgpl-2.1.html
+
+#ifndef SPECTMORPH_ARENA_VECTOR_HH
+#define SPECTMORPH_ARENA_VECTOR_HH
+
+#include <vector>
+#include <memory>
+#include <algorithm>
+#include <type_traits>
+#include <atomic>
+
+#include <string.h>
+#include <assert.h>
+
+namespace SpectMorph
+{
+
+/**
+ * \brief Vector of trivial values, which owns its data or views data stored elsewhere
+ *
+ * This is used for the AudioBlock data: blocks built at runtime own their data
+ * (like std::vector), whereas the blocks of a loaded Audio point into an
+ * arena which contains the data for all frames (see Audio::load). Modifying values
+ * via operator[] writes to the arena; every operation that changes the size of a
+ * view copies the data first, so that the arena itself is never resized.
+ *
+ * Views can also point to read-only memory (a memory mapped file, AUDIO_MMAP). The
+ * mapped data is shared by all users of the file (WavSetRepo), so non-const access
+ * to the elements of such a view is an error (assertion): code that needs to modify
+ * the data must call make_writable() first, which copies it. Changing the size
+ * copies the data, too. The synthesis code gets its data through LiveDecoderSource,
+ * which only hands out const Audio / const AudioBlock pointers, so it never copies;
+ * the number of copies is counted by arena_vector_copies() for tests.
+ */
+inline std::atomic<uint64_t>&
+arena_vector_copies()
+{
+  static std::atomic<uint64_t> n_copies { 0 };
+  return n_copies;
+}
+
+template<class T>
+class ArenaVector
+{
+  static_assert (std::is_trivially_copyable<T>::value, "ArenaVector only supports trivial types");
+
+  T      *m_data     = nullptr;
+  size_t  m_size     = 0;
+  size_t  m_capacity = 0;    // 0 if we don't own m_data
+  bool    m_read_only = false; // view of read-only memory
+
+  void
+  reallocate (size_t new_capacity)
+  {
+    if (m_read_only)
+      arena_vector_copies()++;
+
+    T *new_data = new T[new_capacity];
+    if (m_size)
+      memcpy (new_data, m_data, std::min (m_size, new_capacity) * sizeof (T));
+
+    free_data();
+    m_data = new_data;
+    m_capacity = new_capacity;
+  }
+  void
+  free_data()
+  {
+    if (m_capacity)
+      delete[] m_data;
+
+    m_data = nullptr;
+    m_capacity = 0;
+    m_read_only = false;
+  }
+  T *
+  writable_data() const
+  {
+    assert (!m_read_only); // read-only view: call make_writable() first
+    return m_data;
+  }
+  void
+  assign_data (const T *data, size_t size)
+  {
+    if (size > m_capacity)
+      {
+        free_data();
+        m_data = new T[size];
+        m_capacity = size;
+      }
+    if (size)
+      memcpy (m_data, data, size * sizeof (T));
+    m_size = size;
+  }
+public:
+  typedef T         value_type;
+  typedef T        *iterator;
+  typedef const T  *const_iterator;
+
+  ArenaVector()
+  {
+  }
+  ArenaVector (const ArenaVector& other)
+  {
+    assign_data (other.m_data, other.m_size);
+  }
+  ArenaVector (ArenaVector&& other) :
+    m_data (other.m_data),
+    m_size (other.m_size),
+    m_capacity (other.m_capacity),
+    m_read_only (other.m_read_only)
+  {
+    other.m_data = nullptr;
+    other.m_size = 0;
+    other.m_capacity = 0;
+    other.m_read_only = false;
+  }
+  ArenaVector (const std::vector<T>& other)
+  {
+    assign_data (other.data(), other.size());
+  }
+  ~ArenaVector()
+  {
+    free_data();
+  }
+  ArenaVector&
+  operator= (const ArenaVector& other)
+  {
+    if (this != &other)
+      assign_data (other.m_data, other.m_size);
+    return *this;
+  }
+  ArenaVector&
+  operator= (ArenaVector&& other)
+  {
+    if (this != &other)
+      {
+        free_data();
+        std::swap (m_data, other.m_data);
+        std::swap (m_size, other.m_size);
+        std::swap (m_capacity, other.m_capacity);
+        std::swap (m_read_only, other.m_read_only);
+      }
+    return *this;
+  }
+  ArenaVector&
+  operator= (const std::vector<T>& other)
+  {
+    assign_data (other.data(), other.size());
+    return *this;
+  }
+  /* make this vector a view of size elements of arena memory */
+  void
+  set_view (T *data, size_t size)
+  {
+    free_data();
+    m_data = data;
+    m_size = size;
+  }
+  /* make this vector a view of size elements of read-only memory */
+  void
+  set_view (const T *data, size_t size)
+  {
+    free_data();
+    m_data = const_cast<T *> (data);
+    m_size = size;
+    m_read_only = size > 0;
+  }
+  bool
+  is_view() const
+  {
+    return m_size && !m_capacity;
+  }
+  bool
+  is_read_only() const
+  {
+    return m_read_only;
+  }
+  /* copy the data of a read-only view, so that it can be modified */
+  void
+  make_writable()
+  {
+    if (m_read_only)
+      reallocate (std::max<size_t> (m_size, 1)); // owned data needs m_capacity > 0
+  }
+  template<class InputIterator> void
+  assign (InputIterator first, InputIterator last)
+  {
+    const size_t size = std::distance (first, last);
+    if (size > m_capacity)
+      {
+        free_data();
+        m_data = new T[size];
+        m_capacity = size;
+      }
+    std::copy (first, last, m_data);
+    m_size = size;
+  }
+  void
+  reserve (size_t new_capacity)
+  {
+    /* a view (m_capacity == 0) is copied entirely, even if new_capacity < m_size */
+    if (new_capacity > m_capacity)
+      reallocate (std::max (new_capacity, m_size));
+  }
+  void
+  resize (size_t new_size)
+  {
+    reserve (new_size);
+    if (new_size > m_size)
+      std::fill (m_data + m_size, m_data + new_size, T());
+    m_size = new_size;
+  }
+  void
+  push_back (const T& value)
+  {
+    if (m_size >= m_capacity) // full, or view
+      {
+        const T v = value; // value could be an element of this vector
+
+        reallocate (std::max<size_t> (m_size * 2, 16));
+        m_data[m_size++] = v;
+      }
+    else
+      {
+        m_data[m_size++] = value;
+      }
+  }
+  void
+  clear()
+  {
+    if (!m_capacity)
+      {
+        m_data = nullptr;  // drop view
+        m_read_only = false;
+      }
+    m_size = 0;
+  }
+  size_t
+  size() const
+  {
+    return m_size;
+  }
+  bool
+  empty() const
+  {
+    return m_size == 0;
+  }
+  T&
+  operator[] (size_t pos)
+  {
+    return writable_data()[pos];
+  }
+  const T&
+  operator[] (size_t pos) const
+  {
+    return m_data[pos];
+  }
+  T&
+  back()
+  {
+    return writable_data()[m_size - 1];
+  }
+  const T&
+  back() const
+  {
+    return m_data[m_size - 1];
+  }
+  T *
+  data()
+  {
+    return writable_data();
+  }
+  const T *
+  data() const
+  {
+    return m_data;
+  }
+  iterator       begin()       { return writable_data(); }
+  iterator       end()         { return writable_data() + m_size; }
+  const_iterator begin() const { return m_data; }
+  const_iterator end() const   { return m_data + m_size; }
+};
+
+/**
+ * \brief Memory for ArenaVector views
+ *
+ * Memory is allocated in chunks, so a pointer returned by alloc() stays valid
+ * until the arena is cleared or destroyed.
+ */
+template<class T>
+class Arena
+{
+  static constexpr size_t CHUNK_SIZE = 16384;
+
+  struct Chunk
+  {
+    std::unique_ptr<T[]> data;
+    size_t               size = 0;
+    size_t               capacity = 0;
+  };
+  std::vector<Chunk> chunks;
+
+  void
+  add_chunk (size_t capacity)
+  {
+    chunks.emplace_back();
+    chunks.back().data.reset (new T[capacity]); // uninitialized
+    chunks.back().capacity = capacity;
+  }
+public:
+  T *
+  alloc (size_t n)
+  {
+    if (chunks.empty() || chunks.back().size + n > chunks.back().capacity)
+      add_chunk (std::max (n, CHUNK_SIZE));
+
+    Chunk& chunk = chunks.back();
+
+    T *result = chunk.data.get() + chunk.size;
+    chunk.size += n;
+    return result;
+  }
+  /* reserve space for at least n elements (without chunk size restrictions) */
+  void
+  reserve (size_t n)
+  {
+    add_chunk (n);
+  }
+  void
+  clear()
+  {
+    chunks.clear();
+  }
+  /* memory allocated by this arena in bytes */
+  size_t
+  mem_usage() const
+  {
+    size_t bytes = 0;
+    for (const auto& chunk : chunks)
+      bytes += chunk.capacity * sizeof (T);
+    return bytes;
+  }
+};
+
+}
+
+#endif /* SPECTMORPH_ARENA_VECTOR_HH */
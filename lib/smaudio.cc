@@ -5,13 +5,13 @@
 #include "sminfile.hh"
 #include "smstdioout.hh"
 #include "smleakdebugger.hh"
-#include "smmemout.hh"
-#include "smmmapin.hh"
 #include "smwavsetrepo.hh"
+#include "smmmapin.hh"
 #include <fcntl.h>
 #include <errno.h>
 #include <stdio.h>
 #include <assert.h>
+#include <string.h>
 
 using std::string;
 using std::vector;
@@ -40,6 +40,36 @@ SpectMorph::Audio::load (const string& filename, AudioLoadOptions load_options)
   return result;
 }
 
+/* for mapped blocks, use the data in the file directly (if it is properly aligned) */
+template<class T> static void
+load_block (InFile& ifile, Arena<T>& arena, ArenaVector<T>& block_vector)
+{
+  size_t n_values;
+  const unsigned char *mem = ifile.event_block_data (n_values);
+
+  if (ifile.event_block_mapped() && reinterpret_cast<uintptr_t> (mem) % alignof (T) == 0)
+    {
+      block_vector.set_view (reinterpret_cast<const T *> (mem), n_values);
+    }
+  else
+    {
+      T *arena_data = arena.alloc (n_values);
+
+      if (n_values)
+        memcpy (arena_data, mem, n_values * sizeof (T));
+      block_vector.set_view (arena_data, n_values);
+    }
+}
+
+template<class T> static void
+arena_copy (Arena<T>& arena, const T *data, size_t size, ArenaVector<T>& block_vector)
+{
+  T *arena_data = arena.alloc (size);
+
+  std::copy (data, data + size, arena_data);
+  block_vector.set_view (arena_data, size);
+}
+
 Error
 SpectMorph::Audio::load (GenericIn *file, AudioLoadOptions load_options)
 {
@@ -59,12 +89,23 @@ SpectMorph::Audio::load (GenericIn *file, AudioLoadOptions load_options)
   if (ifile.file_version() != SPECTMORPH_BINARY_FILE_VERSION)
     return Error::Code::FORMAT_INVALID;
 
-  if (load_options == AUDIO_SKIP_DEBUG)
+  if (load_options == AUDIO_SKIP_DEBUG || load_options == AUDIO_MMAP)
     {
       ifile.add_skip_event ("original_fft");
       ifile.add_skip_event ("debug_samples");
     }
 
+  GMappedFile *new_mapped_file = nullptr;
+  if (load_options == AUDIO_MMAP)
+    {
+      MMapIn *mmap_in = dynamic_cast<MMapIn *> (file);
+      if (mmap_in && mmap_in->mapped_file())
+        {
+          new_mapped_file = mmap_in->mapped_file();
+          ifile.set_map_blocks (true);
+        }
+    }
+
   while (ifile.event() != InFile::END_OF_FILE)
     {
       if (ifile.event() == InFile::BEGIN_SECTION)
@@ -113,9 +154,17 @@ SpectMorph::Audio::load (GenericIn *file, AudioLoadOptions load_options)
                 {
                   int frame_count = ifile.event_int();
 
+                  /* the blocks don't allocate memory for their data, but use our arenas */
                   contents.clear();
                   contents.resize (frame_count);
                   contents_pos = 0;
+
+                  uint16_arena.clear();
+                  float_arena.clear();
+
+                  if (mapped_file)
+                    g_mapped_file_unref (mapped_file);
+                  mapped_file = new_mapped_file ? g_mapped_file_ref (new_mapped_file) : nullptr;
                 }
               else
                 printf ("unhandled int %s %s\n", section.c_str(), ifile.event_name().c_str());
@@ -149,13 +198,11 @@ SpectMorph::Audio::load (GenericIn *file, AudioLoadOptions load_options)
         }
       else if (ifile.event() == InFile::FLOAT_BLOCK)
         {
-          const vector<float>& fb = ifile.event_float_block();
-
           if (section == "header")
             {
               if (ifile.event_name() == "original_samples")
                 {
-                  original_samples = fb;
+                  original_samples = ifile.event_float_block();
                 }
               else
                 printf ("unhandled float block %s  %s\n", section.c_str(), ifile.event_name().c_str());
@@ -165,11 +212,11 @@ SpectMorph::Audio::load (GenericIn *file, AudioLoadOptions load_options)
               assert (audio_block != NULL);
               if (ifile.event_name() == "original_fft")
                 {
-                  audio_block->original_fft = fb;
+                  load_block (ifile, float_arena, audio_block->original_fft);
                 }
               else if (ifile.event_name() == "debug_samples")
                 {
-                  audio_block->debug_samples = fb;
+                  load_block (ifile, float_arena, audio_block->debug_samples);
                 }
               else
                 {
@@ -180,35 +227,36 @@ SpectMorph::Audio::load (GenericIn *file, AudioLoadOptions load_options)
         }
       else if (ifile.event() == InFile::UINT16_BLOCK)
         {
-          const vector<uint16_t>& ib = ifile.event_uint16_block();
+          assert (audio_block != NULL);
           if (ifile.event_name() == "freqs")
             {
-              audio_block->freqs = ib;
+              load_block (ifile, uint16_arena, audio_block->freqs);
 
               // ensure that freqs are sorted (we need that for LiveDecoder)
               int old_freq = -1;
 
-              for (size_t i = 0; i < ib.size(); i++)
+              const ArenaVector<uint16_t>& freqs = audio_block->freqs;
+              for (auto freq : freqs)
                 {
-                  if (ib[i] < old_freq)
+                  if (freq < old_freq)
                     {
                       printf ("frequency data is not sorted, can't play file\n");
                       return Error::Code::PARSE_ERROR;
                     }
-                  old_freq = ib[i];
+                  old_freq = freq;
                 }
             }
           else if (ifile.event_name() == "mags")
             {
-              audio_block->mags = ib;
+              load_block (ifile, uint16_arena, audio_block->mags);
             }
           else if (ifile.event_name() == "phases")
             {
-              audio_block->phases = ib;
+              load_block (ifile, uint16_arena, audio_block->phases);
             }
           else if (ifile.event_name() == "noise")
             {
-              audio_block->noise = ib;
+              load_block (ifile, uint16_arena, audio_block->noise);
             }
           else
             {
@@ -236,9 +284,27 @@ SpectMorph::Audio::Audio()
 
 Audio::~Audio()
 {
+  if (mapped_file)
+    g_mapped_file_unref (mapped_file);
+
   leak_debugger.del (this);
 }
 
+size_t
+Audio::mem_usage (std::set<const GMappedFile *>& mapped_files) const
+{
+  size_t bytes = sizeof (Audio);
+
+  bytes += uint16_arena.mem_usage() + float_arena.mem_usage();
+  bytes += contents.capacity() * sizeof (AudioBlock);
+  bytes += original_samples.capacity() * sizeof (float);
+
+  if (mapped_file && mapped_files.insert (mapped_file).second)
+    bytes += g_mapped_file_get_length (mapped_file);
+
+  return bytes;
+}
+
 /**
  * This function saves a SM-File.
  *
@@ -296,30 +362,72 @@ SpectMorph::Audio::save (GenericOut *file) const
         }
 
       of.begin_section ("frame");
-      of.write_uint16_block ("noise", contents[i].noise);
-      of.write_uint16_block ("freqs", contents[i].freqs);
-      of.write_uint16_block ("mags", contents[i].mags);
-      of.write_uint16_block ("phases", contents[i].phases);
-      of.write_float_block ("original_fft", contents[i].original_fft);
-      of.write_float_block ("debug_samples", contents[i].debug_samples);
+      of.write_uint16_block ("noise", contents[i].noise.data(), contents[i].noise.size());
+      of.write_uint16_block ("freqs", contents[i].freqs.data(), contents[i].freqs.size());
+      of.write_uint16_block ("mags", contents[i].mags.data(), contents[i].mags.size());
+      of.write_uint16_block ("phases", contents[i].phases.data(), contents[i].phases.size());
+      of.write_float_block ("original_fft", contents[i].original_fft.data(), contents[i].original_fft.size());
+      of.write_float_block ("debug_samples", contents[i].debug_samples.data(), contents[i].debug_samples.size());
       of.end_section();
     }
   return Error::Code::NONE;
 }
 
-Audio *
-Audio::clone() const
+void
+Audio::pack_contents (const vector<AudioBlock>& blocks)
 {
-  // create a deep copy (by saving/loading)
-  vector<unsigned char> audio_data;
-  MemOut                audio_mo (&audio_data);
+  size_t uint16_size = 0, float_size = 0;
 
-  save (&audio_mo);
+  for (const auto& block : blocks)
+    {
+      uint16_size += block.noise.size() + block.freqs.size() + block.mags.size() + block.phases.size();
+      float_size  += block.original_fft.size() + block.debug_samples.size();
+    }
+
+  contents.clear();
+  contents.resize (blocks.size());
+
+  uint16_arena.clear();
+  uint16_arena.reserve (uint16_size);
+  float_arena.clear();
+  float_arena.reserve (float_size);
 
+  for (size_t f = 0; f < blocks.size(); f++)
+    {
+      const AudioBlock& in = blocks[f];
+      AudioBlock& out = contents[f];
+
+      arena_copy (uint16_arena, in.noise.data(), in.noise.size(), out.noise);
+      arena_copy (uint16_arena, in.freqs.data(), in.freqs.size(), out.freqs);
+      arena_copy (uint16_arena, in.mags.data(), in.mags.size(), out.mags);
+      arena_copy (uint16_arena, in.phases.data(), in.phases.size(), out.phases);
+      arena_copy (float_arena, in.original_fft.data(), in.original_fft.size(), out.original_fft);
+      arena_copy (float_arena, in.debug_samples.data(), in.debug_samples.size(), out.debug_samples);
+    }
+}
+
+Audio *
+Audio::clone() const
+{
+  // create a deep copy
   Audio *audio_clone = new Audio();
-  GenericIn *in = MMapIn::open_mem (&audio_data[0], &audio_data[audio_data.size()]);
-  audio_clone->load (in);
-  delete in;
+
+  audio_clone->fundamental_freq         = fundamental_freq;
+  audio_clone->mix_freq                 = mix_freq;
+  audio_clone->frame_size_ms            = frame_size_ms;
+  audio_clone->frame_step_ms            = frame_step_ms;
+  audio_clone->attack_start_ms          = attack_start_ms;
+  audio_clone->attack_end_ms            = attack_end_ms;
+  audio_clone->zeropad                  = zeropad;
+  audio_clone->loop_type                = loop_type;
+  audio_clone->loop_start               = loop_start;
+  audio_clone->loop_end                 = loop_end;
+  audio_clone->zero_values_at_start     = zero_values_at_start;
+  audio_clone->sample_count             = sample_count;
+  audio_clone->original_samples         = original_samples;
+  audio_clone->original_samples_norm_db = original_samples_norm_db;
+
+  audio_clone->pack_contents (contents);
 
   return audio_clone;
 }
@@ -4,11 +4,13 @@
 #define SPECTMORPH_AUDIO_HH
 
 #include <vector>
+#include <set>
 
 #include "smgenericin.hh"
 #include "smgenericout.hh"
 #include "smmath.hh"
 #include "smutils.hh"
+#include "smarenavector.hh"
 
 #define SPECTMORPH_BINARY_FILE_VERSION   14
 #define SPECTMORPH_SUPPORT_MULTI_CHANNEL 0
@@ -23,16 +25,19 @@ namespace SpectMorph
  * and phases, and a noise envelope for everything that remained after subtracting
  * the sine waves. The parameters original_fft and debug_samples are optional and
  * are used for debugging only.
+ *
+ * For blocks which are part of a loaded Audio, the data is not owned by the block, but
+ * stored in the arena of the Audio object (see SpectMorph::ArenaVector).
  */
 class AudioBlock
 {
 public:
-  std::vector<uint16_t> noise;       //!< noise envelope, representing the original signal minus sine components
-  std::vector<uint16_t> freqs;       //!< frequencies of the sine components of this frame
-  std::vector<uint16_t> mags;        //!< magnitudes of the sine components
-  std::vector<uint16_t> phases;      //!< phases of the sine components
-  std::vector<float> original_fft;   //!< original zeropadded FFT data - for debugging only
-  std::vector<float> debug_samples;  //!< original audio samples for this frame - for debugging only
+  ArenaVector<uint16_t> noise;         //!< noise envelope, representing the original signal minus sine components
+  ArenaVector<uint16_t> freqs;         //!< frequencies of the sine components of this frame
+  ArenaVector<uint16_t> mags;          //!< magnitudes of the sine components
+  ArenaVector<uint16_t> phases;        //!< phases of the sine components
+  ArenaVector<float>    original_fft;  //!< original zeropadded FFT data - for debugging only
+  ArenaVector<float>    debug_samples; //!< original audio samples for this frame - for debugging only
 
   void    sort_freqs();
   double  estimate_fundamental (int n_partials = 1, double *mag = nullptr) const;
@@ -66,7 +71,8 @@ public:
 enum AudioLoadOptions
 {
   AUDIO_LOAD_DEBUG,
-  AUDIO_SKIP_DEBUG
+  AUDIO_SKIP_DEBUG,
+  AUDIO_MMAP        //!< skip debug data; frame data stays in the memory mapped file (read-only)
 };
 
 /**
@@ -79,6 +85,13 @@ enum AudioLoadOptions
 class Audio
 {
   SPECTMORPH_CLASS_NON_COPYABLE (Audio);
+
+  /* data of all blocks in contents, frame by frame (blocks point into these arenas) */
+  Arena<uint16_t> uint16_arena;
+  Arena<float>    float_arena;
+  GMappedFile    *mapped_file = nullptr; /* for AUDIO_MMAP: blocks may point into this file */
+
+  void pack_contents (const std::vector<AudioBlock>& blocks);
 public:
   Audio();
   ~Audio();
@@ -114,6 +127,9 @@ public:
 
   Audio *clone() const; // create a deep copy
 
+  /* memory used by this object; mapped files are only counted if they are not in mapped_files yet */
+  size_t mem_usage (std::set<const GMappedFile *>& mapped_files) const;
+
   static bool loop_type_to_string (LoopType loop_type, std::string& s);
   static bool string_to_loop_type (const std::string& s, LoopType& loop_type);
 };
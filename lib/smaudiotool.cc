@@ -65,11 +65,11 @@ AudioTool::normalize_factor (double norm, Audio& audio)
 
   for (size_t f = 0; f < audio.contents.size(); f++)
     {
-      vector<uint16_t>& mags = audio.contents[f].mags;
+      ArenaVector<uint16_t>& mags = audio.contents[f].mags;
       for (size_t i = 0; i < mags.size(); i++)
         mags[i] = sm_bound<int> (0, mags[i] + norm_delta_idb, 65535);
 
-      vector<uint16_t>& noise = audio.contents[f].noise;
+      ArenaVector<uint16_t>& noise = audio.contents[f].noise;
       for (size_t i = 0; i < noise.size(); i++)
         noise[i] = sm_bound<int> (0, noise[i] + norm_delta_idb, 65535);
     }
@@ -42,6 +42,18 @@ Config::Config()
         {
           m_font_bold = s;
         }
+      else if (cfg_parser.command ("wav_set_cache_mb", i))
+        {
+          m_wav_set_cache_mb = i;
+        }
+      else if (cfg_parser.command ("render_threads", i))
+        {
+          m_render_threads = i;
+        }
+      else if (cfg_parser.command ("noise_bank", i))
+        {
+          m_noise_bank = i;
+        }
       else
         {
           //cfg.die_if_unknown();
@@ -79,6 +91,24 @@ Config::font_bold() const
   return m_font_bold;
 }
 
+int
+Config::wav_set_cache_mb() const
+{
+  return m_wav_set_cache_mb;
+}
+
+int
+Config::render_threads() const
+{
+  return m_render_threads;
+}
+
+bool
+Config::noise_bank() const
+{
+  return m_noise_bank;
+}
+
 void
 Config::store()
 {
@@ -90,6 +120,9 @@ Config::store()
   fprintf (file, "# this file is automatically updated by SpectMorph\n");
   fprintf (file, "# it can be manually edited, however, if you do that, be careful\n");
   fprintf (file, "zoom %d\n", m_zoom);
+  fprintf (file, "wav_set_cache_mb %d\n", m_wav_set_cache_mb);
+  fprintf (file, "render_threads %d\n", m_render_threads);
+  fprintf (file, "noise_bank %d\n", m_noise_bank ? 1 : 0);
 
   for (auto area : m_debug)
     fprintf (file, "debug %s\n", area.c_str());
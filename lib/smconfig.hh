@@ -16,6 +16,9 @@ class Config
   std::vector<std::string> m_debug;
   std::string              m_font;
   std::string              m_font_bold;
+  int                      m_wav_set_cache_mb = 1024;
+  int                      m_render_threads = 1;
+  bool                     m_noise_bank = false;
 
   std::string get_config_filename();
 public:
@@ -29,6 +32,10 @@ public:
   std::string font() const;
   std::string font_bold() const;
 
+  int   wav_set_cache_mb() const;
+  int   render_threads() const;
+  bool  noise_bank() const;
+
   void store();
 };
 
@@ -0,0 +1,236 @@
+// Licensed GNU LGPL v2.1 or later: http://www.gnu.org/licenses/lgpl-2.1.html
+
+#include "smdsptimer.hh"
+
+#include <assert.h>
+
+#include <algorithm>
+#include <chrono>
+
+using namespace SpectMorph;
+
+namespace SpectMorph
+{
+
+/* counters of one thread: only the owner thread writes, so load + store is enough */
+struct DSPThreadCounters
+{
+  std::atomic<bool>   in_use;
+  std::atomic<uint64> calls[int (DSPStage::COUNT)];
+  std::atomic<uint64> ticks[int (DSPStage::COUNT)];
+};
+
+}
+
+namespace
+{
+
+constexpr int N_STAGES = int (DSPStage::COUNT);
+constexpr int N_THREAD_SLOTS = 64;
+
+DSPThreadCounters          thread_counters[N_THREAD_SLOTS];
+DSPThreadCounters          shared_counters; // unregistered threads, if we run out of slots, and counts of released slots
+
+/* only trivially destructible thread local state: no destructors run on thread exit */
+thread_local DSPThreadCounters *this_thread_counters = nullptr;
+thread_local int                stage_depth[N_STAGES];
+thread_local DSPOperatorScope  *current_operator_scope = nullptr;
+
+/* baseline for stats(), written by reset() */
+std::atomic<uint64>        baseline_calls[N_STAGES];
+std::atomic<uint64>        baseline_ticks[N_STAGES];
+
+/* reference point for converting time stamp counter ticks to nanoseconds */
+struct Calibration
+{
+  uint64 ticks = DSPTimers::now();
+  uint64 ns    = DSPTimers::now_ns();
+} const calibration;
+
+DSPThreadCounters *
+get_thread_counters()
+{
+  return this_thread_counters ? this_thread_counters : &shared_counters;
+}
+
+void
+add_counter (DSPThreadCounters *counters, std::atomic<uint64>& counter, uint64 value)
+{
+  if (counters == &shared_counters)
+    counter.fetch_add (value, std::memory_order_relaxed);
+  else
+    counter.store (counter.load (std::memory_order_relaxed) + value, std::memory_order_relaxed);
+}
+
+void
+sum_counters (DSPStage stage, uint64& calls, uint64& ticks)
+{
+  /* unused slots are zero */
+  calls = shared_counters.calls[int (stage)].load (std::memory_order_relaxed);
+  ticks = shared_counters.ticks[int (stage)].load (std::memory_order_relaxed);
+  for (const auto& counters : thread_counters)
+    {
+      calls += counters.calls[int (stage)].load (std::memory_order_relaxed);
+      ticks += counters.ticks[int (stage)].load (std::memory_order_relaxed);
+    }
+}
+
+}
+
+std::atomic<int> DSPTimers::m_enabled { 0 };
+
+DSPThreadSlot::DSPThreadSlot() :
+  m_counters (&shared_counters)
+{
+  for (auto& counters : thread_counters)
+    {
+      bool expected = false;
+      if (counters.in_use.compare_exchange_strong (expected, true))
+        {
+          m_counters = &counters;
+          break;
+        }
+    }
+}
+
+DSPThreadSlot::~DSPThreadSlot()
+{
+  if (m_counters != &shared_counters)
+    {
+      /* keep the counts of this slot, so that the totals don't change */
+      for (int s = 0; s < N_STAGES; s++)
+        {
+          shared_counters.calls[s].fetch_add (m_counters->calls[s].exchange (0));
+          shared_counters.ticks[s].fetch_add (m_counters->ticks[s].exchange (0));
+        }
+      m_counters->in_use.store (false);
+    }
+}
+
+DSPThreadCounters *
+DSPThreadScope::swap_current (DSPThreadCounters *counters)
+{
+  DSPThreadCounters *old_counters = this_thread_counters;
+  this_thread_counters = counters;
+  return old_counters;
+}
+
+void
+DSPTimers::enable()
+{
+  m_enabled.fetch_add (1);
+}
+
+void
+DSPTimers::disable()
+{
+  int old_enabled = m_enabled.fetch_sub (1);
+  assert (old_enabled > 0);
+}
+
+void
+DSPTimers::reset()
+{
+  /* counters are owned by the threads that write them, so we only record a baseline */
+  for (int s = 0; s < N_STAGES; s++)
+    {
+      uint64 calls, ticks;
+      sum_counters (DSPStage (s), calls, ticks);
+
+      baseline_calls[s].store (calls, std::memory_order_relaxed);
+      baseline_ticks[s].store (ticks, std::memory_order_relaxed);
+    }
+}
+
+DSPTimers::Stats
+DSPTimers::stats (DSPStage stage)
+{
+  /* lock free, so this can be used from the audio thread */
+  uint64 calls, ticks;
+  sum_counters (stage, calls, ticks);
+
+  Stats stats;
+  stats.calls = calls - baseline_calls[int (stage)].load (std::memory_order_relaxed);
+  stats.ns    = ticks_to_ns (ticks - baseline_ticks[int (stage)].load (std::memory_order_relaxed));
+  return stats;
+}
+
+int
+DSPTimers::thread_slots_in_use()
+{
+  int n = 0;
+  for (const auto& counters : thread_counters)
+    n += counters.in_use.load();
+  return n;
+}
+
+const char *
+DSPTimers::stage_name (DSPStage stage)
+{
+  switch (stage)
+    {
+      case DSPStage::MORPH:     return "morph";
+      case DSPStage::PARTIALS:  return "partials";
+      case DSPStage::NOISE:     return "noise";
+      case DSPStage::IFFT:      return "ifft";
+      case DSPStage::ENVELOPE:  return "envelope";
+      case DSPStage::FILTER:    return "filter";
+      default:                  return "unknown";
+    }
+}
+
+uint64
+DSPTimers::now_ns()
+{
+  /* monotonic clock (clock_gettime (CLOCK_MONOTONIC) on linux) */
+  const auto now = std::chrono::steady_clock::now().time_since_epoch();
+
+  return std::chrono::duration_cast<std::chrono::nanoseconds> (now).count();
+}
+
+double
+DSPTimers::ticks_to_ns (uint64 ticks)
+{
+#ifdef SM_DSP_TIMER_TSC
+  /* the time stamp counter runs at a constant rate on all cpus we care about, so we
+   * measure its rate against the monotonic clock since the library was loaded
+   */
+  const uint64 elapsed_ticks = now() - calibration.ticks;
+  const uint64 elapsed_ns = now_ns() - calibration.ns;
+
+  if (elapsed_ticks == 0)
+    return ticks;
+  return ticks * (double (elapsed_ns) / elapsed_ticks);
+#else
+  return ticks;
+#endif
+}
+
+bool
+DSPTimers::begin (DSPStage stage)
+{
+  return stage_depth[int (stage)]++ == 0;
+}
+
+void
+DSPTimers::end (DSPStage stage, bool outermost, uint64 start)
+{
+  assert (stage_depth[int (stage)] > 0);
+  stage_depth[int (stage)]--;
+
+  if (outermost)
+    {
+      DSPThreadCounters *counters = get_thread_counters();
+
+      add_counter (counters, counters->calls[int (stage)], 1);
+      add_counter (counters, counters->ticks[int (stage)], now() - start);
+    }
+}
+
+DSPOperatorScope *
+DSPOperatorScope::swap_current (DSPOperatorScope *scope)
+{
+  DSPOperatorScope *old_scope = current_operator_scope;
+  current_operator_scope = scope;
+  return old_scope;
+}
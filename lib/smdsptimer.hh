@@ -0,0 +1,232 @@
+// Licensed GNU LGPL v2.1 or later: http://www.gnu.org/licenses/lgpl-2.1.html
+
+#ifndef SPECTMORPH_DSP_TIMER_HH
+#define SPECTMORPH_DSP_TIMER_HH
+
+#include "smutils.hh"
+
+#include <atomic>
+
+#if defined (__i386__) || defined (__x86_64__)
+#include <x86intrin.h>
+#define SM_DSP_TIMER_TSC 1
+#endif
+
+namespace SpectMorph
+{
+
+/*
+ * Timers for the stages of the synthesis hot path
+ *
+ * Timing is compiled in, but disabled by default; then a DSPScopedTimer only costs
+ * one relaxed atomic load. If a stage is entered again while it is already running in
+ * the same thread (for instance nested morph operators), only the outermost scope is
+ * counted.
+ *
+ * Threads that render audio (the audio thread in MidiSynth::process(), the workers
+ * of RTThreadPool) register their own counters with a DSPThreadScope, so timing
+ * doesn't need locks or atomic read-modify-write operations; timers in threads that
+ * are not registered use shared counters. stats() sums the counters of all threads.
+ * Stage timing is process wide, so it includes all synth instances of the process.
+ */
+enum class DSPStage
+{
+  MORPH,
+  PARTIALS,
+  NOISE,
+  IFFT,
+  ENVELOPE,
+  FILTER,
+  COUNT
+};
+
+class DSPTimers
+{
+  static std::atomic<int> m_enabled;
+public:
+  struct Stats
+  {
+    uint64 calls = 0;
+    uint64 ns = 0;
+  };
+  static bool
+  enabled()
+  {
+    return m_enabled.load (std::memory_order_relaxed) > 0;
+  }
+  /* timing is enabled as long as at least one user needs it */
+  static void         enable();
+  static void         disable();
+  static void         reset();
+  static Stats        stats (DSPStage stage);
+  static const char  *stage_name (DSPStage stage);
+  static int          thread_slots_in_use();
+
+  /* timestamps (cpu time stamp counter where available) */
+  static uint64
+  now()
+  {
+#ifdef SM_DSP_TIMER_TSC
+    return __rdtsc();
+#else
+    return now_ns();
+#endif
+  }
+  static uint64       now_ns();
+  static double       ticks_to_ns (uint64 ticks);
+
+  static bool         begin (DSPStage stage);  // returns true for the outermost scope
+  static void         end (DSPStage stage, bool outermost, uint64 start);
+};
+
+struct DSPThreadCounters;
+
+/* owns the counters of one thread (the counts are kept when the slot is released) */
+class DSPThreadSlot
+{
+  DSPThreadCounters *m_counters;
+public:
+  DSPThreadSlot();
+  ~DSPThreadSlot();
+
+  DSPThreadSlot (const DSPThreadSlot&) = delete;
+  DSPThreadSlot& operator= (const DSPThreadSlot&) = delete;
+
+  DSPThreadCounters *
+  counters() const
+  {
+    return m_counters;
+  }
+};
+
+/* timers in the current thread write to the counters of slot while the scope exists;
+ * a slot must only be used by one thread at a time
+ */
+class DSPThreadScope
+{
+  DSPThreadCounters *m_old_counters;
+
+  static DSPThreadCounters *swap_current (DSPThreadCounters *counters);
+public:
+  DSPThreadScope (DSPThreadSlot& slot)
+  {
+    m_old_counters = swap_current (slot.counters());
+  }
+  ~DSPThreadScope()
+  {
+    swap_current (m_old_counters);
+  }
+};
+
+class DSPScopedTimer
+{
+  DSPStage m_stage;
+  bool     m_running = false;
+  bool     m_outermost = false;
+  uint64   m_start = 0;
+public:
+  DSPScopedTimer (DSPStage stage) :
+    m_stage (stage)
+  {
+    if (DSPTimers::enabled())
+      {
+        m_running = true;
+        m_outermost = DSPTimers::begin (stage);
+        if (m_outermost)
+          m_start = DSPTimers::now();
+      }
+  }
+  ~DSPScopedTimer()
+  {
+    if (m_running)
+      DSPTimers::end (m_stage, m_outermost, m_start);
+  }
+};
+
+/*
+ * Per operator timing: each MorphOperatorModule has a DSPOperatorTimer, which
+ * measures exclusive time, so time spent in nested operator scopes (the inputs of a
+ * morph operator) is not counted for the outer operator.
+ *
+ * A module is only processed by one thread at a time, so no synchronization is
+ * needed; the synth collects (and resets) the timers after rendering.
+ */
+struct DSPOperatorTimer
+{
+  uint64 calls = 0;
+  uint64 ticks = 0;
+};
+
+/* operator timers keyed by operator id; fixed capacity, so adding never allocates */
+class DSPOperatorTimers
+{
+public:
+  static constexpr size_t MAX_OPS = 256;
+
+  size_t           n_ops = 0;
+  uintptr_t        id[MAX_OPS];
+  DSPOperatorTimer timer[MAX_OPS];
+
+  void
+  add (uintptr_t op_id, const DSPOperatorTimer& op_timer)
+  {
+    size_t i = 0;
+    while (i < n_ops && id[i] != op_id)
+      i++;
+
+    if (i == n_ops)
+      {
+        if (n_ops == MAX_OPS) // ignore operators that don't fit
+          return;
+
+        id[n_ops] = op_id;
+        timer[n_ops] = DSPOperatorTimer();
+        n_ops++;
+      }
+    timer[i].calls += op_timer.calls;
+    timer[i].ticks += op_timer.ticks;
+  }
+  void
+  clear()
+  {
+    n_ops = 0;
+  }
+};
+
+class DSPOperatorScope
+{
+  DSPOperatorTimer *m_timer = nullptr;
+  DSPOperatorScope *m_parent = nullptr;
+  uint64            m_start = 0;
+  uint64            m_child_ticks = 0;
+
+  static DSPOperatorScope *swap_current (DSPOperatorScope *scope);
+public:
+  DSPOperatorScope (DSPOperatorTimer& timer)
+  {
+    if (DSPTimers::enabled())
+      {
+        m_timer = &timer;
+        m_parent = swap_current (this);
+        m_start = DSPTimers::now();
+      }
+  }
+  ~DSPOperatorScope()
+  {
+    if (m_timer)
+      {
+        const uint64 ticks = DSPTimers::now() - m_start;
+
+        m_timer->calls++;
+        m_timer->ticks += ticks > m_child_ticks ? ticks - m_child_ticks : 0;
+        if (m_parent)
+          m_parent->m_child_ticks += ticks;
+
+        swap_current (m_parent);
+      }
+  }
+};
+
+}
+
+#endif /* SPECTMORPH_DSP_TIMER_HH */
@@ -2,6 +2,7 @@
 
 #include "smmorphoutputmodule.hh"
 #include "smmorphutils.hh"
+#include "smdsptimer.hh"
 
 using namespace SpectMorph;
 
@@ -76,8 +77,8 @@ public:
   explicit EffectDecoderSource (LiveDecoderSource *source);
 
   void retrigger (int channel, float freq, int midi_velocity, float mix_freq) override;
-  Audio* audio() override;
-  AudioBlock* audio_block (size_t index) override;
+  const Audio* audio() override;
+  const AudioBlock* audio_block (size_t index) override;
 
   void set_skip (float m_skip);
 };
@@ -90,13 +91,13 @@ EffectDecoderSource::retrigger (int channel, float freq, int midi_velocity, floa
   source->retrigger (channel, freq, midi_velocity, mix_freq);
 }
 
-Audio*
+const Audio*
 EffectDecoderSource::audio()
 {
   return &m_audio;
 }
 
-AudioBlock*
+const AudioBlock*
 EffectDecoderSource::audio_block (size_t index)
 {
   const double time_ms = index + m_skip; // 1ms frame step
@@ -141,6 +142,10 @@ EffectDecoder::EffectDecoder (MorphOutputModule *output_module, LiveDecoderSourc
   chain_decoder.reset (new LiveDecoder (original_source));
   chain_decoder->set_filter_callback (filter_callback);
   use_skip_source = false;
+
+  filter_freq.resize (MAX_FILTER_BLOCK);
+  filter_reso.resize (MAX_FILTER_BLOCK);
+  filter_mix.resize (MAX_FILTER_BLOCK);
 }
 
 EffectDecoder::~EffectDecoder()
@@ -204,6 +209,7 @@ EffectDecoder::set_config (const MorphOutput::Config *cfg, float mix_freq)
     }
 
   chain_decoder->enable_noise (cfg->noise);
+  chain_decoder->enable_noise_bank (output_module->noise_bank());
   chain_decoder->enable_sines (cfg->sines);
 
   if (cfg->unison) // unison?
@@ -286,36 +292,80 @@ EffectDecoder::retrigger (int channel, float freq, int midi_velocity, float mix_
 }
 
 void
-EffectDecoder::process (size_t       n_values,
-                        const float *freq_in,
-                        float       *audio_out)
+EffectDecoder::set_random_seed (uint32_t seed)
+{
+  g_assert (chain_decoder);
+
+  chain_decoder->set_random_seed (seed);
+}
+
+void
+EffectDecoder::process (size_t           n_values,
+                        const float     *freq_in,
+                        float           *audio_out,
+                        LadderVCFVoice **deferred_filter)
 {
   g_assert (chain_decoder);
 
   chain_decoder->process (n_values, freq_in, audio_out);
 
-  if (adsr_envelope)
-    adsr_envelope->process (n_values, audio_out);
-  else
-    simple_envelope->process (n_values, audio_out);
+  {
+    DSPScopedTimer timer (DSPStage::ENVELOPE);
+    if (adsr_envelope)
+      adsr_envelope->process (n_values, audio_out);
+    else
+      simple_envelope->process (n_values, audio_out);
+  }
+
+  if (deferred_filter)
+    *deferred_filter = nullptr;
 
   if (filter_enabled)
     {
-      float junk[n_values];
-      const float *inputs[2] = { audio_out, junk };
-      float *outputs[2] = { audio_out, junk };
+      DSPScopedTimer timer (DSPStage::FILTER);
 
-      float freq[n_values], reso[n_values], mix[n_values];
-      for (uint i = 0; i < n_values; i++)
+      if (n_values <= MAX_FILTER_BLOCK)
         {
-          freq[i] = filter_cutoff_smooth.get_next() * exp2f (filter_envelope.get_next() * filter_depth_octaves);
-          reso[i] = filter_resonance_smooth.get_next();
-          mix[i]  = filter_mix_smooth.get_next();
+          filter_block (n_values, audio_out);
+
+          /* the caller can filter several voices at once using LadderVCFVoice::run_voices() */
+          if (deferred_filter)
+            *deferred_filter = &filter;
+          else
+            filter.run_block (n_values);
         }
-      filter.set_mix_in (mix);
+      else
+        {
+          size_t pos = 0;
+          while (pos < n_values)
+            {
+              size_t todo = n_values - pos;
+              if (todo > MAX_FILTER_BLOCK)
+                todo = MAX_FILTER_BLOCK;
+
+              filter_block (todo, audio_out + pos);
+              filter.run_block (todo);
+              pos += todo;
+            }
+        }
+    }
+}
 
-      filter.run_block (n_values, /* const cutoff */ 0, /* const reso */ 0, inputs, outputs, true, false, freq, reso);
+/* compute filter parameters for n_values <= MAX_FILTER_BLOCK samples and set up the filter block */
+void
+EffectDecoder::filter_block (size_t n_values, float *audio_out)
+{
+  for (uint i = 0; i < n_values; i++)
+    {
+      filter_freq[i] = filter_envelope.get_next() * filter_depth_octaves;
+      filter_reso[i] = filter_resonance_smooth.get_next();
+      filter_mix[i]  = filter_mix_smooth.get_next();
     }
+  fast_vector_exp2f (n_values, &filter_freq[0], &filter_freq[0]);
+  for (uint i = 0; i < n_values; i++)
+    filter_freq[i] *= filter_cutoff_smooth.get_next();
+
+  filter.set_block (audio_out, &filter_freq[0], &filter_reso[0], &filter_mix[0]);
 }
 
 void
@@ -40,18 +40,29 @@ class EffectDecoder
   LinearSmooth                          filter_resonance_smooth;
   LinearSmooth                          filter_mix_smooth;
   float                                 filter_depth_octaves;
-  LadderVCFNonLinear                    filter;
+  LadderVCFVoice                        filter;
+  std::vector<float>                    filter_freq;
+  std::vector<float>                    filter_reso;
+  std::vector<float>                    filter_mix;
 
+  void filter_block (size_t n_values, float *audio_out);
 public:
+  /* filter parameter buffers are allocated for this block size in the constructor;
+   * process() filters larger blocks in pieces (but can't defer filtering then)
+   */
+  static constexpr size_t MAX_FILTER_BLOCK = 4096;
+
   EffectDecoder (MorphOutputModule *output_module, LiveDecoderSource *source);
   ~EffectDecoder();
 
   void set_config (const MorphOutput::Config *cfg, float mix_freq);
 
   void retrigger (int channel, float freq, int midi_velocity, float mix_freq);
-  void process (size_t       n_values,
-                const float *freq_in,
-                float       *audio_out);
+  void set_random_seed (uint32_t seed);
+  void process (size_t           n_values,
+                const float     *freq_in,
+                float           *audio_out,
+                LadderVCFVoice **deferred_filter = nullptr);
   void release();
   bool done();
 
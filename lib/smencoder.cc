@@ -8,7 +8,6 @@
 #include "smutils.hh"
 #include "smblockutils.hh"
 #include "smalignedarray.hh"
-#include "smrandom.hh"
 
 #include <math.h>
 #include <stdio.h>
@@ -19,6 +18,8 @@
 #include <algorithm>
 #include <memory>
 #include <cinttypes>
+#include <atomic>
+#include <thread>
 
 using namespace SpectMorph;
 using std::vector;
@@ -26,9 +27,10 @@ using std::string;
 using std::map;
 using std::max;
 using std::complex;
+using std::min;
 
 static double
-magnitude (vector<float>::iterator i)
+magnitude (vector<float>::const_iterator i)
 {
   return sqrt (*i * *i + *(i+1) * *(i+1));
 }
@@ -231,6 +233,49 @@ EncoderParams::setup_params (const WavData& wav_data, double new_fundamental_fre
     }
 }
 
+/**
+ * Recompute the analysis window using the window type from the config
+ * (hann, hamming or blackman; default: hann).
+ *
+ * \returns false if the window type is not supported
+ */
+bool
+EncoderParams::setup_window()
+{
+  string window_type;
+  if (!get_param ("window", window_type))
+    window_type = "hann";
+
+  for (size_t i = 0; i < window.size(); i++)
+    {
+      if (i < frame_size)
+        {
+          if (window_type == "hann")
+            {
+              window[i] = window_cos (2.0 * i / (frame_size - 1) - 1.0);
+            }
+          else if (window_type == "hamming")
+            {
+              /* probably never a good idea, since the sidelobes of the spectrum
+               * do not roll off fast (as with the hann window)
+               */
+              window[i] = window_hamming (2.0 * i / (frame_size - 1) - 1.0);
+            }
+          else if (window_type == "blackman")
+            {
+              window[i] = window_blackman (2.0 * i / (frame_size - 1) - 1.0);
+            }
+          else
+            {
+              return false;
+            }
+        }
+      else
+        window[i] = 0;
+    }
+  return true;
+}
+
 void
 EncoderParams::set_kill_function (const std::function<bool()>& new_kill_function)
 {
@@ -261,12 +306,113 @@ Encoder::Encoder (const EncoderParams& enc_params)
   optimal_attack.attack_end_ms = 0;
 }
 
+namespace
+{
+
+/* scratch buffers for analyzing frames, one per encoder thread */
+class FrameScratch
+{
+public:
+  vector<double> stft_in;
+  float         *fft_in;
+  float         *fft_out;
+
+  FrameScratch (size_t fft_size) :
+    stft_in (fft_size),
+    fft_in (FFT::new_array_float (fft_size)),
+    fft_out (FFT::new_array_float (fft_size))
+  {
+  }
+  ~FrameScratch()
+  {
+    FFT::free_array_float (fft_in);
+    FFT::free_array_float (fft_out);
+  }
+  FrameScratch (const FrameScratch&) = delete;
+  FrameScratch& operator= (const FrameScratch&) = delete;
+};
+
+static vector<std::unique_ptr<FrameScratch>>
+new_frame_scratch (const EncoderParams& enc_params, size_t n_threads)
+{
+  vector<std::unique_ptr<FrameScratch>> scratch;
+  for (size_t t = 0; t < n_threads; t++)
+    scratch.emplace_back (new FrameScratch (enc_params.block_size * enc_params.zeropad));
+  return scratch;
+}
+
+/* number of frames a thread processes before fetching more work */
+static constexpr uint64 FRAME_CHUNK = 8;
+
+}
+
 /**
- * This function computes the short-time-fourier-transform (STFT) of the input
- * signal using a window to cut the individual frames out of the sample.
+ * Returns the number of threads for_each_frame() will use for n_frames frames.
+ */
+size_t
+Encoder::frame_threads (size_t n_frames)
+{
+  size_t n_threads = enc_params.n_threads;
+  if (enc_params.n_threads <= 0)
+    n_threads = std::thread::hardware_concurrency();
+
+  /* keep debug output in frame order */
+  if (Debug::enabled ("encoder"))
+    n_threads = 1;
+
+  n_threads = min<size_t> (n_threads, (n_frames + FRAME_CHUNK - 1) / FRAME_CHUNK);
+  return max<size_t> (n_threads, 1);
+}
+
+/**
+ * This function calls process_frame (thread_index, frame) for each frame, using
+ * frame_threads() threads (thread_index is in range [0, frame_threads()), so it can
+ * be used to access per thread scratch buffers).
+ *
+ * Frames are processed independently of each other, and each frame is computed by
+ * the same code, so the result doesn't depend on the number of threads. The kill
+ * function is only called by the thread calling for_each_frame().
  */
 void
-Encoder::compute_stft (const WavData& multi_channel_wav_data, int channel)
+Encoder::for_each_frame (size_t n_frames, const char *where, const std::function<void (size_t, uint64)>& process_frame)
+{
+  const size_t n_threads = frame_threads (n_frames);
+
+  std::atomic<uint64> next_frame { 0 };
+  std::atomic<bool>   stop { false };
+
+  auto process_frames = [&] (size_t thread_index)
+    {
+      uint64 frame;
+
+      while (!stop.load (std::memory_order_relaxed) && (frame = next_frame.fetch_add (FRAME_CHUNK)) < n_frames)
+        {
+          const uint64 end = min<uint64> (frame + FRAME_CHUNK, n_frames);
+
+          for (; frame < end; frame++)
+            process_frame (thread_index, frame);
+
+          if (thread_index == 0 && killed (where))
+            stop.store (true);
+        }
+    };
+
+  vector<std::thread> threads;
+  for (size_t t = 1; t < n_threads; t++)
+    threads.emplace_back (process_frames, t);
+
+  process_frames (0);
+
+  for (auto& thread : threads)
+    thread.join();
+}
+
+/**
+ * This function extracts the channel to be encoded from the input signal, and
+ * prepends the zero values that are needed to analyze the start of the signal.
+ */
+WavData
+Encoder::prepare_signal (const WavData& multi_channel_wav_data, int channel)
 {
   /* deinterleave multi channel signal */
   vector<float> single_channel_signal;
@@ -285,57 +431,80 @@ Encoder::compute_stft (const WavData& multi_channel_wav_data, int channel)
 
   wav_data.prepend (zero_values);
 
-  const uint64 n_values   = wav_data.n_values();
+  sample_count = wav_data.n_values();
+
+  return wav_data;
+}
+
+static uint64
+frame_count (const EncoderParams& enc_params, const WavData& wav_data)
+{
+  return (wav_data.n_values() + enc_params.frame_step - 1) / enc_params.frame_step;
+}
+
+static void
+compute_frame_spectrum (const EncoderParams& enc_params, const WavData& wav_data, uint64 frame, FrameScratch& scratch,
+                        EncoderBlock& audio_block, bool keep_original_fft)
+{
   const size_t frame_size = enc_params.frame_size;
   const size_t block_size = enc_params.block_size;
-  const int    zeropad    = enc_params.zeropad;
+  const size_t fft_size   = block_size * enc_params.zeropad;
   const auto&  window     = enc_params.window;
 
-  sample_count = n_values;
+  vector<double>& in = scratch.stft_in;
+  float *fft_in = scratch.fft_in;
+  float *fft_out = scratch.fft_out;
 
-  vector<double> in (block_size * zeropad), out (block_size * zeropad + 2);
+  const uint64 pos = frame * enc_params.frame_step;
 
-  float *fft_in = FFT::new_array_float (in.size());
-  float *fft_out = FFT::new_array_float (in.size());
+  /* start with zero block, so the incomplete blocks at end are zeropadded */
+  vector<float> block (block_size);
 
-  for (uint64 pos = 0; pos < n_values; pos += enc_params.frame_step)
+  for (size_t offset = 0; offset < block.size(); offset++)
     {
-      EncoderBlock audio_block;
+      if (pos + offset < wav_data.n_values())
+        block[offset] = wav_data[pos + offset];
+    }
+  vector<float> debug_samples (block.begin(), block.end());
+  Block::mul (enc_params.block_size, &block[0], &window[0]);
 
-      /* start with zero block, so the incomplete blocks at end are zeropadded */
-      vector<float> block (block_size);
+  int j = in.size() - enc_params.frame_size / 2;
+  for (vector<float>::const_iterator i = block.begin(); i != block.end(); i++)
+    in[(j++) % in.size()] = *i;
 
-      for (size_t offset = 0; offset < block.size(); offset++)
-        {
-          if (pos + offset < wav_data.n_values())
-            block[offset] = wav_data[pos + offset];
-        }
-      vector<float> debug_samples (block.begin(), block.end());
-      Block::mul (enc_params.block_size, &block[0], &window[0]);
+  vector<double> out (fft_size + 2);
 
-      int j = in.size() - enc_params.frame_size / 2;
-      for (vector<float>::const_iterator i = block.begin(); i != block.end(); i++)
-        in[(j++) % in.size()] = *i;
+  std::copy (in.begin(), in.end(), fft_in);
+  FFT::fftar_float (in.size(), fft_in, fft_out);
+  std::copy (fft_out, fft_out + in.size(), out.begin());
 
-      std::copy (in.begin(), in.end(), fft_in);
-      FFT::fftar_float (in.size(), fft_in, fft_out);
-      std::copy (fft_out, fft_out + in.size(), out.begin());
+  out[fft_size] = out[1];
+  out[fft_size + 1] = 0;
+  out[1] = 0;
 
-      out[block_size * zeropad] = out[1];
-      out[block_size * zeropad + 1] = 0;
-      out[1] = 0;
+  audio_block.noise.assign (out.begin(), out.end()); // <- will be overwritten by noise spectrum later on
+  if (keep_original_fft)
+    audio_block.original_fft.assign (out.begin(), out.end());
+  audio_block.debug_samples.assign (debug_samples.begin(), debug_samples.begin() + frame_size);
+}
 
-      audio_block.noise.assign (out.begin(), out.end()); // <- will be overwritten by noise spectrum later on
-      audio_block.original_fft.assign (out.begin(), out.end());
-      audio_block.debug_samples.assign (debug_samples.begin(), debug_samples.begin() + frame_size);
+/**
+ * This function computes the short-time-fourier-transform (STFT) of the input
+ * signal using a window to cut the individual frames out of the sample.
+ */
+void
+Encoder::compute_stft (const WavData& wav_data)
+{
+  const uint64 n_frames = frame_count (enc_params, wav_data);
+  auto scratch = new_frame_scratch (enc_params, frame_threads (n_frames));
 
-      audio_blocks.push_back (audio_block);
+  audio_blocks.clear();
+  audio_blocks.resize (n_frames);
 
-      if (killed ("_stft", audio_blocks.size() & 63))
-        break; // break to avoid leaking fft_in, fft_out
-    }
-  FFT::free_array_float (fft_in);
-  FFT::free_array_float (fft_out);
+  for_each_frame (n_frames, "_stft", [&] (size_t thread_index, uint64 frame)
+    {
+      compute_frame_spectrum (enc_params, wav_data, frame, *scratch[thread_index], audio_blocks[frame], true);
+    });
 }
 
 namespace
@@ -366,11 +535,20 @@ public:
 
 }
 
-/**
- * This function searches for peaks in the frame ffts. These are stored in frame_tracksels.
- */
-void
-Encoder::search_local_maxima()
+static double
+frame_max_magnitude (const EncoderParams& enc_params, const EncoderBlock& audio_block)
+{
+  double max_mag = 0;
+  for (size_t d = 2; d < enc_params.block_size * enc_params.zeropad; d += 2)
+    max_mag = max (max_mag, magnitude (audio_block.noise.begin() + d));
+
+  return max_mag;
+}
+
+/* max_mag is the maximum magnitude of all frames (see frame_max_magnitude) */
+static void
+search_frame_maxima (const EncoderParams& enc_params, double max_mag, uint64 n, const EncoderBlock& audio_block,
+                     vector<Tracksel>& tracksels)
 {
   const size_t block_size = enc_params.block_size;
   const size_t frame_size = enc_params.frame_size;
@@ -384,135 +562,144 @@ Encoder::search_local_maxima()
     window_weight += window[i];
   const double window_scale = 2.0 / window_weight;
 
-  // initialize tracksel structure
-  frame_tracksels.clear();
-  frame_tracksels.resize (audio_blocks.size());
-
-  // find maximum of all values
-  double max_mag = 0;
-  for (size_t n = 0; n < audio_blocks.size(); n++)
-    {
-      for (size_t d = 2; d < block_size * zeropad; d += 2)
-	{
-	  max_mag = max (max_mag, magnitude (audio_blocks[n].noise.begin() + d));
-	}
-    }
+  vector<double> mag_values (audio_block.noise.size() / 2);
+  for (size_t d = 0; d < block_size * zeropad; d += 2)
+    mag_values[d / 2] = magnitude (audio_block.noise.begin() + d);
 
-  for (size_t n = 0; n < audio_blocks.size(); n++)
+  for (size_t d = 2; d < block_size * zeropad; d += 2)
     {
-      vector<double> mag_values (audio_blocks[n].noise.size() / 2);
-      for (size_t d = 0; d < block_size * zeropad; d += 2)
-        mag_values[d / 2] = magnitude (audio_blocks[n].noise.begin() + d);
-
-      for (size_t d = 2; d < block_size * zeropad; d += 2)
-	{
 #if 0
-	  double phase = atan2 (*(audio_blocks[n]->noise.begin() + d),
-	                        *(audio_blocks[n]->noise.begin() + d + 1)) / 2 / M_PI;  /* range [-0.5 .. 0.5] */
+      double phase = atan2 (*(audio_block->noise.begin() + d),
+                            *(audio_block->noise.begin() + d + 1)) / 2 / M_PI;  /* range [-0.5 .. 0.5] */
 #endif
-          enum { PEAK_NONE, PEAK_SINGLE, PEAK_DOUBLE } peak_type = PEAK_NONE;
+      enum { PEAK_NONE, PEAK_SINGLE, PEAK_DOUBLE } peak_type = PEAK_NONE;
 
-          if (mag_values[d/2] > mag_values[d/2-1] && mag_values[d/2] > mag_values[d/2+1])   /* search for peaks in fft magnitudes */
+      if (mag_values[d/2] > mag_values[d/2-1] && mag_values[d/2] > mag_values[d/2+1])   /* search for peaks in fft magnitudes */
+        {
+          /* single peak is the common case, where the magnitude of the middle value is
+           * larger than the magnitude of the left and right neighbour
+           */
+          peak_type = PEAK_SINGLE;
+        }
+      else
+        {
+          double epsilon_fact = 1.0 + 1e-8;
+          if (mag_values[d/2] < mag_values[d/2+1] * epsilon_fact && mag_values[d/2] * epsilon_fact > mag_values[d/2 + 1]
+          &&  mag_values[d/2] > mag_values[d/2-1] && mag_values[d/2] > mag_values[d/2+2])
             {
-              /* single peak is the common case, where the magnitude of the middle value is
-               * larger than the magnitude of the left and right neighbour
+              /* double peak is a special case, where two values in the spectrum have (almost) equal magnitude
+               * in this case, this magnitude must be larger than the value left and right of the _two_
+               * maximal values in the spectrum
                */
-              peak_type = PEAK_SINGLE;
-            }
-          else
-            {
-              double epsilon_fact = 1.0 + 1e-8;
-              if (mag_values[d/2] < mag_values[d/2+1] * epsilon_fact && mag_values[d/2] * epsilon_fact > mag_values[d/2 + 1]
-              &&  mag_values[d/2] > mag_values[d/2-1] && mag_values[d/2] > mag_values[d/2+2])
-                {
-                  /* double peak is a special case, where two values in the spectrum have (almost) equal magnitude
-                   * in this case, this magnitude must be larger than the value left and right of the _two_
-                   * maximal values in the spectrum
-                   */
-                  peak_type = PEAK_DOUBLE;
-                }
+              peak_type = PEAK_DOUBLE;
             }
+        }
 
-          const double mag2 = db_from_factor (mag_values[d / 2] / max_mag, -100);
-          debug ("dbspectrum:%zd %f\n", n, mag2);
+      const double mag2 = db_from_factor (mag_values[d / 2] / max_mag, -100);
+      debug ("dbspectrum:%" PRId64 " %f\n", n, mag2);
 
-          if (peak_type != PEAK_NONE)
+      if (peak_type != PEAK_NONE)
+        {
+          if (mag2 > -90)
             {
-              if (mag2 > -90)
-                {
-                  size_t ds, de;
-                  for (ds = d / 2 - 1; ds > 0 && mag_values[ds] < mag_values[ds + 1]; ds--);
-                  for (de = d / 2 + 1; de < (mag_values.size() - 1) && mag_values[de] > mag_values[de + 1]; de++);
+              size_t ds, de;
+              for (ds = d / 2 - 1; ds > 0 && mag_values[ds] < mag_values[ds + 1]; ds--);
+              for (de = d / 2 + 1; de < (mag_values.size() - 1) && mag_values[de] > mag_values[de + 1]; de++);
 
-                  const double normalized_peak_width = (de - ds) * frame_size / double (block_size * zeropad);
+              const double normalized_peak_width = (de - ds) * frame_size / double (block_size * zeropad);
 
-                  bool peak_ok;
-                  double value;
-                  if (enc_params.get_param ("peak-width", value))
-                    peak_ok = normalized_peak_width > value;
-                  else
-                    peak_ok = normalized_peak_width > 2.9;
+              bool peak_ok;
+              double value;
+              if (enc_params.get_param ("peak-width", value))
+                peak_ok = normalized_peak_width > value;
+              else
+                peak_ok = normalized_peak_width > 2.9;
 
-                  if (peak_ok)
+              if (peak_ok)
+                {
+                  const double mag1 = db_from_factor (mag_values[d / 2 - 1] / max_mag, -100);
+                  const double mag3 = db_from_factor (mag_values[d / 2 + 1] / max_mag, -100);
+                  //double freq = d / 2 * mix_freq / (block_size * zeropad); /* bin frequency */
+
+                  QInterpolator mag_interp (mag1, mag2, mag3);
+                  double x_max = mag_interp.x_max();
+                  double tfreq = (d / 2 + x_max) * mix_freq / (block_size * zeropad);
+
+                  double peak_mag_db = mag_interp.eval (x_max);
+                  double peak_mag = db_to_factor (peak_mag_db) * max_mag;
+
+                  // use the interpolation formula for the complex values to find the phase
+                  QInterpolator re_interp (audio_block.noise[d-2], audio_block.noise[d], audio_block.noise[d+2]);
+                  QInterpolator im_interp (audio_block.noise[d-1], audio_block.noise[d+1], audio_block.noise[d+3]);
+/*
+                  if (mag2 > -20)
+                    printf ("%f %f %f %f %f\n", phase, last_phase[d], phase_diff, phase_diff * mix_freq / (block_size * zeropad) * overlap, tfreq);
+*/
+                  Tracksel tracksel;
+                  tracksel.frame = n;
+                  tracksel.d = d;
+                  tracksel.freq = tfreq;
+                  tracksel.mag = peak_mag * window_scale;
+                  tracksel.mag2 = mag2;
+                  tracksel.next = 0;
+                  tracksel.prev = 0;
+
+                  const double re_mag = re_interp.eval (x_max);
+                  const double im_mag = im_interp.eval (x_max);
+                  double phase = atan2 (im_mag, re_mag) + 0.5 * M_PI;
+                  // correct for the odd-centered analysis
                     {
-                      const double mag1 = db_from_factor (mag_values[d / 2 - 1] / max_mag, -100);
-                      const double mag3 = db_from_factor (mag_values[d / 2 + 1] / max_mag, -100);
-                      //double freq = d / 2 * mix_freq / (block_size * zeropad); /* bin frequency */
-
-                      QInterpolator mag_interp (mag1, mag2, mag3);
-                      double x_max = mag_interp.x_max();
-                      double tfreq = (d / 2 + x_max) * mix_freq / (block_size * zeropad);
-
-                      double peak_mag_db = mag_interp.eval (x_max);
-                      double peak_mag = db_to_factor (peak_mag_db) * max_mag;
-
-                      // use the interpolation formula for the complex values to find the phase
-                      QInterpolator re_interp (audio_blocks[n].noise[d-2], audio_blocks[n].noise[d], audio_blocks[n].noise[d+2]);
-                      QInterpolator im_interp (audio_blocks[n].noise[d-1], audio_blocks[n].noise[d+1], audio_blocks[n].noise[d+3]);
-    /*
-                      if (mag2 > -20)
-                        printf ("%f %f %f %f %f\n", phase, last_phase[d], phase_diff, phase_diff * mix_freq / (block_size * zeropad) * overlap, tfreq);
-    */
-                      Tracksel tracksel;
-                      tracksel.frame = n;
-                      tracksel.d = d;
-                      tracksel.freq = tfreq;
-                      tracksel.mag = peak_mag * window_scale;
-                      tracksel.mag2 = mag2;
-                      tracksel.next = 0;
-                      tracksel.prev = 0;
-
-                      const double re_mag = re_interp.eval (x_max);
-                      const double im_mag = im_interp.eval (x_max);
-                      double phase = atan2 (im_mag, re_mag) + 0.5 * M_PI;
-                      // correct for the odd-centered analysis
-                        {
-                          phase -= (frame_size - 1) / 2.0 / mix_freq * tracksel.freq * 2 * M_PI;
-                          phase = normalize_phase (phase);
-                        }
-                      tracksel.phase = phase;
-
-                      // FIXME: need a different criterion here
-                      // mag2 > -30 doesn't track all partials
-                      // mag2 > -60 tracks lots of junk, too
-                      if (mag2 > -90 && tracksel.freq > 10)
-                        frame_tracksels[n].push_back (tracksel);
-
-                      if (peak_type == PEAK_DOUBLE)
-                        d += 2;
+                      phase -= (frame_size - 1) / 2.0 / mix_freq * tracksel.freq * 2 * M_PI;
+                      phase = normalize_phase (phase);
                     }
+                  tracksel.phase = phase;
+
+                  // FIXME: need a different criterion here
+                  // mag2 > -30 doesn't track all partials
+                  // mag2 > -60 tracks lots of junk, too
+                  if (mag2 > -90 && tracksel.freq > 10)
+                    tracksels.push_back (tracksel);
+
+                  if (peak_type == PEAK_DOUBLE)
+                    d += 2;
                 }
+            }
 #if 0
-              last_phase[d] = phase;
+          last_phase[d] = phase;
 #endif
-            }
-	}
-
-      if (killed ("_maxima", n & 15))
-        return;
+        }
     }
 }
 
+/**
+ * This function searches for peaks in the frame ffts. These are stored in frame_tracksels.
+ */
+void
+Encoder::search_local_maxima()
+{
+  // initialize tracksel structure
+  frame_tracksels.clear();
+  frame_tracksels.resize (audio_blocks.size());
+
+  // find maximum of all values
+  vector<double> frame_max_mag (audio_blocks.size());
+  for_each_frame (audio_blocks.size(), "_maxima", [&] (size_t thread_index, uint64 n)
+    {
+      frame_max_mag[n] = frame_max_magnitude (enc_params, audio_blocks[n]);
+    });
+  if (killed ("_maxima"))
+    return;
+
+  double max_mag = 0;
+  for (auto frame_max : frame_max_mag)
+    max_mag = max (max_mag, frame_max);
+
+  for_each_frame (audio_blocks.size(), "_maxima", [&] (size_t thread_index, uint64 n)
+    {
+      search_frame_maxima (enc_params, max_mag, n, audio_blocks[n], frame_tracksels[n]);
+    });
+}
+
 /// @cond
 struct
 PeakIndex
@@ -537,83 +724,87 @@ partial_index_cmp (const PeakIndex& a, const PeakIndex& b)
 
 /**
  * This function links the spectral peaks (contained in the Tracksel structure)
- * of successive frames together by setting the prev and next pointers. It
+ * of two successive frames together by setting the prev and next pointers. It
  * tries to minimize the frequency difference between the peaks that are linked
  * together, while using a threshold of 5% frequency derivation.
  */
-void
-Encoder::link_partials()
+static void
+link_frame_partials (vector<Tracksel>& current, vector<Tracksel>& next)
 {
-  for (size_t n = 0; n + 1 < audio_blocks.size(); n++)
+  // build sorted index for this frame
+  vector<PeakIndex> current_index;
+  for (vector<Tracksel>::iterator i = current.begin(); i != current.end(); i++)
+    current_index.push_back (PeakIndex (i->freq, i));
+  sort (current_index.begin(), current_index.end(), partial_index_cmp);
+
+  // build sorted index for next frame
+  vector<PeakIndex> next_index;
+  for (vector<Tracksel>::iterator i = next.begin(); i != next.end(); i++)
+    next_index.push_back (PeakIndex (i->freq, i));
+  sort (next_index.begin(), next_index.end(), partial_index_cmp);
+
+  vector<PeakIndex>::iterator ci = current_index.begin();
+  vector<PeakIndex>::iterator ni = next_index.begin();
+  if (ni != next_index.end())    // if current or next frame are empty (no peaks) there is nothing to do
     {
-      // build sorted index for this frame
-      vector<PeakIndex> current_index;
-      for (vector<Tracksel>::iterator i = frame_tracksels[n].begin(); i != frame_tracksels[n].end(); i++)
-        current_index.push_back (PeakIndex (i->freq, i));
-      sort (current_index.begin(), current_index.end(), partial_index_cmp);
-
-      // build sorted index for next frame
-      vector<PeakIndex> next_index;
-      for (vector<Tracksel>::iterator i = frame_tracksels[n + 1].begin(); i != frame_tracksels[n + 1].end(); i++)
-        next_index.push_back (PeakIndex (i->freq, i));
-      sort (next_index.begin(), next_index.end(), partial_index_cmp);
-
-      vector<PeakIndex>::iterator ci = current_index.begin();
-      vector<PeakIndex>::iterator ni = next_index.begin();
-      if (ni != next_index.end())    // if current or next frame are empty (no peaks) there is nothing to do
+      while (ci != current_index.end())
         {
-          while (ci != current_index.end())
+          /*
+           * increment ni as long as incrementing it makes ni point to a
+           * better (closer) peak below ci's frequency
+           */
+          vector<PeakIndex>::iterator inc_ni;
+          do
             {
-              /*
-               * increment ni as long as incrementing it makes ni point to a
-               * better (closer) peak below ci's frequency
-               */
-              vector<PeakIndex>::iterator inc_ni;
-              do
-                {
-                  inc_ni = ni + 1;
-                  if (inc_ni < next_index.end() && inc_ni->freq < ci->freq)
-                    ni = inc_ni;
-                }
-              while (ni == inc_ni);
-
-              /*
-               * possible candidates for a match are
-               * - ni      - which contains the greatest peak with a smaller frequency than ci->freq
-               * - ni + 1  - which contains the smallest peak with a greater frequency that ci->freq
-               * => choose the candidate which is closer to ci->freq
-               */
-              vector<PeakIndex>::iterator besti = ni;
-              if (ni + 1 < next_index.end() && fabs (ci->freq - (ni + 1)->freq) < fabs (ci->freq - ni->freq))
-                besti = ni + 1;
-
-              const double delta = fabs (ci->freq - besti->freq) / ci->freq;
-              if (delta < 0.05) /* less than 5% frequency derivation */
+              inc_ni = ni + 1;
+              if (inc_ni < next_index.end() && inc_ni->freq < ci->freq)
+                ni = inc_ni;
+            }
+          while (ni == inc_ni);
+
+          /*
+           * possible candidates for a match are
+           * - ni      - which contains the greatest peak with a smaller frequency than ci->freq
+           * - ni + 1  - which contains the smallest peak with a greater frequency that ci->freq
+           * => choose the candidate which is closer to ci->freq
+           */
+          vector<PeakIndex>::iterator besti = ni;
+          if (ni + 1 < next_index.end() && fabs (ci->freq - (ni + 1)->freq) < fabs (ci->freq - ni->freq))
+            besti = ni + 1;
+
+          const double delta = fabs (ci->freq - besti->freq) / ci->freq;
+          if (delta < 0.05) /* less than 5% frequency derivation */
+            {
+              if (!besti->prev || besti->prev_delta > delta)
                 {
-                  if (!besti->prev || besti->prev_delta > delta)
-                    {
-                      besti->prev = &(*ci);
-                      besti->prev_delta = delta;
-                    }
+                  besti->prev = &(*ci);
+                  besti->prev_delta = delta;
                 }
-              ci++;
             }
+          ci++;
+        }
 
-          /* link best matches (with the smallest frequency derivation) */
-          for (ni = next_index.begin(); ni != next_index.end(); ni++)
+      /* link best matches (with the smallest frequency derivation) */
+      for (ni = next_index.begin(); ni != next_index.end(); ni++)
+        {
+          if (ni->prev)
             {
-              if (ni->prev)
-                {
-                  Tracksel *crosslink_a = &(*ni->prev->i);
-                  Tracksel *crosslink_b = &(*ni->i);
-                  crosslink_a->next = crosslink_b;
-                  crosslink_b->prev = crosslink_a;
-                }
+              Tracksel *crosslink_a = &(*ni->prev->i);
+              Tracksel *crosslink_b = &(*ni->i);
+              crosslink_a->next = crosslink_b;
+              crosslink_b->prev = crosslink_a;
             }
         }
     }
 }
 
+void
+Encoder::link_partials()
+{
+  for (size_t n = 0; n + 1 < audio_blocks.size(); n++)
+    link_frame_partials (frame_tracksels[n], frame_tracksels[n + 1]);
+}
+
 /**
  * This function validates that the partials found by the peak linking have
  * good quality.
@@ -651,78 +842,81 @@ Encoder::validate_partials()
     }
 }
 
-/**
- * This function subtracts the partials from the audio signal, to get the
- * residue (remaining energy not corresponding to sine frequencies).
- */
-void
-Encoder::spectral_subtract()
+static void
+subtract_frame_partials (const EncoderParams& enc_params, uint64 frame, FrameScratch& scratch, EncoderBlock& audio_block)
 {
   const size_t block_size = enc_params.block_size;
   const size_t frame_size = enc_params.frame_size;
   const size_t zeropad    = enc_params.zeropad;
   const auto&  window     = enc_params.window;
 
-  float *fft_in = FFT::new_array_float (block_size * zeropad);
-  float *fft_out = FFT::new_array_float (block_size * zeropad);
+  float *fft_in = scratch.fft_in;
+  float *fft_out = scratch.fft_out;
 
-  for (uint64 frame = 0; frame < audio_blocks.size(); frame++)
+  AlignedArray<float,16> signal (frame_size);
+  for (size_t i = 0; i < audio_block.freqs.size(); i++)
     {
-      AlignedArray<float,16> signal (frame_size);
-      for (size_t i = 0; i < audio_blocks[frame].freqs.size(); i++)
-	{
-          const double freq = audio_blocks[frame].freqs[i];
-	  const double mag = audio_blocks[frame].mags[i];
-	  const double phase = audio_blocks[frame].phases[i];
+      const double freq = audio_block.freqs[i];
+      const double mag = audio_block.mags[i];
+      const double phase = audio_block.phases[i];
 
-          VectorSinParams params;
-          params.mix_freq = enc_params.mix_freq;
-          params.freq = freq;
-          params.phase = phase;
-          params.mag = mag;
-          params.mode = VectorSinParams::ADD;
-
-          fast_vector_sinf (params, &signal[0], &signal[frame_size]);
-	}
-      vector<double> out (block_size * zeropad + 2);
-      // apply window
-      std::fill (fft_in, fft_in + block_size * zeropad, 0);
-      for (size_t k = 0; k < frame_size; k++)
-        fft_in[k] = window[k] * signal[k];
-      // FFT
-      FFT::fftar_float (block_size * zeropad, fft_in, fft_out);
-      std::copy (fft_out, fft_out + block_size * zeropad, out.begin());
-      out[block_size * zeropad] = out[1];
-      out[block_size * zeropad + 1] = 0;
-      out[1] = 0;
-
-      // subtract spectrum from audio spectrum
-      for (size_t d = 0; d < block_size * zeropad; d += 2)
-	{
-	  double re = out[d], im = out[d + 1];
-	  double sub_mag = sqrt (re * re + im * im);
-	  debug ("subspectrum:%" PRId64 " %g\n", frame, sub_mag);
+      VectorSinParams params;
+      params.mix_freq = enc_params.mix_freq;
+      params.freq = freq;
+      params.phase = phase;
+      params.mag = mag;
+      params.mode = VectorSinParams::ADD;
 
-	  double mag = magnitude (audio_blocks[frame].noise.begin() + d);
-	  debug ("spectrum:%" PRId64 " %g\n", frame, mag);
-	  if (mag > 0)
-	    {
-	      audio_blocks[frame].noise[d] /= mag;
-	      audio_blocks[frame].noise[d + 1] /= mag;
-	      mag -= sub_mag;
-	      if (mag < 0)
-		mag = 0;
-	      audio_blocks[frame].noise[d] *= mag;
-	      audio_blocks[frame].noise[d + 1] *= mag;
-	    }
-	  debug ("finalspectrum:%" PRId64 " %g\n", frame, mag);
-	}
+      fast_vector_sinf (params, &signal[0], &signal[frame_size]);
+    }
+  vector<double> out (block_size * zeropad + 2);
+  // apply window
+  std::fill (fft_in, fft_in + block_size * zeropad, 0);
+  for (size_t k = 0; k < frame_size; k++)
+    fft_in[k] = window[k] * signal[k];
+  // FFT
+  FFT::fftar_float (block_size * zeropad, fft_in, fft_out);
+  std::copy (fft_out, fft_out + block_size * zeropad, out.begin());
+  out[block_size * zeropad] = out[1];
+  out[block_size * zeropad + 1] = 0;
+  out[1] = 0;
+
+  // subtract spectrum from audio spectrum
+  for (size_t d = 0; d < block_size * zeropad; d += 2)
+    {
+      double re = out[d], im = out[d + 1];
+      double sub_mag = sqrt (re * re + im * im);
+      debug ("subspectrum:%" PRId64 " %g\n", frame, sub_mag);
 
-      if (killed ("_subtract", frame & 7))
-        return;
+      double mag = magnitude (audio_block.noise.begin() + d);
+      debug ("spectrum:%" PRId64 " %g\n", frame, mag);
+      if (mag > 0)
+        {
+          audio_block.noise[d] /= mag;
+          audio_block.noise[d + 1] /= mag;
+          mag -= sub_mag;
+          if (mag < 0)
+    	mag = 0;
+          audio_block.noise[d] *= mag;
+          audio_block.noise[d + 1] *= mag;
+        }
+      debug ("finalspectrum:%" PRId64 " %g\n", frame, mag);
     }
-  FFT::free_array_float (fft_in);
-  FFT::free_array_float (fft_out);
+}
+
+/**
+ * This function subtracts the partials from the audio signal, to get the
+ * residue (remaining energy not corresponding to sine frequencies).
+ */
+void
+Encoder::spectral_subtract()
+{
+  auto scratch = new_frame_scratch (enc_params, frame_threads (audio_blocks.size()));
+
+  for_each_frame (audio_blocks.size(), "_subtract", [&] (size_t thread_index, uint64 frame)
+    {
+      subtract_frame_partials (enc_params, frame, *scratch[thread_index], audio_blocks[frame]);
+    });
 }
 
 template<class AIter, class BIter>
@@ -923,21 +1117,22 @@ remove_small_partials (EncoderBlock& audio_block)
  * This function reestimates the magnitudes and phases of the partials found
  * in the previous steps.
  */
+static void
+optimize_frame_partials (const EncoderParams& enc_params, int optimization_level, uint64 frame, EncoderBlock& audio_block)
+{
+  if (optimization_level >= 1) // redo FFT estmates, only better
+    refine_sine_params_fast (audio_block, enc_params.mix_freq, frame, enc_params.window);
+
+  remove_small_partials (audio_block);
+}
+
 void
 Encoder::optimize_partials (int optimization_level)
 {
-  const double mix_freq = enc_params.mix_freq;
-
-  for (uint64 frame = 0; frame < audio_blocks.size(); frame++)
+  for_each_frame (audio_blocks.size(), "_optimize", [&] (size_t thread_index, uint64 frame)
     {
-      if (optimization_level >= 1) // redo FFT estmates, only better
-        refine_sine_params_fast (audio_blocks[frame], mix_freq, frame, enc_params.window);
-
-      remove_small_partials (audio_blocks[frame]);
-
-      if (killed ("_optimize"))
-        return;
-    }
+      optimize_frame_partials (enc_params, optimization_level, frame, audio_blocks[frame]);
+    });
 }
 
 static double
@@ -1065,12 +1260,8 @@ xnoise_envelope_to_spectrum (int frame,
     }
 }
 
-/**
- * This function tries to approximate the residual by a spectral envelope
- * for a noise signal.
- */
-void
-Encoder::approx_noise()
+static void
+approx_frame_noise (const EncoderParams& enc_params, uint64 frame, EncoderBlock& audio_block)
 {
   const size_t block_size = enc_params.block_size;
   const size_t frame_size = enc_params.frame_size;
@@ -1084,123 +1275,273 @@ Encoder::approx_noise()
   // sum_w2 is the average influence of the window (w[x]^2), multiplied with frame_size
   const double norm = 0.5 * enc_params.mix_freq * sum_w2;
 
-  for (uint64 frame = 0; frame < audio_blocks.size(); frame++)
+  vector<double> noise_envelope (32);
+  vector<double> spectrum (audio_block.noise.begin(), audio_block.noise.end());
+
+  /* A complex FFT would preserve the energy of the input signal exactly; the difference to
+   * our (real) FFT is that every value in the complex spectrum occurs twice, once as "positive"
+   * frequency, once as "negative" frequency - except for two spectrum values: the value
+   * for frequency 0, and the value for frequency mix_freq / 2.
+   *
+   * To make this FFT energy preserving, we scale those values with a factor of sqrt (2) so
+   * that their energy is twice as big (energy == squared value). Then we scale the whole
+   * thing with a factor of 0.5, and we get an energy preserving transformation.
+   */
+  spectrum[0] /= sqrt (2);
+  spectrum[spectrum.size() - 2] /= sqrt (2);
+
+  approximate_noise_spectrum (frame, enc_params.mix_freq, spectrum, noise_envelope, norm);
+
+  /// DEBUG CODE {
+  const size_t fft_size = block_size * zeropad;
+  const double debug_norm = fft_size * 0.5 * sum_w2;
+
+  vector<double> approx_spectrum (fft_size);
+  xnoise_envelope_to_spectrum (frame, enc_params.mix_freq, noise_envelope, approx_spectrum, norm);
+  for (size_t i = 0; i < approx_spectrum.size(); i += 2)
+    debug ("spect_approx:%" PRId64 " %g\n", frame, approx_spectrum[i]);
+
+  double spect_energy = 0;
+  for (vector<double>::iterator si = approx_spectrum.begin(); si != approx_spectrum.end(); si++)
+    spect_energy += *si * *si / debug_norm;
+
+  double b4_energy = 0;
+  for (vector<double>::iterator si = spectrum.begin(); si != spectrum.end(); si++)
+    b4_energy += *si * *si / debug_norm;
+
+  double r_energy = 0;
+  for (vector<float>::iterator ri = audio_block.debug_samples.begin(); ri != audio_block.debug_samples.end(); ri++)
+    r_energy += *ri * *ri / audio_block.debug_samples.size();
+
+  debug ("noiseenergy:%" PRId64 " %f %f %f\n", frame, spect_energy, b4_energy, r_energy);
+  /// } DEBUG_CODE
+  audio_block.noise.assign (noise_envelope.begin(), noise_envelope.end());
+}
+
+/**
+ * This function tries to approximate the residual by a spectral envelope
+ * for a noise signal.
+ */
+void
+Encoder::approx_noise()
+{
+  for_each_frame (audio_blocks.size(), "_noise", [&] (size_t thread_index, uint64 frame)
     {
-      vector<double> noise_envelope (32);
-      vector<double> spectrum (audio_blocks[frame].noise.begin(), audio_blocks[frame].noise.end());
-
-      /* A complex FFT would preserve the energy of the input signal exactly; the difference to
-       * our (real) FFT is that every value in the complex spectrum occurs twice, once as "positive"
-       * frequency, once as "negative" frequency - except for two spectrum values: the value
-       * for frequency 0, and the value for frequency mix_freq / 2.
-       *
-       * To make this FFT energy preserving, we scale those values with a factor of sqrt (2) so
-       * that their energy is twice as big (energy == squared value). Then we scale the whole
-       * thing with a factor of 0.5, and we get an energy preserving transformation.
-       */
-      spectrum[0] /= sqrt (2);
-      spectrum[spectrum.size() - 2] /= sqrt (2);
+      approx_frame_noise (enc_params, frame, audio_blocks[frame]);
+    });
+}
+
+namespace
+{
+
+/* number of frames used for attack estimation */
+static constexpr size_t ATTACK_FRAMES = 20;
+
+/*
+ * Error model for the attack envelope: the partials of the first frames are
+ * resynthesized, the attack envelope is applied, and the overlap-added signal
+ * is compared to the original signal.
+ *
+ * Only a small part of the signal depends on the attack parameters: before the
+ * first frame that produces output, the decoded signal is zero, and after the
+ * last frame that is affected by the attack, the decoded signal is the sum of
+ * the unmodified frames. The errors for these two regions are precomputed as
+ * prefix sums, so error() only needs to decode the samples in between.
+ */
+class AttackErrorModel
+{
+  const size_t frame_size;
+  const size_t frame_step;
+  const double frame_step_ms;
+  const double mix_freq;
 
-      approximate_noise_spectrum (frame, enc_params.mix_freq, spectrum, noise_envelope, norm);
+  vector<vector<double>> windowed_signal; // resynthesized frames, multiplied with window
+  vector<double>         orig_signal;
+  vector<double>         zero_error_sum;  // prefix sum of errors if decoded signal is zero
+  vector<double>         full_error_sum;  // prefix sum of errors if no frame is affected by the attack
 
-      /// DEBUG CODE {
-      const size_t fft_size = block_size * zeropad;
-      const double debug_norm = fft_size * 0.5 * sum_w2;
+  /* work buffers, so error() doesn't allocate memory */
+  vector<double>         decoded_signal;
+  vector<size_t>         zero_values;
+  vector<size_t>         attack_values;
 
-      vector<double> approx_spectrum (fft_size);
-      xnoise_envelope_to_spectrum (frame, enc_params.mix_freq, noise_envelope, approx_spectrum, norm);
-      for (size_t i = 0; i < approx_spectrum.size(); i += 2)
-        debug ("spect_approx:%" PRId64 " %g\n", frame, approx_spectrum[i]);
+  double
+  sample_ms (size_t f, size_t n) const
+  {
+    return f * frame_step_ms + n * 1000.0 / mix_freq;
+  }
+  size_t samples_before (size_t f, double ms) const;
+  double scale (size_t n_zero_values) const;
 
-      double spect_energy = 0;
-      for (vector<double>::iterator si = approx_spectrum.begin(); si != approx_spectrum.end(); si++)
-        spect_energy += *si * *si / debug_norm;
+public:
+  AttackErrorModel (const EncoderParams& enc_params, const vector<vector<double>>& unscaled_signal, const vector<EncoderBlock>& audio_blocks);
 
-      double b4_energy = 0;
-      for (vector<double>::iterator si = spectrum.begin(); si != spectrum.end(); si++)
-        b4_energy += *si * *si / debug_norm;
+  double error (double attack_start_ms, double attack_end_ms);
+  double frame_scale (size_t f, double attack_start_ms) const;
+  void   sample_times (double start_ms, double end_ms, vector<double>& times) const;
+};
+
+AttackErrorModel::AttackErrorModel (const EncoderParams& enc_params, const vector<vector<double>>& unscaled_signal,
+                                    const vector<EncoderBlock>& audio_blocks) :
+  frame_size (enc_params.frame_size),
+  frame_step (enc_params.frame_step),
+  frame_step_ms (enc_params.frame_step_ms),
+  mix_freq (enc_params.mix_freq)
+{
+  const size_t frames = unscaled_signal.size();
 
-      double r_energy = 0;
-      for (vector<float>::iterator ri = audio_blocks[frame].debug_samples.begin(); ri != audio_blocks[frame].debug_samples.end(); ri++)
-        r_energy += *ri * *ri / audio_blocks[frame].debug_samples.size();
+  orig_signal.resize (frame_size + frame_step * frames);
 
-      debug ("noiseenergy:%" PRId64 " %f %f %f\n", frame, spect_energy, b4_energy, r_energy);
-      /// } DEBUG_CODE
-      audio_blocks[frame].noise.assign (noise_envelope.begin(), noise_envelope.end());
+  vector<double> full_signal (orig_signal.size());
+  for (size_t f = 0; f < frames; f++)
+    {
+      vector<double> signal (frame_size);
+      for (size_t n = 0; n < frame_size; n++)
+        {
+          signal[n] = unscaled_signal[f][n] * enc_params.window[n];
 
-      if (killed ("_noise", frame & 7))
-        return;
+          full_signal[f * frame_step + n] += signal[n];
+          orig_signal[f * frame_step + n] = audio_blocks[f].debug_samples[n];
+        }
+      windowed_signal.push_back (signal);
     }
+
+  zero_error_sum.resize (orig_signal.size() + 1);
+  full_error_sum.resize (orig_signal.size() + 1);
+  for (size_t i = 0; i < orig_signal.size(); i++)
+    {
+      const double error = orig_signal[i] - full_signal[i];
+
+      zero_error_sum[i + 1] = zero_error_sum[i] + orig_signal[i] * orig_signal[i];
+      full_error_sum[i + 1] = full_error_sum[i] + error * error;
+    }
+
+  decoded_signal.resize (orig_signal.size());
+  zero_values.resize (frames);
+  attack_values.resize (frames);
+}
+
+/* number of samples n of frame f with sample_ms (f, n) < ms */
+size_t
+AttackErrorModel::samples_before (size_t f, double ms) const
+{
+  const double estimate = ceil ((ms - f * frame_step_ms) * mix_freq / 1000.0);
+
+  size_t n = sm_bound<double> (0, estimate, frame_size);
+
+  /* correct rounding errors of the estimate */
+  while (n > 0 && sample_ms (f, n - 1) >= ms)
+    n--;
+  while (n < frame_size && sample_ms (f, n) < ms)
+    n++;
+
+  return n;
 }
 
 double
-Encoder::attack_error (const vector< vector<double> >& unscaled_signal, const Attack& attack, vector<double>& out_scale)
+AttackErrorModel::scale (size_t n_zero_values) const
 {
-  const size_t frames = unscaled_signal.size();
-  double total_error = 0;
-  vector<double> decoded_signal (enc_params.frame_size + enc_params.frame_step * frames);
-  vector<double> orig_signal (decoded_signal.size());
+  if (n_zero_values == 0)
+    return 1.0;
+
+  const size_t samples_in_frame = frame_size - n_zero_values;
+  if (samples_in_frame < (frame_size / 8))
+    {
+      /* if we have very few samples in frame, the partials will
+       * not be reliable, so in this case we cancel out the frame
+       */
+      return 0;
+    }
+  else
+    {
+      /* based on an incomplete frame, we boost the partials
+       * to obtain an estimate for one whole frame
+       */
+      return frame_size / double (samples_in_frame);
+    }
+}
 
-  const auto& window = enc_params.window;
+double
+AttackErrorModel::frame_scale (size_t f, double attack_start_ms) const
+{
+  return scale (samples_before (f, attack_start_ms));
+}
 
+/* sorted times of all samples of all frames within [start_ms, end_ms) */
+void
+AttackErrorModel::sample_times (double start_ms, double end_ms, vector<double>& times) const
+{
+  times.clear();
+  for (size_t f = 0; f < windowed_signal.size(); f++)
+    {
+      for (size_t n = samples_before (f, start_ms); n < samples_before (f, end_ms); n++)
+        times.push_back (sample_ms (f, n));
+    }
+  std::sort (times.begin(), times.end());
+}
+
+double
+AttackErrorModel::error (double attack_start_ms, double attack_end_ms)
+{
+  const size_t frames = windowed_signal.size();
+  const double attack_len_ms = attack_end_ms - attack_start_ms;
+
+  /* frames before first_active produce no output, frames starting at first_plain are not
+   * affected by the attack (the number of samples before attack start/end can only
+   * decrease from frame to frame)
+   */
+  size_t first_active = frames;
+  size_t first_plain = frames;
   for (size_t f = 0; f < frames; f++)
     {
-      const vector<double>& frame_signal = unscaled_signal[f];
-      size_t zero_values = 0;
-      double scale = 1.0;
+      zero_values[f] = samples_before (f, attack_start_ms);
+      attack_values[f] = samples_before (f, attack_end_ms) - zero_values[f];
 
-      for (size_t n = 0; n < frame_signal.size(); n++)
-        {
-          const double n_ms = f * enc_params.frame_step_ms + n * 1000.0 / enc_params.mix_freq;
-          double env;
-          if (n_ms < attack.attack_start_ms)
-            {
-              env = 0;
-              zero_values++;
+      if (first_active == frames && zero_values[f] < frame_size && scale (zero_values[f]) > 0)
+        first_active = f;
 
-              size_t samples_in_frame = frame_signal.size() - zero_values;
-              if (samples_in_frame < (frame_signal.size() / 8))
-                {
-                  /* if we have very few samples in frame, the partials will
-                   * not be reliable, so in this case we cancel out the frame
-                   */
-                  scale = 0;
-                }
-              else
-                {
-                  /* based on an incomplete frame, we boost the partials
-                   * to obtain an estimate for one whole frame
-                   */
-                  scale = frame_signal.size() / double (samples_in_frame);
-                }
-            }
-          else if (n_ms < attack.attack_end_ms)  // during attack
-            {
-              const double attack_len_ms = attack.attack_end_ms - attack.attack_start_ms;
+      if (first_plain == frames && zero_values[f] == 0 && attack_values[f] == 0)
+        first_plain = f;
+    }
 
-              env = (n_ms - attack.attack_start_ms) / attack_len_ms;
-            }
-          else // after attack
-            {
-              env = 1.0;
-            }
-          decoded_signal[f * enc_params.frame_step + n] += frame_signal[n] * scale * env * window[n];
-          orig_signal[f * enc_params.frame_step + n] = audio_blocks[f].debug_samples[n];
+  const size_t begin = first_active * frame_step;
+  const size_t end   = max (begin, first_plain > 0 ? (first_plain - 1) * frame_step + frame_size : 0);
+
+  std::fill (decoded_signal.begin() + begin, decoded_signal.begin() + end, 0);
+  for (size_t f = first_active; f < frames && f * frame_step < end; f++)
+    {
+      const size_t n_end = min (frame_size, end - f * frame_step);
+      const double frame_scale = scale (zero_values[f]);
+      const vector<double>& signal = windowed_signal[f];
+
+      double *out = &decoded_signal[f * frame_step];
+      for (size_t n = zero_values[f]; n < min (zero_values[f] + attack_values[f], n_end); n++)
+        {
+          const double env = (sample_ms (f, n) - attack_start_ms) / attack_len_ms;
+
+          out[n] += signal[n] * frame_scale * env;
         }
-      out_scale[f] = scale;
+      for (size_t n = zero_values[f] + attack_values[f]; n < n_end; n++)
+        out[n] += signal[n] * frame_scale;
     }
-  for (size_t i = 0; i < decoded_signal.size(); i++)
+
+  double total_error = zero_error_sum[begin] + full_error_sum.back() - full_error_sum[end];
+  for (size_t i = begin; i < end; i++)
     {
-      double error = orig_signal[i] - decoded_signal[i];
-      //printf ("%d %f %f\n", i,orig_signal[i], decoded_signal[i]);
+      const double error = orig_signal[i] - decoded_signal[i];
       total_error += error * error;
     }
   return total_error;
 }
 
+}
+
 /**
  * This function computes the optimal attack parameters, by finding the optimal
  * attack envelope (attack_start_ms and attack_end_ms) given the data.
+ *
+ * The search is deterministic: a coarse grid search over all valid attack
+ * parameters is followed by a local search with decreasing step size.
  */
 void
 Encoder::compute_attack_params()
@@ -1209,7 +1550,7 @@ Encoder::compute_attack_params()
 
   const double mix_freq   = enc_params.mix_freq;
   const size_t frame_size = enc_params.frame_size;
-  const size_t frames = MIN (20, audio_blocks.size());
+  const size_t frames = min (ATTACK_FRAMES, audio_blocks.size());
 
   vector< vector<double> > unscaled_signal;
   for (size_t f = 0; f < frames; f++)
@@ -1237,71 +1578,143 @@ Encoder::compute_attack_params()
       unscaled_signal.push_back (frame_signal);
     }
 
-  /* make attack envelope deterministically return the same result for the same input every time */
-  Random random;
-  random.set_seed (42);
+  AttackErrorModel error_model (enc_params, unscaled_signal, audio_blocks);
 
-  Attack attack;
-  int no_modification = 0;
-  double error = 1e7;
-  vector<double> scale (frames);
+  const double zero_values_at_start_ms = zero_values_at_start / mix_freq * 1000;
+  const double max_attack_end_ms = 200;
+  const double min_attack_len_ms = 5; // constrain attack to at least 5ms to avoid clickiness at start
 
-  double zero_values_at_start_ms = zero_values_at_start / mix_freq * 1000;
-  attack.attack_start_ms = zero_values_at_start_ms;
-  attack.attack_end_ms = zero_values_at_start_ms + 10;
-  while (no_modification < 3000)
+  bool kill = false;
+
+  /* returns the error for the attack parameters, or -1 if they are not valid */
+  auto attack_error = [&] (Attack& attack)
     {
-      double R;
-      Attack new_attack = attack;
-      if (no_modification < 500)
-        R = 100;
-      else if (no_modification < 1000)
-        R = 20;
-      else if (no_modification < 1500)
-        R = 1;
-      else if (no_modification < 2000)
-        R = 0.2;
-      else if (no_modification < 2500)
-        R = 0.01;
-      else
-        R = 0.002;
+      attack.attack_end_ms = max (attack.attack_end_ms, attack.attack_start_ms + min_attack_len_ms);
 
-      new_attack.attack_start_ms += random.random_double_range (-R, R);
-      new_attack.attack_end_ms += random.random_double_range (-R, R);
+      /* Audio stores the attack parameters as float, so we evaluate exactly the values that will be stored */
+      attack.attack_start_ms = float (attack.attack_start_ms);
+      attack.attack_end_ms = float (attack.attack_end_ms);
 
-      // constrain attack to at least 5ms to avoid clickiness at start
-      new_attack.attack_end_ms = max (new_attack.attack_end_ms, new_attack.attack_start_ms + 5);
+      if (attack.attack_start_ms < zero_values_at_start_ms || attack.attack_end_ms >= max_attack_end_ms)
+        return -1.0;
+
+      if (killed ("_attack", killed_iteration++ & 63))
+        kill = true;
+
+      return error_model.error (attack.attack_start_ms, attack.attack_end_ms);
+    };
+
+  struct Candidate
+  {
+    Attack attack;
+    double error;
+  };
 
-      if (new_attack.attack_start_ms < new_attack.attack_end_ms &&
-          new_attack.attack_start_ms >= zero_values_at_start_ms &&
-          new_attack.attack_end_ms < 200)
+  /* coarse search: evaluate all valid attack parameters on a grid */
+  vector<Candidate> candidates;
+  for (double start_ms = zero_values_at_start_ms; start_ms + min_attack_len_ms < max_attack_end_ms; start_ms += 10)
+    {
+      for (double end_ms = start_ms + min_attack_len_ms; end_ms < max_attack_end_ms; end_ms += 10)
         {
-          const double new_error = attack_error (unscaled_signal, new_attack, scale);
-#if 0
-          printf ("attack=<%f, %f> error=%.17g new_attack=<%f, %f> new_arror=%.17g\n", attack.attack_start_ms, attack.attack_end_ms, error,
-                                                                                       new_attack.attack_start_ms, new_attack.attack_end_ms, new_error);
-#endif
-          if (new_error < error)
-            {
-              error = new_error;
-              attack = new_attack;
+          Candidate candidate;
+          candidate.attack.attack_start_ms = start_ms;
+          candidate.attack.attack_end_ms = end_ms;
+          candidate.error = attack_error (candidate.attack);
 
-              no_modification = 0;
-            }
-          else
+          if (candidate.error >= 0)
+            candidates.push_back (candidate);
+        }
+      if (kill)
+        return;
+    }
+  std::stable_sort (candidates.begin(), candidates.end(), [] (const Candidate& a, const Candidate& b) { return a.error < b.error; });
+
+  auto improve = [&] (Candidate& best, double start_ms, double end_ms)
+    {
+      Candidate candidate;
+      candidate.attack.attack_start_ms = start_ms;
+      candidate.attack.attack_end_ms = end_ms;
+      candidate.error = attack_error (candidate.attack);
+
+      if (candidate.error >= 0 && candidate.error < best.error)
+        {
+          best = candidate;
+          return true;
+        }
+      return false;
+    };
+
+  /* fine search, starting at the best grid points */
+  Candidate best;
+  best.error = -1;
+  for (size_t i = 0; i < min<size_t> (candidates.size(), 4); i++)
+    {
+      Candidate candidate = candidates[i];
+
+      /* move to the best neighbour until there is no improvement, then reduce the step size */
+      for (double step_ms : { 5.0, 2.0, 1.0, 0.5, 0.2, 0.1, 0.05, 0.02, 0.01, 0.005, 0.002, 0.001, 5e-4, 2e-4, 1e-4, 5e-5, 2e-5, 1e-5, 5e-6, 2e-6, 1e-6 })
+        {
+          bool improved;
+          do
             {
-              no_modification++;
+              const Attack center = candidate.attack;
+
+              improved = false;
+              for (int d_start = -1; d_start <= 1; d_start++)
+                {
+                  for (int d_end = -1; d_end <= 1; d_end++)
+                    improved |= improve (candidate, center.attack_start_ms + d_start * step_ms, center.attack_end_ms + d_end * step_ms);
+                }
+              if (kill)
+                return;
             }
+          while (improved);
         }
-      if (killed ("_attack", killed_iteration++ & 63))
+      if (best.error < 0 || candidate.error < best.error)
+        best = candidate;
+    }
+  if (best.error < 0) // no valid attack parameters
+    return;
+
+  /* the frame scale only changes if the attack start passes the time of a sample; between
+   * two sample times the error usually increases with the attack start, so we try starting
+   * the attack right after each sample time near the current attack start, and optimize
+   * the attack end for each of these
+   */
+  vector<double> sample_times;
+  error_model.sample_times (best.attack.attack_start_ms - 0.1, best.attack.attack_start_ms + 0.1, sample_times);
+
+  const Attack center = best.attack;
+  for (auto t : sample_times)
+    {
+      Candidate candidate;
+      candidate.attack.attack_start_ms = float (t) > t ? float (t) : nextafterf (t, t + 1);
+      candidate.attack.attack_end_ms = center.attack_end_ms;
+      candidate.error = attack_error (candidate.attack);
+      if (candidate.error < 0)
+        continue;
+
+      for (double step_ms : { 0.02, 0.01, 0.005, 0.002, 0.001, 5e-4, 2e-4, 1e-4, 5e-5, 2e-5, 1e-5, 5e-6, 2e-6, 1e-6 })
+        {
+          while (improve (candidate, candidate.attack.attack_start_ms, candidate.attack.attack_end_ms - step_ms) ||
+                 improve (candidate, candidate.attack.attack_start_ms, candidate.attack.attack_end_ms + step_ms))
+            ;
+        }
+      if (kill)
         return;
+
+      if (candidate.error < best.error)
+        best = candidate;
     }
+
   for (size_t f = 0; f < frames; f++)
     {
+      const double scale = error_model.frame_scale (f, best.attack.attack_start_ms);
+
       for (size_t i = 0; i < audio_blocks[f].mags.size(); i++)
-        audio_blocks[f].mags[i] *= scale[f];
+        audio_blocks[f].mags[i] *= scale;
     }
-  optimal_attack = attack;
+  optimal_attack = best.attack;
 }
 
 struct PartialData
@@ -1353,6 +1766,172 @@ Encoder::sort_freqs()
     }
 }
 
+/**
+ * Streaming variant of encode(): instead of computing the spectra of all frames
+ * first, the frames are analyzed chunk by chunk, so only the spectra of one chunk
+ * need to be kept in memory. Debug data is only kept if requested (keep_debug_data).
+ * The encoded parameters are identical to those computed by encode().
+ *
+ * Peak detection needs the maximum magnitude of all frames, so the spectra are
+ * computed twice: the first pass only determines the maximum magnitude.
+ */
+bool
+Encoder::encode_streaming (const WavData& multi_channel_wav_data, int channel, int optimization_level,
+                           bool attack, bool track_sines)
+{
+  const WavData wav_data   = prepare_signal (multi_channel_wav_data, channel);
+  const uint64  n_frames   = frame_count (enc_params, wav_data);
+  const size_t  chunk_size = max<size_t> (64, frame_threads (n_frames) * FRAME_CHUNK * 4);
+
+  auto scratch = new_frame_scratch (enc_params, frame_threads (n_frames));
+
+  vector<EncoderBlock>     chunk_blocks (chunk_size);
+  vector<vector<Tracksel>> chunk_tracksels (chunk_size);
+
+  double max_mag = 0;
+  if (track_sines)
+    {
+      vector<double> frame_max_mag (chunk_size);
+
+      for (uint64 chunk_start = 0; chunk_start < n_frames; chunk_start += chunk_size)
+        {
+          const size_t chunk_len = min<uint64> (chunk_size, n_frames - chunk_start);
+
+          for_each_frame (chunk_len, "_stream_max", [&] (size_t thread_index, uint64 i)
+            {
+              compute_frame_spectrum (enc_params, wav_data, chunk_start + i, *scratch[thread_index], chunk_blocks[i], false);
+              frame_max_mag[i] = frame_max_magnitude (enc_params, chunk_blocks[i]);
+            });
+          if (killed ("stream_max"))
+            return false;
+
+          for (size_t i = 0; i < chunk_len; i++)
+            max_mag = max (max_mag, frame_max_mag[i]);
+        }
+    }
+
+  /* track start (frame, index) for each peak of the previous and the current frame */
+  typedef std::pair<uint64, size_t> TrackStart;
+
+  vector<Tracksel>   prev_tracksels;
+  vector<TrackStart> prev_track_starts;
+  vector<TrackStart> track_starts;
+  vector<size_t>     order;
+
+  audio_blocks.clear();
+  audio_blocks.resize (n_frames);
+
+  for (uint64 chunk_start = 0; chunk_start < n_frames; chunk_start += chunk_size)
+    {
+      const size_t chunk_len = min<uint64> (chunk_size, n_frames - chunk_start);
+
+      for_each_frame (chunk_len, "_stream", [&] (size_t thread_index, uint64 i)
+        {
+          EncoderBlock& audio_block = chunk_blocks[i];
+
+          audio_block.freqs.clear();
+          audio_block.mags.clear();
+          audio_block.phases.clear();
+          compute_frame_spectrum (enc_params, wav_data, chunk_start + i, *scratch[thread_index], audio_block, enc_params.keep_debug_data);
+
+          if (track_sines)
+            {
+              chunk_tracksels[i].clear();
+              search_frame_maxima (enc_params, max_mag, chunk_start + i, audio_block, chunk_tracksels[i]);
+            }
+        });
+      if (killed ("stream"))
+        return false;
+
+      if (track_sines)
+        {
+          /* every peak is above the threshold that validate_partials() uses, so all tracks are
+           * valid; validate_partials() adds the peaks of each frame sorted by track start, and
+           * we need to use the same order to get identical results
+           */
+          for (size_t i = 0; i < chunk_len; i++)
+            {
+              vector<Tracksel>& tracksels = chunk_tracksels[i];
+
+              link_frame_partials (prev_tracksels, tracksels);
+
+              track_starts.resize (tracksels.size());
+              order.resize (tracksels.size());
+              for (size_t t = 0; t < tracksels.size(); t++)
+                {
+                  if (tracksels[t].prev)
+                    track_starts[t] = prev_track_starts[tracksels[t].prev - &prev_tracksels[0]];
+                  else
+                    track_starts[t] = TrackStart (chunk_start + i, t);
+
+                  order[t] = t;
+                }
+              std::sort (order.begin(), order.end(), [&] (size_t a, size_t b) { return track_starts[a] < track_starts[b]; });
+
+              EncoderBlock& audio_block = chunk_blocks[i];
+              for (auto t : order)
+                {
+                  audio_block.freqs.push_back (tracksels[t].freq);
+                  audio_block.mags.push_back (tracksels[t].mag);
+                  audio_block.phases.push_back (tracksels[t].phase);
+                }
+              prev_tracksels.swap (tracksels);
+              prev_track_starts.swap (track_starts);
+            }
+        }
+
+      for_each_frame (chunk_len, "_stream", [&] (size_t thread_index, uint64 i)
+        {
+          const uint64  frame = chunk_start + i;
+          EncoderBlock& audio_block = chunk_blocks[i];
+
+          if (track_sines)
+            {
+              optimize_frame_partials (enc_params, optimization_level, frame, audio_block);
+              subtract_frame_partials (enc_params, frame, *scratch[thread_index], audio_block);
+            }
+          approx_frame_noise (enc_params, frame, audio_block);
+
+          /* copy (rather than move) the results, so the large buffers are reused for the next chunk */
+          EncoderBlock& out_block = audio_blocks[frame];
+
+          out_block.noise.assign (audio_block.noise.begin(), audio_block.noise.end());
+          out_block.freqs.assign (audio_block.freqs.begin(), audio_block.freqs.end());
+          out_block.mags.assign (audio_block.mags.begin(), audio_block.mags.end());
+          out_block.phases.assign (audio_block.phases.begin(), audio_block.phases.end());
+          if (enc_params.keep_debug_data)
+            out_block.original_fft.assign (audio_block.original_fft.begin(), audio_block.original_fft.end());
+
+          /* attack estimation needs the samples of the first frames */
+          if (enc_params.keep_debug_data || (attack && frame < ATTACK_FRAMES))
+            out_block.debug_samples.assign (audio_block.debug_samples.begin(), audio_block.debug_samples.end());
+        });
+      if (killed ("stream"))
+        return false;
+    }
+
+  if (attack)
+    compute_attack_params();
+
+  if (killed ("attack"))
+    return false;
+
+  if (!enc_params.keep_debug_data)
+    {
+      for (auto& audio_block : audio_blocks)
+        {
+          audio_block.debug_samples.clear();
+          audio_block.debug_samples.shrink_to_fit();
+        }
+    }
+
+  sort_freqs();
+  if (killed ("sort"))
+    return false;
+
+  return true;
+}
+
 /**
  * This function calls all steps necessary for encoding in the right order.
  *
@@ -1364,7 +1943,10 @@ bool
 Encoder::encode (const WavData& wav_data, int channel, int optimization_level,
                  bool attack, bool track_sines)
 {
-  compute_stft (wav_data, channel);
+  if (enc_params.streaming)
+    return encode_streaming (wav_data, channel, optimization_level, attack, track_sines);
+
+  compute_stft (prepare_signal (wav_data, channel));
   if (killed ("stft"))
     return false;
 
@@ -1471,7 +2053,7 @@ convert_freqs_mags_phases (const EncoderBlock& eblock, AudioBlock& ablock, const
 }
 
 static void
-convert_noise (const vector<float>& noise, vector<uint16_t>& inoise)
+convert_noise (const vector<float>& noise, ArenaVector<uint16_t>& inoise)
 {
   inoise.resize (noise.size());
 
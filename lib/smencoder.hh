@@ -7,6 +7,7 @@
 #include <vector>
 #include <string>
 #include <map>
+#include <functional>
 
 #include "smaudio.hh"
 #include "smwavdata.hh"
@@ -61,6 +62,15 @@ public:
   /** allow termination during encode() */
   std::function<bool()> kill_function;
 
+  /** number of threads for the per frame analysis steps (0: one thread per cpu core) */
+  int     n_threads = 1;
+
+  /** analyze frames in small chunks to save memory (see Encoder::encode_streaming) */
+  bool    streaming = false;
+
+  /** keep debug data (original_fft, debug_samples) in streaming mode */
+  bool    keep_debug_data = false;
+
   bool add_config_entry (const std::string& param, const std::string& value);
 
   bool load_config (const std::string& filename);
@@ -72,6 +82,9 @@ public:
   /** use sane defaults for every parameter: */
   void setup_params (const WavData& wav_data, double fundamental_freq);
 
+  /** compute window according to "window" config parameter (after setup_params) */
+  bool setup_window();
+
   /** to be able to terminate encoder before we are done */
   void set_kill_function (const std::function<bool()>& kill_function);
 };
@@ -120,10 +133,10 @@ class Encoder
     double attack_start_ms;
     double attack_end_ms;
   };
-  double attack_error (const std::vector< std::vector<double> >& unscaled_signal, const Attack& attack, std::vector<double>& out_scale);
 
   // single encoder steps:
-  void compute_stft (const WavData& wav_data, int channel);
+  WavData prepare_signal (const WavData& wav_data, int channel);
+  void compute_stft (const WavData& wav_data);
   void search_local_maxima();
   void link_partials();
   void validate_partials();
@@ -133,6 +146,12 @@ class Encoder
   void compute_attack_params();
   void sort_freqs();
 
+  bool encode_streaming (const WavData& wav_data, int channel, int optimization_level,
+                         bool attack, bool track_sines);
+
+  size_t frame_threads (size_t n_frames);
+  void   for_each_frame (size_t n_frames, const char *where, const std::function<void (size_t, uint64)>& process_frame);
+
   inline bool
   killed (const char *where, uint64_t z = 0)
   {
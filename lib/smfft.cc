@@ -3,6 +3,7 @@
 #include "smfft.hh"
 #include "smutils.hh"
 #include <algorithm>
+#include <atomic>
 #include <map>
 #include <mutex>
 #include "config.h"
@@ -15,6 +16,7 @@
 using namespace SpectMorph;
 using std::map;
 using std::string;
+using std::vector;
 
 static bool enable_gsl_fft = false;
 static bool randomize_new_fft_arrays = false;
@@ -45,12 +47,100 @@ static void save_wisdom();
 static std::mutex fftw_plan_mutex;
 static std::mutex plan_map_mutex;
 
-static fftwf_plan&
-read_plan_map_threadsafe (std::map<int, fftwf_plan>& plan_map, size_t N)
+/*
+ * plans for power of two sizes are stored in a fixed size array (indexed by
+ * log2 (N)), and published atomically; once a plan is published it will not
+ * be modified (until FFT::cleanup), so looking up an existing plan doesn't
+ * need to lock a mutex, which is important for realtime synthesis
+ *
+ * plans for other sizes are rare (encoder only) and kept in a std::map
+ */
+class PlanMap
+{
+  static constexpr int MAX_LOG2 = 31;
+
+  std::atomic<fftwf_plan>   power2_plans[MAX_LOG2 + 1];
+  map<size_t, fftwf_plan>   other_plans;
+
+  static int
+  power2_index (size_t N)
+  {
+    if (N == 0 || (N & (N - 1)) != 0)
+      return -1;
+
+    int index = 0;
+    while (N > 1)
+      {
+        N >>= 1;
+        index++;
+      }
+    return index <= MAX_LOG2 ? index : -1;
+  }
+public:
+  PlanMap()
+  {
+    for (auto& plan : power2_plans)
+      plan.store (nullptr);
+  }
+  fftwf_plan
+  lookup (size_t N)
+  {
+    const int index = power2_index (N);
+    if (index >= 0)
+      return power2_plans[index].load (std::memory_order_acquire);
+
+    /* std::map access is not threadsafe */
+    std::lock_guard<std::mutex> lg (plan_map_mutex);
+    auto it = other_plans.find (N);
+    return it != other_plans.end() ? it->second : nullptr;
+  }
+  void
+  insert (size_t N, fftwf_plan plan)
+  {
+    const int index = power2_index (N);
+    if (index >= 0)
+      {
+        power2_plans[index].store (plan, std::memory_order_release);
+        return;
+      }
+    std::lock_guard<std::mutex> lg (plan_map_mutex);
+    other_plans[N] = plan;
+  }
+  void
+  cleanup()
+  {
+    for (auto& plan : power2_plans)
+      {
+        if (plan.load())
+          fftwf_destroy_plan (plan.load());
+        plan.store (nullptr);
+      }
+
+    std::lock_guard<std::mutex> lg (plan_map_mutex);
+    for (auto& plan_entry : other_plans)
+      fftwf_destroy_plan (plan_entry.second);
+
+    other_plans.clear();
+  }
+};
+
+/* returns existing plan for size N, or creates a new plan (using create_plan) */
+template<class CreatePlan> static inline fftwf_plan
+get_plan (PlanMap& plan_map, size_t N, CreatePlan create_plan)
 {
-  /* std::map access is not threadsafe */
-  std::lock_guard<std::mutex> lg (plan_map_mutex);
-  return plan_map[N];
+  fftwf_plan plan = plan_map.lookup (N);
+  if (!plan)
+    {
+      std::lock_guard<std::mutex> lg (fftw_plan_mutex);
+
+      plan = plan_map.lookup (N); // another thread might have created the plan in the meantime
+      if (!plan)
+        {
+          plan = create_plan();
+          plan_map.insert (N, plan);
+        }
+    }
+  return plan;
 }
 
 float *
@@ -74,7 +164,7 @@ FFT::free_array_float (float *f)
   fftwf_free (f);
 }
 
-static map<int, fftwf_plan> fftar_float_plan;
+static PlanMap fftar_float_plan;
 
 static int
 plan_flags (FFT::PlanMode plan_mode)
@@ -87,51 +177,55 @@ plan_flags (FFT::PlanMode plan_mode)
     }
 }
 
+static fftwf_plan
+create_fftar_float_plan (size_t N, FFT::PlanMode plan_mode)
+{
+  float *plan_in = FFT::new_array_float (N);
+  float *plan_out = FFT::new_array_float (N);
+  fftwf_plan plan = fftwf_plan_dft_r2c_1d (N, plan_in, (fftwf_complex *) plan_out, plan_flags (plan_mode));
+  if (!plan) /* missing from wisdom -> create plan and save it */
+    {
+      plan = fftwf_plan_dft_r2c_1d (N, plan_in, (fftwf_complex *) plan_out, plan_flags (plan_mode) & ~FFTW_WISDOM_ONLY);
+      save_wisdom();
+    }
+  FFT::free_array_float (plan_out);
+  FFT::free_array_float (plan_in);
+  return plan;
+}
+
 void
 FFT::fftar_float (size_t N, float *in, float *out, PlanMode plan_mode)
 {
-  fftwf_plan& plan = read_plan_map_threadsafe (fftar_float_plan, N);
+  fftwf_plan plan = get_plan (fftar_float_plan, N, [&]() { return create_fftar_float_plan (N, plan_mode); });
 
-  if (!plan)
-    {
-      std::lock_guard<std::mutex> lg (fftw_plan_mutex);
-      float *plan_in = new_array_float (N);
-      float *plan_out = new_array_float (N);
-      plan = fftwf_plan_dft_r2c_1d (N, plan_in, (fftwf_complex *) plan_out, plan_flags (plan_mode));
-      if (!plan) /* missing from wisdom -> create plan and save it */
-        {
-          plan = fftwf_plan_dft_r2c_1d (N, plan_in, (fftwf_complex *) plan_out, plan_flags (plan_mode) & ~FFTW_WISDOM_ONLY);
-          save_wisdom();
-        }
-      free_array_float (plan_out);
-      free_array_float (plan_in);
-    }
   fftwf_execute_dft_r2c (plan, in, (fftwf_complex *) out);
 
   out[1] = out[N];
 }
 
-static map<int, fftwf_plan> fftsr_float_plan;
+static PlanMap fftsr_float_plan;
+
+static fftwf_plan
+create_fftsr_float_plan (size_t N, FFT::PlanMode plan_mode)
+{
+  float *plan_in = FFT::new_array_float (N);
+  float *plan_out = FFT::new_array_float (N);
+  fftwf_plan plan = fftwf_plan_dft_c2r_1d (N, (fftwf_complex *) plan_in, plan_out, plan_flags (plan_mode));
+  if (!plan) /* missing from wisdom -> create plan and save it */
+    {
+      plan = fftwf_plan_dft_c2r_1d (N, (fftwf_complex *) plan_in, plan_out, plan_flags (plan_mode) & ~FFTW_WISDOM_ONLY);
+      save_wisdom();
+    }
+  FFT::free_array_float (plan_out);
+  FFT::free_array_float (plan_in);
+  return plan;
+}
 
 void
 FFT::fftsr_float (size_t N, float *in, float *out, PlanMode plan_mode)
 {
-  fftwf_plan& plan = read_plan_map_threadsafe (fftsr_float_plan, N);
+  fftwf_plan plan = get_plan (fftsr_float_plan, N, [&]() { return create_fftsr_float_plan (N, plan_mode); });
 
-  if (!plan)
-    {
-      std::lock_guard<std::mutex> lg (fftw_plan_mutex);
-      float *plan_in = new_array_float (N);
-      float *plan_out = new_array_float (N);
-      plan = fftwf_plan_dft_c2r_1d (N, (fftwf_complex *) plan_in, plan_out, plan_flags (plan_mode));
-      if (!plan) /* missing from wisdom -> create plan and save it */
-        {
-          plan = fftwf_plan_dft_c2r_1d (N, (fftwf_complex *) plan_in, plan_out, plan_flags (plan_mode) & ~FFTW_WISDOM_ONLY);
-          save_wisdom();
-        }
-      free_array_float (plan_out);
-      free_array_float (plan_in);
-    }
   in[N] = in[1];
   in[N+1] = 0;
   in[1] = 0;
@@ -141,29 +235,31 @@ FFT::fftsr_float (size_t N, float *in, float *out, PlanMode plan_mode)
   in[1] = in[N]; // we need to preserve the input array
 }
 
-static map<int, fftwf_plan> fftsr_destructive_float_plan;
+static PlanMap fftsr_destructive_float_plan;
+
+static fftwf_plan
+create_fftsr_destructive_float_plan (size_t N, FFT::PlanMode plan_mode)
+{
+  int xplan_flags = plan_flags (plan_mode) & ~FFTW_PRESERVE_INPUT;
+  float *plan_in = FFT::new_array_float (N);
+  float *plan_out = FFT::new_array_float (N);
+  fftwf_plan plan = fftwf_plan_dft_c2r_1d (N, (fftwf_complex *) plan_in, plan_out, xplan_flags);
+  if (!plan) /* missing from wisdom -> create plan and save it */
+    {
+      plan = fftwf_plan_dft_c2r_1d (N, (fftwf_complex *) plan_in, plan_out,
+                                    xplan_flags & ~FFTW_WISDOM_ONLY);
+      save_wisdom();
+    }
+  FFT::free_array_float (plan_out);
+  FFT::free_array_float (plan_in);
+  return plan;
+}
 
 void
 FFT::fftsr_destructive_float (size_t N, float *in, float *out, PlanMode plan_mode)
 {
-  fftwf_plan& plan = read_plan_map_threadsafe (fftsr_destructive_float_plan, N);
+  fftwf_plan plan = get_plan (fftsr_destructive_float_plan, N, [&]() { return create_fftsr_destructive_float_plan (N, plan_mode); });
 
-  if (!plan)
-    {
-      std::lock_guard<std::mutex> lg (fftw_plan_mutex);
-      int xplan_flags = plan_flags (plan_mode) & ~FFTW_PRESERVE_INPUT;
-      float *plan_in = new_array_float (N);
-      float *plan_out = new_array_float (N);
-      plan = fftwf_plan_dft_c2r_1d (N, (fftwf_complex *) plan_in, plan_out, xplan_flags);
-      if (!plan) /* missing from wisdom -> create plan and save it */
-        {
-          plan = fftwf_plan_dft_c2r_1d (N, (fftwf_complex *) plan_in, plan_out,
-                                        xplan_flags & ~FFTW_WISDOM_ONLY);
-          save_wisdom();
-        }
-      free_array_float (plan_out);
-      free_array_float (plan_in);
-    }
   in[N] = in[1];
   in[N+1] = 0;
   in[1] = 0;
@@ -171,59 +267,77 @@ FFT::fftsr_destructive_float (size_t N, float *in, float *out, PlanMode plan_mod
   fftwf_execute_dft_c2r (plan, (fftwf_complex *)in, out);
 }
 
-static map<int, fftwf_plan> fftac_float_plan;
+static PlanMap fftac_float_plan;
 
-void
-FFT::fftac_float (size_t N, float *in, float *out, PlanMode plan_mode)
+static fftwf_plan
+create_fftac_float_plan (size_t N, FFT::PlanMode plan_mode)
 {
-  fftwf_plan& plan = read_plan_map_threadsafe (fftac_float_plan, N);
-  if (!plan)
-    {
-      std::lock_guard<std::mutex> lg (fftw_plan_mutex);
-      float *plan_in = new_array_float (N * 2);
-      float *plan_out = new_array_float (N * 2);
+  float *plan_in = FFT::new_array_float (N * 2);
+  float *plan_out = FFT::new_array_float (N * 2);
 
+  fftwf_plan plan = fftwf_plan_dft_1d (N, (fftwf_complex *) plan_in, (fftwf_complex *) plan_out,
+                                       FFTW_FORWARD, plan_flags (plan_mode));
+  if (!plan) /* missing from wisdom -> create plan and save it */
+    {
       plan = fftwf_plan_dft_1d (N, (fftwf_complex *) plan_in, (fftwf_complex *) plan_out,
-                                FFTW_FORWARD, plan_flags (plan_mode));
-      if (!plan) /* missing from wisdom -> create plan and save it */
-        {
-          plan = fftwf_plan_dft_1d (N, (fftwf_complex *) plan_in, (fftwf_complex *) plan_out,
-                                    FFTW_FORWARD, plan_flags (plan_mode) & ~FFTW_WISDOM_ONLY);
-          save_wisdom();
-        }
-      free_array_float (plan_out);
-      free_array_float (plan_in);
+                                FFTW_FORWARD, plan_flags (plan_mode) & ~FFTW_WISDOM_ONLY);
+      save_wisdom();
     }
+  FFT::free_array_float (plan_out);
+  FFT::free_array_float (plan_in);
+  return plan;
+}
+
+void
+FFT::fftac_float (size_t N, float *in, float *out, PlanMode plan_mode)
+{
+  fftwf_plan plan = get_plan (fftac_float_plan, N, [&]() { return create_fftac_float_plan (N, plan_mode); });
 
   fftwf_execute_dft (plan, (fftwf_complex *)in, (fftwf_complex *)out);
 }
 
-static map<int, fftwf_plan> fftsc_float_plan;
+static PlanMap fftsc_float_plan;
 
-void
-FFT::fftsc_float (size_t N, float *in, float *out, PlanMode plan_mode)
+static fftwf_plan
+create_fftsc_float_plan (size_t N, FFT::PlanMode plan_mode)
 {
-  fftwf_plan& plan = read_plan_map_threadsafe (fftsc_float_plan, N);
-  if (!plan)
-    {
-      std::lock_guard<std::mutex> lg (fftw_plan_mutex);
-      float *plan_in = new_array_float (N * 2);
-      float *plan_out = new_array_float (N * 2);
+  float *plan_in = FFT::new_array_float (N * 2);
+  float *plan_out = FFT::new_array_float (N * 2);
 
+  fftwf_plan plan = fftwf_plan_dft_1d (N, (fftwf_complex *) plan_in, (fftwf_complex *) plan_out,
+                                       FFTW_BACKWARD, plan_flags (plan_mode));
+  if (!plan) /* missing from wisdom -> create plan and save it */
+    {
       plan = fftwf_plan_dft_1d (N, (fftwf_complex *) plan_in, (fftwf_complex *) plan_out,
-                                FFTW_BACKWARD, plan_flags (plan_mode));
-      if (!plan) /* missing from wisdom -> create plan and save it */
-        {
-          plan = fftwf_plan_dft_1d (N, (fftwf_complex *) plan_in, (fftwf_complex *) plan_out,
-                                    FFTW_BACKWARD, plan_flags (plan_mode) & ~FFTW_WISDOM_ONLY);
-          save_wisdom();
-        }
-      free_array_float (plan_out);
-      free_array_float (plan_in);
+                                FFTW_BACKWARD, plan_flags (plan_mode) & ~FFTW_WISDOM_ONLY);
+      save_wisdom();
     }
+  FFT::free_array_float (plan_out);
+  FFT::free_array_float (plan_in);
+  return plan;
+}
+
+void
+FFT::fftsc_float (size_t N, float *in, float *out, PlanMode plan_mode)
+{
+  fftwf_plan plan = get_plan (fftsc_float_plan, N, [&]() { return create_fftsc_float_plan (N, plan_mode); });
+
   fftwf_execute_dft (plan, (fftwf_complex *)in, (fftwf_complex *)out);
 }
 
+void
+FFT::prepare_plans (const vector<size_t>& sizes, PlanMode plan_mode)
+{
+  /* create plans for the transforms used during synthesis (IFFTSynth, NoiseDecoder),
+   * so that the realtime thread never needs to run the fftw planner
+   */
+  for (auto N : sizes)
+    {
+      get_plan (fftsr_float_plan, N, [&]() { return create_fftsr_float_plan (N, plan_mode); });
+      get_plan (fftsr_destructive_float_plan, N, [&]() { return create_fftsr_destructive_float_plan (N, plan_mode); });
+    }
+}
+
 static string
 wisdom_filename()
 {
@@ -295,19 +409,11 @@ FFT::init()
 void
 FFT::cleanup()
 {
-  typedef map<int, fftwf_plan> PlanMap;
-
-  auto cleanup_plans = [](PlanMap& plan_map) {
-    for (auto& plan_entry : plan_map)
-      fftwf_destroy_plan (plan_entry.second);
-
-    plan_map.clear();
-  };
-  cleanup_plans (fftar_float_plan);
-  cleanup_plans (fftsr_float_plan);
-  cleanup_plans (fftsr_destructive_float_plan);
-  cleanup_plans (fftac_float_plan);
-  cleanup_plans (fftsc_float_plan);
+  fftar_float_plan.cleanup();
+  fftsr_float_plan.cleanup();
+  fftsr_destructive_float_plan.cleanup();
+  fftac_float_plan.cleanup();
+  fftsc_float_plan.cleanup();
 }
 
 #else
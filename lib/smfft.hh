@@ -4,6 +4,7 @@
 #define SPECTMORPH_FFT_HH
 
 #include <sys/types.h>
+#include <vector>
 
 namespace SpectMorph
 {
@@ -22,6 +23,8 @@ void   fftsr_destructive_float (size_t N, float *in, float *out, PlanMode plan_m
 void   fftac_float (size_t N, float *in, float *out, PlanMode plan_mode = PLAN_PATIENT);
 void   fftsc_float (size_t N, float *in, float *out, PlanMode plan_mode = PLAN_PATIENT);
 
+void   prepare_plans (const std::vector<size_t>& sizes, PlanMode plan_mode = PLAN_PATIENT);
+
 void   use_gsl_fft (bool enabled);
 void   debug_randomize_new_arrays (bool enabled);
 
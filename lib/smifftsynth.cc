@@ -4,6 +4,7 @@
 #include "smmath.hh"
 #include "smfft.hh"
 #include "smblockutils.hh"
+#include "smmain.hh"
 #include <assert.h>
 #include <stdio.h>
 
@@ -117,6 +118,56 @@ IFFTSynth::get_samples (float      *samples,
     }
 }
 
+/* render a batch of partials, equivalent to calling render_partial() once
+ * for each partial (the spectrum is updated in the same order, so the result
+ * is bit-identical)
+ */
+void
+IFFTSynth::render_partials (size_t        n_partials,
+                            const double *freqs,
+                            const double *mags,
+                            const double *phases)
+{
+#ifdef __SSE__
+  if (sm_sse())
+    {
+      const int range = 4;
+
+      for (size_t p = 0; p < n_partials; p++)
+        {
+          const float *wmag_p;
+          float phase_rcmag, phase_rsmag;
+
+          const int ibin = setup_partial (freqs[p], mags[p], phases[p], wmag_p, phase_rcmag, phase_rsmag);
+          if (is_corner_case (ibin))
+            {
+              render_corner_case (ibin, wmag_p, phase_rcmag, phase_rsmag);
+              continue;
+            }
+
+          /* 9 complex bins: 4 x 2 bins using SSE, last bin scalar */
+          float *sp = fft_in + 2 * (ibin - range);
+
+          const __m128 rcs = _mm_setr_ps (phase_rcmag, phase_rsmag, phase_rcmag, phase_rsmag);
+          const __m128 w0123 = _mm_loadu_ps (wmag_p);
+          const __m128 w4567 = _mm_loadu_ps (wmag_p + 4);
+
+          _mm_storeu_ps (sp,      _mm_add_ps (_mm_loadu_ps (sp),      _mm_mul_ps (rcs, _mm_unpacklo_ps (w0123, w0123))));
+          _mm_storeu_ps (sp + 4,  _mm_add_ps (_mm_loadu_ps (sp + 4),  _mm_mul_ps (rcs, _mm_unpackhi_ps (w0123, w0123))));
+          _mm_storeu_ps (sp + 8,  _mm_add_ps (_mm_loadu_ps (sp + 8),  _mm_mul_ps (rcs, _mm_unpacklo_ps (w4567, w4567))));
+          _mm_storeu_ps (sp + 12, _mm_add_ps (_mm_loadu_ps (sp + 12), _mm_mul_ps (rcs, _mm_unpackhi_ps (w4567, w4567))));
+
+          const float wmag = wmag_p[2 * range];
+          sp[16] += phase_rcmag * wmag;
+          sp[17] += phase_rsmag * wmag;
+        }
+      return;
+    }
+#endif
+  for (size_t p = 0; p < n_partials; p++)
+    render_partial (freqs[p], mags[p], phases[p]);
+}
+
 double
 IFFTSynth::quantized_freq (double mf_freq)
 {
@@ -33,6 +33,10 @@ class IFFTSynth
 
   static std::vector<float> sin_table;
 
+  inline int  setup_partial (double freq, double mag, double phase, const float *& wmag_p, float& phase_rcmag, float& phase_rsmag);
+  inline bool is_corner_case (int ibin);
+  inline void render_corner_case (int ibin, const float *wmag_p, float phase_rcmag, float phase_rsmag);
+
 public:
   enum WindowType { WIN_BLACKMAN_HARRIS_92, WIN_HANNING };
   enum OutputMode { REPLACE, ADD };
@@ -53,6 +57,7 @@ public:
   }
 
   inline void render_partial (double freq, double mag, double phase);
+  void render_partials (size_t n_partials, const double *freqs, const double *mags, const double *phases);
   void get_samples (float *samples, OutputMode output_mode = REPLACE);
 
   double quantized_freq (double freq);
@@ -65,15 +70,13 @@ struct IFFTSynthTable
   float             *win_scale;
 };
 
-inline void
-IFFTSynth::render_partial (double mf_freq, double mag, double phase)
+inline int
+IFFTSynth::setup_partial (double mf_freq, double mag, double phase, const float *& wmag_p, float& phase_rcmag, float& phase_rsmag)
 {
   const int range = 4;
 
   const int freq256 = sm_round_positive (mf_freq * freq256_factor);
-  const int ibin = freq256 >> 8;
-  float *sp = fft_in + 2 * (ibin - range);
-  const float *wmag_p = &table->win_trans[(freq256 & 0xff) * (range * 2 + 1)];
+  wmag_p = &table->win_trans[(freq256 & 0xff) * (range * 2 + 1)];
 
   const float nmag = mag * mag_norm;
 
@@ -87,13 +90,73 @@ IFFTSynth::render_partial (double mf_freq, double mag, double phase)
   int iphase_adjust = freq256 * SIN_TABLE_SIZE / 512 + (SIN_TABLE_SIZE - SIN_TABLE_SIZE / 4);
   iarg += iphase_adjust;
 
-  const float phase_rsmag = sin_table [iarg & SIN_TABLE_MASK] * nmag;
+  phase_rsmag = sin_table [iarg & SIN_TABLE_MASK] * nmag;
   iarg += SIN_TABLE_SIZE / 4;
-  const float phase_rcmag = sin_table [iarg & SIN_TABLE_MASK] * nmag;
+  phase_rcmag = sin_table [iarg & SIN_TABLE_MASK] * nmag;
+
+  return freq256 >> 8;
+}
+
+inline bool
+IFFTSynth::is_corner_case (int ibin)
+{
+  const int range = 4;
+
+  return !(ibin > range && 2 * (ibin + range) < static_cast<int> (block_size));
+}
+
+inline void
+IFFTSynth::render_corner_case (int ibin, const float *wmag_p, float phase_rcmag, float phase_rsmag)
+{
+  const int range = 4;
+
+  wmag_p += range; // allow negative addressing
+  for (int i = -range; i <= range; i++)
+    {
+      const float wmag = wmag_p[i];
+      if ((ibin + i) < 0)
+        {
+          fft_in[-(ibin + i) * 2] += phase_rcmag * wmag;
+          fft_in[-(ibin + i) * 2 + 1] -= phase_rsmag * wmag;
+        }
+      else if ((ibin + i) == 0)
+        {
+          fft_in[0] += 2 * phase_rcmag * wmag;
+        }
+      else if (2 * (ibin + i) == static_cast<int> (block_size))
+        {
+          fft_in[1] += 2 * phase_rcmag * wmag;
+        }
+      else if (2 * (ibin + i) > static_cast<int> (block_size))
+        {
+          int p = block_size - (2 * (ibin + i) - block_size);
+
+          fft_in[p] += phase_rcmag * wmag;
+          fft_in[p + 1] -= phase_rsmag * wmag;
+        }
+      else // no corner case
+        {
+          fft_in[(ibin + i) * 2] += phase_rcmag * wmag;
+          fft_in[(ibin + i) * 2 + 1] += phase_rsmag * wmag;
+        }
+    }
+}
+
+inline void
+IFFTSynth::render_partial (double mf_freq, double mag, double phase)
+{
+  const int range = 4;
+
+  const float *wmag_p;
+  float phase_rcmag, phase_rsmag;
+
+  const int ibin = setup_partial (mf_freq, mag, phase, wmag_p, phase_rcmag, phase_rsmag);
 
   /* compute FFT spectrum modifications */
-  if (ibin > range && 2 * (ibin + range) < static_cast<int> (block_size))
+  if (!is_corner_case (ibin))
     {
+      float *sp = fft_in + 2 * (ibin - range);
+
       for (int i = 0; i <= 2 * range; i++)
         {
           const float wmag = wmag_p[i];
@@ -103,36 +166,7 @@ IFFTSynth::render_partial (double mf_freq, double mag, double phase)
     }
   else
     {
-      wmag_p += range; // allow negative addressing
-      for (int i = -range; i <= range; i++)
-        {
-          const float wmag = wmag_p[i];
-          if ((ibin + i) < 0)
-            {
-              fft_in[-(ibin + i) * 2] += phase_rcmag * wmag;
-              fft_in[-(ibin + i) * 2 + 1] -= phase_rsmag * wmag;
-            }
-          else if ((ibin + i) == 0)
-            {
-              fft_in[0] += 2 * phase_rcmag * wmag;
-            }
-          else if (2 * (ibin + i) == static_cast<int> (block_size))
-            {
-              fft_in[1] += 2 * phase_rcmag * wmag;
-            }
-          else if (2 * (ibin + i) > static_cast<int> (block_size))
-            {
-              int p = block_size - (2 * (ibin + i) - block_size);
-
-              fft_in[p] += phase_rcmag * wmag;
-              fft_in[p + 1] -= phase_rsmag * wmag;
-            }
-          else // no corner case
-            {
-              fft_in[(ibin + i) * 2] += phase_rcmag * wmag;
-              fft_in[(ibin + i) * 2 + 1] += phase_rsmag * wmag;
-            }
-        }
+      render_corner_case (ibin, wmag_p, phase_rcmag, phase_rsmag);
     }
 }
 
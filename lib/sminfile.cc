@@ -3,6 +3,7 @@
 #include "sminfile.hh"
 #include <assert.h>
 #include <glib.h>
+#include <string.h>
 
 using std::string;
 using std::vector;
@@ -15,7 +16,11 @@ using SpectMorph::GenericIn;
  * \param filename name of the file
  */
 InFile::InFile (const string& filename) :
-  file_delete (true)
+  file_delete (true),
+  current_event_block_mem (nullptr),
+  current_event_block_size (0),
+  current_event_block_mapped (false),
+  map_blocks (false)
 {
   file = GenericIn::open (filename);
   current_event = NONE;
@@ -30,7 +35,11 @@ InFile::InFile (const string& filename) :
  */
 InFile::InFile (GenericIn *file) :
   file (file),
-  file_delete (false)
+  file_delete (false),
+  current_event_block_mem (nullptr),
+  current_event_block_size (0),
+  current_event_block_mapped (false),
+  map_blocks (false)
 {
   current_event = NONE;
   read_file_type_and_version();
@@ -172,10 +181,20 @@ InFile::next_event()
                   return;
                 }
             }
+          else if (map_blocks)
+            {
+              if (read_mapped_block (4))
+                current_event = FLOAT_BLOCK;
+            }
           else
             {
               if (read_raw_float_block (current_event_float_block))
-                current_event = FLOAT_BLOCK;
+                {
+                  current_event = FLOAT_BLOCK;
+                  current_event_block_mem = reinterpret_cast<const unsigned char *> (current_event_float_block.data());
+                  current_event_block_size = current_event_float_block.size();
+                  current_event_block_mapped = false;
+                }
             }
         }
     }
@@ -193,10 +212,20 @@ InFile::next_event()
                   return;
                 }
             }
+          else if (map_blocks)
+            {
+              if (read_mapped_block (2))
+                current_event = UINT16_BLOCK;
+            }
           else
             {
               if (read_raw_uint16_block (current_event_uint16_block))
-                current_event = UINT16_BLOCK;
+                {
+                  current_event = UINT16_BLOCK;
+                  current_event_block_mem = reinterpret_cast<const unsigned char *> (current_event_uint16_block.data());
+                  current_event_block_size = current_event_uint16_block.size();
+                  current_event_block_mapped = false;
+                }
             }
         }
     }
@@ -328,6 +357,26 @@ InFile::read_raw_uint16_block (vector<uint16_t>& ib)
   return true;
 }
 
+/* reads the block without copying the data (file must be memory mapped) */
+bool
+InFile::read_mapped_block (size_t value_size)
+{
+  int size;
+  if (!read_raw_int (size) || size < 0)
+    return false;
+
+  size_t remaining;
+  const unsigned char *mem = file->mmap_mem (remaining);
+
+  if (!file->skip (size * value_size))
+    return false;
+
+  current_event_block_mem = mem;
+  current_event_block_size = size;
+  current_event_block_mapped = true;
+  return true;
+}
+
 bool
 InFile::skip_raw_float_block()
 {
@@ -423,6 +472,12 @@ InFile::event_data()
 const vector<float>&
 InFile::event_float_block()
 {
+  if (current_event_block_mapped)
+    {
+      current_event_float_block.resize (current_event_block_size);
+      if (current_event_block_size)
+        memcpy (current_event_float_block.data(), current_event_block_mem, current_event_block_size * 4);
+    }
   return current_event_float_block;
 }
 
@@ -434,9 +489,43 @@ InFile::event_float_block()
 const vector<uint16_t>&
 InFile::event_uint16_block()
 {
+  if (current_event_block_mapped)
+    {
+      current_event_uint16_block.resize (current_event_block_size);
+      if (current_event_block_size)
+        memcpy (current_event_uint16_block.data(), current_event_block_mem, current_event_block_size * 2);
+    }
   return current_event_uint16_block;
 }
 
+/**
+ * Get raw data of the current event (only if the event is FLOAT_BLOCK or UINT16_BLOCK).
+ * The data is in host byte order; for blocks that are not mapped, this is the data
+ * of event_float_block() or event_uint16_block().
+ *
+ * \param n_values is set to the number of floats / uint16 values in the block
+ *
+ * \returns pointer to the block data (which might not be aligned for mapped blocks)
+ */
+const unsigned char *
+InFile::event_block_data (size_t& n_values)
+{
+  n_values = current_event_block_size;
+  return current_event_block_mem;
+}
+
+/**
+ * Check whether the current block event data points into the memory of the input
+ * file (see set_map_blocks()).
+ *
+ * \returns true if event_block_data() remains valid as long as the input file memory
+ */
+bool
+InFile::event_block_mapped()
+{
+  return current_event_block_mapped;
+}
+
 /**
  * Get blob's checksum.  This works for both: BLOB objects and BLOB_REF
  * objects.  During writing files, the first occurence of a BLOB is stored
@@ -463,6 +552,25 @@ InFile::add_skip_event (const string& skip_event)
   skip_events.insert (skip_event);
 }
 
+/**
+ * Enable reading FLOAT_BLOCK and UINT16_BLOCK events without copying the data.
+ * This only has an effect if the input is memory mapped (and the file byte order
+ * matches the host byte order); use event_block_data() to access the data.
+ *
+ * \param new_map_blocks whether to avoid copying block data
+ */
+void
+InFile::set_map_blocks (bool new_map_blocks)
+{
+#if G_BYTE_ORDER == G_LITTLE_ENDIAN
+  size_t remaining;
+
+  map_blocks = new_map_blocks && file && file->mmap_mem (remaining);
+#else
+  map_blocks = false; /* data needs to be converted to host byte order */
+#endif
+}
+
 /**
  * Get file type (usually a class name, like "SpectMorph::WavSet").
  *
@@ -52,6 +52,9 @@ protected:
   float                 current_event_float;
   std::vector<float>    current_event_float_block;
   std::vector<uint16_t> current_event_uint16_block;
+  const unsigned char  *current_event_block_mem;
+  size_t                current_event_block_size;
+  bool                  current_event_block_mapped;
   size_t                current_event_blob_pos;
   size_t                current_event_blob_size;
   std::string           current_event_blob_sum;
@@ -59,6 +62,7 @@ protected:
   int                   m_file_version;
 
   std::set<std::string> skip_events;
+  bool                  map_blocks;
 
   bool        read_raw_bool (bool& b);
   bool        read_raw_string (std::string& str);
@@ -67,6 +71,7 @@ protected:
   bool        read_raw_float_block (std::vector<float>& fb);
   bool        skip_raw_float_block();
   bool        read_raw_uint16_block (std::vector<uint16_t>& ib);
+  bool        read_mapped_block (size_t value_size);
   bool        skip_raw_uint16_block();
 
   void        read_file_type_and_version();
@@ -94,10 +99,13 @@ public:
   std::string  event_data();
   const std::vector<float>&     event_float_block();
   const std::vector<uint16_t>&  event_uint16_block();
+  const unsigned char          *event_block_data (size_t& n_values);
+  bool                          event_block_mapped();
   std::string  event_blob_sum();
 
   void         next_event();
   void         add_skip_event (const std::string& event);
+  void         set_map_blocks (bool map_blocks);
   std::string  file_type();
   int          file_version();
 
@@ -12,8 +12,11 @@
 #include <mutex>
 #include <cinttypes>
 #include <regex>
+#include <chrono>
 
 #include <assert.h>
+#include <string.h>
+#include <time.h>
 #include <unistd.h>
 #include <glib/gstdio.h>
 #include <utime.h>
@@ -25,6 +28,7 @@ using std::vector;
 using std::map;
 using std::regex;
 using std::regex_search;
+using std::regex_match;
 
 static string
 cache_filename (const string& filename)
@@ -44,10 +48,50 @@ InstEncCache::CacheData::~CacheData()
   leak_debugger.del (this);
 }
 
+static const char *index_filename = "inst_enc_index";
+static const int   INDEX_SAVE_DELAY = 10; // seconds without new entries before the write thread saves the index
+
+static string
+cache_key_filename (const string& key)
+{
+  return cache_filename ("inst_enc_" + key);
+}
+
+static uint64
+time_now()
+{
+  return time (nullptr);
+}
+
 InstEncCache::InstEncCache() :
-  cache_file_re ("inst_enc_[0-9a-f]{8}_[0-9a-f]{8}_[0-9]+_[0-9a-f]{40}$")
+  cache_file_re ("inst_enc_[0-9a-f]{40}$"),
+  new_file_re ("inst_enc_[0-9a-f]{40}\\.new\\.[0-9]+$"),
+  old_cache_file_re ("inst_enc_[0-9a-f]{8}_[0-9a-f]{8}_[0-9]+_[0-9a-f]{40}$")
 {
-  delete_old_files();
+  /* only scan the cache directory if there is no (valid) index */
+  if (!index_load_L())
+    index_rebuild_L();
+
+  delete_old_files_L();
+  if (disk_index_dirty)
+    index_save_L();
+
+  write_thread = std::thread (&InstEncCache::write_thread_run, this);
+}
+
+InstEncCache::~InstEncCache()
+{
+  /* write thread finishes all pending writes before it quits */
+  {
+    std::lock_guard<std::mutex> lg (write_mutex);
+    write_quit = true;
+  }
+  write_cond.notify_all();
+  write_thread.join();
+
+  std::lock_guard<std::mutex> lg (disk_mutex);
+  if (disk_index_dirty)
+    index_save_L();
 }
 
 InstEncCache*
@@ -56,78 +100,163 @@ InstEncCache::the()
   return Global::inst_enc_cache();
 }
 
-void
-InstEncCache::cache_save_L (const string& key)
+bool
+InstEncCache::index_load_L()
 {
-  const CacheData& cache_data = cache[key];
+  FILE *file = fopen (cache_filename (index_filename).c_str(), "r");
+  if (!file)
+    return false;
 
-  BinBuffer buffer;
+  char line[1024];
+  bool ok = fgets (line, sizeof (line), file) && strcmp (line, "SpectMorphCacheIndex 1\n") == 0;
+  while (ok && fgets (line, sizeof (line), file))
+    {
+      char        key[41];
+      size_t      size;
+      uint64_t    last_use;
 
-  buffer.write_start ("SpectMorphCache");
-  buffer.write_string (cache_data.version.c_str());
-  buffer.write_int (cache_data.data.size());
-  buffer.write_string (sha1_hash (&cache_data.data[0], cache_data.data.size()).c_str());
-  buffer.write_end();
+      if (sscanf (line, "%40s %zu %" SCNu64, key, &size, &last_use) == 3 && regex_match (string ("inst_enc_") + key, cache_file_re))
+        {
+          DiskEntry& entry = disk_index[key];
+
+          entry.size     = size;
+          entry.last_use = std::max<uint64> (entry.last_use, last_use);
+        }
+      else
+        {
+          ok = false;
+        }
+    }
+  fclose (file);
+
+  if (!ok)
+    disk_index.clear();
+  return ok;
+}
 
+void
+InstEncCache::index_rebuild_L()
+{
   vector<string> files;
   Error error = read_dir (sm_get_user_dir (USER_DIR_CACHE), files);
+  if (error)
+    return;
+
   for (auto filename : files)
     {
-      if (regex_search (filename, cache_file_re)) /* avoid unlink on something that we shouldn't delete */
+      const string abs_filename = cache_filename (filename);
+
+      GStatBuf stbuf;
+      if (g_stat (abs_filename.c_str(), &stbuf) != 0)
+        continue;
+
+      if (regex_search (filename, cache_file_re))
         {
-          if (filename.size() > key.size() && filename.compare (0, key.size(), key) == 0)
-            {
-              unlink (cache_filename (filename).c_str());
-            }
+          DiskEntry& entry = disk_index[filename.substr (strlen ("inst_enc_"))];
+
+          entry.size     = stbuf.st_size;
+          entry.last_use = stbuf.st_mtime;
+        }
+      else if (regex_search (filename, old_cache_file_re))
+        {
+          /* entries from older versions (one file per group and note) will never be used again */
+          unlink (abs_filename.c_str());
+        }
+      else if (regex_search (filename, new_file_re) && uint64 (stbuf.st_mtime) + 3600 < time_now())
+        {
+          /* leaked by a process that was terminated while writing a cache file */
+          unlink (abs_filename.c_str());
         }
     }
+  disk_index_dirty = true;
+}
 
-  string out_filename = cache_filename (key) + "_" + cache_data.version;
-  FILE *outf = fopen (out_filename.c_str(), "wb");
+void
+InstEncCache::index_save_L()
+{
+  /* other processes may have added entries since we've loaded the index, so merge
+   * with the current index file before replacing it (without the entries we deleted)
+   */
+  std::map<std::string, DiskEntry> our_index;
+  our_index.swap (disk_index);
+  index_load_L();
+
+  for (auto& entry : disk_index)
+    {
+      auto it = our_index.find (entry.first);
+      if (it != our_index.end())
+        it->second.last_use = std::max (it->second.last_use, entry.second.last_use);
+      else if (!disk_deleted_keys.count (entry.first))
+        our_index[entry.first] = entry.second;
+    }
+  disk_index.swap (our_index);
+  disk_deleted_keys.clear();
+
+  /* atomically replace old index with new index */
+  const string filename     = cache_filename (index_filename);
+  const string new_filename = string_printf ("%s.new.%d", filename.c_str(), getpid());
+
+  FILE *outf = fopen (new_filename.c_str(), "w");
   if (outf)
     {
-      for (auto ch : buffer.to_string())
-        fputc (ch, outf);
-      fputc (0, outf);
-      const unsigned char *ptr = cache_data.data.data();
-      fwrite (ptr, 1, cache_data.data.size(), outf);
-      fclose (outf);
+      fprintf (outf, "SpectMorphCacheIndex 1\n");
+      for (auto& entry : disk_index)
+        fprintf (outf, "%s %zu %" PRIu64 "\n", entry.first.c_str(), entry.second.size, uint64_t (entry.second.last_use));
+
+      if (fclose (outf) == 0)
+        g_rename (new_filename.c_str(), filename.c_str());
+      else
+        unlink (new_filename.c_str());
     }
+  disk_index_dirty = false;
 }
 
 static bool
-ends_with (const string& value, const string& ending)
+write_cache_file (const string& key, const vector<unsigned char>& data, size_t& file_size)
 {
-  if (ending.size() > value.size())
-    return false;
+  BinBuffer buffer;
 
-  return std::equal (ending.rbegin(), ending.rend(), value.rbegin());
-}
+  buffer.write_start ("SpectMorphCache");
+  buffer.write_string (key.c_str());
+  buffer.write_int (data.size());
+  buffer.write_string (sha1_hash (&data[0], data.size()).c_str());
+  buffer.write_end();
 
-void
-InstEncCache::cache_try_load_L (const string& cache_key, const string& need_version)
-{
-  GenericIn *in_file = nullptr;
-  string     abs_filename;
+  const string header = buffer.to_string();
 
-  vector<string> files;
-  Error error = read_dir (sm_get_user_dir (USER_DIR_CACHE), files);
-  for (auto filename : files)
+  /* write to a temporary file and atomically rename it into place, so that other processes
+   * never see a partially written cache file (only the write thread writes cache files, so
+   * using the pid for the temporary filename is sufficient)
+   */
+  const string filename     = cache_key_filename (key);
+  const string new_filename = string_printf ("%s.new.%d", filename.c_str(), getpid());
+
+  FILE *outf = fopen (new_filename.c_str(), "wb");
+  if (!outf)
+    return false;
+
+  bool ok = fwrite (header.data(), 1, header.size(), outf) == header.size();
+  ok = ok && fputc (0, outf) == 0;
+  ok = ok && fwrite (data.data(), 1, data.size(), outf) == data.size();
+  ok = (fclose (outf) == 0) && ok;
+
+  if (ok && g_rename (new_filename.c_str(), filename.c_str()) == 0)
     {
-      if (regex_search (filename, cache_file_re))
-        {
-          if (ends_with (filename, need_version))
-            {
-              abs_filename = cache_filename (filename);
-              in_file = GenericIn::open (abs_filename);
-              if (in_file)
-                break;
-            }
-        }
+      file_size = header.size() + 1 + data.size();
+      return true;
     }
+  unlink (new_filename.c_str());
+  return false;
+}
 
+std::shared_ptr<const Audio>
+InstEncCache::cache_load (const string& key)
+{
+  const string abs_filename = cache_key_filename (key);
+
+  GenericIn *in_file = GenericIn::open (abs_filename);
   if (!in_file)  // no cache entry
-    return;
+    return nullptr;
 
   // read header (till zero char)
   string header_str;
@@ -143,7 +272,8 @@ InstEncCache::cache_try_load_L (const string& cache_key, const string& need_vers
   int    data_size  = buffer.read_int();
   string data_hash  = buffer.read_string_inplace();
 
-  if (version == need_version)
+  std::shared_ptr<const Audio> result;
+  if (version == key && data_size >= 0)
     {
       vector<unsigned char> data (data_size);
       if (in_file->read (&data[0], data.size()) == data_size)
@@ -151,24 +281,43 @@ InstEncCache::cache_try_load_L (const string& cache_key, const string& need_vers
           string load_data_hash = sha1_hash (&data[0], data.size());
           if (load_data_hash == data_hash)
             {
-              cache[cache_key].version = version;
-              cache[cache_key].data    = std::move (data);
-
-              /* bump mtime on successful load; this information is used during
-               * InstEncCache::delete_old_files() to remove the oldest cache files
-               */
-              g_utime (abs_filename.c_str(), nullptr);
+              GenericIn *in = MMapIn::open_mem (&data[0], &data[data.size()]);
+              Audio     *audio = new Audio;
+              Error      error = audio->load (in);
+
+              delete in;
+
+              if (!error)
+                {
+                  result.reset (audio);
+
+                  /* bump mtime on successful load; this information is used to rebuild the index */
+                  g_utime (abs_filename.c_str(), nullptr);
+
+                  std::lock_guard<std::mutex> lg (disk_mutex);
+                  DiskEntry& entry = disk_index[key];
+
+                  entry.size     = header_str.size() + 1 + data_size;
+                  entry.last_use = time_now();
+                  disk_index_dirty = true;
+                }
+              else
+                {
+                  delete audio;
+                }
             }
         }
     }
   delete in_file;
+
+  return result;
 }
 
 static string
-mk_version (const string& wav_data_hash, int midi_note, int iclipstart, int iclipend, Instrument::EncoderConfig& cfg)
+mk_cache_key (const string& wav_data_hash, int midi_note, int iclipstart, int iclipend, Instrument::EncoderConfig& cfg)
 {
   /* create one single string that lists all the dependencies for the cache entry;
-   * hash it to get a compact representation of the "version"
+   * hash it to get a compact representation, which is used as cache key
    */
   string depends;
 
@@ -186,23 +335,45 @@ mk_version (const string& wav_data_hash, int midi_note, int iclipstart, int icli
   return sha1_hash (depends);
 }
 
+class InstEncCache::KeyLockGuard
+{
+  InstEncCache& cache;
+  std::string   key;
+  KeyLock      *key_lock;
+public:
+  KeyLockGuard (InstEncCache& cache, const string& key) :
+    cache (cache),
+    key (key)
+  {
+    {
+      std::lock_guard<std::mutex> lg (cache.cache_mutex);
+
+      key_lock = &cache.key_locks[key];
+      key_lock->users++;
+    }
+    key_lock->mutex.lock();
+  }
+  ~KeyLockGuard()
+  {
+    key_lock->mutex.unlock();
+
+    std::lock_guard<std::mutex> lg (cache.cache_mutex);
+    if (--key_lock->users == 0)
+      cache.key_locks.erase (key);
+  }
+};
+
 Audio *
 InstEncCache::encode (Group *group, const WavData& wav_data, const string& wav_data_hash, int midi_note, int iclipstart, int iclipend, Instrument::EncoderConfig& cfg,
                       const std::function<bool()>& kill_function)
 {
-  // if group is not specified we create a random group just for this one request
-  std::unique_ptr<Group> random_group;
-  if (!group)
-    {
-      random_group.reset (create_group());
-      group = random_group.get();
-    }
+  string cache_key = mk_cache_key (wav_data_hash, midi_note, iclipstart, iclipend, cfg);
 
-  string cache_key = string_printf ("inst_enc_%s_%d", group->id.c_str(), midi_note);
-  string version   = mk_version (wav_data_hash, midi_note, iclipstart, iclipend, cfg);
+  /* only one thread at a time looks up / encodes this key, others wait for the cache entry */
+  KeyLockGuard key_lock_guard (*this, cache_key);
 
   // search disk cache and memory cache
-  Audio *audio = cache_lookup (cache_key, version);
+  Audio *audio = cache_lookup (cache_key);
   if (audio)
     return audio;
 
@@ -224,66 +395,153 @@ InstEncCache::encode (Group *group, const WavData& wav_data, const string& wav_d
   if (!audio)
     return nullptr;
 
-  cache_add (cache_key, version, audio);
+  cache_add (cache_key, audio);
 
   return audio;
 }
 
 Audio *
-InstEncCache::cache_lookup (const string& cache_key, const string& version)
+InstEncCache::cache_lookup (const string& cache_key)
 {
-  std::lock_guard<std::mutex> lg (cache_mutex);
-  if (cache[cache_key].version != version)
+  std::shared_ptr<const Audio> audio;
+  {
+    std::lock_guard<std::mutex> lg (cache_mutex);
+
+    auto it = cache.find (cache_key);
+    if (it != cache.end()) // cache hit (in memory)
+      {
+        it->second.read_stamp = cache_read_stamp++;
+        audio = it->second.audio;
+      }
+  }
+  if (!audio)
     {
-      cache_try_load_L (cache_key, version);
+      /* file I/O and parsing without holding cache_mutex; the per-key lock ensures that
+       * only one thread at a time loads this entry */
+      audio = cache_load (cache_key);
+      if (!audio)
+        return nullptr;
+
+      cache_insert (cache_key, audio);
     }
-  if (cache[cache_key].version == version) // cache hit (in memory)
-    {
-      vector<unsigned char>& data = cache[cache_key].data;
-      cache[cache_key].read_stamp = cache_read_stamp++;
+  return audio->clone();
+}
 
-      GenericIn *in = MMapIn::open_mem (&data[0], &data[data.size()]);
-      Audio     *audio = new Audio;
-      Error      error = audio->load (in);
+void
+InstEncCache::cache_insert (const string& cache_key, std::shared_ptr<const Audio> audio)
+{
+  std::set<const GMappedFile *> mapped_files;
+  const size_t size = audio->mem_usage (mapped_files);
 
-      delete in;
+  std::lock_guard<std::mutex> lg (cache_mutex);
 
-      if (!error)
-        return audio;
+  CacheData& cache_data = cache[cache_key];
 
-      delete audio;
-    }
-  return nullptr;
+  cache_data.audio      = audio;
+  cache_data.size       = size;
+  cache_data.read_stamp = cache_read_stamp++;
+
+  /* enforce size limits and expire cache data from time to time */
+  if ((cache_read_stamp % 10) == 0)
+    delete_old_memory_L();
 }
 
 void
-InstEncCache::cache_add (const string& cache_key, const string& version, const Audio *audio)
+InstEncCache::cache_add (const string& cache_key, const Audio *audio)
 {
   vector<unsigned char> data;
   MemOut                audio_mem_out (&data);
 
   audio->save (&audio_mem_out);
 
-  // LOCK cache: store entry
-  std::lock_guard<std::mutex> lg (cache_mutex);
+  cache_insert (cache_key, std::shared_ptr<const Audio> (audio->clone()));
 
-  cache[cache_key].version    = version;
-  cache[cache_key].data       = data;
-  cache[cache_key].read_stamp = cache_read_stamp++;
+  /* writing the file is done by the write thread */
+  std::lock_guard<std::mutex> lg (write_mutex);
 
-  cache_save_L (cache_key);
+  write_queue.push_back ({ cache_key, std::move (data) });
+  write_cond.notify_all();
+}
 
-  /* enforce size limits and expire cache data from time to time */
-  if ((cache_read_stamp % 10) == 0)
+void
+InstEncCache::write_thread_run()
+{
+  std::unique_lock<std::mutex> lock (write_mutex);
+
+  bool index_save_pending = false;
+  while (!write_quit || !write_queue.empty())
     {
-      delete_old_files();
-      delete_old_memory_L();
+      if (write_queue.empty())
+        {
+          if (!index_save_pending)
+            {
+              write_cond.wait (lock);
+              continue;
+            }
+          /* make new entries visible to other processes once no more entries were written for
+           * a while, so encoding many notes doesn't rewrite the index for each batch (the
+           * destructor saves the index if we quit before that)
+           */
+          if (write_cond.wait_for (lock, std::chrono::seconds (INDEX_SAVE_DELAY)) == std::cv_status::timeout && write_queue.empty())
+            {
+              lock.unlock();
+              {
+                std::lock_guard<std::mutex> lg (disk_mutex);
+                if (disk_index_dirty)
+                  index_save_L();
+              }
+              lock.lock();
+              index_save_pending = false;
+            }
+          continue;
+        }
+      vector<WriteJob> jobs;
+      jobs.swap (write_queue);
+      write_busy = true;
+
+      lock.unlock();
+
+      for (const auto& job : jobs)
+        {
+          size_t file_size;
+          if (write_cache_file (job.key, job.data, file_size))
+            {
+              std::lock_guard<std::mutex> lg (disk_mutex);
+              DiskEntry& entry = disk_index[job.key];
+
+              entry.size     = file_size;
+              entry.last_use = time_now();
+              disk_index_dirty = true;
+            }
+        }
+      {
+        /* enforce disk size limit */
+        std::lock_guard<std::mutex> lg (disk_mutex);
+
+        delete_old_files_L();
+        index_save_pending = disk_index_dirty;
+      }
+
+      lock.lock();
+      write_busy = false;
+      write_cond.notify_all();
     }
 }
 
+void
+InstEncCache::wait_for_writes()
+{
+  std::unique_lock<std::mutex> lock (write_mutex);
+
+  write_cond.wait (lock, [this] { return write_queue.empty() && !write_busy; });
+}
+
 void
 InstEncCache::clear()
 {
+  /* entries that are not written yet would be lost */
+  wait_for_writes();
+
   std::lock_guard<std::mutex> lg (cache_mutex);
 
   cache.clear();
@@ -299,53 +557,45 @@ InstEncCache::create_group()
 }
 
 void
-InstEncCache::delete_old_files()
+InstEncCache::delete_old_files_L()
 {
   struct Status
   {
-    string abs_filename;
-    uint64 mtime = 0;
+    string key;
+    uint64 last_use = 0;
     size_t size = 0;
   };
-  vector<string> files;
   vector<Status> file_status;
 
-  Error error = read_dir (sm_get_user_dir (USER_DIR_CACHE), files);
-  if (error)
-    return;
-
-  for (auto filename : files)
+  for (auto& entry : disk_index)
     {
       Status status;
-      status.abs_filename = cache_filename (filename);
-      GStatBuf stbuf;
-      if (g_stat (status.abs_filename.c_str(), &stbuf) == 0)
-        {
-          status.mtime = stbuf.st_mtime;
-          status.size  = stbuf.st_size;;
-          file_status.push_back (status);
-        }
+      status.key      = entry.first;
+      status.last_use = entry.second.last_use;
+      status.size     = entry.second.size;
+      file_status.push_back (status);
     }
   std::sort (file_status.begin(), file_status.end(),
     [](const Status& st1, const Status& st2)
       {
         /* sort: start with newest entries */
-        return st1.mtime > st2.mtime;
+        return st1.last_use > st2.last_use;
       });
 
   const size_t max_total_size = 100 * 1000 * 1000; // 100 MB total cache size
   size_t total_size = 0;
   for (auto status : file_status)
     {
-      /* using a regexp here avoids deleting unrelated files; even if something is
-       * misconfigured this should make calling unlink() relatively safe */
-      if (regex_search (status.abs_filename, cache_file_re))
+      total_size += status.size;
+      if (total_size > max_total_size)
         {
-          total_size += status.size;
-          if (total_size > max_total_size)
-            unlink (status.abs_filename.c_str());
-          // printf ("%s %" PRIu64 " %zd %zd\n", status.abs_filename.c_str(), status.mtime, status.size, total_size);
+          /* only unlink files named after a cache key, so this is relatively safe */
+          unlink (cache_key_filename (status.key).c_str());
+          disk_index.erase (status.key);
+          disk_deleted_keys.insert (status.key);
+          disk_index_dirty = true;
         }
+      // printf ("%s %" PRIu64 " %zd %zd\n", status.key.c_str(), status.last_use, status.size, total_size);
     }
 }
 
@@ -367,7 +617,7 @@ InstEncCache::delete_old_memory_L()
 
       Status status;
       status.key        = key;
-      status.size       = cache_data.data.size();
+      status.size       = cache_data.size;
       status.read_stamp = cache_data.read_stamp;
 
       mem_status.push_back (status);
@@ -8,37 +8,96 @@
 #include "sminstrument.hh"
 
 #include <mutex>
+#include <thread>
+#include <condition_variable>
+#include <memory>
 #include <regex>
+#include <set>
 
 namespace SpectMorph
 {
 
 class InstEncCache
 {
+  /* cache entries are content addressed: the key is a hash of everything the encoded
+   * data depends on (see mk_cache_key), so entries are shared between groups and processes
+   *
+   * the memory cache stores decoded (immutable) Audio objects, so a hit only needs a copy
+   */
   struct CacheData
   {
-    std::string                version;
-    std::vector<unsigned char> data;
-    uint64                     read_stamp = 0;
+    std::shared_ptr<const Audio> audio;
+    size_t                       size = 0;
+    uint64                       read_stamp = 0;
 
     CacheData();
     ~CacheData();
   };
 
-  std::map<std::string, CacheData> cache;
+  /* on-disk index entry: size and time of last use (in seconds) of a cache file */
+  struct DiskEntry
+  {
+    size_t size     = 0;
+    uint64 last_use = 0;
+  };
+
+  /* encoding a key is serialized by a per-key lock, so that different keys can be encoded
+   * in parallel, but the same key is never encoded twice at the same time */
+  struct KeyLock
+  {
+    std::mutex  mutex;
+    int         users = 0;
+  };
+  class KeyLockGuard;
+
+  /* serialized entry that is waiting to be written to disk */
+  struct WriteJob
+  {
+    std::string                key;
+    std::vector<unsigned char> data;
+  };
+
+  /* memory cache: cache_mutex is only held for short map operations, never for disk I/O */
+  std::map<std::string, CacheData> cache;       // protected by cache_mutex
+  std::map<std::string, KeyLock>   key_locks;   // protected by cache_mutex
+  uint64                           cache_read_stamp = 0;
   std::mutex                       cache_mutex;
+
+  /* disk cache */
+  std::map<std::string, DiskEntry> disk_index;  // protected by disk_mutex
+  bool                             disk_index_dirty = false;
+  std::set<std::string>            disk_deleted_keys; // protected by disk_mutex, files deleted since the last index_save_L()
+  std::mutex                       disk_mutex;
   const std::regex                 cache_file_re;
-  uint64                           cache_read_stamp = 0;
+  const std::regex                 new_file_re;
+  const std::regex                 old_cache_file_re;
+
+  /* background write-back and disk cache expiry */
+  std::vector<WriteJob>            write_queue; // protected by write_mutex
+  bool                             write_busy = false;
+  bool                             write_quit = false;
+  std::mutex                       write_mutex;
+  std::condition_variable          write_cond;
+  std::thread                      write_thread;
+
+  std::shared_ptr<const Audio> cache_load (const std::string& key);
+  void        cache_insert (const std::string& key, std::shared_ptr<const Audio> audio);
+  Audio      *cache_lookup (const std::string& key);
+  void        cache_add (const std::string& key, const Audio *audio);
+  void        write_thread_run();
+  void        wait_for_writes();
 
-  void        cache_save_L (const std::string& key);
-  void        cache_try_load_L (const std::string& key, const std::string& need_version);
-  Audio      *cache_lookup (const std::string& cache_key, const std::string& version);
-  void        cache_add (const std::string& cache_key, const std::string& version, const Audio *audio);
+  /* the index/disk functions need disk_mutex, delete_old_memory_L() needs cache_mutex */
+  bool        index_load_L();
+  void        index_rebuild_L();
+  void        index_save_L();
 
-  void        delete_old_files();
+  void        delete_old_files_L();
   void        delete_old_memory_L();
 
 public:
+  /* groups don't affect caching (entries are shared between all groups), they are
+   * only kept for API compatibility */
   class Group
   {
   public:
@@ -52,6 +111,7 @@ public:
   Group      *create_group();
 
   InstEncCache();
+  ~InstEncCache();
 
   static InstEncCache *the(); // Singleton
 };
@@ -30,6 +30,7 @@ InstEncoder::encode (const WavData& wav_data, int midi_note, Instrument::Encoder
   enc_params.setup_params (wav_data, freq_from_note (midi_note));
   enc_params.enable_phases = false; // save some space
   enc_params.set_kill_function (kill_function);
+  enc_params.streaming = true; // don't keep debug data, which we don't need
 
   Encoder encoder (enc_params);
 
@@ -37,13 +38,6 @@ InstEncoder::encode (const WavData& wav_data, int midi_note, Instrument::Encoder
     return nullptr;
 
   /* strip stuff we don't need (but keep everything that is needed if loop points are changed) */
-  vector<EncoderBlock>& audio_blocks = encoder.audio_blocks;
-
-  for (size_t i = 0; i < audio_blocks.size(); i++)
-    {
-      audio_blocks[i].debug_samples.clear();
-      audio_blocks[i].original_fft.clear();
-    }
   encoder.original_samples.clear();
 
   return encoder.save_as_audio();
@@ -0,0 +1,304 @@
+// Licensed GNU LGPL v2.1 or later: http://www.gnu.org/licenses/lgpl-2.1.html
+
+#include "smladdervcf.hh"
+#include "smmain.hh"
+
+#ifdef __SSE__
+#include <pmmintrin.h>
+#endif
+
+using namespace SpectMorph;
+
+using std::min;
+
+LadderVCFVoice::LadderVCFVoice()
+{
+  reset();
+  set_mode (LadderVCFMode::LP4);
+  set_drive (0);
+  set_rate (48000);
+}
+
+void
+LadderVCFVoice::set_mode (LadderVCFMode new_mode)
+{
+  mode = new_mode;
+}
+
+void
+LadderVCFVoice::set_drive (double drive_db)
+{
+  const double drive_delta_db = 36;
+
+  pre_scale = db_to_factor (drive_db - drive_delta_db);
+  post_scale = std::max (1 / pre_scale, 1.0f);
+}
+
+void
+LadderVCFVoice::set_rate (double r)
+{
+  rate = r;
+}
+
+void
+LadderVCFVoice::reset()
+{
+  x1 = x2 = x3 = x4 = 0;
+  y1 = y2 = y3 = y4 = 0;
+
+  res_up.reset();
+  res_down.reset();
+}
+
+void
+LadderVCFVoice::set_block (float *samples, const float *freq_in, const float *reso_in, const float *mix_in)
+{
+  this->samples = samples;
+  this->freq_in = freq_in;
+  this->reso_in = reso_in;
+  this->mix_in  = mix_in;
+}
+
+void
+LadderVCFVoice::run_block (uint n_samples)
+{
+  LadderVCFVoice *voices[1] = { this };
+
+  run_lanes (voices, 1, n_samples);
+}
+
+void
+LadderVCFVoice::run_voices (LadderVCFVoice **voices, uint n_voices, uint n_samples)
+{
+  for (uint v = 0; v < n_voices; v += LANES)
+    run_lanes (voices + v, min (n_voices - v, LANES), n_samples);
+}
+
+/*
+ * Filter up to LANES voices at once; this is the same algorithm as LadderVCF::run(),
+ * but the data is interleaved so that each SSE lane contains the data of one voice.
+ * Unused lanes get zero input and are discarded.
+ */
+void
+LadderVCFVoice::run_lanes (LadderVCFVoice **voices, uint n_voices, uint n_samples)
+{
+  constexpr uint L = LANES;
+
+  alignas (16) float lx1[L] = { 0, }, lx2[L] = { 0, }, lx3[L] = { 0, }, lx4[L] = { 0, };
+  alignas (16) float ly1[L] = { 0, }, ly2[L] = { 0, }, ly3[L] = { 0, }, ly4[L] = { 0, };
+  alignas (16) float lpre_scale[L] = { 0, };
+
+  /* output = y1 * sel1 + ... + y4 * sel4, where only the selected filter output has a non-zero factor */
+  alignas (16) float lsel1[L] = { 0, }, lsel2[L] = { 0, }, lsel3[L] = { 0, }, lsel4[L] = { 0, };
+
+  for (uint v = 0; v < n_voices; v++)
+    {
+      const LadderVCFVoice *voice = voices[v];
+
+      lx1[v] = voice->x1;
+      lx2[v] = voice->x2;
+      lx3[v] = voice->x3;
+      lx4[v] = voice->x4;
+      ly1[v] = voice->y1;
+      ly2[v] = voice->y2;
+      ly3[v] = voice->y3;
+      ly4[v] = voice->y4;
+      lpre_scale[v] = voice->pre_scale;
+
+      switch (voice->mode)
+        {
+          case LadderVCFMode::LP1: lsel1[v] = voice->post_scale;
+                                   break;
+          case LadderVCFMode::LP2: lsel2[v] = voice->post_scale;
+                                   break;
+          case LadderVCFMode::LP3: lsel3[v] = voice->post_scale;
+                                   break;
+          case LadderVCFMode::LP4: lsel4[v] = voice->post_scale;
+                                   break;
+        }
+    }
+
+  const float a = 1 / 1.3;
+  const float b = 0.3 / 1.3;
+  const float g_comp = 0.5; // passband gain correction
+
+  for (uint pos = 0; pos < n_samples; pos += BLOCK_SIZE)
+    {
+      const uint n = min (BLOCK_SIZE, n_samples - pos);
+
+      alignas (16) float over[2 * BLOCK_SIZE][L];
+      alignas (16) float fc[BLOCK_SIZE][L];
+      alignas (16) float res[BLOCK_SIZE][L];
+      alignas (16) float mix[BLOCK_SIZE][L];
+      float tmp[2 * BLOCK_SIZE];
+
+      for (uint v = 0; v < L; v++)
+        {
+          if (v < n_voices)
+            {
+              LadderVCFVoice *voice = voices[v];
+
+              voice->res_up.process_block (voice->samples + pos, n, tmp);
+              for (uint i = 0; i < 2 * n; i++)
+                over[i][v] = tmp[i];
+
+              /* oversampling: cutoff is relative to 2 * nyquist */
+              for (uint i = 0; i < n; i++)
+                {
+                  fc[i][v]  = sm_clamp (voice->freq_in[pos + i] / voice->rate, 0.0f, 1.0f) * float (M_PI);
+                  res[i][v] = sm_clamp (voice->reso_in[pos + i], 0.0f, 1.0f);
+                  mix[i][v] = voice->mix_in ? voice->mix_in[pos + i] : 1;
+                }
+            }
+          else
+            {
+              for (uint i = 0; i < 2 * n; i++)
+                over[i][v] = 0;
+
+              for (uint i = 0; i < n; i++)
+                fc[i][v] = res[i][v] = mix[i][v] = 0;
+            }
+        }
+#ifdef __SSE__
+      /* the filter state decays into denormals once the input is silent, which is very slow */
+      const uint old_csr = _mm_getcsr();
+      _mm_setcsr (old_csr | _MM_FLUSH_ZERO_ON | _MM_DENORMALS_ZERO_ON);
+
+      if (sm_sse())
+        {
+          __m128 x1 = _mm_load_ps (lx1), x2 = _mm_load_ps (lx2), x3 = _mm_load_ps (lx3), x4 = _mm_load_ps (lx4);
+          __m128 y1 = _mm_load_ps (ly1), y2 = _mm_load_ps (ly2), y3 = _mm_load_ps (ly3), y4 = _mm_load_ps (ly4);
+
+          const __m128 pre_scale = _mm_load_ps (lpre_scale);
+          const __m128 sel1 = _mm_load_ps (lsel1), sel2 = _mm_load_ps (lsel2), sel3 = _mm_load_ps (lsel3), sel4 = _mm_load_ps (lsel4);
+          const __m128 va = _mm_set1_ps (a), vb = _mm_set1_ps (b), vg_comp = _mm_set1_ps (g_comp);
+          const __m128 one = _mm_set1_ps (1), minus_one = _mm_set1_ps (-1), third = _mm_set1_ps (1.0f / 3);
+
+          for (uint i = 0; i < n; i++)
+            {
+              const __m128 f = _mm_load_ps (fc[i]);
+
+              /* g = 0.9892 * f - 0.4342 * f^2 + 0.1381 * f^3 - 0.0202 * f^4 */
+              __m128 g = _mm_add_ps (_mm_mul_ps (f, _mm_set1_ps (-0.0202f)), _mm_set1_ps (0.1381f));
+              g = _mm_add_ps (_mm_mul_ps (g, f), _mm_set1_ps (-0.4342f));
+              g = _mm_add_ps (_mm_mul_ps (g, f), _mm_set1_ps (0.9892f));
+              g = _mm_mul_ps (g, f);
+
+              /* res *= 1.0029 + 0.0526 * f - 0.0926 * f^2 + 0.0218 * f^3 */
+              __m128 rc = _mm_add_ps (_mm_mul_ps (f, _mm_set1_ps (0.0218f)), _mm_set1_ps (-0.0926f));
+              rc = _mm_add_ps (_mm_mul_ps (rc, f), _mm_set1_ps (0.0526f));
+              rc = _mm_add_ps (_mm_mul_ps (rc, f), _mm_set1_ps (1.0029f));
+              const __m128 res4 = _mm_mul_ps (_mm_mul_ps (_mm_load_ps (res[i]), rc), _mm_set1_ps (4));
+
+              const __m128 wet = _mm_load_ps (mix[i]);
+              const __m128 dry = _mm_sub_ps (one, wet);
+
+              for (uint os = 0; os < 2; os++)
+                {
+                  float *value_p = over[i * 2 + os];
+
+                  const __m128 value = _mm_load_ps (value_p);
+                  const __m128 x = _mm_mul_ps (value, pre_scale);
+
+                  /* distort: clamp to [-1:1], then x - x^3 / 3 */
+                  __m128 x0 = _mm_sub_ps (x, _mm_mul_ps (_mm_sub_ps (y4, _mm_mul_ps (vg_comp, x)), res4));
+                  x0 = _mm_min_ps (_mm_max_ps (x0, minus_one), one);
+                  x0 = _mm_sub_ps (x0, _mm_mul_ps (_mm_mul_ps (_mm_mul_ps (x0, x0), x0), third));
+
+                  y1 = _mm_add_ps (_mm_mul_ps (_mm_sub_ps (_mm_add_ps (_mm_mul_ps (x0, va), _mm_mul_ps (x1, vb)), y1), g), y1);
+                  x1 = x0;
+
+                  y2 = _mm_add_ps (_mm_mul_ps (_mm_sub_ps (_mm_add_ps (_mm_mul_ps (y1, va), _mm_mul_ps (x2, vb)), y2), g), y2);
+                  x2 = y1;
+
+                  y3 = _mm_add_ps (_mm_mul_ps (_mm_sub_ps (_mm_add_ps (_mm_mul_ps (y2, va), _mm_mul_ps (x3, vb)), y3), g), y3);
+                  x3 = y2;
+
+                  y4 = _mm_add_ps (_mm_mul_ps (_mm_sub_ps (_mm_add_ps (_mm_mul_ps (y3, va), _mm_mul_ps (x4, vb)), y4), g), y4);
+                  x4 = y3;
+
+                  __m128 out = _mm_mul_ps (y1, sel1);
+                  out = _mm_add_ps (out, _mm_mul_ps (y2, sel2));
+                  out = _mm_add_ps (out, _mm_mul_ps (y3, sel3));
+                  out = _mm_add_ps (out, _mm_mul_ps (y4, sel4));
+
+                  _mm_store_ps (value_p, _mm_add_ps (_mm_mul_ps (out, wet), _mm_mul_ps (value, dry)));
+                }
+            }
+          _mm_store_ps (lx1, x1); _mm_store_ps (lx2, x2); _mm_store_ps (lx3, x3); _mm_store_ps (lx4, x4);
+          _mm_store_ps (ly1, y1); _mm_store_ps (ly2, y2); _mm_store_ps (ly3, y3); _mm_store_ps (ly4, y4);
+        }
+      else
+#endif
+        {
+          for (uint v = 0; v < n_voices; v++)
+            {
+              float x1 = lx1[v], x2 = lx2[v], x3 = lx3[v], x4 = lx4[v];
+              float y1 = ly1[v], y2 = ly2[v], y3 = ly3[v], y4 = ly4[v];
+
+              for (uint i = 0; i < n; i++)
+                {
+                  const float f = fc[i][v];
+                  const float g = (((-0.0202f * f + 0.1381f) * f - 0.4342f) * f + 0.9892f) * f;
+                  const float rc = ((0.0218f * f - 0.0926f) * f + 0.0526f) * f + 1.0029f;
+                  const float res4 = res[i][v] * rc * 4;
+                  const float wet = mix[i][v];
+                  const float dry = 1 - wet;
+
+                  for (uint os = 0; os < 2; os++)
+                    {
+                      float& value = over[i * 2 + os][v];
+
+                      const float x = value * lpre_scale[v];
+
+                      float x0 = sm_clamp (x - (y4 - g_comp * x) * res4, -1.0f, 1.0f);
+                      x0 = x0 - x0 * x0 * x0 * (1.0f / 3);
+
+                      y1 = (x0 * a + x1 * b - y1) * g + y1;
+                      x1 = x0;
+
+                      y2 = (y1 * a + x2 * b - y2) * g + y2;
+                      x2 = y1;
+
+                      y3 = (y2 * a + x3 * b - y3) * g + y3;
+                      x3 = y2;
+
+                      y4 = (y3 * a + x4 * b - y4) * g + y4;
+                      x4 = y3;
+
+                      const float out = y1 * lsel1[v] + y2 * lsel2[v] + y3 * lsel3[v] + y4 * lsel4[v];
+
+                      value = out * wet + value * dry;
+                    }
+                }
+              lx1[v] = x1; lx2[v] = x2; lx3[v] = x3; lx4[v] = x4;
+              ly1[v] = y1; ly2[v] = y2; ly3[v] = y3; ly4[v] = y4;
+            }
+        }
+#ifdef __SSE__
+      _mm_setcsr (old_csr);
+#endif
+
+      for (uint v = 0; v < n_voices; v++)
+        {
+          for (uint i = 0; i < 2 * n; i++)
+            tmp[i] = over[i][v];
+
+          voices[v]->res_down.process_block (tmp, 2 * n, voices[v]->samples + pos);
+        }
+    }
+
+  for (uint v = 0; v < n_voices; v++)
+    {
+      LadderVCFVoice *voice = voices[v];
+
+      voice->x1 = lx1[v];
+      voice->x2 = lx2[v];
+      voice->x3 = lx3[v];
+      voice->x4 = lx4[v];
+      voice->y1 = ly1[v];
+      voice->y2 = ly2[v];
+      voice->y3 = ly3[v];
+      voice->y4 = ly4[v];
+    }
+}
@@ -303,6 +303,53 @@ typedef LadderVCF<true,  true>  LadderVCFNonLinear;
 // fast non-linear version (no oversampling), may have aliasing
 typedef LadderVCF<false, true>  LadderVCFNonLinearCheap;
 
+/*
+ * Mono version of LadderVCFNonLinear for synthesis voices, with float state.
+ *
+ * Filtering is done in two steps: set_block() stores the input/output buffer and
+ * the parameters of the next block, run_voices() filters the blocks of several voices
+ * at once, using one SSE lane per voice.
+ */
+class LadderVCFVoice
+{
+public:
+  static constexpr uint LANES = 4;
+
+private:
+  static constexpr uint BLOCK_SIZE = 128;  // run_voices() processes the samples in blocks of this size
+
+  float x1, x2, x3, x4;
+  float y1, y2, y3, y4;
+
+  Resampler2 res_up   { Resampler2::UP,   2, Resampler2::PREC_72DB };
+  Resampler2 res_down { Resampler2::DOWN, 2, Resampler2::PREC_72DB };
+
+  LadderVCFMode mode;
+  float         pre_scale, post_scale;
+  float         rate;
+
+  // next block
+  float        *samples = nullptr;
+  const float  *freq_in = nullptr;
+  const float  *reso_in = nullptr;
+  const float  *mix_in  = nullptr;
+
+  static void run_lanes (LadderVCFVoice **voices, uint n_voices, uint n_samples);
+public:
+  LadderVCFVoice();
+
+  void set_mode (LadderVCFMode new_mode);
+  void set_drive (double drive_db);
+  void set_rate (double r);
+  void reset();
+
+  /* samples are filtered in place: freq_in is the cutoff (Hz), reso_in the resonance [0:1], mix_in the dry/wet mix [0:1] */
+  void set_block (float *samples, const float *freq_in, const float *reso_in, const float *mix_in);
+  void run_block (uint n_samples);
+
+  static void run_voices (LadderVCFVoice **voices, uint n_voices, uint n_samples);
+};
+
 } // SpectMorph
 
 #endif // __BSE_DEVICES_LADDER_VCF_HH__
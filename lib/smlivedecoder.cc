@@ -4,6 +4,7 @@
 #include "smmath.hh"
 #include "smleakdebugger.hh"
 #include "smutils.hh"
+#include "smdsptimer.hh"
 
 #include <stdio.h>
 #include <assert.h>
@@ -55,12 +56,16 @@ LiveDecoder::LiveDecoder() :
   source (NULL),
   sines_enabled (true),
   noise_enabled (true),
+  noise_bank_enabled (false),
   debug_fft_perf_enabled (false),
   original_samples_enabled (false),
   loop_enabled (true),
   start_skip_enabled (false),
   noise_seed (-1),
+  have_random_seed (false),
+  random_seed (0),
   sse_samples (NULL),
+  dsp_mix_freq (0),
   vibrato_enabled (false)
 {
   init_aa_filter();
@@ -100,10 +105,35 @@ LiveDecoder::~LiveDecoder()
   leak_debugger.del (this);
 }
 
+void
+LiveDecoder::setup_dsp (float mix_freq)
+{
+  /* NoiseDecoder, IFFTSynth and the sample buffer only depend on mix_freq
+   * (and block_size, which is derived from mix_freq), so we only need to
+   * allocate them once, and can reuse them for every retrigger (note on)
+   */
+  if (noise_decoder && dsp_mix_freq == mix_freq)
+    return;
+
+  if (noise_decoder)
+    delete noise_decoder;
+  noise_decoder = new NoiseDecoder (mix_freq, block_size);
+
+  if (ifft_synth)
+    delete ifft_synth;
+  ifft_synth = new IFFTSynth (block_size, mix_freq, IFFTSynth::WIN_HANNING);
+
+  if (sse_samples)
+    delete sse_samples;
+  sse_samples = new AlignedArray<float, 16> (block_size);
+
+  dsp_mix_freq = mix_freq;
+}
+
 void
 LiveDecoder::retrigger (int channel, float freq, int midi_velocity, float mix_freq)
 {
-  Audio *best_audio = 0;
+  const Audio *best_audio = 0;
   double best_diff = 1e10;
 
   if (source)
@@ -120,7 +150,7 @@ LiveDecoder::retrigger (int channel, float freq, int midi_velocity, float mix_fr
           // find best audio candidate
           for (vector<WavSetWave>::iterator wi = smset->waves.begin(); wi != smset->waves.end(); wi++)
             {
-              Audio *audio = wi->audio;
+              const Audio *audio = wi->audio;
               if (audio && wi->channel == channel &&
                            wi->velocity_range_min <= midi_velocity &&
                            wi->velocity_range_max >= midi_velocity)
@@ -155,20 +185,18 @@ LiveDecoder::retrigger (int channel, float freq, int midi_velocity, float mix_fr
       if (start_skip_enabled)
         zero_values_at_start_scaled += block_size / 2;
 
-      if (noise_decoder)
-        delete noise_decoder;
-      noise_decoder = new NoiseDecoder (mix_freq, block_size);
+      setup_dsp (mix_freq);
 
+      /* reset reused dsp objects to the state a newly allocated object would have */
       if (noise_seed != -1)
         noise_decoder->set_seed (noise_seed);
+      else if (have_random_seed)
+        noise_decoder->set_seed (random_seed);
+      else
+        noise_decoder->set_seed (g_random_int());
+      noise_decoder->enable_spectrum_bank (noise_bank_enabled);
 
-      if (ifft_synth)
-        delete ifft_synth;
-      ifft_synth = new IFFTSynth (block_size, mix_freq, IFFTSynth::WIN_HANNING);
-
-      if (sse_samples)
-        delete sse_samples;
-      sse_samples = new AlignedArray<float, 16> (block_size);
+      zero_float_block (block_size, &(*sse_samples)[0]);
 
       pp_inter = PolyPhaseInter::the(); // do not delete
 
@@ -193,7 +221,14 @@ LiveDecoder::retrigger (int channel, float freq, int midi_velocity, float mix_fr
       // setup portamento state
       assert (PortamentoState::DELTA >= pp_inter->get_min_padding());
 
+      /* process() renders at most 10 ms per portamento step, and the buffer will contain
+       * up to 256 samples before a step (see portamento_shrink())
+       */
+      const size_t max_step_values = mix_freq * 0.010 + 1;
+      const size_t portamento_capacity = 256 + PortamentoState::DELTA + 1 + max_step_values * PortamentoState::MAX_STRETCH;
+
       portamento_state.pos = PortamentoState::DELTA;
+      portamento_state.buffer.set_capacity (portamento_capacity);
       portamento_state.buffer.resize (PortamentoState::DELTA);
       portamento_state.active = false;
 
@@ -206,7 +241,7 @@ LiveDecoder::retrigger (int channel, float freq, int midi_velocity, float mix_fr
 }
 
 size_t
-LiveDecoder::compute_loop_frame_index (size_t frame_idx, Audio *audio)
+LiveDecoder::compute_loop_frame_index (size_t frame_idx, const Audio *audio)
 {
   if (int (frame_idx) > audio->loop_start)
     {
@@ -330,9 +365,10 @@ LiveDecoder::process_internal (size_t n_values, float *audio_out, float portamen
                 frame_idx = loop_point;
             }
 
-          AudioBlock *audio_block_ptr = NULL;
+          const AudioBlock *audio_block_ptr = NULL;
           if (source)
             {
+              DSPScopedTimer timer (DSPStage::MORPH);
               audio_block_ptr = source->audio_block (frame_idx);
             }
           else if (frame_idx < audio->contents.size())
@@ -367,6 +403,8 @@ LiveDecoder::process_internal (size_t n_values, float *audio_out, float portamen
 
               if (sines_enabled)
                 {
+                  DSPScopedTimer timer (DSPStage::PARTIALS);
+
                   const double phase_factor = block_size * M_PI / current_mix_freq;
                   const double filter_fact = 18000.0 / 44100.0;  // for 44.1 kHz, filter at 18 kHz (higher mix freq => higher filter)
                   const double filter_min_freq = filter_fact * current_mix_freq;
@@ -472,10 +510,13 @@ LiveDecoder::process_internal (size_t n_values, float *audio_out, float portamen
                                   phase = unison_phase_random_gen.random_double_range (0, 2 * M_PI);
                                 }
 
-                              ifft_synth->render_partial (freq * unison_freq_factor[i], mag, phase);
+                              unison_render_freqs[i]  = freq * unison_freq_factor[i];
+                              unison_render_mags[i]   = mag;
+                              unison_render_phases[i] = phase;
 
                               unison_new_phases.push_back (phase);
                             }
+                          ifft_synth->render_partials (unison_voices, &unison_render_freqs[0], &unison_render_mags[0], &unison_render_phases[0]);
                         }
 
                       PartialState ps;
@@ -487,10 +528,15 @@ LiveDecoder::process_internal (size_t n_values, float *audio_out, float portamen
               last_pstate = &new_pstate;
 
               if (noise_enabled)
-                noise_decoder->process (audio_block, ifft_synth->fft_buffer(), NoiseDecoder::FFT_SPECTRUM, portamento_stretch);
+                {
+                  DSPScopedTimer timer (DSPStage::NOISE);
+                  noise_decoder->process (audio_block, ifft_synth->fft_buffer(), NoiseDecoder::FFT_SPECTRUM, portamento_stretch);
+                }
 
               if (noise_enabled || sines_enabled || debug_fft_perf_enabled)
                 {
+                  DSPScopedTimer timer (DSPStage::IFFT);
+
                   float *samples = &(*sse_samples)[0];
                   ifft_synth->get_samples (samples, IFFTSynth::ADD);
                 }
@@ -565,10 +611,10 @@ LiveDecoder::portamento_grow (double end_pos, float portamento_stretch)
   const int TODO = int (end_pos) + PortamentoState::DELTA - int (portamento_state.buffer.size());
   if (TODO > 0)
     {
-      const size_t START = portamento_state.buffer.size();
-
-      portamento_state.buffer.resize (portamento_state.buffer.size() + TODO);
-      process_internal (TODO, &portamento_state.buffer[START], portamento_stretch);
+      /* the capacity set on retrigger is enough for MAX_STRETCH, so this never allocates */
+      portamento_state.buffer.append (TODO, [&] (size_t n_values, float *out) {
+        process_internal (n_values, out, portamento_stretch);
+      });
     }
   portamento_state.pos = end_pos;
 }
@@ -576,14 +622,14 @@ LiveDecoder::portamento_grow (double end_pos, float portamento_stretch)
 void
 LiveDecoder::portamento_shrink()
 {
-  vector<float>& buffer = portamento_state.buffer;
+  RingBuffer& buffer = portamento_state.buffer;
 
   /* avoid infinite state */
   if (buffer.size() > 256)
     {
       const int shrink_buffer = buffer.size() - 2 * PortamentoState::DELTA; // only keep 2 * DELTA samples
 
-      buffer.erase (buffer.begin(), buffer.begin() + shrink_buffer);
+      buffer.drop_front (shrink_buffer);
       portamento_state.pos -= shrink_buffer;
     }
 }
@@ -594,7 +640,7 @@ LiveDecoder::process_portamento (size_t n_values, const float *freq_in, float *a
   assert (audio); // need selected (triggered) audio to use this function
 
   const double start_pos = portamento_state.pos;
-  const vector<float>& buffer = portamento_state.buffer;
+  const RingBuffer& buffer = portamento_state.buffer;
 
   if (!portamento_state.active)
     {
@@ -616,21 +662,23 @@ LiveDecoder::process_portamento (size_t n_values, const float *freq_in, float *a
         {
           pos[i] = end_pos;
 
-          current_step = freq_in[i] / current_freq;
+          current_step = min<double> (freq_in[i] / current_freq, double (PortamentoState::MAX_STRETCH));
           end_pos += current_step;
         }
       portamento_grow (end_pos, current_step);
 
       /* interpolate from buffer (portamento) */
+      const float *samples = buffer.data(); // only valid after portamento_grow()
+
       for (size_t i = 0; i < n_values; i++)
-        audio_out[i] = pp_inter->get_sample_no_check (buffer, pos[i]);
+        audio_out[i] = pp_inter->get_sample_no_check (samples, pos[i]);
     }
   else
     {
       /* no portamento: just compute & copy values */
       portamento_grow (start_pos + n_values, 1);
 
-      const float *start = &buffer[sm_round_positive (start_pos)];
+      const float *start = buffer.data() + sm_round_positive (start_pos);
       std::copy (start, start + n_values, audio_out);
     }
   portamento_shrink();
@@ -741,6 +789,15 @@ LiveDecoder::enable_noise (bool en)
   noise_enabled = en;
 }
 
+void
+LiveDecoder::enable_noise_bank (bool enb)
+{
+  /* precomputed noise spectra are much faster, but the noise is only made from a limited
+   * number of random variations, so this is disabled by default
+   */
+  noise_bank_enabled = enb;
+}
+
 void
 LiveDecoder::enable_sines (bool es)
 {
@@ -776,10 +833,14 @@ LiveDecoder::precompute_tables (float mix_freq)
 {
   /* computing one sample (from the source) will ensure that tables (like
    * anti-alias filter table and IFFTSynth window table and FFTW plan) will be
-   * available once RT synthesis is needed
+   * available once RT synthesis is needed; it also allocates the dsp objects
+   * (see setup_dsp) so that retrigger() will not need to allocate memory
    */
   float out;
 
+  pstate[0].reserve (MAX_PARTIALS);
+  pstate[1].reserve (MAX_PARTIALS);
+
   retrigger (0, 440, 127, mix_freq);
   process (1, nullptr, &out);
 }
@@ -791,6 +852,16 @@ LiveDecoder::set_noise_seed (int seed)
   noise_seed = seed;
 }
 
+/* seed for the randomization of the next note (noise, unison phases); without it,
+ * g_random is used, so the output is not reproducible */
+void
+LiveDecoder::set_random_seed (uint32_t seed)
+{
+  have_random_seed = true;
+  random_seed = seed;
+  unison_phase_random_gen.set_seed (seed);
+}
+
 Audio::LoopType
 LiveDecoder::get_loop_type()
 {
@@ -819,6 +890,11 @@ LiveDecoder::set_unison_voices (int voices, float detune)
   /* setup unison frequency factors for unison voices */
   unison_freq_factor.resize (voices);
 
+  /* per voice parameters for IFFTSynth::render_partials() */
+  unison_render_freqs.resize (voices);
+  unison_render_mags.resize (voices);
+  unison_render_phases.resize (voices);
+
   for (size_t i = 0; i < unison_freq_factor.size(); i++)
     {
       const float detune_cent = -detune/2 + i / float (voices - 1) * detune;
@@ -833,6 +909,9 @@ LiveDecoder::set_unison_voices (int voices, float detune)
    */
   unison_gain = 1 / sqrt (voices);
 
+  unison_phases[0].reserve (MAX_PARTIALS * voices);
+  unison_phases[1].reserve (MAX_PARTIALS * voices);
+
   /* resize unison phase array to match pstate */
   const bool lps_zero = (last_pstate == &pstate[0]);
   const vector<PartialState>& old_pstate = lps_zero ? pstate[0] : pstate[1];
@@ -9,6 +9,7 @@
 #include "smlivedecodersource.hh"
 #include "smpolyphaseinter.hh"
 #include "smalignedarray.hh"
+#include "smringbuffer.hh"
 #include <vector>
 #include <functional>
 
@@ -23,16 +24,25 @@ class LiveDecoder
   };
   std::vector<PartialState> pstate[2], *last_pstate;
 
+  /* capacity of the partial state (and unison phase) vectors, reserved before rendering
+   * starts; only frames with more partials need to allocate memory during rendering
+   */
+  enum { MAX_PARTIALS = 1024 };
+
   struct PortamentoState {
-    std::vector<float> buffer;
+    RingBuffer         buffer;
     double             pos;
     bool               active;
 
     enum { DELTA = 32 };
+    /* maximum speedup factor for reading the buffer (determines the buffer capacity);
+     * faster reading (more than four octaves up) is clamped to this value
+     */
+    static constexpr double MAX_STRETCH = 16;
   } portamento_state;
 
   WavSet             *smset;
-  Audio              *audio;
+  const Audio        *audio;
 
   IFFTSynth          *ifft_synth;
   NoiseDecoder       *noise_decoder;
@@ -41,6 +51,7 @@ class LiveDecoder
 
   bool                sines_enabled;
   bool                noise_enabled;
+  bool                noise_bank_enabled;
   bool                debug_fft_perf_enabled;
   bool                original_samples_enabled;
   bool                loop_enabled;
@@ -63,13 +74,19 @@ class LiveDecoder
   double              original_samples_norm_factor;
 
   int                 noise_seed;
+  bool                have_random_seed;
+  uint32_t            random_seed;
 
   AlignedArray<float,16> *sse_samples;
+  float               dsp_mix_freq;
 
   // unison
   int                 unison_voices;
   std::vector<float>  unison_phases[2];
   std::vector<float>  unison_freq_factor;
+  std::vector<double> unison_render_freqs;
+  std::vector<double> unison_render_mags;
+  std::vector<double> unison_render_phases;
   float               unison_gain;
   Random              unison_phase_random_gen;
 
@@ -98,6 +115,8 @@ class LiveDecoder
 
   Audio::LoopType     get_loop_type();
 
+  void setup_dsp (float mix_freq);
+
   void process_internal (size_t       n_values,
                          float       *audio_out,
                          float        portamento_stretch);
@@ -118,12 +137,14 @@ public:
   ~LiveDecoder();
 
   void enable_noise (bool ne);
+  void enable_noise_bank (bool enb);
   void enable_sines (bool se);
   void enable_debug_fft_perf (bool dfp);
   void enable_original_samples (bool eos);
   void enable_loop (bool eloop);
   void enable_start_skip (bool ess);
   void set_noise_seed (int seed);
+  void set_random_seed (uint32_t seed);
   void set_unison_voices (int voices, float detune);
   void set_vibrato (bool enable_vibrato, float depth, float frequency, float attack);
   void set_filter_callback (const std::function<void()>& filter_callback);
@@ -137,7 +158,7 @@ public:
   double current_pos() const;
   double fundamental_note() const;
 
-  static size_t compute_loop_frame_index (size_t index, Audio *audio);
+  static size_t compute_loop_frame_index (size_t index, const Audio *audio);
   bool done() const;
 
   double time_offset_ms() const;
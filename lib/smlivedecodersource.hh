@@ -11,8 +11,8 @@ class LiveDecoderSource
 {
 public:
   virtual void retrigger (int channel, float freq, int midi_velocity, float mix_freq) = 0;
-  virtual Audio *audio() = 0;
-  virtual AudioBlock *audio_block (size_t index) = 0;
+  virtual const Audio *audio() = 0;
+  virtual const AudioBlock *audio_block (size_t index) = 0;
   virtual ~LiveDecoderSource();
 };
 
@@ -12,6 +12,8 @@
 #include <assert.h>
 #include <locale.h>
 
+#include <algorithm>
+
 #if SPECTMORPH_HAVE_BSE
 #include <bse/bsemain.hh>
 #endif
@@ -97,6 +99,9 @@ GlobalData::GlobalData()
   for (auto area : cfg.debug())
     Debug::enable (area);
 
+  /* unreferenced instruments are kept in memory until this limit is reached (0: no limit) */
+  wav_set_repo.set_memory_budget (size_t (std::max (cfg.wav_set_cache_mb(), 0)) * 1024 * 1024);
+
   FFT::init();
   int_sincos_init();
   sm_math_init();
@@ -3,6 +3,10 @@
 #include "smmath.hh"
 #include <assert.h>
 
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
 namespace SpectMorph {
 
 double
@@ -162,4 +166,69 @@ velocity_to_gain (double velocity, double vrange_db)
   return x * x;
 }
 
+/* fast exp2 approximation: max relative error is 1.5e-7 for inputs in [-126, 126]
+ *
+ * the input is split into integer part i and fractional part f (0 <= f < 1), so
+ *   exp2 (x) = 2^i * 2^f
+ * where 2^i is computed from the exponent bits and 2^f using a polynomial
+ */
+static constexpr float exp2_c0 = 9.9999994e-1;
+static constexpr float exp2_c1 = 6.9315308e-1;
+static constexpr float exp2_c2 = 2.4015361e-1;
+static constexpr float exp2_c3 = 5.5826318e-2;
+static constexpr float exp2_c4 = 8.9893397e-3;
+static constexpr float exp2_c5 = 1.8775767e-3;
+
+void
+fast_vector_exp2f (size_t n_values, const float *in, float *out)
+{
+  size_t i = 0;
+#ifdef __SSE2__
+  for (; i + 4 <= n_values; i += 4)
+    {
+      __m128 x = _mm_loadu_ps (in + i);
+
+      x = _mm_min_ps (_mm_max_ps (x, _mm_set1_ps (-126)), _mm_set1_ps (126));
+
+      /* floor (x) */
+      __m128i ipart = _mm_cvttps_epi32 (x);
+      __m128  fipart = _mm_cvtepi32_ps (ipart);
+      __m128  neg_adjust = _mm_and_ps (_mm_cmplt_ps (x, fipart), _mm_set1_ps (1));
+      fipart = _mm_sub_ps (fipart, neg_adjust);
+      ipart = _mm_cvtps_epi32 (fipart);
+
+      const __m128 f = _mm_sub_ps (x, fipart);
+
+      __m128 p = _mm_set1_ps (exp2_c5);
+      p = _mm_add_ps (_mm_mul_ps (p, f), _mm_set1_ps (exp2_c4));
+      p = _mm_add_ps (_mm_mul_ps (p, f), _mm_set1_ps (exp2_c3));
+      p = _mm_add_ps (_mm_mul_ps (p, f), _mm_set1_ps (exp2_c2));
+      p = _mm_add_ps (_mm_mul_ps (p, f), _mm_set1_ps (exp2_c1));
+      p = _mm_add_ps (_mm_mul_ps (p, f), _mm_set1_ps (exp2_c0));
+
+      const __m128i exp_bits = _mm_slli_epi32 (_mm_add_epi32 (ipart, _mm_set1_epi32 (127)), 23);
+
+      _mm_storeu_ps (out + i, _mm_mul_ps (p, _mm_castsi128_ps (exp_bits)));
+    }
+#endif
+  for (; i < n_values; i++)
+    {
+      const float x = sm_clamp (in[i], -126.f, 126.f);
+      const float fipart = floorf (x);
+      const float f = x - fipart;
+
+      float p = exp2_c5;
+      p = p * f + exp2_c4;
+      p = p * f + exp2_c3;
+      p = p * f + exp2_c2;
+      p = p * f + exp2_c1;
+      p = p * f + exp2_c0;
+
+      union { uint32_t i; float f; } scale;
+      scale.i = uint32_t (int (fipart) + 127) << 23;
+
+      out[i] = p * scale.f;
+    }
+}
+
 }
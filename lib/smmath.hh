@@ -527,6 +527,8 @@ double sm_xparam_inv (double x, double slope);
 double sm_bessel_i0 (double x);
 double velocity_to_gain (double velocity, double vrange_db);
 
+void fast_vector_exp2f (size_t n_values, const float *in, float *out);
+
 /* FIXME: FILTER: get rid of sm_bound */
 template<typename T>
 inline const T&
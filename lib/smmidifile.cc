@@ -0,0 +1,386 @@
+// Licensed GNU LGPL v2.1 or later: http://www.gnu.org/licenses/lgpl-2.1.html
+
+#include "smmidifile.hh"
+
+#include <stdio.h>
+#include <string.h>
+
+#include <algorithm>
+
+using namespace SpectMorph;
+
+using std::string;
+using std::vector;
+
+namespace
+{
+
+class Reader
+{
+  const vector<unsigned char>& data;
+  size_t                       pos;
+  size_t                       end;
+public:
+  bool                         error = false;
+
+  Reader (const vector<unsigned char>& data, size_t pos, size_t end) :
+    data (data),
+    pos (pos),
+    end (std::min (end, data.size()))
+  {
+  }
+  bool
+  at_end() const
+  {
+    return pos >= end;
+  }
+  size_t
+  position() const
+  {
+    return pos;
+  }
+  int
+  read_byte()
+  {
+    if (pos >= end)
+      {
+        error = true;
+        return 0;
+      }
+    return data[pos++];
+  }
+  uint32_t
+  read_uint (int n_bytes)
+  {
+    uint32_t value = 0;
+    for (int i = 0; i < n_bytes; i++)
+      value = (value << 8) + read_byte();
+    return value;
+  }
+  uint32_t
+  read_var_len()
+  {
+    /* variable length quantity: 7 bits per byte, at most 4 bytes */
+    uint32_t value = 0;
+    for (int i = 0; i < 4; i++)
+      {
+        const int b = read_byte();
+
+        value = (value << 7) + (b & 0x7f);
+        if ((b & 0x80) == 0)
+          return value;
+      }
+    error = true;
+    return value;
+  }
+  void
+  skip (size_t n)
+  {
+    if (n > end - pos)
+      {
+        error = true;
+        pos = end;
+      }
+    else
+      {
+        pos += n;
+      }
+  }
+};
+
+struct TrackEvent
+{
+  enum Type { CHANNEL, TEMPO, END_OF_TRACK };
+
+  uint64_t      tick = 0;
+  Type          type = CHANNEL;
+  uint32_t      tempo = 0;      // microseconds per quarter note
+  unsigned char midi_data[3] = { 0, 0, 0 };
+};
+
+}
+
+Error
+MidiFile::load (const string& filename)
+{
+  FILE *file = fopen (filename.c_str(), "rb");
+  if (!file)
+    return Error::Code::FILE_NOT_FOUND;
+
+  vector<unsigned char> data;
+  unsigned char buffer[4096];
+  size_t n;
+  while ((n = fread (buffer, 1, sizeof (buffer), file)) > 0)
+    data.insert (data.end(), buffer, buffer + n);
+  fclose (file);
+
+  return load (data);
+}
+
+Error
+MidiFile::load (const vector<unsigned char>& data)
+{
+  m_events.clear();
+  m_tempo_events.clear();
+  m_length = 0;
+  m_n_tracks = 0;
+
+  Error error = parse (data);
+  if (error)
+    {
+      m_events.clear();
+      m_tempo_events.clear();
+      m_length = 0;
+      m_n_tracks = 0;
+    }
+  return error;
+}
+
+Error
+MidiFile::parse (const vector<unsigned char>& data)
+{
+  Reader header (data, 0, data.size());
+
+  if (data.size() < 14 || memcmp (&data[0], "MThd", 4) != 0)
+    return Error::Code::FORMAT_INVALID;
+
+  header.skip (4);
+  const uint32_t header_len = header.read_uint (4);
+  const int      format     = header.read_uint (2);
+  const int      n_tracks   = header.read_uint (2);
+  const uint32_t division   = header.read_uint (2);
+
+  if (header_len < 6 || format > 1)
+    return Error ("Unsupported MIDI file format");
+  header.skip (header_len - 6);
+
+  /* read all tracks; ticks are converted to seconds after merging, since for format 1
+   * the tempo map is stored in the first track but applies to all tracks
+   */
+  vector<TrackEvent> track_events;
+
+  size_t chunk_pos = header.position();
+  while (chunk_pos + 8 <= data.size() && m_n_tracks < n_tracks)
+    {
+      Reader chunk (data, chunk_pos + 4, data.size());
+      const uint32_t chunk_len = chunk.read_uint (4);
+      const size_t   chunk_start = chunk_pos + 8;
+
+      if (chunk_len > data.size() - chunk_start)
+        return Error::Code::PARSE_ERROR;
+
+      chunk_pos = chunk_start + chunk_len;
+      if (memcmp (&data[chunk_start - 8], "MTrk", 4) != 0) // unknown chunks must be ignored
+        continue;
+
+      Reader track (data, chunk_start, chunk_start + chunk_len);
+
+      uint64_t tick = 0;
+      int      running_status = 0;
+      bool     end_of_track = false;
+      while (!track.at_end() && !end_of_track)
+        {
+          tick += track.read_var_len();
+
+          TrackEvent event;
+          event.tick = tick;
+
+          int status = track.read_byte();
+          int data1;
+          if (status < 0x80)
+            {
+              /* running status: status byte omitted, this is the first data byte */
+              if (!running_status)
+                return Error::Code::PARSE_ERROR;
+              data1 = status;
+              status = running_status;
+            }
+          else if (status < 0xf0)
+            {
+              data1 = track.read_byte();
+              running_status = status;
+            }
+          else if (status == 0xff)
+            {
+              /* meta event */
+              running_status = 0;
+
+              const int      type = track.read_byte();
+              const uint32_t len = track.read_var_len();
+              if (type == 0x51 && len == 3)
+                {
+                  event.type = TrackEvent::TEMPO;
+                  event.tempo = track.read_uint (3);
+                  track_events.push_back (event);
+                }
+              else if (type == 0x2f)
+                {
+                  end_of_track = true;
+                  track.skip (len);
+                }
+              else
+                {
+                  track.skip (len);
+                }
+              continue;
+            }
+          else if (status == 0xf0 || status == 0xf7)
+            {
+              /* sysex event: ignored */
+              running_status = 0;
+              track.skip (track.read_var_len());
+              continue;
+            }
+          else
+            {
+              return Error::Code::PARSE_ERROR;
+            }
+
+          event.midi_data[0] = status;
+          event.midi_data[1] = data1 & 0x7f;
+
+          /* program change and channel pressure have only one data byte */
+          const int type = status & 0xf0;
+          if (type != 0xc0 && type != 0xd0)
+            event.midi_data[2] = track.read_byte() & 0x7f;
+
+          track_events.push_back (event);
+        }
+      if (track.error)
+        return Error::Code::PARSE_ERROR;
+
+      /* tracks without end of track meta event end after their last event */
+      TrackEvent end_event;
+      end_event.tick = tick;
+      end_event.type = TrackEvent::END_OF_TRACK;
+      track_events.push_back (end_event);
+
+      m_n_tracks++;
+    }
+  if (m_n_tracks == 0)
+    return Error::Code::PARSE_ERROR;
+
+  /* merge tracks (stable sort: events with the same tick keep track order) */
+  std::stable_sort (track_events.begin(), track_events.end(),
+    [] (const TrackEvent& a, const TrackEvent& b) { return a.tick < b.tick; });
+
+  double   time = 0;
+  double   ppq_pos = 0;
+  uint64_t last_tick = 0;
+  double   seconds_per_tick;
+  bool     smpte = false;
+
+  if (division & 0x8000)
+    {
+      /* SMPTE time division: frames per second (as negative number) and ticks per frame */
+      const int fps = -int (int8_t (division >> 8));
+      const int ticks_per_frame = division & 0xff;
+      if (fps <= 0 || ticks_per_frame == 0)
+        return Error::Code::FORMAT_INVALID;
+
+      seconds_per_tick = 1.0 / (fps * ticks_per_frame);
+      smpte = true;
+    }
+  else
+    {
+      if (division == 0)
+        return Error::Code::FORMAT_INVALID;
+
+      seconds_per_tick = 500000 / 1e6 / division; // default tempo: 120 bpm
+    }
+  for (const auto& track_event : track_events)
+    {
+      time += (track_event.tick - last_tick) * seconds_per_tick;
+      if (!smpte)
+        ppq_pos += double (track_event.tick - last_tick) / division;
+      last_tick = track_event.tick;
+
+      if (track_event.type == TrackEvent::TEMPO)
+        {
+          /* with SMPTE time division, tempo events don't affect timing */
+          if (!smpte && track_event.tempo > 0)
+            {
+              seconds_per_tick = track_event.tempo / 1e6 / division;
+
+              TempoEvent tempo_event;
+              tempo_event.time = time;
+              tempo_event.ppq_pos = ppq_pos;
+              tempo_event.tempo = 60e6 / track_event.tempo;
+              m_tempo_events.push_back (tempo_event);
+            }
+        }
+      else if (track_event.type == TrackEvent::END_OF_TRACK)
+        {
+          m_length = std::max (m_length, time);
+        }
+      else
+        {
+          Event event;
+          event.time = time;
+          std::copy (track_event.midi_data, track_event.midi_data + 3, event.midi_data);
+          m_events.push_back (event);
+        }
+    }
+  return Error::Code::NONE;
+}
+
+bool
+MidiFile::Event::is_note_on() const
+{
+  /* note on with velocity 0 => note off */
+  return (midi_data[0] & 0xf0) == 0x90 && midi_data[2] != 0;
+}
+
+bool
+MidiFile::Event::is_note_off() const
+{
+  const int type = midi_data[0] & 0xf0;
+
+  return type == 0x80 || (type == 0x90 && midi_data[2] == 0);
+}
+
+bool
+MidiFile::Event::is_controller() const
+{
+  return (midi_data[0] & 0xf0) == 0xb0;
+}
+
+const vector<MidiFile::Event>&
+MidiFile::events() const
+{
+  return m_events;
+}
+
+const vector<MidiFile::TempoEvent>&
+MidiFile::tempo_events() const
+{
+  return m_tempo_events;
+}
+
+/* tempo and song position at a given time (default tempo before the first tempo event: 120 bpm) */
+MidiFile::TempoEvent
+MidiFile::tempo_at (double time) const
+{
+  auto it = std::upper_bound (m_tempo_events.begin(), m_tempo_events.end(), time,
+    [] (double t, const TempoEvent& event) { return t < event.time; });
+
+  TempoEvent result;
+  if (it != m_tempo_events.begin())
+    result = *(it - 1);
+
+  result.ppq_pos += (time - result.time) * result.tempo / 60;
+  result.time = time;
+  return result;
+}
+
+double
+MidiFile::length() const
+{
+  return m_length;
+}
+
+int
+MidiFile::n_tracks() const
+{
+  return m_n_tracks;
+}
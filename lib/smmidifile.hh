@@ -0,0 +1,60 @@
+// Licensed GNU LGPL v2.1 or later: http://www.gnu.org/licenses/lgpl-2.1.html
+
+#ifndef SPECTMORPH_MIDI_FILE_HH
+#define SPECTMORPH_MIDI_FILE_HH
+
+#include "smutils.hh"
+
+#include <vector>
+#include <string>
+
+namespace SpectMorph
+{
+
+/*
+ * Standard MIDI File (format 0 and 1) reader
+ *
+ * All tracks are merged into one list of channel messages, sorted by time; the
+ * tempo map is applied, so that event times are in seconds. The tempo changes are
+ * available separately, to compute the tempo and song position (in quarter notes)
+ * for any time.
+ */
+class MidiFile
+{
+public:
+  struct Event
+  {
+    double        time = 0;                  // seconds
+    unsigned char midi_data[3] = { 0, 0, 0 };
+
+    bool is_note_on() const;
+    bool is_note_off() const;
+    bool is_controller() const;
+  };
+  struct TempoEvent
+  {
+    double        time = 0;                  // seconds
+    double        ppq_pos = 0;               // song position in quarter notes
+    double        tempo = 120;               // beats per minute
+  };
+private:
+  std::vector<Event>      m_events;
+  std::vector<TempoEvent> m_tempo_events;
+  double             m_length = 0;
+  int                m_n_tracks = 0;
+
+  Error parse (const std::vector<unsigned char>& data);
+public:
+  Error load (const std::string& filename);
+  Error load (const std::vector<unsigned char>& data);
+
+  const std::vector<Event>&      events() const;
+  const std::vector<TempoEvent>& tempo_events() const;
+  TempoEvent                     tempo_at (double time) const;
+  double                         length() const;     // end of the last track in seconds
+  int                            n_tracks() const;
+};
+
+}
+
+#endif /* SPECTMORPH_MIDI_FILE_HH */
@@ -3,6 +3,7 @@
 #include "smmidisynth.hh"
 #include "smmorphoutputmodule.hh"
 #include "smdebug.hh"
+#include "smnoisedecoder.hh"
 
 #include <mutex>
 #include <cinttypes>
@@ -40,12 +41,22 @@ MidiSynth::MidiSynth (double mix_freq, size_t n_voices) :
   voices.clear();
   voices.resize (n_voices);
   active_voices.reserve (n_voices);
+  filter_voices.reserve (n_voices);
 
   for (size_t i = 0; i < n_voices; i++)
     {
       voices[i].mp_voice = morph_plan_synth.voice (i);
+      voices[i].render_buffer.resize (MAX_RENDER_BLOCK);
       idle_voices.push_back (&voices[i]);
     }
+
+  /* the noise decoders only use precomputed noise spectra prepared before synthesis starts */
+  NoiseDecoder::prepare_spectrum_bank (mix_freq);
+}
+
+MidiSynth::~MidiSynth()
+{
+  set_dsp_timing (false);
 }
 
 MidiSynth::Voice *
@@ -358,6 +369,91 @@ MidiSynth::add_midi_event (size_t offset, const unsigned char *midi_data)
     }
 }
 
+bool
+MidiSynth::render_voice (Voice *voice, const TimeInfo& time_info, float *samples, size_t n_values, bool defer_filter)
+{
+  /* returns true if samples were computed for this voice
+   *
+   * if defer_filter is true, the filter is not run, but stored in voice->filter
+   *
+   * this may run in a worker thread, so it must not modify anything but the voice state
+   */
+  float *values[1] = { samples };
+  LadderVCFVoice **deferred_filters = defer_filter ? &voice->filter : nullptr;
+
+  voice->filter = nullptr;
+
+  voice->mp_voice->set_control_input (0, control[0]);
+  voice->mp_voice->set_control_input (1, control[1]);
+  voice->mp_voice->set_control_input (2, control[2]);
+  voice->mp_voice->set_control_input (3, control[3]);
+
+  const float *freq_in = nullptr;
+  float frequencies[n_values];
+  if (fabs (voice->pitch_bend_freq - voice->freq) > 1e-3 || voice->pitch_bend_steps > 0)
+    {
+      for (unsigned int i = 0; i < n_values; i++)
+        {
+          frequencies[i] = voice->pitch_bend_freq;
+          if (voice->pitch_bend_steps > 0)
+            {
+              voice->pitch_bend_freq *= voice->pitch_bend_factor;
+              voice->pitch_bend_steps--;
+            }
+        }
+      freq_in = frequencies;
+    }
+  if (voice->mono_type == Voice::MonoType::SHADOW)
+    {
+      /* skip: shadow voices are not rendered */
+      return false;
+    }
+  else if (voice->state == Voice::STATE_ON)
+    {
+      MorphOutputModule *output_module = voice->mp_voice->output();
+
+      output_module->process (time_info, n_values, values, 1, freq_in, deferred_filters);
+      return true;
+    }
+  else if (voice->state == Voice::STATE_RELEASE)
+    {
+      MorphOutputModule *output_module = voice->mp_voice->output();
+
+      output_module->process (time_info, n_values, values, 1, freq_in, deferred_filters);
+
+      if (output_module->done())
+        {
+          /* envelope reached zero -> voice can be reused later */
+          voice->state = Voice::STATE_IDLE;
+          voice->pedal = false;
+        }
+      return true;
+    }
+  else
+    {
+      g_assert_not_reached();
+      return false;
+    }
+}
+
+void
+MidiSynth::RenderJob::run_task (size_t index)
+{
+  Voice *voice = synth->active_voices[index];
+
+  voice->rendered = synth->render_voice (voice, *time_info, &voice->render_buffer[0], n_values, true);
+}
+
+void
+MidiSynth::FilterJob::run_task (size_t index)
+{
+  const size_t first = index * LadderVCFVoice::LANES;
+  const size_t count = min<size_t> (synth->filter_voices.size() - first, LadderVCFVoice::LANES);
+
+  DSPScopedTimer timer (DSPStage::FILTER);
+  LadderVCFVoice::run_voices (&synth->filter_voices[first], count, n_values);
+}
+
 void
 MidiSynth::process_audio (const TimeInfo& time_info, float *output, size_t n_values)
 {
@@ -365,8 +461,6 @@ MidiSynth::process_audio (const TimeInfo& time_info, float *output, size_t n_val
     return;
 
   bool  need_free = false;
-  float samples[n_values];
-  float *values[1] = { samples };
 
   zero_float_block (n_values, output);
 
@@ -374,61 +468,77 @@ MidiSynth::process_audio (const TimeInfo& time_info, float *output, size_t n_val
   if (!morph_plan_synth.have_output())
     return;
 
-  for (Voice *voice : active_voices)
+  static_assert (MAX_RENDER_BLOCK <= EffectDecoder::MAX_FILTER_BLOCK, "deferred filtering needs filter parameters for the whole block");
+  if (n_values <= MAX_RENDER_BLOCK)
     {
-      voice->mp_voice->set_control_input (0, control[0]);
-      voice->mp_voice->set_control_input (1, control[1]);
-      voice->mp_voice->set_control_input (2, control[2]);
-      voice->mp_voice->set_control_input (3, control[3]);
+      /* render voices (in parallel if possible) without running the filter */
+      if (render_pool && active_voices.size() > 1)
+        {
+          render_job.synth     = this;
+          render_job.time_info = &time_info;
+          render_job.n_values  = n_values;
 
-      const float gain = voice->gain * m_gain;
-      const float *freq_in = nullptr;
-      float frequencies[n_values];
-      if (fabs (voice->pitch_bend_freq - voice->freq) > 1e-3 || voice->pitch_bend_steps > 0)
+          render_pool->run (&render_job, active_voices.size());
+        }
+      else
         {
-          for (unsigned int i = 0; i < n_values; i++)
-            {
-              frequencies[i] = voice->pitch_bend_freq;
-              if (voice->pitch_bend_steps > 0)
-                {
-                  voice->pitch_bend_freq *= voice->pitch_bend_factor;
-                  voice->pitch_bend_steps--;
-                }
-            }
-          freq_in = frequencies;
+          for (Voice *voice : active_voices)
+            voice->rendered = render_voice (voice, time_info, &voice->render_buffer[0], n_values, true);
         }
-      if (voice->mono_type == Voice::MonoType::SHADOW)
+
+      /* run the filters, LadderVCFVoice::LANES voices at a time; grouping doesn't depend on
+       * the number of threads, so the output is the same for serial and multithreaded rendering
+       */
+      filter_voices.clear();
+      for (Voice *voice : active_voices)
         {
-          /* skip: shadow voices are not rendered */
+          if (voice->rendered && voice->filter)
+            filter_voices.push_back (voice->filter);
         }
-      else if (voice->state == Voice::STATE_ON)
+
+      const size_t n_groups = (filter_voices.size() + LadderVCFVoice::LANES - 1) / LadderVCFVoice::LANES;
+      if (render_pool && n_groups > 1)
         {
-          MorphOutputModule *output_module = voice->mp_voice->output();
+          filter_job.synth    = this;
+          filter_job.n_values = n_values;
 
-          output_module->process (time_info, n_values, values, 1, freq_in);
-          for (size_t i = 0; i < n_values; i++)
-            output[i] += samples[i] * gain;
+          render_pool->run (&filter_job, n_groups);
         }
-      else if (voice->state == Voice::STATE_RELEASE)
+      else if (filter_voices.size())
         {
-          MorphOutputModule *output_module = voice->mp_voice->output();
+          DSPScopedTimer timer (DSPStage::FILTER);
+          LadderVCFVoice::run_voices (filter_voices.data(), filter_voices.size(), n_values);
+        }
 
-          output_module->process (time_info, n_values, values, 1, freq_in);
-          for (size_t i = 0; i < n_values; i++)
-            output[i] += samples[i] * gain;
+      /* sum voices in order */
+      for (Voice *voice : active_voices)
+        {
+          const float gain = voice->gain * m_gain;
 
-          if (output_module->done())
+          if (voice->rendered)
             {
-              /* envelope reached zero -> voice can be reused later */
-              voice->state = Voice::STATE_IDLE;
-              voice->pedal = false;
-
-              need_free = true; // need to recompute active_voices and idle_voices vectors
+              for (size_t i = 0; i < n_values; i++)
+                output[i] += voice->render_buffer[i] * gain;
             }
+          if (voice->state == Voice::STATE_IDLE)
+            need_free = true; // need to recompute active_voices and idle_voices vectors
         }
-      else
+    }
+  else
+    {
+      float samples[n_values];
+
+      for (Voice *voice : active_voices)
         {
-          g_assert_not_reached();
+          const float gain = voice->gain * m_gain;
+
+          if (render_voice (voice, time_info, samples, n_values, false))
+            {
+              for (size_t i = 0; i < n_values; i++)
+                output[i] += samples[i] * gain;
+            }
+          if (voice->state == Voice::STATE_IDLE)
+            need_free = true; // need to recompute active_voices and idle_voices vectors
         }
     }
   if (need_free)
@@ -439,6 +549,26 @@ MidiSynth::process_audio (const TimeInfo& time_info, float *output, size_t n_val
 
 void
 MidiSynth::process (float *output, size_t n_values)
+{
+  DSPThreadScope dsp_thread_scope (dsp_thread_slot);
+
+  if (!m_dsp_timing)
+    {
+      process_internal (output, n_values);
+      return;
+    }
+
+  const uint64 start_ns = DSPTimers::now_ns();
+  process_internal (output, n_values);
+  dsp_timing_process_ns += DSPTimers::now_ns() - start_ns;
+  dsp_timing_samples += n_values;
+
+  if (dsp_timing_samples >= m_mix_freq * 0.5) // report twice per second
+    send_dsp_timing_report();
+}
+
+void
+MidiSynth::process_internal (float *output, size_t n_values)
 {
   if (inst_edit) // inst edit mode? -> delegate
     {
@@ -568,12 +698,131 @@ MidiSynth::apply_update (MorphPlanSynth::UpdateP update)
   morph_plan_synth.apply_update (update);
 }
 
+void
+MidiSynth::set_render_threads (int n_threads)
+{
+  // not rt safe, needs to be called when synthesis thread is not running
+
+  /* the thread calling process() also renders voices, so we need one worker thread less */
+  if (n_threads > 1)
+    {
+      render_pool.reset (new RTThreadPool (n_threads - 1));
+    }
+  else
+    {
+      render_pool.reset();
+    }
+}
+
+void
+MidiSynth::set_dsp_timing (bool dsp_timing)
+{
+  if (m_dsp_timing == dsp_timing)
+    return;
+
+  m_dsp_timing = dsp_timing;
+  if (m_dsp_timing)
+    {
+      DSPTimers::enable();
+
+      /* stage timers are shared with other synth instances, so we only use differences */
+      for (int stage = 0; stage < int (DSPStage::COUNT); stage++)
+        dsp_timing_stage_start[stage] = DSPTimers::stats (DSPStage (stage));
+
+      /* discard time measured before (if any) */
+      for (auto& voice : voices)
+        voice.mp_voice->add_dsp_timers (dsp_timing_ops);
+
+      dsp_timing_ops.clear();
+      dsp_timing_samples = 0;
+      dsp_timing_process_ns = 0;
+    }
+  else
+    {
+      DSPTimers::disable();
+    }
+}
+
+void
+MidiSynth::send_dsp_timing_report()
+{
+  const double interval_ns = dsp_timing_samples / m_mix_freq * 1e9;
+
+  float stage_percent[int (DSPStage::COUNT)];
+  for (int stage = 0; stage < int (DSPStage::COUNT); stage++)
+    {
+      const DSPTimers::Stats stats = DSPTimers::stats (DSPStage (stage));
+
+      stage_percent[stage] = (stats.ns - dsp_timing_stage_start[stage].ns) / interval_ns * 100;
+      dsp_timing_stage_start[stage] = stats;
+    }
+
+  for (auto& voice : voices)
+    voice.mp_voice->add_dsp_timers (dsp_timing_ops);
+
+  DSPTimingData& data = dsp_timing_data[dsp_timing_back];
+
+  data.interval_ms = interval_ns / 1e6;
+  data.process_percent = dsp_timing_process_ns / interval_ns * 100;
+  std::copy_n (stage_percent, int (DSPStage::COUNT), data.stage_percent);
+  data.n_ops = dsp_timing_ops.n_ops;
+  for (size_t i = 0; i < dsp_timing_ops.n_ops; i++)
+    {
+      data.op_ptr_id[i] = dsp_timing_ops.id[i];
+      data.op_percent[i] = DSPTimers::ticks_to_ns (dsp_timing_ops.timer[i].ticks) / interval_ns * 100;
+    }
+
+  /* publish report */
+  dsp_timing_back = dsp_timing_middle.exchange (dsp_timing_back | DSP_TIMING_NEW) & 3;
+
+  dsp_timing_ops.clear();
+  dsp_timing_samples = 0;
+  dsp_timing_process_ns = 0;
+}
+
+/* returns the most recent report (if there is a new one); may be called from one (non audio) thread */
+bool
+MidiSynth::take_dsp_timing_report (DSPTimingReport& report)
+{
+  if (!(dsp_timing_middle.load() & DSP_TIMING_NEW))
+    return false;
+
+  dsp_timing_front = dsp_timing_middle.exchange (dsp_timing_front) & 3;
+
+  const DSPTimingData& data = dsp_timing_data[dsp_timing_front];
+
+  report.interval_ms = data.interval_ms;
+  report.process_percent = data.process_percent;
+  report.stage_percent.assign (data.stage_percent, data.stage_percent + int (DSPStage::COUNT));
+  report.op_ptr_id.assign (data.op_ptr_id, data.op_ptr_id + data.n_ops);
+  report.op_percent.assign (data.op_percent, data.op_percent + data.n_ops);
+  return true;
+}
+
 void
 MidiSynth::set_gain (double gain)
 {
   m_gain = gain;
 }
 
+void
+MidiSynth::set_noise_bank (bool noise_bank)
+{
+  morph_plan_synth.set_noise_bank (noise_bank);
+}
+
+void
+MidiSynth::set_random_seed (uint32_t seed)
+{
+  /* all randomization of the notes (noise, unison phases, random lfo) is derived from this;
+   * the decoders use a separate generator, so the number of notes played doesn't affect the lfo
+   */
+  Random *random_gen = morph_plan_synth.random_gen();
+
+  random_gen->set_seed (seed);
+  morph_plan_synth.decoder_random_gen()->set_seed (random_gen->random_uint32());
+}
+
 void
 MidiSynth::set_inst_edit (bool iedit)
 {
@@ -5,9 +5,23 @@
 
 #include "smmorphplansynth.hh"
 #include "sminsteditsynth.hh"
+#include "smrtthreadpool.hh"
+#include "smladdervcf.hh"
+#include "smdsptimer.hh"
+
+#include <atomic>
 
 namespace SpectMorph {
 
+struct DSPTimingReport
+{
+  float                             interval_ms = 0;     // length of the measured audio
+  float                             process_percent = 0; // MidiSynth::process time relative to interval_ms
+  std::vector<float>                stage_percent;   // cpu time of each DSPStage (all threads)
+  std::vector<MorphOperator::PtrID> op_ptr_id;
+  std::vector<float>                op_percent;      // exclusive cpu time of each operator
+};
+
 class MidiSynth
 {
   class Voice
@@ -37,6 +51,10 @@ class MidiSynth
     int          pitch_bend_steps;
     int          note_id;
 
+    std::vector<float> render_buffer;
+    bool               rendered;
+    LadderVCFVoice    *filter = nullptr; // filter that still needs to be run on render_buffer
+
     Voice() :
       mp_voice (NULL),
       state (STATE_IDLE),
@@ -70,12 +88,74 @@ class MidiSynth
 
   std::vector<float>    control = std::vector<float> (MorphPlan::N_CONTROL_INPUTS);
 
+  /* dsp timing report data: fixed size, so that the audio thread never allocates */
+  struct DSPTimingData
+  {
+    float                interval_ms = 0;
+    float                process_percent = 0;
+    float                stage_percent[int (DSPStage::COUNT)] {};
+    size_t               n_ops = 0;
+    MorphOperator::PtrID op_ptr_id[DSPOperatorTimers::MAX_OPS];
+    float                op_percent[DSPOperatorTimers::MAX_OPS];
+  };
+
+  /* dsp timing: measured while enabled, and published as report twice per second
+   *
+   * reports are passed to the reader using a triple buffer: the audio thread writes
+   * dsp_timing_data[dsp_timing_back], the reader reads dsp_timing_data[dsp_timing_front],
+   * and the two threads exchange their buffer with dsp_timing_middle atomically
+   */
+  static constexpr int  DSP_TIMING_NEW = 4; // flag for dsp_timing_middle: contains a new report
+  bool                  m_dsp_timing = false;
+  uint64                dsp_timing_samples = 0;
+  uint64                dsp_timing_process_ns = 0;
+  DSPTimers::Stats      dsp_timing_stage_start[int (DSPStage::COUNT)];
+  DSPOperatorTimers     dsp_timing_ops;
+  DSPThreadSlot         dsp_thread_slot;  // stage timer counters of the thread calling process()
+  DSPTimingData         dsp_timing_data[3];
+  int                   dsp_timing_back = 0;
+  int                   dsp_timing_front = 1;
+  std::atomic<int>      dsp_timing_middle { 2 };
+
+  void    send_dsp_timing_report();
+  void    process_internal (float *output, size_t n_values);
+
+  /* voices are rendered into their render_buffer, and filtered in groups of LadderVCFVoice::LANES
+   * afterwards, optionally using multiple threads; blocks larger than MAX_RENDER_BLOCK are rendered
+   * one voice at a time without grouping
+   */
+  static constexpr size_t MAX_RENDER_BLOCK = 4096;
+
+  class RenderJob : public RTThreadPool::Job
+  {
+  public:
+    MidiSynth      *synth = nullptr;
+    const TimeInfo *time_info = nullptr;
+    size_t          n_values = 0;
+
+    void run_task (size_t index) override;
+  };
+  RenderJob                     render_job;
+
+  class FilterJob : public RTThreadPool::Job
+  {
+  public:
+    MidiSynth      *synth = nullptr;
+    size_t          n_values = 0;
+
+    void run_task (size_t index) override;
+  };
+  FilterJob                     filter_job;
+  std::vector<LadderVCFVoice *> filter_voices;
+  std::unique_ptr<RTThreadPool> render_pool;
+
   Voice  *alloc_voice();
   void    free_unused_voices();
   bool    update_mono_voice();
   float   freq_from_note (float note);
 
   void set_mono_enabled (bool new_value);
+  bool render_voice (Voice *voice, const TimeInfo& time_info, float *samples, size_t n_values, bool defer_filter);
   void process_audio (const TimeInfo& block_time, float *output, size_t n_values);
   void process_note_on (const TimeInfo& block_time, int channel, int midi_note, int midi_velocity);
   void process_note_off (int midi_note);
@@ -99,6 +179,7 @@ class MidiSynth
 
 public:
   MidiSynth (double mix_freq, size_t n_voices);
+  ~MidiSynth();
 
   void add_midi_event (size_t offset, const unsigned char *midi_data);
   void process (float *output, size_t n_values);
@@ -114,7 +195,12 @@ public:
 
   void set_inst_edit (bool inst_edit);
   void set_gain (double gain);
+  void set_random_seed (uint32_t seed);
   void set_control_by_cc (bool control_by_cc);
+  void set_render_threads (int n_threads);
+  void set_noise_bank (bool noise_bank);
+  void set_dsp_timing (bool dsp_timing);
+  bool take_dsp_timing_report (DSPTimingReport& report);
   InstEditSynth *inst_edit_synth();
 };
 
@@ -137,6 +223,7 @@ struct InstEditVoice : public SynthNotifyEvent
   std::vector<float> fundamental_note;
 };
 
+
 }
 
 #endif /* SPECTMORPH_MIDI_SYNTH_HH */
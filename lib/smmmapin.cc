@@ -113,5 +113,16 @@ MMapIn::get_pos()
 GenericIn *
 MMapIn::open_subfile (size_t pos, size_t len)
 {
-  return new MMapIn (mapfile + pos, mapfile + pos + len, nullptr /* no mapped file */);
+  /* subfile keeps the mapping alive, too */
+  if (g_mapped_file)
+    g_mapped_file_ref (g_mapped_file);
+
+  return new MMapIn (mapfile + pos, mapfile + pos + len, g_mapped_file);
+}
+
+/* returns the mapped file the data belongs to (or nullptr for open_mem) */
+GMappedFile *
+MMapIn::mapped_file()
+{
+  return g_mapped_file;
 }
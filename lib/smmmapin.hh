@@ -29,6 +29,8 @@ public:
   unsigned char *mmap_mem (size_t& remaining);
   size_t get_pos();
   GenericIn *open_subfile (size_t pos, size_t len);
+
+  GMappedFile *mapped_file();
 };
 
 }
@@ -186,7 +186,7 @@ MorphGrid::set_width (int width)
   m_config.width = width;
   update_size();
 
-  m_morph_plan->emit_plan_changed();
+  emit_config_changed();
 }
 
 int
@@ -201,7 +201,7 @@ MorphGrid::set_height (int height)
   m_config.height = height;
   update_size();
 
-  m_morph_plan->emit_plan_changed();
+  emit_config_changed();
 }
 
 int
@@ -215,7 +215,7 @@ MorphGrid::set_selected_x (int x)
 {
   m_selected_x = x;
 
-  m_morph_plan->emit_plan_changed();
+  m_morph_plan->emit_view_changed();
 }
 
 int
@@ -229,7 +229,7 @@ MorphGrid::set_selected_y (int y)
 {
   m_selected_y = y;
 
-  m_morph_plan->emit_plan_changed();
+  m_morph_plan->emit_view_changed();
 }
 
 int
@@ -269,14 +269,15 @@ MorphGrid::set_input_node (int x, int y, const MorphGridNode& node)
   g_return_if_fail (node.smset == "" || !node.op);  // should not set both
 
   m_config.input_node[x][y] = node;
-  m_morph_plan->emit_plan_changed();
+  emit_config_changed();
 }
 
 void
 MorphGrid::set_zoom (int z)
 {
   m_zoom = z;
-  m_morph_plan->emit_plan_changed();
+
+  m_morph_plan->emit_view_changed();
 }
 
 int
@@ -341,9 +342,13 @@ MorphGrid::input_node_label (int x, int y)
       string smset_dir = m_morph_plan->index()->smset_dir();
       string path = smset_dir + "/" + node.smset;
 
-      WavSet *wav_set = WavSetRepo::the()->get (path);
+      /* don't block the gui thread while the instrument is loading */
+      WavSetRepo::Ref ref;
+      WavSet *wav_set = WavSetRepo::the()->try_get (path, ref);
       if (wav_set)
         return wav_set->short_name;
+      else
+        return "...";
     }
   else if (node.op)
     {
@@ -395,10 +400,12 @@ MorphGrid::clone_config()
           if (smset != "")
             {
               cfg->input_node[x][y].path = smset_dir + "/" + smset;
+              cfg->input_node[x][y].wav_set = WavSetRepo::the()->load_async (cfg->input_node[x][y].path);
             }
           else
             {
               cfg->input_node[x][y].path = "";
+              cfg->input_node[x][y].wav_set = WavSetRepo::Ref();
             }
         }
     }
@@ -5,6 +5,7 @@
 
 #include "smmorphoperator.hh"
 #include "smmodulationlist.hh"
+#include "smwavsetrepo.hh"
 
 #include <map>
 
@@ -16,6 +17,7 @@ struct MorphGridNode
   MorphOperatorPtr  op;                     // a node has either an operator (op) as input,
   std::string       smset;                  // or an instrument (smset)
   std::string       path;
+  WavSetRepo::Ref   wav_set;
   double            delta_db;
 
   MorphGridNode();
@@ -3,12 +3,14 @@
 #include "smmorphgridmodule.hh"
 #include "smmorphgrid.hh"
 #include "smmorphplanvoice.hh"
+#include "smmorphplansynth.hh"
 #include "smleakdebugger.hh"
 #include "smmath.hh"
 #include "smlivedecoder.hh"
 #include "smmorphutils.hh"
 
 #include <assert.h>
+#include <string.h>
 
 using namespace SpectMorph;
 
@@ -59,7 +61,7 @@ MorphGridModule::set_config (const MorphOperatorConfig *op_cfg)
 
           if (node.path != "")
             {
-              input_node[x][y].source.set_wav_set (node.path);
+              input_node[x][y].source.set_wav_set (node.wav_set);
               input_node[x][y].has_source = true;
             }
           else
@@ -70,6 +72,124 @@ MorphGridModule::set_config (const MorphOperatorConfig *op_cfg)
           input_node[x][y].delta_db = node.delta_db;
         }
     }
+
+  MorphPlanSynth *synth = morph_plan_voice->morph_plan_synth();
+  if (synth)
+    {
+      shared_state = dynamic_cast<SharedState *> (synth->shared_state (m_ptr_id));
+      if (!shared_state)
+        {
+          shared_state = new SharedState();
+          synth->set_shared_state (m_ptr_id, shared_state);
+        }
+      /* cached results may have been computed using the old config */
+      for (auto& entry : shared_state->cache)
+        entry.state.store (CacheEntry::EMPTY, std::memory_order_relaxed);
+    }
+}
+
+void
+MorphGridModule::update_shared_state (const TimeInfo& time_info)
+{
+  /* cache entries are only valid during one block: the input blocks may be freed afterwards */
+  if (shared_state)
+    {
+      for (auto& entry : shared_state->cache)
+        entry.state.store (CacheEntry::EMPTY, std::memory_order_relaxed);
+    }
+}
+
+bool
+MorphGridModule::CacheKey::operator== (const CacheKey& other) const
+{
+  for (size_t i = 0; i < 4; i++)
+    if (blocks[i] != other.blocks[i])
+      return false;
+
+  return x_morphing == other.x_morphing && y_morphing == other.y_morphing;
+}
+
+size_t
+MorphGridModule::CacheKey::hash() const
+{
+  uint64_t h = 0;
+  for (size_t i = 0; i < 4; i++)
+    h = h * 1000003 + uintptr_t (blocks[i]);
+
+  uint64_t x_bits, y_bits;
+  memcpy (&x_bits, &x_morphing, sizeof (x_bits));
+  memcpy (&y_bits, &y_morphing, sizeof (y_bits));
+  h = (h * 1000003 + x_bits) * 1000003 + y_bits;
+
+  /* mix all bits into the lower bits which are used as cache index */
+  h ^= h >> 33;
+  h *= 0xff51afd7ed558ccdULL;
+  h ^= h >> 33;
+  h *= 0xc4ceb9fe1a85ec53ULL;
+  h ^= h >> 33;
+  return h;
+}
+
+/* lock-free lookup, as voices may be rendered by different threads
+ *
+ * returns a READY entry with the result (hit = true), or an entry in BUSY state which
+ * the caller needs to fill and set to READY (hit = false), or nullptr if the cache is full
+ *
+ * if another thread is computing the same result (BUSY entry with the same key), we
+ * don't wait for it, but return nullptr, so the caller computes the result again
+ * (without storing it); this is counted in cache_duplicates
+ */
+MorphGridModule::CacheEntry *
+MorphGridModule::cache_lookup (const CacheKey& key, bool& hit)
+{
+  const size_t h = key.hash();
+
+  hit = false;
+  for (size_t p = 0; p < SharedState::CACHE_PROBES; p++)
+    {
+      CacheEntry& entry = shared_state->cache[(h + p) & (SharedState::CACHE_SIZE - 1)];
+
+      int state = entry.state.load (std::memory_order_acquire);
+      if (state == CacheEntry::EMPTY)
+        {
+          if (entry.state.compare_exchange_strong (state, CacheEntry::CLAIMED, std::memory_order_acquire))
+            {
+              entry.key = key;
+              entry.state.store (CacheEntry::BUSY, std::memory_order_release);
+              return &entry;
+            }
+          /* failed: state now contains the state set by the other thread */
+        }
+      if (state == CacheEntry::READY && entry.key == key)
+        {
+          hit = true;
+          return &entry;
+        }
+      if (state == CacheEntry::BUSY && entry.key == key)
+        {
+          shared_state->cache_duplicates.fetch_add (1, std::memory_order_relaxed);
+          return nullptr;
+        }
+    }
+  return nullptr;
+}
+
+uint64_t
+MorphGridModule::cache_hits() const
+{
+  return shared_state ? shared_state->cache_hits.load() : 0;
+}
+
+uint64_t
+MorphGridModule::cache_misses() const
+{
+  return shared_state ? shared_state->cache_misses.load() : 0;
+}
+
+uint64_t
+MorphGridModule::cache_duplicates() const
+{
+  return shared_state ? shared_state->cache_duplicates.load() : 0;
 }
 
 void
@@ -93,14 +213,14 @@ MorphGridModule::MySource::retrigger (int channel, float freq, int midi_velocity
     }
 }
 
-Audio*
+const Audio*
 MorphGridModule::MySource::audio()
 {
   return &module->audio;
 }
 
-static bool
-get_normalized_block (MorphGridModule::InputNode& input_node, size_t index, AudioBlock& out_audio_block)
+static const AudioBlock *
+get_normalized_block (MorphGridModule::InputNode& input_node, size_t index)
 {
   LiveDecoderSource *source = NULL;
 
@@ -114,7 +234,7 @@ get_normalized_block (MorphGridModule::InputNode& input_node, size_t index, Audi
     }
   const double time_ms = index; // 1ms frame step
 
-  return MorphUtils::get_normalized_block (source, time_ms, out_audio_block);
+  return MorphUtils::get_normalized_block_ptr (source, time_ms);
 }
 
 namespace
@@ -154,7 +274,9 @@ morph_scale (AudioBlock& out_block, const AudioBlock& in_block, double factor)
 {
   const int ddb = sm_factor2delta_idb (factor);
 
-  out_block = in_block;
+  out_block.noise = in_block.noise;
+  out_block.mags  = in_block.mags;
+  out_block.freqs = in_block.freqs;
   for (size_t i = 0; i < out_block.noise.size(); i++)
     out_block.noise[i] = sm_bound<int> (0, out_block.noise[i] + ddb, 65535);
 
@@ -166,25 +288,27 @@ morph_scale (AudioBlock& out_block, const AudioBlock& in_block, double factor)
 
 static bool
 morph (AudioBlock& out_block,
-       bool have_left, const AudioBlock& left_block,
-       bool have_right, const AudioBlock& right_block,
+       const AudioBlock *left_ptr,
+       const AudioBlock *right_ptr,
        double morphing)
 {
   const double interp = (morphing + 1) / 2; /* examples => 0: only left; 0.5 both equally; 1: only right */
 
-  if (!have_left && !have_right) // nothing + nothing = nothing
+  if (!left_ptr && !right_ptr) // nothing + nothing = nothing
     return false;
 
-  if (!have_left) // nothing + interp * right = interp * right
+  if (!left_ptr) // nothing + interp * right = interp * right
     {
-      morph_scale (out_block, right_block, interp);
+      morph_scale (out_block, *right_ptr, interp);
       return true;
     }
-  if (!have_right) // (1 - interp) * left + nothing = (1 - interp) * left
+  if (!right_ptr) // (1 - interp) * left + nothing = (1 - interp) * left
     {
-      morph_scale (out_block, left_block, 1 - interp);
+      morph_scale (out_block, *left_ptr, 1 - interp);
       return true;
     }
+  const AudioBlock& left_block = *left_ptr;
+  const AudioBlock& right_block = *right_ptr;
 
   // clear result block
   out_block.freqs.clear();
@@ -314,12 +438,7 @@ morph (AudioBlock& out_block,
 namespace
 {
 
-struct LocalMorphParams
-{
-  int     start;
-  int     end;
-  double  morphing;
-};
+typedef MorphGridModule::LocalMorphParams LocalMorphParams;
 
 static LocalMorphParams
 global_to_local_params (double global_morphing, int node_count)
@@ -361,91 +480,126 @@ apply_delta_db (AudioBlock& block, double delta_db)
 
 }
 
-AudioBlock *
-MorphGridModule::MySource::audio_block (size_t index)
+bool
+MorphGridModule::MySource::morph_grid (AudioBlock& out_block, InputNode *nodes[4], const AudioBlock *blocks[4],
+                                       const LocalMorphParams& x_morph_params, const LocalMorphParams& y_morph_params)
 {
-  const double x_morphing = module->apply_modulation (module->cfg->x_morphing_mod);
-  const double y_morphing = module->apply_modulation (module->cfg->y_morphing_mod);
+  if (module->cfg->height == 1 || module->cfg->width == 1)
+    {
+      /*
+       *  A ---- B    or    A
+       *                    |
+       *                    |
+       *                    B
+       */
+      const double morphing = (module->cfg->height == 1) ? x_morph_params.morphing : y_morph_params.morphing;
 
-  const LocalMorphParams x_morph_params = global_to_local_params (x_morphing, module->cfg->width);
-  const LocalMorphParams y_morph_params = global_to_local_params (y_morphing, module->cfg->height);
+      bool have_ab = morph (out_block, blocks[0], blocks[1], morphing);
 
-  if (module->cfg->height == 1)
+      double delta_db = morph_delta_db (nodes[0]->delta_db, nodes[1]->delta_db, morphing);
+
+      if (have_ab)
+        apply_delta_db (out_block, delta_db);
+
+      return have_ab;
+    }
+  else
     {
       /*
        *  A ---- B
+       *  |      |
+       *  |      |
+       *  C ---- D
        */
+      bool have_ab = morph (audio_block_ab, blocks[0], blocks[1], x_morph_params.morphing);
+      bool have_cd = morph (audio_block_cd, blocks[2], blocks[3], x_morph_params.morphing);
+      bool have_abcd = morph (out_block, have_ab ? &audio_block_ab : nullptr, have_cd ? &audio_block_cd : nullptr, y_morph_params.morphing);
 
-      InputNode& node_a = module->input_node[x_morph_params.start][0];
-      InputNode& node_b = module->input_node[x_morph_params.end  ][0];
+      double delta_db_ab = morph_delta_db (nodes[0]->delta_db, nodes[1]->delta_db, x_morph_params.morphing);
+      double delta_db_cd = morph_delta_db (nodes[2]->delta_db, nodes[3]->delta_db, x_morph_params.morphing);
+      double delta_db_abcd = morph_delta_db (delta_db_ab, delta_db_cd, y_morph_params.morphing);
+
+      if (have_abcd)
+        apply_delta_db (out_block, delta_db_abcd);
 
-      bool have_a = get_normalized_block (node_a, index, audio_block_a);
-      bool have_b = get_normalized_block (node_b, index, audio_block_b);
+      return have_abcd;
+    }
+}
 
-      bool have_ab = morph (module->audio_block, have_a, audio_block_a, have_b, audio_block_b, x_morph_params.morphing);
+const AudioBlock *
+MorphGridModule::MySource::audio_block (size_t index)
+{
+  DSPOperatorScope op_scope (module->m_dsp_timer);
 
-      double delta_db = morph_delta_db (node_a.delta_db, node_b.delta_db, x_morph_params.morphing);
+  const double x_morphing = module->apply_modulation (module->cfg->x_morphing_mod);
+  const double y_morphing = module->apply_modulation (module->cfg->y_morphing_mod);
 
-      if (have_ab)
-        apply_delta_db (module->audio_block, delta_db);
+  const LocalMorphParams x_morph_params = global_to_local_params (x_morphing, module->cfg->width);
+  const LocalMorphParams y_morph_params = global_to_local_params (y_morphing, module->cfg->height);
 
-      return have_ab ? &module->audio_block : NULL;
+  InputNode *nodes[4] = { nullptr, nullptr, nullptr, nullptr };
+  if (module->cfg->height == 1)
+    {
+      nodes[0] = &module->input_node[x_morph_params.start][0];
+      nodes[1] = &module->input_node[x_morph_params.end  ][0];
     }
   else if (module->cfg->width == 1)
     {
-      /*
-       *  A
-       *  |
-       *  |
-       *  B
-       */
+      nodes[0] = &module->input_node[0][y_morph_params.start];
+      nodes[1] = &module->input_node[0][y_morph_params.end  ];
+    }
+  else
+    {
+      nodes[0] = &module->input_node[x_morph_params.start][y_morph_params.start];
+      nodes[1] = &module->input_node[x_morph_params.end  ][y_morph_params.start];
+      nodes[2] = &module->input_node[x_morph_params.start][y_morph_params.end  ];
+      nodes[3] = &module->input_node[x_morph_params.end  ][y_morph_params.end  ];
+    }
 
-      InputNode& node_a = module->input_node[0][y_morph_params.start];
-      InputNode& node_b = module->input_node[0][y_morph_params.end  ];
+  /* results can only be shared if all inputs are instruments: the block of an
+   * instrument frame stays the same during the whole block, whereas the output
+   * block of another operator is recomputed for each frame
+   */
+  bool cacheable = (module->shared_state != nullptr);
 
-      bool have_a = get_normalized_block (node_a, index, audio_block_a);
-      bool have_b = get_normalized_block (node_b, index, audio_block_b);
+  CacheKey key;
+  for (size_t i = 0; i < 4; i++)
+    {
+      key.blocks[i] = nodes[i] ? get_normalized_block (*nodes[i], index) : nullptr;
 
-      bool have_ab = morph (module->audio_block, have_a, audio_block_a, have_b, audio_block_b, y_morph_params.morphing);
+      if (nodes[i] && nodes[i]->mod)
+        cacheable = false;
+    }
+  key.x_morphing = x_morphing;
+  key.y_morphing = y_morphing;
 
-      double delta_db = morph_delta_db (node_a.delta_db, node_b.delta_db, y_morph_params.morphing);
+  CacheEntry *entry = nullptr;
+  bool hit = false;
+  if (cacheable)
+    entry = module->cache_lookup (key, hit);
 
-      if (have_ab)
-        apply_delta_db (module->audio_block, delta_db);
+  if (!entry)
+    {
+      bool have_block = morph_grid (module->audio_block, nodes, key.blocks, x_morph_params, y_morph_params);
 
-      return have_ab ? &module->audio_block : NULL;
+      return have_block ? &module->audio_block : NULL;
+    }
+  if (hit)
+    {
+      module->shared_state->cache_hits.fetch_add (1, std::memory_order_relaxed);
     }
   else
     {
-      /*
-       *  A ---- B
-       *  |      |
-       *  |      |
-       *  C ---- D
-       */
-      InputNode& node_a = module->input_node[x_morph_params.start][y_morph_params.start];
-      InputNode& node_b = module->input_node[x_morph_params.end  ][y_morph_params.start];
-      InputNode& node_c = module->input_node[x_morph_params.start][y_morph_params.end  ];
-      InputNode& node_d = module->input_node[x_morph_params.end  ][y_morph_params.end  ];
-
-      bool have_a = get_normalized_block (node_a, index, audio_block_a);
-      bool have_b = get_normalized_block (node_b, index, audio_block_b);
-      bool have_c = get_normalized_block (node_c, index, audio_block_c);
-      bool have_d = get_normalized_block (node_d, index, audio_block_d);
-
-      bool have_ab = morph (audio_block_ab, have_a, audio_block_a, have_b, audio_block_b, x_morph_params.morphing);
-      bool have_cd = morph (audio_block_cd, have_c, audio_block_c, have_d, audio_block_d, x_morph_params.morphing);
-      bool have_abcd = morph (module->audio_block, have_ab, audio_block_ab, have_cd, audio_block_cd, y_morph_params.morphing);
-
-      double delta_db_ab = morph_delta_db (node_a.delta_db, node_b.delta_db, x_morph_params.morphing);
-      double delta_db_cd = morph_delta_db (node_c.delta_db, node_d.delta_db, x_morph_params.morphing);
-      double delta_db_abcd = morph_delta_db (delta_db_ab, delta_db_cd, y_morph_params.morphing);
+      module->shared_state->cache_misses.fetch_add (1, std::memory_order_relaxed);
 
-      if (have_abcd)
-        apply_delta_db (module->audio_block, delta_db_abcd);
-
-      return have_abcd ? &module->audio_block : NULL;
+      entry->have_block = morph_grid (entry->block, nodes, key.blocks, x_morph_params, y_morph_params);
+      entry->state.store (CacheEntry::READY, std::memory_order_release);
     }
+  if (!entry->have_block)
+    return NULL;
+
+  /* no copy: the entry stays READY until the next block */
+  return &entry->block;
 }
 
 LiveDecoderSource *
@@ -8,6 +8,8 @@
 #include "smwavset.hh"
 #include "smmorphsourcemodule.hh"
 
+#include <atomic>
+
 namespace SpectMorph
 {
 
@@ -21,6 +23,12 @@ public:
     bool                 has_source;
     SimpleWavSetSource   source;
   };
+  struct LocalMorphParams
+  {
+    int     start;
+    int     end;
+    double  morphing;
+  };
 
 private:
   const MorphGrid::Config *cfg = nullptr;
@@ -31,21 +39,57 @@ private:
   Audio               audio;
   AudioBlock          audio_block;
 
+  /* morph results are shared between all voices: if the input blocks
+   * and the morph parameters are the same, the result is the same
+   */
+  struct CacheKey
+  {
+    const AudioBlock *blocks[4];
+    double            x_morphing;
+    double            y_morphing;
+
+    bool operator== (const CacheKey& other) const;
+    size_t hash() const;
+  };
+  /* a READY entry is only reset to EMPTY between blocks (or by set_config), so a pointer
+   * to its block stays valid while the voices of one block are rendered
+   */
+  struct CacheEntry
+  {
+    enum State { EMPTY, CLAIMED, BUSY, READY }; // CLAIMED: key not yet set
+
+    std::atomic<int>  state { EMPTY };
+    CacheKey          key;
+    bool              have_block = false;
+    AudioBlock        block;
+  };
+  struct SharedState : public MorphModuleSharedState
+  {
+    static constexpr size_t CACHE_SIZE = 64;   // must be a power of two
+    static constexpr size_t CACHE_PROBES = 8;
+
+    CacheEntry             cache[CACHE_SIZE];
+    std::atomic<uint64_t>  cache_hits { 0 };
+    std::atomic<uint64_t>  cache_misses { 0 };
+    std::atomic<uint64_t>  cache_duplicates { 0 }; // computed again while BUSY in another thread
+  };
+  SharedState *shared_state = nullptr;
+
+  CacheEntry *cache_lookup (const CacheKey& key, bool& hit);
+
   struct MySource : public LiveDecoderSource
   {
     // temporary blocks for morphing:
-    AudioBlock        audio_block_a;
-    AudioBlock        audio_block_b;
-    AudioBlock        audio_block_c;
-    AudioBlock        audio_block_d;
     AudioBlock        audio_block_ab;
     AudioBlock        audio_block_cd;
 
     MorphGridModule  *module;
 
+    bool morph_grid (AudioBlock& out_block, InputNode *nodes[4], const AudioBlock *blocks[4],
+                     const LocalMorphParams& x_morph_params, const LocalMorphParams& y_morph_params);
     void retrigger (int channel, float freq, int midi_velocity, float mix_freq);
-    Audio* audio();
-    AudioBlock *audio_block (size_t index);
+    const Audio* audio();
+    const AudioBlock *audio_block (size_t index);
   } my_source;
 
 public:
@@ -53,7 +97,12 @@ public:
   ~MorphGridModule();
 
   void set_config (const MorphOperatorConfig *cfg);
+  void update_shared_state (const TimeInfo& time_info) override;
   LiveDecoderSource *source();
+
+  uint64_t cache_hits() const;
+  uint64_t cache_misses() const;
+  uint64_t cache_duplicates() const;
 };
 
 }
@@ -145,7 +145,7 @@ MorphLFO::set_sync_voices (float sync_voices)
 {
   m_config.sync_voices = sync_voices;
 
-  m_morph_plan->emit_plan_changed();
+  emit_config_changed();
 }
 
 bool
@@ -159,7 +159,7 @@ MorphLFO::set_beat_sync (bool beat_sync)
 {
   m_config.beat_sync = beat_sync;
 
-  m_morph_plan->emit_plan_changed();
+  emit_config_changed();
 }
 
 MorphOperatorConfig *
@@ -48,7 +48,7 @@ MorphLFOModule::set_config (const MorphOperatorConfig *op_cfg)
       if (!shared_state)
         {
           shared_state = new SharedState();
-          restart_lfo (shared_state->global_lfo_state, /* start from zero time */ TimeInfo());
+          restart_lfo (shared_state->global_lfo_state, shared_state->global_random_gen, /* start from zero time */ TimeInfo());
           synth->set_shared_state (m_ptr_id, shared_state);
         }
     }
@@ -57,18 +57,22 @@ MorphLFOModule::set_config (const MorphOperatorConfig *op_cfg)
 float
 MorphLFOModule::value()
 {
+  DSPOperatorScope op_scope (m_dsp_timer);
+
   TimeInfo time = time_info();
 
   if (cfg->sync_voices)
     {
+      /* work on copies: value() may be called for different voices in parallel */
       auto lfo_state = shared_state->global_lfo_state;
-      update_lfo_value (lfo_state, time);
+      auto lfo_random_gen = shared_state->global_random_gen;
+      update_lfo_value (lfo_state, lfo_random_gen, time);
 
       return lfo_state.value;
     }
   else
     {
-      update_lfo_value (local_lfo_state, time);
+      update_lfo_value (local_lfo_state, local_random_gen, time);
       return local_lfo_state.value;
     }
 }
@@ -76,24 +80,27 @@ MorphLFOModule::value()
 void
 MorphLFOModule::reset_value (const TimeInfo& time_info)
 {
-  restart_lfo (local_lfo_state, time_info);
+  restart_lfo (local_lfo_state, local_random_gen, time_info);
 }
 
 void
-MorphLFOModule::restart_lfo (LFOState& state, const TimeInfo& time_info)
+MorphLFOModule::restart_lfo (LFOState& state, Random& lfo_random_gen, const TimeInfo& time_info)
 {
   state = LFOState(); /* reset to defaults */
-  state.last_random_value = random_gen()->random_double_range (-1, 1);
-  state.random_value = random_gen()->random_double_range (-1, 1);
+
+  /* restarting is done by the audio thread, so we can use the shared random generator to seed */
+  lfo_random_gen.set_seed (random_gen()->random_uint32());
+  state.last_random_value = lfo_random_gen.random_double_range (-1, 1);
+  state.random_value = lfo_random_gen.random_double_range (-1, 1);
   /* compute initial value */
   TimeInfo zero_time;
-  update_lfo_value (state, zero_time);
+  update_lfo_value (state, lfo_random_gen, zero_time);
   state.last_time_ms = time_info.time_ms;
   state.last_ppq_pos = time_info.ppq_pos;
 }
 
 void
-MorphLFOModule::update_lfo_value (LFOState& state, const TimeInfo& time_info)
+MorphLFOModule::update_lfo_value (LFOState& state, Random& lfo_random_gen, const TimeInfo& time_info)
 {
   if (!cfg->beat_sync)
     {
@@ -140,7 +147,7 @@ MorphLFOModule::update_lfo_value (LFOState& state, const TimeInfo& time_info)
     {
       // retrigger random lfo
       state.last_random_value = state.random_value;
-      state.random_value = random_gen()->random_double_range (-1, 1);
+      state.random_value = lfo_random_gen.random_double_range (-1, 1);
     }
 
   if (cfg->wave_type == MorphLFO::WAVE_SINE)
@@ -197,5 +204,7 @@ MorphLFOModule::update_lfo_value (LFOState& state, const TimeInfo& time_info)
 void
 MorphLFOModule::update_shared_state (const TimeInfo& time_info)
 {
-  update_lfo_value (shared_state->global_lfo_state, time_info);
+  DSPOperatorScope op_scope (m_dsp_timer);
+
+  update_lfo_value (shared_state->global_lfo_state, shared_state->global_random_gen, time_info);
 }
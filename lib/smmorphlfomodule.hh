@@ -6,6 +6,7 @@
 #include "smmorphoperatormodule.hh"
 #include "smmorphlfo.hh"
 #include "smwavset.hh"
+#include "smrandom.hh"
 
 namespace SpectMorph
 {
@@ -25,15 +26,17 @@ class MorphLFOModule : public MorphOperatorModule
     double last_ppq_pos       = 0;
     double last_time_ms       = 0;
   } local_lfo_state;
+  Random local_random_gen;  // per voice: voices may be rendered in parallel
 
   struct SharedState : public MorphModuleSharedState
   {
     LFOState global_lfo_state;
+    Random   global_random_gen;
   };
   SharedState *shared_state;
 
-  void update_lfo_value (LFOState& state, const TimeInfo& time_info);
-  void restart_lfo (LFOState& state, const TimeInfo& time_info);
+  void update_lfo_value (LFOState& state, Random& lfo_random_gen, const TimeInfo& time_info);
+  void restart_lfo (LFOState& state, Random& lfo_random_gen, const TimeInfo& time_info);
 public:
   MorphLFOModule (MorphPlanVoice *voice);
   ~MorphLFOModule();
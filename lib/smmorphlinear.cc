@@ -164,7 +164,7 @@ MorphLinear::set_left_op (MorphOperator *op)
 {
   m_config.left_op.set (op);
 
-  m_morph_plan->emit_plan_changed();
+  emit_config_changed();
 }
 
 void
@@ -172,7 +172,7 @@ MorphLinear::set_right_op (MorphOperator *op)
 {
   m_config.right_op.set (op);
 
-  m_morph_plan->emit_plan_changed();
+  emit_config_changed();
 }
 
 string
@@ -192,7 +192,7 @@ MorphLinear::set_left_smset (const string& smset)
 {
   m_left_smset = smset;
 
-  m_morph_plan->emit_plan_changed();
+  emit_config_changed();
 }
 
 void
@@ -200,7 +200,7 @@ MorphLinear::set_right_smset (const string& smset)
 {
   m_right_smset = smset;
 
-  m_morph_plan->emit_plan_changed();
+  emit_config_changed();
 }
 
 void
@@ -221,7 +221,7 @@ MorphLinear::set_db_linear (bool dbl)
 {
   m_config.db_linear = dbl;
 
-  m_morph_plan->emit_plan_changed();
+  emit_config_changed();
 }
 
 vector<MorphOperator *>
@@ -241,12 +241,20 @@ MorphLinear::clone_config()
   string smset_dir = morph_plan()->index()->smset_dir();
 
   cfg->left_path = "";
+  cfg->left_wav_set = WavSetRepo::Ref();
   if (m_left_smset != "")
-    cfg->left_path = smset_dir + "/" + m_left_smset;
+    {
+      cfg->left_path = smset_dir + "/" + m_left_smset;
+      cfg->left_wav_set = WavSetRepo::the()->load_async (cfg->left_path);
+    }
 
   cfg->right_path = "";
+  cfg->right_wav_set = WavSetRepo::Ref();
   if (m_right_smset != "")
-    cfg->right_path = smset_dir + "/" + m_right_smset;
+    {
+      cfg->right_path = smset_dir + "/" + m_right_smset;
+      cfg->right_wav_set = WavSetRepo::the()->load_async (cfg->right_path);
+    }
 
   return cfg;
 }
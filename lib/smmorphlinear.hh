@@ -5,6 +5,7 @@
 
 #include "smmorphoperator.hh"
 #include "smmodulationlist.hh"
+#include "smwavsetrepo.hh"
 
 #include <string>
 
@@ -20,6 +21,8 @@ public:
     MorphOperatorPtr right_op;
     std::string      left_path;
     std::string      right_path;
+    WavSetRepo::Ref  left_wav_set;
+    WavSetRepo::Ref  right_wav_set;
 
     ModulationData   morphing_mod;
     bool             db_linear;
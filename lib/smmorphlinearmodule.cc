@@ -55,11 +55,11 @@ MorphLinearModule::set_config (const MorphOperatorConfig *op_cfg)
 
   have_left_source = (cfg->left_path != "");
   if (have_left_source)
-    left_source.set_wav_set (cfg->left_path);
+    left_source.set_wav_set (cfg->left_wav_set);
 
   have_right_source = (cfg->right_path != "");
   if (have_right_source)
-    right_source.set_wav_set (cfg->right_path);
+    right_source.set_wav_set (cfg->right_wav_set);
 }
 
 void
@@ -86,7 +86,7 @@ MorphLinearModule::MySource::retrigger (int channel, float freq, int midi_veloci
     }
 }
 
-Audio*
+const Audio*
 MorphLinearModule::MySource::audio()
 {
   return &module->audio;
@@ -111,15 +111,8 @@ dump_line (size_t index, const char *what, double start, double end)
     }
 }
 
-struct MagData
-{
-  enum {
-    BLOCK_LEFT  = 0,
-    BLOCK_RIGHT = 1
-  }        block;
-  size_t   index;
-  uint16_t mag;
-};
+using MorphUtils::MagData;
+using MorphUtils::NO_MATCH;
 
 static bool
 md_cmp (const MagData& m1, const MagData& m2)
@@ -127,15 +120,13 @@ md_cmp (const MagData& m1, const MagData& m2)
   return m1.mag > m2.mag;  // sort with biggest magnitude first
 }
 
+/* ddb: delta idb for scaling the magnitude by (1 - interp) (left) or interp (right) */
 void
-MorphLinearModule::MySource::interp_mag_one (double interp, uint16_t *left, uint16_t *right)
+MorphLinearModule::MySource::interp_mag_one (double interp, int ddb, uint16_t *left, uint16_t *right)
 {
   if (module->cfg->db_linear)
     {
-      const uint16_t lmag_idb = max<uint16_t> (left ? *left : 0, SM_IDB_CONST_M96);
-      const uint16_t rmag_idb = max<uint16_t> (right ? *right : 0, SM_IDB_CONST_M96);
-
-      const uint16_t mag_idb = sm_round_positive ((1 - interp) * lmag_idb + interp * rmag_idb);
+      const uint16_t mag_idb = MorphUtils::interp_mag_idb (interp, left ? *left : 0, right ? *right : 0);
 
       if (left)
         *left = mag_idb;
@@ -145,89 +136,94 @@ MorphLinearModule::MySource::interp_mag_one (double interp, uint16_t *left, uint
   else
     {
       if (left)
-        *left = sm_factor2idb ((1 - interp) * sm_idb2factor (*left));
+        *left = sm_bound<int> (0, *left + ddb, 65535);
       if (right)
-        *right = sm_factor2idb (interp * sm_idb2factor (*right));
+        *right = sm_bound<int> (0, *right + ddb, 65535);
     }
 }
 
-AudioBlock *
+static void
+init_mags_f (const AudioBlock& block, vector<double>& mags_f)
+{
+  mags_f.resize (block.mags.size());
+  for (size_t i = 0; i < block.mags.size(); i++)
+    mags_f[i] = block.mags_f (i);
+}
+
+const AudioBlock *
 MorphLinearModule::MySource::audio_block (size_t index)
 {
-  bool have_left = false, have_right = false;
+  DSPOperatorScope op_scope (module->m_dsp_timer);
 
   const double morphing = module->apply_modulation (module->cfg->morphing_mod);
   const double interp = (morphing + 1) / 2; /* examples => 0: only left; 0.5 both equally; 1: only right */
   const double time_ms = index; // 1ms frame step
 
-  Audio *left_audio = nullptr;
-  Audio *right_audio = nullptr;
+  /* the input blocks are not copied, so we only read them through these pointers */
+  const AudioBlock *left_block = nullptr;
+  const AudioBlock *right_block = nullptr;
+
   if (module->left_mod && module->left_mod->source())
-    {
-      have_left = MorphUtils::get_normalized_block (module->left_mod->source(), time_ms, left_block);
-      left_audio = module->left_mod->source()->audio();
-    }
+    left_block = MorphUtils::get_normalized_block_ptr (module->left_mod->source(), time_ms);
 
   if (module->right_mod && module->right_mod->source())
-    {
-      have_right = MorphUtils::get_normalized_block (module->right_mod->source(), time_ms, right_block);
-      right_audio = module->right_mod->source()->audio();
-    }
+    right_block = MorphUtils::get_normalized_block_ptr (module->right_mod->source(), time_ms);
 
   if (module->have_left_source)
-    {
-      have_left = MorphUtils::get_normalized_block (&module->left_source, time_ms, left_block);
-      left_audio = module->left_source.audio();
-    }
+    left_block = MorphUtils::get_normalized_block_ptr (&module->left_source, time_ms);
 
   if (module->have_right_source)
-    {
-      have_right = MorphUtils::get_normalized_block (&module->right_source, time_ms, right_block);
-      right_audio = module->right_source.audio();
-    }
+    right_block = MorphUtils::get_normalized_block_ptr (&module->right_source, time_ms);
 
-  if (have_left && have_right) // true morph: both sources present
+  const int left_ddb = sm_factor2delta_idb (1 - interp);
+  const int right_ddb = sm_factor2delta_idb (interp);
+
+  AudioBlock& out_block = module->audio_block;
+
+  if (left_block && right_block) // true morph: both sources present
     {
-      assert (left_audio && right_audio);
+      out_block.freqs.clear();
+      out_block.mags.clear();
 
-      module->audio_block.freqs.clear();
-      module->audio_block.mags.clear();
+      dump_block (index, "A", *left_block);
+      dump_block (index, "B", *right_block);
 
-      dump_block (index, "A", left_block);
-      dump_block (index, "B", right_block);
+      const size_t left_freqs_size = left_block->freqs.size();
+      const size_t right_freqs_size = right_block->freqs.size();
 
-      MagData mds[left_block.freqs.size() + right_block.freqs.size()];
-      size_t  mds_size = 0;
-      for (size_t i = 0; i < left_block.freqs.size(); i++)
+      mds.resize (left_freqs_size + right_freqs_size);
+      for (size_t i = 0; i < left_freqs_size; i++)
         {
-          MagData& md = mds[mds_size];
+          MagData& md = mds[i];
 
           md.block = MagData::BLOCK_LEFT;
           md.index = i;
-          md.mag   = left_block.mags[i];
-          mds_size++;
+          md.mag   = left_block->mags[i];
         }
-      for (size_t i = 0; i < right_block.freqs.size(); i++)
+      for (size_t i = 0; i < right_freqs_size; i++)
         {
-          MagData& md = mds[mds_size];
+          MagData& md = mds[left_freqs_size + i];
 
           md.block = MagData::BLOCK_RIGHT;
           md.index = i;
-          md.mag   = right_block.mags[i];
-          mds_size++;
+          md.mag   = right_block->mags[i];
         }
-      sort (mds, mds + mds_size, md_cmp);
+      sort (mds.begin(), mds.end(), md_cmp);
+
+      left_freqs.resize (left_freqs_size);
+      right_freqs.resize (right_freqs_size);
 
-      size_t    left_freqs_size = left_block.freqs.size();
-      size_t    right_freqs_size = right_block.freqs.size();
+      init_freq_state (left_block->freqs, left_freqs.data());
+      init_freq_state (right_block->freqs, right_freqs.data());
 
-      MorphUtils::FreqState   left_freqs[left_freqs_size];
-      MorphUtils::FreqState   right_freqs[right_freqs_size];
+      init_mags_f (*left_block, left_mags_f);
+      init_mags_f (*right_block, right_mags_f);
 
-      init_freq_state (left_block.freqs, left_freqs);
-      init_freq_state (right_block.freqs, right_freqs);
+      /* keep match indices from the previous frame as long as the partial exists */
+      left_match.resize (left_freqs_size, NO_MATCH);
+      right_match.resize (right_freqs_size, NO_MATCH);
 
-      for (size_t m = 0; m < mds_size; m++)
+      for (size_t m = 0; m < mds.size(); m++)
         {
           size_t i, j;
           bool match = false;
@@ -236,108 +232,110 @@ MorphLinearModule::MySource::audio_block (size_t index)
               i = mds[m].index;
 
               if (!left_freqs[i].used)
-                match = MorphUtils::find_match (left_freqs[i].freq_f, right_freqs, right_freqs_size, &j);
+                match = MorphUtils::find_match (left_freqs[i].freq_f, right_freqs.data(), right_freqs_size, &j, left_match[i]);
             }
           else // (mds[m].block == MagData::BLOCK_RIGHT)
             {
               j = mds[m].index;
               if (!right_freqs[j].used)
-                match = MorphUtils::find_match (right_freqs[j].freq_f, left_freqs, left_freqs_size, &i);
+                match = MorphUtils::find_match (right_freqs[j].freq_f, left_freqs.data(), left_freqs_size, &i, right_match[j]);
             }
           if (match)
             {
               double freq;
 
               /* prefer frequency of louder partial */
-              const double lfreq = left_block.freqs[i];
-              const double rfreq = right_block.freqs[j];
+              const double lfreq = left_block->freqs[i];
+              const double rfreq = right_block->freqs[j];
 
-              if (left_block.mags[i] > right_block.mags[j])
+              if (left_block->mags[i] > right_block->mags[j])
                 {
-                  const double mfact = right_block.mags_f (j) / left_block.mags_f (i);
+                  const double mfact = right_mags_f[j] / left_mags_f[i];
 
                   freq = lfreq + mfact * interp * (rfreq - lfreq);
                 }
               else
                 {
-                  const double mfact = left_block.mags_f (i) / right_block.mags_f (j);
+                  const double mfact = left_mags_f[i] / right_mags_f[j];
 
                   freq = rfreq + mfact * (1 - interp) * (lfreq - rfreq);
                 }
 
-              double mag;
+              uint16_t mag_idb;
               if (module->cfg->db_linear)
                 {
-                  // FIXME: this could be faster if we avoided db conversion (see grid morph)
-
-                  double lmag_db = db_from_factor (left_block.mags_f (i), -100);
-                  double rmag_db = db_from_factor (right_block.mags_f (j), -100);
-
-                  double mag_db = (1 - interp) * lmag_db + interp * rmag_db;
-
-                  mag = db_to_factor (mag_db);
+                  mag_idb = MorphUtils::interp_mag_idb (interp, left_block->mags[i], right_block->mags[j]);
                 }
               else
                 {
-                  mag = (1 - interp) * left_block.mags_f (i) + interp * right_block.mags_f (j);
+                  mag_idb = sm_factor2idb ((1 - interp) * left_mags_f[i] + interp * right_mags_f[j]);
                 }
-              module->audio_block.freqs.push_back (freq);
-              module->audio_block.mags.push_back (sm_factor2idb (mag));
+              out_block.freqs.push_back (freq);
+              out_block.mags.push_back (mag_idb);
 
-              dump_line (index, "L", left_block.freqs[i], right_block.freqs[j]);
+              dump_line (index, "L", left_block->freqs[i], right_block->freqs[j]);
               left_freqs[i].used = 1;
               right_freqs[j].used = 1;
+
+              left_match[i] = j;
+              right_match[j] = i;
             }
         }
-      for (size_t i = 0; i < left_block.freqs.size(); i++)
+      for (size_t i = 0; i < left_freqs_size; i++)
         {
           if (!left_freqs[i].used)
             {
-              module->audio_block.freqs.push_back (left_block.freqs[i]);
-              module->audio_block.mags.push_back (left_block.mags[i]);
+              out_block.freqs.push_back (left_block->freqs[i]);
+              out_block.mags.push_back (left_block->mags[i]);
 
-              interp_mag_one (interp, &module->audio_block.mags.back(), NULL);
+              interp_mag_one (interp, left_ddb, &out_block.mags.back(), NULL);
+              left_match[i] = NO_MATCH;
             }
         }
-      for (size_t i = 0; i < right_block.freqs.size(); i++)
+      for (size_t i = 0; i < right_freqs_size; i++)
         {
           if (!right_freqs[i].used)
             {
-              module->audio_block.freqs.push_back (right_block.freqs[i]);
-              module->audio_block.mags.push_back (right_block.mags[i]);
+              out_block.freqs.push_back (right_block->freqs[i]);
+              out_block.mags.push_back (right_block->mags[i]);
 
-              interp_mag_one (interp, NULL, &module->audio_block.mags.back());
+              interp_mag_one (interp, right_ddb, NULL, &out_block.mags.back());
+              right_match[i] = NO_MATCH;
             }
         }
-      assert (left_block.noise.size() == right_block.noise.size());
+      assert (left_block->noise.size() == right_block->noise.size());
 
-      module->audio_block.noise.clear();
-      for (size_t i = 0; i < left_block.noise.size(); i++)
-        module->audio_block.noise.push_back (sm_factor2idb ((1 - interp) * left_block.noise_f (i) + interp * right_block.noise_f (i)));
+      out_block.noise.resize (left_block->noise.size());
+      for (size_t i = 0; i < left_block->noise.size(); i++)
+        out_block.noise[i] = sm_factor2idb ((1 - interp) * left_block->noise_f (i) + interp * right_block->noise_f (i));
 
-      module->audio_block.sort_freqs();
+      out_block.sort_freqs();
 
-      return &module->audio_block;
+      return &out_block;
     }
-  else if (have_left) // only left source output present
+  else if (left_block) // only left source output present
     {
-      module->audio_block = left_block;
-      for (size_t i = 0; i < module->audio_block.noise.size(); i++)
-        module->audio_block.noise[i] = sm_factor2idb (module->audio_block.noise_f (i) * (1 - interp));
-      for (size_t i = 0; i < module->audio_block.freqs.size(); i++)
-        interp_mag_one (interp, &module->audio_block.mags[i], NULL);
-
-      return &module->audio_block;
+      out_block.noise = left_block->noise;
+      out_block.mags  = left_block->mags;
+      out_block.freqs = left_block->freqs;
+      for (size_t i = 0; i < out_block.noise.size(); i++)
+        out_block.noise[i] = sm_bound<int> (0, out_block.noise[i] + left_ddb, 65535);
+      for (size_t i = 0; i < out_block.freqs.size(); i++)
+        interp_mag_one (interp, left_ddb, &out_block.mags[i], NULL);
+
+      return &out_block;
     }
-  else if (have_right) // only right source output present
+  else if (right_block) // only right source output present
     {
-      module->audio_block = right_block;
-      for (size_t i = 0; i < module->audio_block.noise.size(); i++)
-        module->audio_block.noise[i] = sm_factor2idb (module->audio_block.noise_f (i) * interp);
-      for (size_t i = 0; i < module->audio_block.freqs.size(); i++)
-        interp_mag_one (interp, NULL, &module->audio_block.mags[i]);
-
-      return &module->audio_block;
+      out_block.noise = right_block->noise;
+      out_block.mags  = right_block->mags;
+      out_block.freqs = right_block->freqs;
+      for (size_t i = 0; i < out_block.noise.size(); i++)
+        out_block.noise[i] = sm_bound<int> (0, out_block.noise[i] + right_ddb, 65535);
+      for (size_t i = 0; i < out_block.freqs.size(); i++)
+        interp_mag_one (interp, right_ddb, NULL, &out_block.mags[i]);
+
+      return &out_block;
     }
   return NULL;
 }
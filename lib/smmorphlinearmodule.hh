@@ -8,6 +8,7 @@
 #include "smmorphoperatormodule.hh"
 #include "smmorphlinear.hh"
 #include "smmorphsourcemodule.hh"
+#include "smmorphutils.hh"
 
 namespace SpectMorph
 {
@@ -32,13 +33,20 @@ class MorphLinearModule : public MorphOperatorModule
     MorphLinearModule    *module;
 
     // temporary data for morphing (avoid malloc by putting it here)
-    AudioBlock            left_block;
-    AudioBlock            right_block;
+    std::vector<MorphUtils::MagData>   mds;
+    std::vector<MorphUtils::FreqState> left_freqs;
+    std::vector<MorphUtils::FreqState> right_freqs;
+    std::vector<double>                left_mags_f;
+    std::vector<double>                right_mags_f;
 
-    void interp_mag_one (double interp, uint16_t *left, uint16_t *right);
+    // match indices of the previous frame, used as start for find_match
+    std::vector<size_t>                left_match;
+    std::vector<size_t>                right_match;
+
+    void interp_mag_one (double interp, int ddb, uint16_t *left, uint16_t *right);
     void retrigger (int channel, float freq, int midi_velocity, float mix_freq);
-    Audio* audio();
-    AudioBlock *audio_block (size_t index);
+    const Audio* audio();
+    const AudioBlock *audio_block (size_t index);
   } my_source;
 
 public:
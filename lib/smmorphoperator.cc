@@ -16,6 +16,7 @@ MorphOperator::MorphOperator (MorphPlan *morph_plan) :
   m_morph_plan (morph_plan)
 {
   m_folded = false;
+  m_config_version = MorphPlan::generate_version();
 }
 
 MorphOperator::~MorphOperator()
@@ -42,7 +43,7 @@ MorphOperator::set_name (const string& name)
 
   m_name = name;
 
-  m_morph_plan->emit_plan_changed();
+  m_morph_plan->emit_operator_changed();
 }
 
 string
@@ -68,7 +69,22 @@ MorphOperator::set_folded (bool folded)
 {
   m_folded = folded;
 
-  m_morph_plan->emit_plan_changed();
+  m_morph_plan->emit_operator_changed();
+}
+
+uint64
+MorphOperator::config_version() const
+{
+  return m_config_version;
+}
+
+/* needs to be called whenever the result of clone_config() changes */
+void
+MorphOperator::emit_config_changed()
+{
+  m_config_version = MorphPlan::generate_version();
+
+  m_morph_plan->emit_operator_changed();
 }
 
 void
@@ -138,8 +154,8 @@ MorphOperator::add_property_log (float *value, const string& identifier, const s
   assert (!m_properties[identifier]);
   LogProperty *property = new LogProperty (this, value, identifier, label, value_label, def, mn, mx);
   m_properties[identifier].reset (property);
-  connect (property->signal_value_changed, [this]() { m_morph_plan->emit_plan_changed(); });
-  connect (property->signal_modulation_changed, [this]() { m_morph_plan->emit_plan_changed(); });
+  connect (property->signal_value_changed, [this]() { emit_config_changed(); });
+  connect (property->signal_modulation_changed, [this]() { emit_config_changed(); });
   return property;
 }
 
@@ -157,8 +173,8 @@ MorphOperator::add_property_xparam (float *value, const string& identifier, cons
   assert (!m_properties[identifier]);
   XParamProperty *property = new XParamProperty (this, value, identifier, label, value_label, def, mn, mx, slope);
   m_properties[identifier].reset (property);
-  connect (property->signal_value_changed, [this]() { m_morph_plan->emit_plan_changed(); });
-  connect (property->signal_modulation_changed, [this]() { m_morph_plan->emit_plan_changed(); });
+  connect (property->signal_value_changed, [this]() { emit_config_changed(); });
+  connect (property->signal_modulation_changed, [this]() { emit_config_changed(); });
   return property;
 }
 
@@ -168,8 +184,8 @@ MorphOperator::add_property (float *value, const string& identifier, const strin
   assert (!m_properties[identifier]);
   LinearProperty *property = new LinearProperty (this, value, identifier, label, value_label, def, mn, mx);
   m_properties[identifier].reset (property);
-  connect (property->signal_value_changed, [this]() { m_morph_plan->emit_plan_changed(); });
-  connect (property->signal_modulation_changed, [this]() { m_morph_plan->emit_plan_changed(); });
+  connect (property->signal_value_changed, [this]() { emit_config_changed(); });
+  connect (property->signal_modulation_changed, [this]() { emit_config_changed(); });
   return property;
 }
 
@@ -189,8 +205,8 @@ MorphOperator::add_property (int *value, const std::string& identifier,
   assert (!m_properties[identifier]);
   IntProperty *property = new IntProperty (this, value, identifier, label, value_label, def, mn, mx);
   m_properties[identifier].reset (property);
-  connect (property->signal_value_changed, [this]() { m_morph_plan->emit_plan_changed(); });
-  connect (property->signal_modulation_changed, [this]() { m_morph_plan->emit_plan_changed(); });
+  connect (property->signal_value_changed, [this]() { emit_config_changed(); });
+  connect (property->signal_modulation_changed, [this]() { emit_config_changed(); });
   return property;
 }
 
@@ -202,8 +218,8 @@ MorphOperator::add_property (bool *value, const std::string& identifier,
   assert (!m_properties[identifier]);
   BoolProperty *property = new BoolProperty (this, value, identifier, label, def);
   m_properties[identifier].reset (property);
-  connect (property->signal_value_changed, [this]() { m_morph_plan->emit_plan_changed(); });
-  connect (property->signal_modulation_changed, [this]() { m_morph_plan->emit_plan_changed(); });
+  connect (property->signal_value_changed, [this]() { emit_config_changed(); });
+  connect (property->signal_modulation_changed, [this]() { emit_config_changed(); });
   return property;
 }
 
@@ -217,8 +233,8 @@ MorphOperator::add_property_enum (const std::string& identifier,
   EnumProperty *property = new EnumProperty (this, identifier, label, def, ei, read_func, write_func);
   /* FIXME: FILTER: all the common code for adding properties should be centralized */
   m_properties[identifier].reset (property);
-  connect (property->signal_value_changed, [this]() { m_morph_plan->emit_plan_changed(); });
-  connect (property->signal_modulation_changed, [this]() { m_morph_plan->emit_plan_changed(); });
+  connect (property->signal_value_changed, [this]() { emit_config_changed(); });
+  connect (property->signal_modulation_changed, [this]() { emit_config_changed(); });
   return property;
 }
 
@@ -35,8 +35,11 @@ protected:
   std::string m_name;
   std::string m_id;
   bool        m_folded;
+  uint64      m_config_version;
   std::map<std::string, std::unique_ptr<Property>> m_properties;
 
+  void emit_config_changed();
+
   LogProperty *add_property_log (float *value, const std::string& identifier,
                                  const std::string& label, const std::string& value_label,
                                  float def, float mn, float mx);
@@ -104,6 +107,8 @@ public:
   virtual std::vector<MorphOperator *> dependencies();
   virtual MorphOperatorConfig *clone_config() = 0;
 
+  uint64 config_version() const;
+
   void get_property_dependencies (std::vector<MorphOperator *>& deps, const std::vector<std::string>& identifiers);
 
   Property *property (const std::string& identifier);
@@ -60,6 +60,14 @@ MorphOperatorModule::update_shared_state (const TimeInfo& time_info)
 {
 }
 
+DSPOperatorTimer
+MorphOperatorModule::take_dsp_timer()
+{
+  DSPOperatorTimer timer = m_dsp_timer;
+  m_dsp_timer = DSPOperatorTimer();
+  return timer;
+}
+
 Random *
 MorphOperatorModule::random_gen() const
 {
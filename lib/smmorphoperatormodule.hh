@@ -6,6 +6,7 @@
 #include "smmorphoperator.hh"
 #include "smlivedecodersource.hh"
 #include "smrandom.hh"
+#include "smdsptimer.hh"
 
 #include <string>
 
@@ -33,6 +34,7 @@ class MorphOperatorModule
 protected:
   MorphPlanVoice                     *morph_plan_voice;
   MorphOperator::PtrID                m_ptr_id;
+  DSPOperatorTimer                    m_dsp_timer;
 
   Random *random_gen() const;
   TimeInfo time_info() const;
@@ -48,6 +50,7 @@ public:
   virtual void update_shared_state (const TimeInfo& time_info);
 
   void set_ptr_id (MorphOperator::PtrID ptr_id);
+  DSPOperatorTimer take_dsp_timer();
 
   static MorphOperatorModule *create (const std::string& type, MorphPlanVoice *voice);
 };
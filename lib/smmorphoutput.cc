@@ -164,7 +164,7 @@ MorphOutput::set_channel_op (int ch, MorphOperator *op)
   assert (ch >= 0 && ch < CHANNEL_OP_COUNT);
 
   m_config.channel_ops[ch].set (op);
-  m_morph_plan->emit_plan_changed();
+  emit_config_changed();
 }
 
 MorphOperator *
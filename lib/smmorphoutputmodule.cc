@@ -79,6 +79,12 @@ MorphOutputModule::portamento() const
   return cfg->portamento;
 }
 
+bool
+MorphOutputModule::noise_bank() const
+{
+  return morph_plan_voice->morph_plan_synth()->noise_bank();
+}
+
 float
 MorphOutputModule::portamento_glide() const
 {
@@ -110,21 +116,30 @@ MorphOutputModule::filter_mix_mod() const
 }
 
 void
-MorphOutputModule::process (const TimeInfo& time_info, size_t n_samples, float **values, size_t n_ports, const float *freq_in)
+MorphOutputModule::process (const TimeInfo& time_info, size_t n_samples, float **values, size_t n_ports, const float *freq_in,
+                            LadderVCFVoice **deferred_filters)
 {
+  /* if deferred_filters is set, the filter of each port is not run here, but
+   * returned (or nullptr if there is nothing to filter) so that the caller can run it later
+   */
   g_return_if_fail (n_ports <= out_decoders.size());
 
+  DSPOperatorScope op_scope (m_dsp_timer);
+
   const bool have_cycle = morph_plan_voice->morph_plan_synth()->have_cycle();
 
   block_time = time_info;
 
   for (size_t port = 0; port < n_ports; port++)
     {
+      if (deferred_filters)
+        deferred_filters[port] = nullptr;
+
       if (values[port])
         {
           if (out_decoders[port] && !have_cycle)
             {
-              out_decoders[port]->process (n_samples, freq_in, values[port]);
+              out_decoders[port]->process (n_samples, freq_in, values[port], deferred_filters ? &deferred_filters[port] : nullptr);
             }
           else
             {
@@ -163,6 +178,8 @@ MorphOutputModule::retrigger (const TimeInfo& time_info, int channel, float freq
     {
       if (out_decoders[port])
         {
+          /* derive randomization from the MorphPlanSynth seed, so that rendering is reproducible */
+          out_decoders[port]->set_random_seed (morph_plan_voice->morph_plan_synth()->decoder_random_gen()->random_uint32());
           out_decoders[port]->retrigger (channel, freq, midi_velocity, morph_plan_voice->mix_freq());
         }
     }
@@ -21,12 +21,14 @@ public:
   ~MorphOutputModule();
 
   void set_config (const MorphOperatorConfig *op_cfg);
-  void process (const TimeInfo& time_info, size_t n_samples, float **values, size_t n_ports, const float *freq_in = nullptr);
+  void process (const TimeInfo& time_info, size_t n_samples, float **values, size_t n_ports, const float *freq_in = nullptr,
+                LadderVCFVoice **deferred_filters = nullptr);
   void retrigger (const TimeInfo& time_info, int channel, float freq, int midi_velocity);
   void release();
   bool done();
 
   bool  portamento() const;
+  bool  noise_bank() const;
   float portamento_glide() const;
   float velocity_sensitivity() const;
   float filter_cutoff_mod() const;
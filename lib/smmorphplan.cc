@@ -14,6 +14,7 @@
 #include "smutils.hh"
 
 #include <map>
+#include <atomic>
 #include <assert.h>
 
 using namespace SpectMorph;
@@ -29,6 +30,8 @@ MorphPlan::MorphPlan (Project& project) :
 {
   in_restore = false;
   m_id = generate_id();
+  m_structure_version = generate_version();
+  m_state_version = m_structure_version;
 
   leak_debugger.add (this);
 }
@@ -480,8 +483,47 @@ MorphPlan::save (GenericOut *file, ExtraParameters *params) const
   return Error::Code::NONE;
 }
 
+/**
+ * Notify about a change of the plan structure (operators added, removed, moved,
+ * or the plan was loaded). All operators need to be considered for the next
+ * synthesis update.
+ */
 void
 MorphPlan::emit_plan_changed()
+{
+  m_structure_version = generate_version();
+  m_state_version = m_structure_version;
+
+  if (!in_restore)
+    {
+      signal_plan_changed();
+    }
+}
+
+/**
+ * Notify about a change of one or more operators (the structure of the plan
+ * is unchanged). Operators with a new MorphOperator::config_version() need
+ * to be updated by the next synthesis update, but all other operators can
+ * be reused.
+ */
+void
+MorphPlan::emit_operator_changed()
+{
+  m_state_version = generate_version();
+
+  if (!in_restore)
+    {
+      signal_plan_changed();
+    }
+}
+
+/**
+ * Notify about a change that only affects the user interface (like the selected
+ * node of a grid). The state of the plan is unchanged, so it doesn't need to be
+ * saved, and the synthesis doesn't need to be updated.
+ */
+void
+MorphPlan::emit_view_changed()
 {
   if (!in_restore)
     {
@@ -492,6 +534,10 @@ MorphPlan::emit_plan_changed()
 void
 MorphPlan::emit_index_changed()
 {
+  /* config of all operators depends on the index (smset_dir) */
+  m_structure_version = generate_version();
+  m_state_version = m_structure_version;
+
   if (!in_restore)
     {
       signal_index_changed();
@@ -528,6 +574,28 @@ MorphPlan::id()
   return m_id;
 }
 
+uint64
+MorphPlan::structure_version() const
+{
+  return m_structure_version;
+}
+
+/* changes whenever something changes that is saved with the plan */
+uint64
+MorphPlan::state_version() const
+{
+  return m_state_version;
+}
+
+uint64
+MorphPlan::generate_version()
+{
+  /* version numbers are globally unique, so they can't collide between plans or operators */
+  static std::atomic<uint64> version_counter { 0 };
+
+  return ++version_counter;
+}
+
 MorphPlan *
 MorphPlan::clone() const
 {
@@ -33,6 +33,8 @@ protected:
   Index                        m_index;
   std::vector<MorphOperator *> m_operators;
   std::string                  m_id;
+  uint64                       m_structure_version;
+  uint64                       m_state_version;
 
   bool                         in_restore;
 
@@ -47,6 +49,8 @@ public:
   const Index *index();
   Project     *project();
   std::string  id();
+  uint64       structure_version() const;
+  uint64       state_version() const;
 
   enum AddPos {
     ADD_POS_AUTO,
@@ -60,6 +64,8 @@ public:
 
   void set_plan_str (const std::string& plan_str);
   void emit_plan_changed();
+  void emit_operator_changed();
+  void emit_view_changed();
   void emit_index_changed();
 
   Error save (GenericOut *file, ExtraParameters *params = nullptr) const;
@@ -71,6 +77,7 @@ public:
 
   static std::string id_chars();
   static std::string generate_id();
+  static uint64      generate_version();
 
   Signal<>                signal_plan_changed;
   Signal<>                signal_index_changed;
@@ -80,33 +80,69 @@ MorphPlanSynth::prepare_update (MorphPlanPtr plan) /* main thread */
 {
   UpdateP update = std::make_shared<Update>();
 
-  update->have_cycle = false;
-  for (auto op : plan->operators())
+  if (plan->structure_version() != m_prepared_structure_version)
     {
-      if (recursive_cycle_check (op, 0))
-        update->have_cycle = true;
+      /* structure changed (or different plan): all configs need to be cloned */
+      vector<string> update_ids = sorted_id_list (plan);
+
+      update->cheap = (update_ids == m_last_update_ids) && (plan->id() == m_last_plan_id);
+      m_last_update_ids = update_ids;
+      m_last_plan_id = plan->id();
+
+      m_prepared_ops.clear();
+      for (auto o : plan->operators())
+        {
+          PreparedOp prepared_op;
+          prepared_op.op = o;
+          m_prepared_ops.push_back (prepared_op);
+        }
+      sort (m_prepared_ops.begin(), m_prepared_ops.end(),
+            [](const PreparedOp& a, const PreparedOp& b) { return a.op->ptr_id() < b.op->ptr_id(); });
+
+      m_prepared_structure_version = plan->structure_version();
+    }
+  else
+    {
+      /* same operators as last update: only clone configs of operators that changed */
+      update->cheap = true;
     }
 
-  for (auto o : plan->operators())
+  for (size_t i = 0; i < m_prepared_ops.size(); i++)
     {
-      MorphOperatorConfigP config (o->clone_config());
-      update->new_configs.push_back (config);
+      PreparedOp& prepared_op = m_prepared_ops[i];
+      MorphOperator *o = prepared_op.op;
+
+      if (prepared_op.config_version != o->config_version())
+        {
+          prepared_op.config.reset (o->clone_config());
+          prepared_op.config_version = o->config_version();
+
+          update->changed_ops.push_back (i);
+        }
+      update->new_configs.push_back (prepared_op.config);
 
       Update::Op op = {
         .ptr_id = o->ptr_id(),
         .type   = o->type(),
-        .config = config.get()
+        .config = prepared_op.config.get()
       };
       update->ops.push_back (op);
     }
-  sort (update->ops.begin(), update->ops.end(),
-        [](const Update::Op& a, const Update::Op& b) { return a.ptr_id < b.ptr_id; });
 
-  vector<string> update_ids = sorted_id_list (plan);
+  /* operator dependencies can only change if some config changed */
+  if (!update->changed_ops.empty())
+    {
+      m_prepared_have_cycle = false;
+      for (auto op : plan->operators())
+        {
+          if (recursive_cycle_check (op, 0))
+            m_prepared_have_cycle = true;
+        }
+    }
+  update->have_cycle = m_prepared_have_cycle;
 
-  update->cheap = (update_ids == m_last_update_ids) && (plan->id() == m_last_plan_id);
-  m_last_update_ids = update_ids;
-  m_last_plan_id = plan->id();
+  update->base_serial = m_prepared_serial;
+  update->serial = m_prepared_serial = MorphPlan::generate_version();
 
   return update;
 }
@@ -122,7 +158,13 @@ MorphPlanSynth::apply_update (MorphPlanSynth::UpdateP update) /* audio thread */
   m_active_configs = std::move (update->new_configs);
   m_have_cycle = update->have_cycle;
 
-  if (update->cheap)
+  if (update->cheap && update->base_serial == m_applied_serial)
+    {
+      /* only reconfigure modules for operators that changed since the last update */
+      for (size_t i = 0; i < voices.size(); i++)
+        voices[i]->delta_update (update);
+    }
+  else if (update->cheap)
     {
       for (size_t i = 0; i < voices.size(); i++)
         voices[i]->cheap_update (update);
@@ -134,6 +176,7 @@ MorphPlanSynth::apply_update (MorphPlanSynth::UpdateP update) /* audio thread */
       for (size_t i = 0; i < voices.size(); i++)
         voices[i]->full_update (update);
     }
+  m_applied_serial = update->serial;
 }
 
 void
@@ -168,6 +211,12 @@ MorphPlanSynth::random_gen()
   return &m_random_gen;
 }
 
+Random *
+MorphPlanSynth::decoder_random_gen()
+{
+  return &m_decoder_random_gen;
+}
+
 bool
 MorphPlanSynth::have_output() const
 {
@@ -184,6 +233,19 @@ MorphPlanSynth::have_cycle() const
   return m_have_cycle;
 }
 
+void
+MorphPlanSynth::set_noise_bank (bool noise_bank)
+{
+  // not rt safe: only affects decoders created/configured by the next apply_update()
+  m_noise_bank = noise_bank;
+}
+
+bool
+MorphPlanSynth::noise_bank() const
+{
+  return m_noise_bank;
+}
+
 void
 MorphPlanSynth::free_shared_state()
 {
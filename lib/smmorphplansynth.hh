@@ -19,13 +19,28 @@ class MorphPlanSynth {
 protected:
   std::vector<MorphPlanVoice *> voices;
   std::map<MorphOperator::PtrID, MorphModuleSharedState *> m_shared_state;
+  std::vector<MorphOperatorConfigP>               m_active_configs;
+  uint64                                          m_applied_serial = 0;
+
+  /* main thread state for prepare_update */
+  struct PreparedOp
+  {
+    MorphOperator       *op = nullptr;
+    uint64               config_version = 0;  // 0: config needs to be cloned
+    MorphOperatorConfigP config;
+  };
+  std::vector<PreparedOp>                         m_prepared_ops;  // sorted by ptr_id
+  uint64                                          m_prepared_structure_version = 0;
+  uint64                                          m_prepared_serial = 0;
+  bool                                            m_prepared_have_cycle = false;
   std::vector<std::string>                        m_last_update_ids;
   std::string                                     m_last_plan_id;
-  std::vector<MorphOperatorConfigP>               m_active_configs;
 
   float           m_mix_freq;
   Random          m_random_gen;
+  Random          m_decoder_random_gen; // seeds for the decoders of each note
   bool            m_have_cycle = false;
+  bool            m_noise_bank = false;
 
 public:
   struct Update
@@ -39,6 +54,9 @@ public:
     bool            cheap = false; // cheap update: same set of operators
     bool            have_cycle = false; // plan contains cycles?
     std::vector<Op> ops;
+    std::vector<size_t> changed_ops; // indices of ops with new config (for cheap updates)
+    uint64          serial = 0;
+    uint64          base_serial = 0; // changed_ops are relative to this update
     std::vector<MorphOperatorConfigP> new_configs;
     std::vector<MorphOperatorConfigP> old_configs;
   };
@@ -61,7 +79,11 @@ public:
   float   mix_freq() const;
   bool    have_output() const;
   Random *random_gen();
+  Random *decoder_random_gen();
   bool    have_cycle() const;
+
+  void    set_noise_bank (bool noise_bank);
+  bool    noise_bank() const;
 };
 
 }
@@ -126,6 +126,22 @@ MorphPlanVoice::cheap_update (MorphPlanSynth::UpdateP update)
   configure_modules();
 }
 
+void
+MorphPlanVoice::delta_update (MorphPlanSynth::UpdateP update)
+{
+  g_return_if_fail (update->ops.size() == modules.size());
+
+  // exchange and reconfigure changed operators only
+  for (auto i : update->changed_ops)
+    {
+      assert (modules[i].ptr_id == update->ops[i].ptr_id);
+      modules[i].config = update->ops[i].config;
+      assert (modules[i].config);
+
+      modules[i].module->set_config (modules[i].config);
+    }
+}
+
 double
 MorphPlanVoice::control_input (double value, MorphOperator::ControlType ctype, MorphOperatorModule *module)
 {
@@ -174,3 +190,16 @@ MorphPlanVoice::reset_value (const TimeInfo& time_info)
   for (size_t i = 0; i < modules.size(); i++)
     modules[i].module->reset_value (time_info);
 }
+
+void
+MorphPlanVoice::add_dsp_timers (DSPOperatorTimers& timers)
+{
+  /* adds the time spent in each operator since the last call */
+  for (const auto& op_module : modules)
+    {
+      const DSPOperatorTimer module_timer = op_module.module->take_dsp_timer();
+
+      if (module_timer.calls)
+        timers.add (op_module.ptr_id, module_timer);
+    }
+}
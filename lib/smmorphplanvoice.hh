@@ -35,6 +35,7 @@ public:
   ~MorphPlanVoice();
 
   void cheap_update (MorphPlanSynth::UpdateP update);
+  void delta_update (MorphPlanSynth::UpdateP update);
   void full_update (MorphPlanSynth::UpdateP update);
 
   MorphOperatorModule *module (const MorphOperatorPtr& ptr);
@@ -49,6 +50,7 @@ public:
 
   void update_shared_state (const TimeInfo& time_info);
   void reset_value (const TimeInfo& time_info);
+  void add_dsp_timers (DSPOperatorTimers& timers);
 };
 
 }
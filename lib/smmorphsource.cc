@@ -25,7 +25,7 @@ void
 MorphSource::set_smset (const string& smset)
 {
   m_smset = smset;
-  m_morph_plan->emit_plan_changed();
+  emit_config_changed();
 }
 
 string
@@ -41,6 +41,7 @@ MorphSource::clone_config()
 
   string smset_dir = morph_plan()->index()->smset_dir();
   cfg->path = smset_dir + "/" + m_smset;
+  cfg->wav_set = WavSetRepo::the()->load_async (cfg->path);
 
   return cfg;
 }
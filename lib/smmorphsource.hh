@@ -4,6 +4,7 @@
 #define SPECTMORPH_MORPH_SOURCE_HH
 
 #include "smmorphoperator.hh"
+#include "smwavsetrepo.hh"
 
 #include <string>
 
@@ -15,7 +16,8 @@ class MorphSource : public MorphOperator
 public:
   struct Config : public MorphOperatorConfig
   {
-    std::string path;
+    std::string     path;
+    WavSetRepo::Ref wav_set;   // loading starts when the config is created
   };
   Config      m_config;
 protected:
@@ -22,15 +22,13 @@ freq_to_note (float freq)
 }
 
 SimpleWavSetSource::SimpleWavSetSource() :
-  wav_set (NULL),
   active_audio (NULL)
 {
 }
 
 void
-SimpleWavSetSource::set_wav_set (const string& path)
+SimpleWavSetSource::set_wav_set (const WavSetRepo::Ref& new_wav_set)
 {
-  WavSet *new_wav_set = WavSetRepo::the()->get (path);
   if (new_wav_set != wav_set)
     {
       wav_set = new_wav_set;
@@ -41,15 +39,17 @@ SimpleWavSetSource::set_wav_set (const string& path)
 void
 SimpleWavSetSource::retrigger (int channel, float freq, int midi_velocity, float mix_freq)
 {
-  Audio *best_audio = NULL;
+  const Audio *best_audio = NULL;
   float  best_diff  = 1e10;
 
+  /* wav_set is nullptr while the WavSet is still being loaded: produce no output */
+  WavSet *wav_set = this->wav_set.wav_set();
   if (wav_set)
     {
       float note = freq_to_note (freq);
       for (vector<WavSetWave>::iterator wi = wav_set->waves.begin(); wi != wav_set->waves.end(); wi++)
         {
-          Audio *audio = wi->audio;
+          const Audio *audio = wi->audio;
           if (audio && wi->channel == channel &&
                        wi->velocity_range_min <= midi_velocity &&
                        wi->velocity_range_max >= midi_velocity)
@@ -64,15 +64,20 @@ SimpleWavSetSource::retrigger (int channel, float freq, int midi_velocity, float
         }
     }
   active_audio = best_audio;
+
+  /* the LiveDecoder uses active_audio until the next retrigger, so we need to
+   * keep the WavSet from being evicted even if set_wav_set() changes wav_set
+   */
+  active_wav_set = this->wav_set;
 }
 
-Audio*
+const Audio*
 SimpleWavSetSource::audio()
 {
   return active_audio;
 }
 
-AudioBlock *
+const AudioBlock *
 SimpleWavSetSource::audio_block (size_t index)
 {
   if (active_audio && index < active_audio->contents.size())
@@ -103,5 +108,5 @@ MorphSourceModule::set_config (const MorphOperatorConfig *op_cfg)
 {
   auto cfg = dynamic_cast<const MorphSource::Config *> (op_cfg);
 
-  my_source.set_wav_set (cfg->path);
+  my_source.set_wav_set (cfg->wav_set);
 }
@@ -4,7 +4,7 @@
 #define SPECTMORPH_MORPH_SOURCE_MODULE_HH
 
 #include "smmorphoperatormodule.hh"
-#include "smwavset.hh"
+#include "smwavsetrepo.hh"
 
 namespace SpectMorph
 {
@@ -12,17 +12,18 @@ namespace SpectMorph
 class SimpleWavSetSource : public LiveDecoderSource
 {
 private:
-  WavSet *wav_set;
-  Audio  *active_audio;
+  WavSetRepo::Ref wav_set;
+  WavSetRepo::Ref active_wav_set;  // keeps active_audio alive after set_wav_set()
+  const Audio    *active_audio;
 
 public:
   SimpleWavSetSource();
 
-  void        set_wav_set (const std::string& path);
+  void        set_wav_set (const WavSetRepo::Ref& new_wav_set);
 
   void        retrigger (int channel, float freq, int midi_velocity, float mix_freq);
-  Audio      *audio();
-  AudioBlock *audio_block (size_t index);
+  const Audio      *audio();
+  const AudioBlock *audio_block (size_t index);
 };
 
 class MorphSourceModule : public MorphOperatorModule
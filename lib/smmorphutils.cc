@@ -20,8 +20,32 @@ fs_cmp (const FreqState& fs1, const FreqState& fs2)
   return fs1.freq_f < fs2.freq_f;
 }
 
+static size_t
+find_start (float freq_start, const FreqState *freq_state, size_t freq_state_size, size_t hint)
+{
+  /* the hint is usually the index of the match in the previous frame, so
+   * the first partial with freq_f >= freq_start is typically very close
+   */
+  if (hint < freq_state_size)
+    {
+      size_t i = hint;
+      for (int step = 0; step < 4; step++)
+        {
+          if (i > 0 && freq_state[i - 1].freq_f >= freq_start)
+            i--;
+          else if (i < freq_state_size && freq_state[i].freq_f < freq_start)
+            i++;
+          else
+            return i;
+        }
+    }
+  FreqState start_freq_state = {freq_start, 0};
+  const FreqState *start_ptr = std::lower_bound (freq_state, freq_state + freq_state_size, start_freq_state, fs_cmp);
+  return start_ptr - freq_state;
+}
+
 bool
-find_match (float freq, const FreqState *freq_state, size_t freq_state_size, size_t *index)
+find_match (float freq, const FreqState *freq_state, size_t freq_state_size, size_t *index, size_t hint)
 {
   const float freq_start = freq - 0.5;
   const float freq_end   = freq + 0.5;
@@ -29,9 +53,7 @@ find_match (float freq, const FreqState *freq_state, size_t freq_state_size, siz
   double min_diff = 1e20;
   size_t best_index = 0; // initialized to avoid compiler warning
 
-  FreqState start_freq_state = {freq_start, 0};
-  const FreqState *start_ptr = std::lower_bound (freq_state, freq_state + freq_state_size, start_freq_state, fs_cmp);
-  size_t i = start_ptr - freq_state;
+  size_t i = find_start (freq_start, freq_state, freq_state_size, hint);
 
   while (i < freq_state_size && freq_state[i].freq_f < freq_end)
     {
@@ -55,7 +77,7 @@ find_match (float freq, const FreqState *freq_state, size_t freq_state_size, siz
 }
 
 void
-init_freq_state (const vector<uint16_t>& fint, FreqState *freq_state)
+init_freq_state (const ArenaVector<uint16_t>& fint, FreqState *freq_state)
 {
   for (size_t i = 0; i < fint.size(); i++)
     {
@@ -64,13 +86,13 @@ init_freq_state (const vector<uint16_t>& fint, FreqState *freq_state)
     }
 }
 
-AudioBlock*
+const AudioBlock*
 get_normalized_block_ptr (LiveDecoderSource *source, double time_ms)
 {
   if (!source)
     return nullptr;
 
-  Audio *audio = source->audio();
+  const Audio *audio = source->audio();
   if (!audio)
     return nullptr;
 
@@ -105,7 +127,7 @@ get_normalized_block_ptr (LiveDecoderSource *source, double time_ms)
 bool
 get_normalized_block (LiveDecoderSource *source, double time_ms, AudioBlock& out_audio_block)
 {
-  AudioBlock *block_ptr = MorphUtils::get_normalized_block_ptr (source, time_ms);
+  const AudioBlock *block_ptr = MorphUtils::get_normalized_block_ptr (source, time_ms);
   if (!block_ptr)
     return false;
 
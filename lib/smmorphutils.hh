@@ -22,10 +22,34 @@ struct FreqState
   int   used;
 };
 
-bool find_match (float freq, const FreqState *freq_state, size_t freq_state_size, size_t *index);
-void init_freq_state (const std::vector<uint16_t>& fint, FreqState *freq_state);
+struct MagData
+{
+  enum {
+    BLOCK_LEFT  = 0,
+    BLOCK_RIGHT = 1
+  }        block;
+  size_t   index;
+  uint16_t mag;
+};
+
+static constexpr size_t NO_MATCH = ~size_t (0);
+
+/* interpolates two magnitudes linearly in dB (idb values are linear in dB);
+ * magnitudes below -96 dB (like zero) are treated as -96 dB
+ */
+inline uint16_t
+interp_mag_idb (double interp, uint16_t left_idb, uint16_t right_idb)
+{
+  const uint16_t lmag_idb = std::max<uint16_t> (left_idb, SM_IDB_CONST_M96);
+  const uint16_t rmag_idb = std::max<uint16_t> (right_idb, SM_IDB_CONST_M96);
+
+  return sm_round_positive ((1 - interp) * lmag_idb + interp * rmag_idb);
+}
+
+bool find_match (float freq, const FreqState *freq_state, size_t freq_state_size, size_t *index, size_t hint = NO_MATCH);
+void init_freq_state (const ArenaVector<uint16_t>& fint, FreqState *freq_state);
 
-AudioBlock* get_normalized_block_ptr (LiveDecoderSource *source, double time_ms);
+const AudioBlock* get_normalized_block_ptr (LiveDecoderSource *source, double time_ms);
 bool get_normalized_block (LiveDecoderSource *source, double time_ms, AudioBlock& out_audio_block);
 
 }
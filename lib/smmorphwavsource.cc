@@ -40,7 +40,7 @@ MorphWavSource::set_object_id (int id)
   // object id to use in Project
   m_config.object_id = id;
 
-  m_morph_plan->emit_plan_changed();
+  emit_config_changed();
 }
 
 int
@@ -54,7 +54,7 @@ MorphWavSource::set_instrument (int instrument)
 {
   m_instrument = instrument;
 
-  m_morph_plan->emit_plan_changed();
+  emit_config_changed();
 }
 
 int
@@ -68,7 +68,7 @@ MorphWavSource::set_lv2_filename (const string& filename)
 {
   m_lv2_filename = filename;
 
-  m_morph_plan->emit_plan_changed();
+  emit_config_changed();
 }
 
 string
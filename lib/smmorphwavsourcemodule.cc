@@ -27,7 +27,7 @@ freq_to_note (float freq)
 void
 MorphWavSourceModule::InstrumentSource::retrigger (int channel, float freq, int midi_velocity, float mix_freq)
 {
-  Audio  *best_audio = nullptr;
+  const Audio *best_audio = nullptr;
   float   best_diff  = 1e10;
 
   // we can not delete the old wav_set between retrigger() invocations
@@ -39,7 +39,7 @@ MorphWavSourceModule::InstrumentSource::retrigger (int channel, float freq, int
       float note = freq_to_note (freq);
       for (vector<WavSetWave>::iterator wi = wav_set->waves.begin(); wi != wav_set->waves.end(); wi++)
         {
-          Audio *audio = wi->audio;
+          const Audio *audio = wi->audio;
           if (audio && wi->channel == channel &&
                        wi->velocity_range_min <= midi_velocity &&
                        wi->velocity_range_max >= midi_velocity)
@@ -56,15 +56,17 @@ MorphWavSourceModule::InstrumentSource::retrigger (int channel, float freq, int
   active_audio = best_audio;
 }
 
-Audio*
+const Audio*
 MorphWavSourceModule::InstrumentSource::audio()
 {
   return active_audio;
 }
 
-AudioBlock *
+const AudioBlock *
 MorphWavSourceModule::InstrumentSource::audio_block (size_t index)
 {
+  DSPOperatorScope op_scope (module->m_dsp_timer);
+
   if (active_audio && module->cfg->play_mode == MorphWavSource::PLAY_MODE_CUSTOM_POSITION)
     {
       const double position = module->apply_modulation (module->cfg->position_mod) * 0.01;
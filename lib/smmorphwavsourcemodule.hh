@@ -20,7 +20,7 @@ class MorphWavSourceModule : public MorphOperatorModule
 
   class InstrumentSource : public LiveDecoderSource
   {
-    Audio                  *active_audio = nullptr;
+    const Audio            *active_audio = nullptr;
     std::shared_ptr<WavSet> wav_set;
     int                     object_id;
     Project                *project;
@@ -28,8 +28,8 @@ class MorphWavSourceModule : public MorphOperatorModule
     MorphWavSourceModule   *module = nullptr;
 
     void retrigger (int channel, float freq, int midi_velocity, float mix_freq) override;
-    Audio *audio() override;
-    AudioBlock *audio_block (size_t index) override;
+    const Audio *audio() override;
+    const AudioBlock *audio_block (size_t index) override;
 
     void update_project (Project *project);
     void update_object_id (int object_id);
@@ -80,7 +80,7 @@ NoiseBandPartition::n_spectrum_bins()
 }
 
 void
-NoiseBandPartition::noise_envelope_to_spectrum (Random& random_gen, const vector<uint16_t>& envelope, float *spectrum, double scale)
+NoiseBandPartition::noise_envelope_to_spectrum (Random& random_gen, const ArenaVector<uint16_t>& envelope, float *spectrum, double scale)
 {
   assert (envelope.size() == n_bands());
 
@@ -8,15 +8,56 @@
 #include <stdio.h>
 #include <math.h>
 #include <assert.h>
+#include <atomic>
 #include <map>
+#include <mutex>
 
 using std::vector;
 using SpectMorph::NoiseDecoder;
+using SpectMorph::NoiseSpectrumBank;
+using SpectMorph::NoiseBandPartition;
+using SpectMorph::Random;
 using std::map;
 using SpectMorph::sm_sse;
 
 static map<size_t, float *> cos_window_for_block_size;
 
+/* Precomputed noise spectra (for FFT_SPECTRUM output)
+ *
+ * For each noise band, the bank contains SIZE spectra which have random phases and
+ * magnitude 1 within the band, and are already windowed (convolved with the window
+ * spectrum). Since windowing is linear, the windowed noise spectrum of a frame is
+ * the sum of one randomly selected (and randomly negated) bank entry per band, scaled
+ * with the band envelope; this avoids generating random phases for each bin and
+ * windowing the whole spectrum for every frame.
+ */
+class SpectMorph::NoiseSpectrumBank
+{
+public:
+  static constexpr size_t SIZE = 64;
+
+  double mix_freq = 0;
+  size_t block_size = 0;
+  struct Band
+  {
+    size_t        start = 0;    // range of fft buffer values affected by this band
+    size_t        end = 0;
+    vector<float> spectra;      // SIZE * (end - start) values
+    float         nyquist[SIZE];
+  };
+  vector<Band> bands;
+};
+
+/* Banks are shared by all noise decoders, and never freed. They are only built by
+ * prepare_spectrum_bank (before synthesis starts); the synthesis thread looks them up
+ * without locking: a bank is fully built before it is published by incrementing
+ * n_spectrum_banks.
+ */
+static constexpr size_t          MAX_SPECTRUM_BANKS = 16;
+static const NoiseSpectrumBank  *spectrum_banks[MAX_SPECTRUM_BANKS];
+static std::atomic<size_t>       n_spectrum_banks { 0 };
+static std::mutex                spectrum_bank_mutex;
+
 static size_t
 next_power2 (size_t i)
 {
@@ -47,11 +88,18 @@ NoiseDecoder::NoiseDecoder (double mix_freq, size_t block_size) :
 
   cos_window = win;
 
+  // 8 values before and after spectrum required by apply_window/SSE
+  spectrum_buffer = FFT::new_array_float (block_size + 18);
+  ifft_buffer = FFT::new_array_float (block_size);
+
   assert (block_size == next_power2 (block_size));
 }
 
 NoiseDecoder::~NoiseDecoder()
 {
+  FFT::free_array_float (spectrum_buffer);
+  FFT::free_array_float (ifft_buffer);
+
   if (noise_band_partition)
     {
       delete noise_band_partition;
@@ -63,6 +111,22 @@ void
 NoiseDecoder::set_seed (int seed)
 {
   random_gen.set_seed (seed);
+  std::fill (bank_last_index.begin(), bank_last_index.end(), 0);
+}
+
+/**
+ * Use precomputed noise spectra for FFT_SPECTRUM output; this is a lot faster,
+ * and the output has the same spectral envelope and energy, but the phases of
+ * the noise bins are only chosen from a limited number of random variations.
+ *
+ * The bank needs to be created with prepare_spectrum_bank() before synthesis
+ * starts; if no bank was prepared for the mix_freq/number of noise bands, the
+ * noise spectrum is generated for each block (as without the bank).
+ */
+void
+NoiseDecoder::enable_spectrum_bank (bool enable)
+{
+  spectrum_bank_enabled = enable;
 }
 
 /**
@@ -77,18 +141,39 @@ NoiseDecoder::process (const AudioBlock& audio_block,
                        OutputMode        output_mode,
                        float             portamento_stretch)
 {
-  if (!noise_band_partition)
-    noise_band_partition = new NoiseBandPartition (audio_block.noise.size(), block_size + 2, mix_freq);
+  if (!noise_band_partition || noise_band_partition->n_bands() != audio_block.noise.size())
+    {
+      /* NoiseDecoder objects are reused for different audio blocks (LiveDecoder::retrigger),
+       * so recreate the partition if the number of noise bands changes
+       */
+      if (noise_band_partition)
+        delete noise_band_partition;
+      noise_band_partition = new NoiseBandPartition (audio_block.noise.size(), block_size + 2, mix_freq);
+      spectrum_bank = nullptr;
+      bank_last_index.assign (audio_block.noise.size(), 0);
+    }
 
   assert (noise_band_partition->n_bands() == audio_block.noise.size());
   assert (noise_band_partition->n_spectrum_bins() == block_size + 2);
 
   // 8 values before and after spectrum required by apply_window/SSE
-  float *interpolated_spectrum = FFT::new_array_float (block_size + 18) + 8;
+  float *interpolated_spectrum = spectrum_buffer + 8;
 
   const double Eww = 0.375; // expected value of the energy of the window
   const double norm = mix_freq / (Eww * block_size);
 
+  if (output_mode == FFT_SPECTRUM && spectrum_bank_enabled && portamento_stretch <= 1.01)
+    {
+      if (!spectrum_bank)
+        spectrum_bank = find_spectrum_bank (mix_freq, block_size, audio_block.noise.size());
+
+      if (spectrum_bank)
+        {
+          add_bank_spectrum (audio_block, samples, sqrt (norm) / 2);
+          return;
+        }
+    }
+
   noise_band_partition->noise_envelope_to_spectrum (random_gen, audio_block.noise, interpolated_spectrum, sqrt (norm) / 2);
 
   if (portamento_stretch > 1.01) // avoid aliasing during portamento
@@ -105,17 +190,16 @@ NoiseDecoder::process (const AudioBlock& audio_block,
     }
   else if (output_mode == DEBUG_UNWINDOWED)
     {
-      float *in = FFT::new_array_float (block_size);
+      float *in = ifft_buffer;
       FFT::fftsr_float (block_size, &interpolated_spectrum[0], &in[0]);
       memcpy (samples, in, block_size * sizeof (float));
-      FFT::free_array_float (in);
     }
   else if (output_mode == DEBUG_NO_OUTPUT)
     {
     }
   else
     {
-      float *in = FFT::new_array_float (block_size);
+      float *in = ifft_buffer;
       FFT::fftsr_float (block_size, &interpolated_spectrum[0], &in[0]);
 
       Block::mul (block_size, in, cos_window);
@@ -145,10 +229,171 @@ NoiseDecoder::process (const AudioBlock& audio_block,
         i_energy += interpolated_spectrum[i] * interpolated_spectrum[i] / norm;
       printf ("RE %f SE %f XE %f IE %f\n", r_energy, s_energy, xs_energy, i_energy);
     #endif
+    }
+}
+
+void
+NoiseDecoder::add_bank_spectrum (const AudioBlock& audio_block, float *fft_buffer, double scale)
+{
+  for (size_t b = 0; b < spectrum_bank->bands.size(); b++)
+    {
+      const NoiseSpectrumBank::Band& band = spectrum_bank->bands[b];
+
+      /* one random number selects the bank entry and the sign; we never use the same
+       * entry twice in a row, since consecutive frames overlap
+       */
+      const uint32_t r = random_gen.random_uint32();
+      const size_t   index = (bank_last_index[b] + 1 + r % (NoiseSpectrumBank::SIZE - 1)) % NoiseSpectrumBank::SIZE;
+      bank_last_index[b] = index;
+
+      const float    value = sm_idb2factor (audio_block.noise[b]) * scale * ((r & 0x80000000) ? -1 : 1);
+
+      const size_t len = band.end - band.start;
+      const float *spectrum = &band.spectra[index * len];
+      float *out = fft_buffer + band.start;
+      for (size_t i = 0; i < len; i++)
+        out[i] += spectrum[i] * value;
+
+      fft_buffer[1] += band.nyquist[index] * value;
+    }
+}
+
+void
+NoiseDecoder::build_spectrum_bank (NoiseSpectrumBank *bank, size_t n_bands)
+{
+  NoiseBandPartition partition (n_bands, block_size + 2, mix_freq);
+  Random             random;
+
+  random.set_seed (1);
+
+  float *spectrum = spectrum_buffer + 8;
+  float *windowed = ifft_buffer;
+
+  auto window_energy = [&]() {
+    spectrum[1] = spectrum[block_size];
 
-      FFT::free_array_float (in);
+    zero_float_block (block_size, windowed);
+    apply_window (spectrum, windowed);
+
+    double energy = 0;
+    for (size_t i = 0; i < block_size; i++)
+      energy += windowed[i] * windowed[i];
+    return energy;
+  };
+
+  vector<float> windowed_spectra (NoiseSpectrumBank::SIZE * block_size);
+  bank->bands.resize (n_bands);
+  for (size_t b = 0; b < n_bands; b++)
+    {
+      NoiseSpectrumBank::Band& band = bank->bands[b];
+
+      const size_t first = partition.first_bin (b);
+      const size_t last = first + partition.bins_per_band (b) * 2;
+
+      /* expected energy of the windowed band for random phases: the average energy
+       * of phase 0 and phase pi/2 for each bin (the cross terms average out)
+       */
+      double expected_energy = 0;
+      for (size_t d = first; d < last; d += 2)
+        {
+          for (int im = 0; im < 2; im++)
+            {
+              zero_float_block (block_size + 2, spectrum);
+              spectrum[d + im] = 1;
+              expected_energy += window_energy() / 2;
+            }
+        }
+
+      double bank_energy = 0;
+      size_t start = block_size, end = 0;
+      for (size_t index = 0; index < NoiseSpectrumBank::SIZE; index++)
+        {
+          zero_float_block (block_size + 2, spectrum);
+
+          for (size_t d = first; d < last; d += 2)
+            {
+              const guint8 r = random.random_uint32() & 0xff;
+
+              spectrum[d]   = int_cosf (r);
+              spectrum[d+1] = int_sinf (r);
+            }
+          bank_energy += window_energy();
+
+          /* the nyquist frequency is stored in the imaginary part of the first bin */
+          band.nyquist[index] = windowed[1];
+          windowed[1] = 0;
+
+          for (size_t i = 0; i < block_size; i++)
+            {
+              if (windowed[i] != 0)
+                {
+                  start = std::min (start, i);
+                  end = std::max (end, i + 1);
+                }
+            }
+          std::copy (windowed, windowed + block_size, &windowed_spectra[index * block_size]);
+        }
+      if (start > end)
+        start = end = 0;
+
+      /* normalize the bank, so that its average energy is the expected energy (we scale
+       * all entries with the same factor, since the energy of an entry depends on how
+       * much energy leaks into the neighbour bands)
+       */
+      const float norm = bank_energy > 0 ? sqrt (expected_energy * NoiseSpectrumBank::SIZE / bank_energy) : 0;
+
+      const size_t len = end - start;
+      band.start = start;
+      band.end = end;
+      band.spectra.resize (NoiseSpectrumBank::SIZE * len);
+      for (size_t index = 0; index < NoiseSpectrumBank::SIZE; index++)
+        {
+          const float *windowed_start = &windowed_spectra[index * block_size + start];
+          for (size_t i = 0; i < len; i++)
+            band.spectra[index * len + i] = windowed_start[i] * norm;
+
+          band.nyquist[index] *= norm;
+        }
+    }
+}
+
+/* rt safe: no locks, no memory allocations */
+const NoiseSpectrumBank *
+NoiseDecoder::find_spectrum_bank (double mix_freq, size_t block_size, size_t n_bands)
+{
+  const size_t n_banks = n_spectrum_banks.load (std::memory_order_acquire);
+
+  for (size_t i = 0; i < n_banks; i++)
+    {
+      const NoiseSpectrumBank *bank = spectrum_banks[i];
+
+      if (bank->mix_freq == mix_freq && bank->block_size == block_size && bank->bands.size() == n_bands)
+        return bank;
     }
-  FFT::free_array_float (interpolated_spectrum - 8);
+  return nullptr;
+}
+
+void
+NoiseDecoder::prepare_spectrum_bank (double mix_freq, size_t n_bands)
+{
+  /* computing the bank is expensive, so this must be done before synthesis starts */
+  const size_t block_size = preferred_block_size (mix_freq);
+
+  std::lock_guard<std::mutex> lg (spectrum_bank_mutex);
+
+  const size_t n_banks = n_spectrum_banks.load();
+  if (find_spectrum_bank (mix_freq, block_size, n_bands) || n_banks == MAX_SPECTRUM_BANKS)
+    return;
+
+  NoiseDecoder noise_decoder (mix_freq, block_size);
+
+  NoiseSpectrumBank *bank = new NoiseSpectrumBank();
+  bank->mix_freq = mix_freq;
+  bank->block_size = block_size;
+  noise_decoder.build_spectrum_bank (bank, n_bands);
+
+  spectrum_banks[n_banks] = bank;
+  n_spectrum_banks.store (n_banks + 1, std::memory_order_release);
 }
 
 size_t
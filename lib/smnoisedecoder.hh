@@ -10,20 +10,36 @@
 namespace SpectMorph
 {
 
+class NoiseSpectrumBank;
+
 /**
  * \brief Decoder for the noise component (stochastic component) of the signal
  */
 class NoiseDecoder
 {
+  SPECTMORPH_CLASS_NON_COPYABLE (NoiseDecoder);
+
   double mix_freq;
   size_t block_size;
 
   float *cos_window;
 
+  /* work buffers, allocated once to avoid memory allocations in process() */
+  float *spectrum_buffer;
+  float *ifft_buffer;
+
   Random random_gen;
   NoiseBandPartition *noise_band_partition;
 
+  bool                     spectrum_bank_enabled = false;
+  const NoiseSpectrumBank *spectrum_bank = nullptr;
+  std::vector<int>         bank_last_index;
+
   void apply_window (float *spectrum, float *fft_buffer);
+  void add_bank_spectrum (const AudioBlock& audio_block, float *fft_buffer, double scale);
+  void build_spectrum_bank (NoiseSpectrumBank *bank, size_t n_bands);
+
+  static const NoiseSpectrumBank *find_spectrum_bank (double mix_freq, size_t block_size, size_t n_bands);
 
 public:
   NoiseDecoder (double mix_freq,
@@ -33,12 +49,14 @@ public:
   enum OutputMode { REPLACE, ADD, FFT_SPECTRUM, DEBUG_UNWINDOWED, DEBUG_NO_OUTPUT };
 
   void set_seed (int seed);
+  void enable_spectrum_bank (bool enable);
   void process (const AudioBlock& audio_block,
                 float *samples,
                 OutputMode output_mode = REPLACE,
                 float portamento_stretch = 1.0);
 
   static size_t preferred_block_size (double mix_freq);
+  static void   prepare_spectrum_bank (double mix_freq, size_t n_bands = 32);
 };
 
 }
@@ -129,42 +129,58 @@ OutFile::write_bool (const string& s,
 void
 OutFile::write_float_block (const string& s,
                             const vector<float>& fb)
+{
+  write_float_block (s, fb.data(), fb.size());
+}
+
+void
+OutFile::write_float_block (const string& s,
+                            const float  *fb,
+                            size_t        n)
 {
   file->put_byte ('F');
 
   write_raw_string (s);
-  write_raw_int (fb.size());
+  write_raw_int (n);
 
 #if G_BYTE_ORDER != G_LITTLE_ENDIAN
-  const int *fb_data = reinterpret_cast<const int *> (&fb[0]);
+  const int *fb_data = reinterpret_cast<const int *> (fb);
 
-  vector<int> buffer (fb.size());
-  for (size_t i = 0; i < fb.size(); i++)
+  vector<int> buffer (n);
+  for (size_t i = 0; i < n; i++)
     buffer[i] = GINT32_TO_LE (fb_data[i]); // little endian encoding
 
   file->write (&buffer[0], buffer.size() * 4);
 #else
-  file->write (&fb[0], fb.size() * 4);
+  file->write (fb, n * 4);
 #endif
 }
 
 void
 OutFile::write_uint16_block (const string& s,
                             const vector<uint16_t>& ib)
+{
+  write_uint16_block (s, ib.data(), ib.size());
+}
+
+void
+OutFile::write_uint16_block (const string& s,
+                             const uint16_t *ib,
+                             size_t          n)
 {
   file->put_byte ('6');
 
   write_raw_string (s);
-  write_raw_int (ib.size());
+  write_raw_int (n);
 
 #if G_BYTE_ORDER != G_LITTLE_ENDIAN
-  vector<int16_t> buffer (ib.size());
-  for (size_t i = 0; i < ib.size(); i++)
+  vector<int16_t> buffer (n);
+  for (size_t i = 0; i < n; i++)
     buffer[i] = GUINT16_TO_LE (ib[i]); // little endian encoding
 
   file->write (&buffer[0], buffer.size() * 2);
 #else
-  file->write (&ib[0], ib.size() * 2);
+  file->write (ib, n * 2);
 #endif
 }
 
@@ -44,7 +44,9 @@ public:
   void write_string (const std::string& s, const std::string& data);
   void write_float (const std::string& s, double f);
   void write_float_block (const std::string& s, const std::vector<float>& fb);
+  void write_float_block (const std::string& s, const float *fb, size_t n);
   void write_uint16_block (const std::string& s, const std::vector<uint16_t>& ib);
+  void write_uint16_block (const std::string& s, const uint16_t *ib, size_t n);
   void write_blob (const std::string& s, const void *data, size_t size);
   void write_operator (const std::string& name, const MorphOperatorPtr& op);
 };
@@ -59,6 +59,12 @@ PolyPhaseInter::get_sample (const vector<float>& signal, double pos)
 
 double
 PolyPhaseInter::get_sample_no_check (const vector<float>& signal, double pos)
+{
+  return get_sample_no_check (&signal[0], pos);
+}
+
+double
+PolyPhaseInter::get_sample_no_check (const float *signal, double pos)
 {
   const int ipos = pos;
 
@@ -21,6 +21,7 @@ public:
 
   double get_sample (const std::vector<float>& signal, double pos);
   double get_sample_no_check (const std::vector<float>& signal, double pos);
+  double get_sample_no_check (const float *signal, double pos);
 
   size_t get_min_padding();
 };
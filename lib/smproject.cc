@@ -8,6 +8,10 @@
 #include "smmemout.hh"
 #include "smmorphwavsource.hh"
 #include "smuserinstrumentindex.hh"
+#include "smnoisedecoder.hh"
+#include "smfft.hh"
+#include "smwavsetrepo.hh"
+#include "smconfig.hh"
 #include "smproject.hh"
 
 using namespace SpectMorph;
@@ -17,55 +21,97 @@ using std::vector;
 using std::set;
 using std::map;
 
+ControlEventQueue::~ControlEventQueue()
+{
+  SynthControlEvent *ev;
+
+  while (events.pop (ev))
+    delete ev;
+
+  delete_garbage_L();
+
+  for (auto pending_ev : pending)
+    delete pending_ev;
+}
+
 void
-ControlEventVector::take (SynthControlEvent *ev)
+ControlEventQueue::take (SynthControlEvent *ev) /* ui thread */
 {
-  // we'd rather run destructors in non-rt part of the code
-  if (clear)
-    {
-      events.clear();
-      clear = false;
-    }
+  std::lock_guard<std::mutex> lg (producer_mutex);
+
+  delete_garbage_L();
 
-  events.emplace_back (ev);
+  pending.push_back (ev);
+  flush_L();
 }
 
 void
-ControlEventVector::run_rt (Project *project)
+ControlEventQueue::flush_L()
 {
-  if (!clear)
-    {
-      for (const auto& ev : events)
-        ev->run_rt (project);
+  /* if the synthesis thread doesn't run, the queue may be full: keep order of events */
+  size_t n = 0;
+  while (n < pending.size() && events.push (pending[n]))
+    n++;
+
+  pending.erase (pending.begin(), pending.begin() + n);
+}
+
+void
+ControlEventQueue::delete_garbage_L()
+{
+  SynthControlEvent *ev;
+  while (garbage.pop (ev))
+    delete ev;
+}
 
-      clear = true;
+void
+ControlEventQueue::collect_garbage() /* ui thread */
+{
+  std::lock_guard<std::mutex> lg (producer_mutex);
+
+  delete_garbage_L();
+  flush_L();
+}
+
+void
+ControlEventQueue::run_rt (Project *project) /* synthesis thread */
+{
+  // we'd rather run destructors in non-rt part of the code, so events are only
+  // processed if they can be passed back to the ui thread
+  SynthControlEvent *ev;
+
+  while (!garbage.full() && events.pop (ev))
+    {
+      ev->run_rt (project);
+      garbage.push (ev);
     }
 }
 
 bool
 Project::try_update_synth()
 {
-  bool state_changed = false;
-  // handle synth updates (if locking is possible without blocking)
+  // handle synth updates (never blocks)
   //  - apply new parameters
   //  - process events
-  if (m_synth_mutex.try_lock())
+  m_control_events.run_rt (this);
+
+  // notifications are only passed to the ui thread if it took the previous ones,
+  // so we never free memory here
+  if (m_out_events_mutex.try_lock())
     {
-      m_control_events.run_rt (this);
-      m_out_events = m_midi_synth->inst_edit_synth()->take_out_events();
-      m_voices_active = m_midi_synth->active_voice_count() > 0;
-      state_changed = m_state_changed;
-      m_state_changed = false;
+      if (m_out_events.empty())
+        m_out_events = m_midi_synth->inst_edit_synth()->take_out_events();
 
-      m_synth_mutex.unlock();
+      m_out_events_mutex.unlock();
     }
-  return state_changed;
+  m_voices_active.store (m_midi_synth->active_voice_count() > 0, std::memory_order_relaxed);
+
+  return m_state_changed.exchange (false);
 }
 
 void
 Project::synth_take_control_event (SynthControlEvent *event)
 {
-  std::lock_guard<std::mutex> lg (m_synth_mutex);
   m_control_events.take (event);
 }
 
@@ -154,7 +200,10 @@ Project::get_wav_set (int object_id)
 vector<string>
 Project::notify_take_events()
 {
-  std::lock_guard<std::mutex> lg (m_synth_mutex);
+  /* called periodically by the ui: free events processed by the synthesis thread */
+  m_control_events.collect_garbage();
+
+  std::lock_guard<std::mutex> lg (m_out_events_mutex);
   return std::move (m_out_events);
 }
 
@@ -174,6 +223,7 @@ Project::Project()
 {
   m_morph_plan = new MorphPlan (*this);
   m_morph_plan->load_default();
+  m_last_state_version = m_morph_plan->state_version();
 
   connect (m_morph_plan->signal_plan_changed, this, &Project::on_plan_changed);
   connect (m_morph_plan->signal_operator_added, this, &Project::on_operator_added);
@@ -187,12 +237,28 @@ Project::set_mix_freq (double mix_freq)
 {
   // not rt safe, needs to be called when synthesis thread is not running
   m_midi_synth.reset (new MidiSynth (mix_freq, 64));
+
+  // voices can be rendered in parallel (set render_threads in the config file)
+  Config cfg;
+  m_midi_synth->set_render_threads (cfg.render_threads());
+
+  // precomputed noise spectra are faster, but change the noise (set noise_bank in the config file)
+  m_midi_synth->set_noise_bank (cfg.noise_bank());
+
+  // create fft plans for synthesis now, so the synthesis thread never needs to
+  FFT::prepare_plans ({ NoiseDecoder::preferred_block_size (mix_freq) });
+
   m_mix_freq = mix_freq;
 
   // FIXME: can this cause problems if an old plan change control event remained
   auto update = m_midi_synth->prepare_update (m_morph_plan);
   m_midi_synth->apply_update (update);
   m_midi_synth->set_gain (db_to_factor (m_volume));
+
+  /* hosts that never restore a project (so post_load() is not called) would get
+   * silent output until the instruments of the default plan are loaded
+   */
+  WavSetRepo::the()->wait_for_loads();
 }
 
 void
@@ -217,41 +283,39 @@ Project::state_changed()
 void
 Project::on_plan_changed()
 {
-  /* FIXME: CONFIG
-   *
-   * we used to save here anyway, so state changed check could be done easily
-   * however now with fast config updates, we just save for state changed
-   * checks which is a waste of time
+  /* plan changes are only signalled for actual modifications, so we don't need
+   * to serialize the plan to find out whether the state changed; changes that only
+   * affect the user interface (grid selection) don't change the state version
    */
-  // create a deep copy (by saving/loading)
-  vector<unsigned char> plan_data;
-  MemOut                plan_mo (&plan_data);
+  if (m_morph_plan->state_version() == m_last_state_version)
+    return;
 
-  m_morph_plan->save (&plan_mo);
+  m_last_state_version = m_morph_plan->state_version();
+  state_changed();
 
-  if (plan_data != m_last_plan_data)
+  if (m_morph_plan->structure_version() != m_last_structure_version)
     {
-      m_last_plan_data = plan_data;
-      state_changed();
-    }
+      m_last_structure_version = m_morph_plan->structure_version();
 
-  // this might take a while, and cannot be done in synthesis thread
-  MorphPlanSynth mp_synth (m_mix_freq, 1);
-  {
-    auto update = mp_synth.prepare_update (m_morph_plan);
-    mp_synth.apply_update (update);
-  }
+      // this might take a while, and cannot be done in synthesis thread
+      MorphPlanSynth mp_synth (m_mix_freq, 1);
+      {
+        auto update = mp_synth.prepare_update (m_morph_plan);
+        mp_synth.apply_update (update);
+      }
 
-  MorphOutputModule *om = mp_synth.voice(0)->output();
-  if (om)
-    {
-      TimeInfo ti; // not relevant
-      om->retrigger (ti, 0, 440, 1);
-      float s;
-      float *values[1] = { &s };
-      om->process (ti, 1, values, 1);
+      MorphOutputModule *om = mp_synth.voice(0)->output();
+      if (om)
+        {
+          TimeInfo ti; // not relevant
+          om->retrigger (ti, 0, 440, 1);
+          float s;
+          float *values[1] = { &s };
+          om->process (ti, 1, values, 1);
+        }
     }
 
+  /* for parameter changes, this only clones the configs of the operators that changed */
   MorphPlanSynth::UpdateP update = m_midi_synth->prepare_update (m_morph_plan);
   m_synth_interface->emit_apply_update (update);
 }
@@ -304,8 +368,10 @@ Project::on_operator_removed (MorphOperator *op)
 bool
 Project::voices_active()
 {
-  std::lock_guard<std::mutex> lg (m_synth_mutex);
-  return m_voices_active;
+  /* called periodically by the ui: free events processed by the synthesis thread */
+  m_control_events.collect_garbage();
+
+  return m_voices_active.load (std::memory_order_relaxed);
 }
 
 MorphPlanPtr
@@ -365,6 +431,11 @@ Project::post_load()
   //  -> rebuild morph plan view (somewhat hacky)
   m_morph_plan->signal_need_view_rebuild();
   m_morph_plan->emit_plan_changed();
+
+  /* instruments are loaded in the background; when a project is loaded (for instance
+   * if the host restores its state), they should be available for the first note
+   */
+  WavSetRepo::the()->wait_for_loads();
 }
 
 Error
@@ -10,9 +10,11 @@
 #include "smbuilderthread.hh"
 #include "smmorphplan.hh"
 #include "smuserinstrumentindex.hh"
+#include "smspscqueue.hh"
 
 #include <thread>
 #include <mutex>
+#include <atomic>
 
 namespace SpectMorph
 {
@@ -53,12 +55,28 @@ public:
   }
 };
 
-class ControlEventVector
+/*
+ * Events are passed from the ui thread to the synthesis thread using a lock-free
+ * queue; after running an event, the synthesis thread passes it back using a
+ * second queue, so that the event (and the data it owns) is always deleted in
+ * the ui thread.
+ */
+class ControlEventQueue
 {
-  std::vector<std::unique_ptr<SynthControlEvent>> events;
-  bool clear = false;
+  static constexpr size_t QUEUE_SIZE = 4096;
+
+  SPSCQueue<SynthControlEvent *>   events { QUEUE_SIZE };   // ui thread -> synthesis thread
+  SPSCQueue<SynthControlEvent *>   garbage { QUEUE_SIZE };  // synthesis thread -> ui thread
+  std::vector<SynthControlEvent *> pending;                 // events that didn't fit into the queue
+  std::mutex                       producer_mutex;          // never locked by synthesis thread
+
+  void flush_L();
+  void delete_garbage_L();
 public:
+  ~ControlEventQueue();
+
   void take (SynthControlEvent *ev);
+  void collect_garbage();
   void run_rt (Project *project);
 };
 
@@ -77,15 +95,16 @@ private:
   double                      m_mix_freq = 0;
   double                      m_volume = -6;
   RefPtr<MorphPlan>           m_morph_plan;
-  std::vector<unsigned char>  m_last_plan_data;
+  uint64                      m_last_structure_version = 0;
+  uint64                      m_last_state_version = 0;
   bool                        m_state_changed_notify = false;
   StorageModel                m_storage_model = StorageModel::COPY;
 
-  std::mutex                  m_synth_mutex;
-  ControlEventVector          m_control_events;          // protected by synth mutex
-  std::vector<std::string>    m_out_events;              // protected by synth mutex
-  bool                        m_voices_active = false;   // protected by synth mutex
-  bool                        m_state_changed = false;   // protected by synth mutex
+  ControlEventQueue           m_control_events;
+  std::mutex                  m_out_events_mutex;
+  std::vector<std::string>    m_out_events;              // protected by out events mutex
+  std::atomic<bool>           m_voices_active { false };
+  std::atomic<bool>           m_state_changed { false };
 
   std::unique_ptr<SynthInterface> m_synth_interface;
 
@@ -117,22 +136,11 @@ public:
 
   void synth_take_control_event (SynthControlEvent *event);
 
-  std::mutex&
-  synth_mutex()
-  {
-    /* the synthesis thread will typically not block on synth_mutex
-     * instead, it tries locking it, and if that fails, continues
-     *
-     * the ui thread will block on the synth_mutex to enqueue events,
-     * parameter changes (in form of a new morph plan, volume, ...)
-     * and so on
-     *
-     * if the synthesis thread can obtain a lock, it will then be
-     * able to process these events to update its internal state
-     * and also send notifications back to the ui
-     */
-    return m_synth_mutex;
-  }
+  /* the synthesis thread calls try_update_synth() before each block, which
+   *  - runs the events (parameter changes in form of a new morph plan, volume, ...)
+   *    enqueued by the ui thread, without blocking
+   *  - sends notifications back to the ui
+   */
   bool try_update_synth();
   void set_mix_freq (double mix_freq);
   void set_storage_model (StorageModel model);
@@ -0,0 +1,107 @@
+// Licensed GNU LGPL v2.1 or later: http://www.gnu.org/licenses/lgpl-2.1.html
+
+#ifndef SPECTMORPH_RING_BUFFER_HH
+#define SPECTMORPH_RING_BUFFER_HH
+
+#include <vector>
+#include <algorithm>
+
+#include <assert.h>
+
+namespace SpectMorph
+{
+
+/*
+ * Fixed capacity FIFO for audio samples, without allocations or memmove after set_capacity().
+ *
+ * Every sample is stored twice (at index i and i + capacity), so the samples
+ * in the buffer are always available as one contiguous block via data(), even
+ * if they wrap around the end of the ring.
+ */
+class RingBuffer
+{
+  std::vector<float> m_buffer;
+  size_t             m_capacity = 0;
+  size_t             m_start = 0;
+  size_t             m_size = 0;
+
+public:
+  /* change capacity, allocates memory only if capacity grows */
+  void
+  set_capacity (size_t capacity)
+  {
+    if (capacity > m_capacity)
+      {
+        std::vector<float> new_buffer (capacity * 2);
+
+        std::copy (data(), data() + m_size, new_buffer.begin());
+        std::copy (data(), data() + m_size, new_buffer.begin() + capacity);
+
+        m_buffer.swap (new_buffer);
+        m_capacity = capacity;
+        m_start = 0;
+      }
+  }
+  /* like std::vector::resize(): keeps the first samples, new samples are zero */
+  void
+  resize (size_t size)
+  {
+    if (size > m_size)
+      append (size - m_size, [] (size_t n, float *out) { std::fill (out, out + n, 0); });
+    else
+      m_size = size;
+  }
+  /* append n samples, fill (n, out) is called to write them */
+  template<class Fill> void
+  append (size_t n, Fill fill)
+  {
+    assert (m_size + n <= m_capacity);
+
+    /* m_start < m_capacity, so there is enough space behind the last sample */
+    const size_t first = m_start + m_size;
+    fill (n, &m_buffer[first]);
+
+    /* update copy of the new samples */
+    const size_t last = first + n;
+    if (first < m_capacity)
+      std::copy (m_buffer.begin() + first, m_buffer.begin() + std::min (last, m_capacity), m_buffer.begin() + first + m_capacity);
+    if (last > m_capacity)
+      {
+        const size_t wrap = std::max (first, m_capacity);
+        std::copy (m_buffer.begin() + wrap, m_buffer.begin() + last, m_buffer.begin() + wrap - m_capacity);
+      }
+
+    m_size += n;
+  }
+  /* remove n samples from the start */
+  void
+  drop_front (size_t n)
+  {
+    assert (n <= m_size);
+
+    m_start += n;
+    if (m_start >= m_capacity)
+      m_start -= m_capacity;
+
+    m_size -= n;
+  }
+  const float *
+  data() const
+  {
+    return m_buffer.data() + m_start;
+  }
+  size_t
+  size() const
+  {
+    return m_size;
+  }
+  size_t
+  capacity() const
+  {
+    return m_capacity;
+  }
+};
+
+}
+
+#endif
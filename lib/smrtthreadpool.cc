@@ -0,0 +1,205 @@
+// Licensed GNU LGPL v2.1 or later: http://www.gnu.org/licenses/lgpl-2.1.html
+
+#include "smrtthreadpool.hh"
+
+#ifdef SM_OS_WINDOWS
+#include <windows.h>
+#include <limits.h>
+#elif defined (SM_OS_MACOS)
+#include <dispatch/dispatch.h>
+#else
+#include <semaphore.h>
+#include <errno.h>
+#endif
+
+using namespace SpectMorph;
+
+/* number of busy wait iterations before a worker blocks on its semaphore */
+static constexpr int SPIN_COUNT = 256;
+
+/* posting the semaphore never locks a mutex, so it can be done by the realtime thread */
+class RTThreadPool::Semaphore
+{
+#ifdef SM_OS_WINDOWS
+  HANDLE               sem;
+#elif defined (SM_OS_MACOS)
+  dispatch_semaphore_t sem;
+#else
+  sem_t                sem;
+#endif
+public:
+  Semaphore()
+  {
+#ifdef SM_OS_WINDOWS
+    sem = CreateSemaphore (nullptr, 0, LONG_MAX, nullptr);
+#elif defined (SM_OS_MACOS)
+    sem = dispatch_semaphore_create (0);
+#else
+    sem_init (&sem, 0, 0);
+#endif
+  }
+  ~Semaphore()
+  {
+#ifdef SM_OS_WINDOWS
+    CloseHandle (sem);
+#elif defined (SM_OS_MACOS)
+    dispatch_release (sem);
+#else
+    sem_destroy (&sem);
+#endif
+  }
+  void
+  post()
+  {
+#ifdef SM_OS_WINDOWS
+    ReleaseSemaphore (sem, 1, nullptr);
+#elif defined (SM_OS_MACOS)
+    dispatch_semaphore_signal (sem);
+#else
+    sem_post (&sem);
+#endif
+  }
+  void
+  wait()
+  {
+#ifdef SM_OS_WINDOWS
+    WaitForSingleObject (sem, INFINITE);
+#elif defined (SM_OS_MACOS)
+    dispatch_semaphore_wait (sem, DISPATCH_TIME_FOREVER);
+#else
+    while (sem_wait (&sem) != 0 && errno == EINTR)
+      ;
+#endif
+  }
+};
+
+RTThreadPool::Worker::Worker() :
+  wakeup (new Semaphore())
+{
+}
+
+RTThreadPool::Worker::~Worker()
+{
+}
+
+RTThreadPool::RTThreadPool (int n_workers)
+{
+  for (int w = 0; w < n_workers; w++)
+    {
+      Worker *worker = new Worker();
+      workers.emplace_back (worker);
+
+      worker->thread = std::thread (&RTThreadPool::worker_thread, this, worker);
+    }
+}
+
+RTThreadPool::~RTThreadPool()
+{
+  quit.store (true);
+  for (auto& worker : workers)
+    wake_worker (worker.get());
+
+  for (auto& worker : workers)
+    worker->thread.join();
+}
+
+void
+RTThreadPool::wake_worker (Worker *worker)
+{
+  /* the worker sets sleeping before it checks start_gen / quit for the last time,
+   * so either it sees the new value, or we see sleeping == true here
+   */
+  if (worker->sleeping.load() && worker->sleeping.exchange (false))
+    worker->wakeup->post();
+}
+
+int
+RTThreadPool::n_workers() const
+{
+  return workers.size();
+}
+
+void
+RTThreadPool::run_tasks()
+{
+  size_t index;
+
+  while ((index = next_task.fetch_add (1)) < n_tasks)
+    job->run_task (index);
+}
+
+void
+RTThreadPool::run (Job *new_job, size_t new_n_tasks)
+{
+  /* workers only read job and n_tasks between start_gen and done_gen, so we can
+   * modify them here: all workers have finished the previous generation
+   */
+  job = new_job;
+  n_tasks = new_n_tasks;
+  next_task.store (0);
+  generation++;
+
+  for (auto& worker : workers)
+    {
+      worker->start_gen.store (generation);
+      wake_worker (worker.get());
+    }
+
+  run_tasks();
+
+  for (auto& worker : workers)
+    {
+      int spin = 0;
+      while (worker->done_gen.load (std::memory_order_acquire) != generation)
+        {
+          if (++spin > SPIN_COUNT)
+            std::this_thread::yield();
+        }
+    }
+}
+
+bool
+RTThreadPool::wait_for_job (Worker *worker, uint64 gen)
+{
+  int spin = 0;
+
+  while (worker->start_gen.load (std::memory_order_acquire) == gen)
+    {
+      if (quit.load())
+        return false;
+
+      if (++spin > SPIN_COUNT)
+        {
+          worker->sleeping.store (true);
+
+          if (worker->start_gen.load() == gen && !quit.load())
+            {
+              worker->wakeup->wait(); // wake_worker() resets sleeping
+            }
+          else if (!worker->sleeping.exchange (false))
+            {
+              /* wake_worker() has reset sleeping concurrently, so it posts (or posted) the semaphore */
+              worker->wakeup->wait();
+            }
+          spin = 0;
+        }
+    }
+  return !quit.load();
+}
+
+void
+RTThreadPool::worker_thread (Worker *worker)
+{
+  DSPThreadScope dsp_thread_scope (worker->dsp_thread_slot);
+
+  uint64 gen = 0;
+
+  while (wait_for_job (worker, gen))
+    {
+      gen = worker->start_gen.load (std::memory_order_acquire);
+
+      run_tasks();
+
+      worker->done_gen.store (gen, std::memory_order_release);
+    }
+}
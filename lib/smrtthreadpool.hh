@@ -0,0 +1,74 @@
+// Licensed GNU LGPL v2.1 or later: http://www.gnu.org/licenses/lgpl-2.1.html
+
+#ifndef SPECTMORPH_RT_THREAD_POOL_HH
+#define SPECTMORPH_RT_THREAD_POOL_HH
+
+#include "smutils.hh"
+#include "smdsptimer.hh"
+
+#include <thread>
+#include <atomic>
+#include <memory>
+#include <vector>
+
+namespace SpectMorph
+{
+
+/*
+ * Thread pool for splitting work done by the realtime thread across cores
+ *
+ * RTThreadPool::run() hands out the tasks of a job to the worker threads (and
+ * the calling thread, which also executes tasks) and waits for completion.
+ * Workers spin for a short time after each job, then block on a semaphore;
+ * run() wakes sleeping workers by posting the semaphore, which never locks
+ * a mutex.
+ */
+class RTThreadPool
+{
+public:
+  class Job
+  {
+  public:
+    virtual ~Job() {}
+    virtual void run_task (size_t index) = 0;
+  };
+
+  RTThreadPool (int n_workers);
+  ~RTThreadPool();
+
+  void run (Job *job, size_t n_tasks);
+  int  n_workers() const;
+
+private:
+  class Semaphore;
+
+  struct Worker
+  {
+    Worker();
+    ~Worker();
+
+    std::thread                thread;
+    std::atomic<uint64>        start_gen { 0 };
+    std::atomic<uint64>        done_gen { 0 };
+    std::atomic<bool>          sleeping { false };
+    std::unique_ptr<Semaphore> wakeup;
+    DSPThreadSlot              dsp_thread_slot;
+  };
+  std::vector<std::unique_ptr<Worker>> workers;
+
+  Job                    *job = nullptr;
+  size_t                  n_tasks = 0;
+  uint64                  generation = 0;
+  std::atomic<size_t>     next_task { 0 };
+
+  std::atomic<bool>       quit { false };
+
+  void wake_worker (Worker *worker);
+  void run_tasks();
+  bool wait_for_job (Worker *worker, uint64 gen);
+  void worker_thread (Worker *worker);
+};
+
+}
+
+#endif
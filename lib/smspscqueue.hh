@@ -0,0 +1,79 @@
+// Licensed GNU LGPL v2.1 or later: http://www.gnu.org/licenses/lgpl-2.1.html
+
+#ifndef SPECTMORPH_SPSC_QUEUE_HH
+#define SPECTMORPH_SPSC_QUEUE_HH
+
+#include <vector>
+#include <atomic>
+
+namespace SpectMorph
+{
+
+/*
+ * Lock-free single producer / single consumer queue with fixed capacity.
+ *
+ * push() must only be called from one thread (the producer), pop() must
+ * only be called from one other thread (the consumer); neither of them
+ * blocks or allocates memory, so either side can be a realtime thread.
+ */
+template<class T>
+class SPSCQueue
+{
+  std::vector<T>      m_items;
+  std::atomic<size_t> m_read_pos { 0 };
+  std::atomic<size_t> m_write_pos { 0 };
+
+  size_t
+  next_pos (size_t pos) const
+  {
+    pos++;
+    return pos == m_items.size() ? 0 : pos;
+  }
+public:
+  SPSCQueue (size_t capacity) :
+    m_items (capacity + 1) // one item is always unused to distinguish full and empty
+  {
+  }
+  /* producer: returns false if the queue is full */
+  bool
+  push (const T& item)
+  {
+    const size_t write_pos = m_write_pos.load (std::memory_order_relaxed);
+    const size_t new_write_pos = next_pos (write_pos);
+
+    if (new_write_pos == m_read_pos.load (std::memory_order_acquire))
+      return false;
+
+    m_items[write_pos] = item;
+    m_write_pos.store (new_write_pos, std::memory_order_release);
+    return true;
+  }
+  /* producer: true if push() would fail */
+  bool
+  full() const
+  {
+    return next_pos (m_write_pos.load (std::memory_order_relaxed)) == m_read_pos.load (std::memory_order_acquire);
+  }
+  /* consumer: returns false if the queue is empty */
+  bool
+  pop (T& item)
+  {
+    const size_t read_pos = m_read_pos.load (std::memory_order_relaxed);
+
+    if (read_pos == m_write_pos.load (std::memory_order_acquire))
+      return false;
+
+    item = m_items[read_pos];
+    m_read_pos.store (next_pos (read_pos), std::memory_order_release);
+    return true;
+  }
+  size_t
+  capacity() const
+  {
+    return m_items.size() - 1;
+  }
+};
+
+}
+
+#endif
@@ -99,6 +99,22 @@ public:
         });
   }
   void
+  emit_set_dsp_timing (bool dsp_timing)
+  {
+    /* while enabled, the synth publishes a DSPTimingReport twice per second */
+    send_control_event (
+      [=] (Project *project)
+        {
+          project->midi_synth()->set_dsp_timing (dsp_timing);
+        });
+  }
+  bool
+  take_dsp_timing_report (DSPTimingReport& report)
+  {
+    /* this doesn't block the synthesis thread, see MidiSynth::take_dsp_timing_report() */
+    return m_project->midi_synth()->take_dsp_timing_report (report);
+  }
+  void
   emit_add_rebuild_result (int object_id, WavSet *take_wav_set)
   {
     /* ownership of take_wav_set is transferred to the event */
@@ -288,3 +288,18 @@ WavSet::~WavSet()
 {
   clear();
 }
+
+size_t
+WavSet::mem_usage() const
+{
+  set<const Audio *>       audios;     // waves may share one Audio object (see clear())
+  set<const GMappedFile *> mapped_files;
+
+  size_t bytes = sizeof (WavSet) + waves.capacity() * sizeof (WavSetWave);
+  for (const auto& wave : waves)
+    {
+      if (wave.audio && audios.insert (wave.audio).second)
+        bytes += wave.audio->mem_usage (mapped_files);
+    }
+  return bytes;
+}
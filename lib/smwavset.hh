@@ -38,6 +38,8 @@ public:
 
   Error load (const std::string& filename, AudioLoadOptions load_options = AUDIO_LOAD_DEBUG);
   Error save (const std::string& filename, bool embed_models = false);
+
+  size_t mem_usage() const;
 };
 
 }
@@ -7,6 +7,8 @@
 #include "smaudiotool.hh"
 
 #include <mutex>
+#include <thread>
+#include <atomic>
 
 using namespace SpectMorph;
 
@@ -69,35 +71,76 @@ WavSetBuilder::killed()
   return kill_function && kill_function();
 }
 
+Audio *
+WavSetBuilder::encode_sample (const SampleData& sd)
+{
+  /* clipping */
+  const WavData& wav_data = sd.shared->wav_data();
+  assert (wav_data.n_channels() == 1);
+
+  /* if we have a loop, the loop end determines the real end of the recording */
+  int iclipend = wav_data.n_values();
+  if (sd.loop == Sample::Loop::NONE)
+    iclipend = sm_bound<int> (0, sm_round_positive (sd.clip_end_ms * wav_data.mix_freq() / 1000.0), wav_data.n_values());
+
+  int iclipstart = sm_bound<int> (0, sm_round_positive (sd.clip_start_ms * wav_data.mix_freq() / 1000.0), iclipend);
+
+  Audio *audio = InstEncCache::the()->encode (cache_group, wav_data, sd.shared->wav_data_hash(), sd.midi_note, iclipstart, iclipend, encoder_config, kill_function);
+
+  if (audio && keep_samples)
+    audio->original_samples = wav_data.samples(); // FIXME: clipping?
+
+  return audio;
+}
+
 WavSet *
 WavSetBuilder::run()
 {
-  for (auto& sd : sample_data_vec)
+  /* encode samples in parallel: each thread picks the next sample that still needs to be encoded */
+  vector<Audio *>     audios (sample_data_vec.size());
+  std::atomic<size_t> next_sample { 0 };
+
+  auto encode_samples = [&]()
     {
-      /* clipping */
-      const WavData& wav_data = sd.shared->wav_data();
-      assert (wav_data.n_channels() == 1);
+      size_t index;
+
+      while ((index = next_sample.fetch_add (1)) < sample_data_vec.size() && !killed())
+        audios[index] = encode_sample (sample_data_vec[index]);
+    };
 
-      /* if we have a loop, the loop end determines the real end of the recording */
-      int iclipend = wav_data.n_values();
-      if (sd.loop == Sample::Loop::NONE)
-        iclipend = sm_bound<int> (0, sm_round_positive (sd.clip_end_ms * wav_data.mix_freq() / 1000.0), wav_data.n_values());
+  const size_t n_threads = std::min<size_t> (max (std::thread::hardware_concurrency(), 1u), sample_data_vec.size());
 
-      int iclipstart = sm_bound<int> (0, sm_round_positive (sd.clip_start_ms * wav_data.mix_freq() / 1000.0), iclipend);
+  vector<std::thread> threads;
+  for (size_t t = 1; t < n_threads; t++)
+    threads.emplace_back (encode_samples);
 
+  encode_samples();
 
+  for (auto& thread : threads)
+    thread.join();
+
+  bool ok = true;
+  for (auto audio : audios)
+    {
+      if (!audio) // killed?
+        ok = false;
+    }
+  if (!ok)
+    {
+      for (auto audio : audios)
+        delete audio;
+
+      return nullptr;
+    }
+
+  for (size_t i = 0; i < sample_data_vec.size(); i++)
+    {
       WavSetWave new_wave;
-      new_wave.midi_note = sd.midi_note;
+      new_wave.midi_note = sample_data_vec[i].midi_note;
       new_wave.channel = 0;
       new_wave.velocity_range_min = 0;
       new_wave.velocity_range_max = 127;
-      new_wave.audio = InstEncCache::the()->encode (cache_group, wav_data, sd.shared->wav_data_hash(), sd.midi_note, iclipstart, iclipend, encoder_config, kill_function);
-
-      if (!new_wave.audio) // killed?
-        return nullptr;
-
-      if (keep_samples)
-        new_wave.audio->original_samples = wav_data.samples(); // FIXME: clipping?
+      new_wave.audio = audios[i];
 
       wav_set->waves.push_back (new_wave);
     }
@@ -40,6 +40,7 @@ class WavSetBuilder
   void apply_auto_tune();
 
   void add_sample (const Sample *sample);
+  Audio *encode_sample (const SampleData& sd);
 public:
   WavSetBuilder (const Instrument *instrument, bool keep_samples);
   ~WavSetBuilder();
@@ -2,10 +2,19 @@
 
 #include "smwavsetrepo.hh"
 #include "smmain.hh"
+#include "smdebug.hh"
+
+#include <assert.h>
+
+#include <chrono>
 
 using namespace SpectMorph;
 
 using std::string;
+using std::vector;
+using std::unique_ptr;
+
+#define REPO_DEBUG(...) Debug::debug ("wavsetrepo", __VA_ARGS__)
 
 WavSetRepo*
 WavSetRepo::the()
@@ -13,22 +22,303 @@ WavSetRepo::the()
   return Global::wav_set_repo();
 }
 
-WavSet*
-WavSetRepo::get (const string& filename)
+WavSetRepo::WavSetRepo()
+{
+  thread = std::thread (&WavSetRepo::run, this);
+}
+
+WavSetRepo::~WavSetRepo()
+{
+  std::unique_lock<std::mutex> lock (mutex);
+  thread_quit = true;
+  cond.notify_all();
+  lock.unlock();
+
+  thread.join();
+}
+
+WavSetRepo::Ref::Ref (Entry *entry) :
+  entry (entry)
+{
+  /* called with repo mutex locked, so the entry can't be evicted at the same time */
+  entry->ref_count.fetch_add (1);
+}
+
+WavSetRepo::Ref::Ref (const Ref& other)
+{
+  *this = other;
+}
+
+WavSetRepo::Ref&
+WavSetRepo::Ref::operator= (const Ref& other)
+{
+  if (other.entry == entry)
+    return *this;
+
+  /* other holds a reference, so the ref count can't be zero (the entry can't be evicted) */
+  if (other.entry)
+    other.entry->ref_count.fetch_add (1);
+
+  if (entry)
+    entry->repo->unref (entry);
+
+  entry = other.entry;
+  return *this;
+}
+
+WavSetRepo::Ref::~Ref()
+{
+  if (entry)
+    entry->repo->unref (entry);
+}
+
+WavSet *
+WavSetRepo::Ref::wav_set() const
+{
+  /* no lock necessary: entry can't be evicted while we reference it */
+  return entry ? entry->wav_set.load (std::memory_order_acquire) : nullptr;
+}
+
+void
+WavSetRepo::Ref::wait() const
+{
+  if (!entry)
+    return;
+
+  std::unique_lock<std::mutex> lock (entry->repo->mutex);
+  entry->repo->cond.wait (lock, [this] { return entry->wav_set.load() != nullptr; });
+}
+
+void
+WavSetRepo::unref (Entry *entry)
+{
+  /* this may run in the audio thread, so we only update the LRU state here (without
+   * locking the mutex); if the loader thread waits for entries that can be evicted,
+   * releasing the last reference wakes it up
+   *
+   * after the last reference is released, the loader thread may delete the entry at
+   * any time, so we must not access it after decrementing the ref count
+   */
+  entry->last_use.store (++use_counter);
+
+  const int old_ref_count = entry->ref_count.fetch_sub (1);
+  assert (old_ref_count > 0);
+
+  if (old_ref_count == 1)
+    {
+      n_released.fetch_add (1);
+      if (evict_waiting.load())
+        cond.notify_all();
+    }
+}
+
+WavSetRepo::Ref
+WavSetRepo::load_async (const string& filename)
 {
   std::lock_guard<std::mutex> lock (mutex);
 
-  WavSet*& wav_set = wav_set_map[filename];
-  if (!wav_set)
+  unique_ptr<Entry>& entry = entries[filename];
+  if (!entry)
     {
-      wav_set = new WavSet();
-      wav_set->load (filename, AUDIO_SKIP_DEBUG);
+      entry.reset (new Entry());
+      entry->repo = this;
+      entry->filename = filename;
+
+      load_queue.push_back (entry.get());
+      cond.notify_all();
     }
-  return wav_set;
+  entry->last_use = ++use_counter;
+
+  return Ref (entry.get());
 }
 
-WavSetRepo::~WavSetRepo()
+WavSet *
+WavSetRepo::get (const string& filename, Ref& ref)
+{
+  ref = load_async (filename);
+  ref.wait();
+
+  return ref.wav_set();
+}
+
+WavSet *
+WavSetRepo::try_get (const string& filename, Ref& ref)
+{
+  ref = load_async (filename);
+
+  return ref.wav_set();
+}
+
+void
+WavSetRepo::wait_for_loads()
 {
-  for (auto w : wav_set_map)
-    delete w.second;
+  std::unique_lock<std::mutex> lock (mutex);
+
+  cond.wait (lock, [this] {
+    for (auto& it : entries)
+      if (!it.second->wav_set.load())
+        return false;
+    return true;
+  });
+}
+
+void
+WavSetRepo::set_memory_budget (size_t bytes)
+{
+  std::lock_guard<std::mutex> lock (mutex);
+
+  memory_budget = bytes;
+  cond.notify_all();
+}
+
+bool
+WavSetRepo::need_eviction_L()
+{
+  return memory_budget && resident_bytes > memory_budget;
+}
+
+void
+WavSetRepo::evict_L (vector<unique_ptr<WavSet>>& evicted)
+{
+  while (need_eviction_L())
+    {
+      /* find least recently used entry that is not referenced */
+      Entry *lru_entry = nullptr;
+      for (auto& it : entries)
+        {
+          Entry *entry = it.second.get();
+
+          if (entry->ref_count == 0 && entry->wav_set.load() && (!lru_entry || entry->last_use < lru_entry->last_use))
+            lru_entry = entry;
+        }
+      if (!lru_entry)
+        return;
+
+      REPO_DEBUG ("evict %s (%.2f MB)\n", lru_entry->filename.c_str(), lru_entry->bytes / 1048576.);
+
+      resident_bytes -= lru_entry->bytes;
+      n_evictions++;
+
+      /* delete WavSet outside the lock */
+      evicted.push_back (std::move (lru_entry->wav_set_storage));
+      const string filename = lru_entry->filename;
+      entries.erase (filename);
+    }
+}
+
+void
+WavSetRepo::run()
+{
+  std::unique_lock<std::mutex> lock (mutex);
+
+  while (!thread_quit)
+    {
+      if (!load_queue.empty())
+        {
+          Entry *entry = load_queue.front();
+          load_queue.erase (load_queue.begin());
+
+          /* entry can't be removed from the map while it is loading (wav_set is nullptr) */
+          const string filename = entry->filename;
+          lock.unlock();
+
+          const double start_time = get_time();
+          unique_ptr<WavSet> wav_set (new WavSet());
+          wav_set->load (filename, AUDIO_MMAP); // on error, we keep the empty WavSet, so that we don't retry
+          const size_t bytes = wav_set->mem_usage();
+          const double load_time = get_time() - start_time;
+
+          REPO_DEBUG ("load %s: %.2f ms, %.2f MB\n", filename.c_str(), load_time * 1000, bytes / 1048576.);
+
+          lock.lock();
+          entry->bytes = bytes;
+          entry->load_time = load_time;
+          entry->wav_set_storage = std::move (wav_set);
+          entry->wav_set.store (entry->wav_set_storage.get(), std::memory_order_release);
+
+          resident_bytes += bytes;
+          total_load_time += load_time;
+          n_loads++;
+
+          cond.notify_all();
+        }
+      else if (need_eviction_L())
+        {
+          vector<unique_ptr<WavSet>> evicted;
+          evict_L (evicted);
+
+          lock.unlock();
+          evicted.clear();
+          lock.lock();
+
+          /* nothing left to evict: wait until the last reference of an entry is released
+           *
+           * unref() notifies without locking the mutex (it may run in the audio thread),
+           * so in rare cases the notification can get lost; the timeout handles this
+           */
+          if (load_queue.empty() && !thread_quit)
+            {
+              const uint64 released = n_released.load();
+
+              evict_waiting.store (true);
+              cond.wait_for (lock, std::chrono::seconds (1), [&] {
+                return n_released.load() != released || !load_queue.empty() || !need_eviction_L() || thread_quit;
+              });
+              evict_waiting.store (false);
+            }
+        }
+      else
+        {
+          cond.wait (lock);
+        }
+    }
+  /* thread quit: free everything */
+  entries.clear();
+}
+
+WavSetRepo::Stats
+WavSetRepo::stats()
+{
+  std::lock_guard<std::mutex> lock (mutex);
+
+  Stats stats;
+  stats.resident_bytes  = resident_bytes;
+  stats.memory_budget   = memory_budget;
+  stats.n_entries       = entries.size();
+  stats.n_loads         = n_loads;
+  stats.n_evictions     = n_evictions;
+  stats.total_load_time = total_load_time;
+
+  for (auto& it : entries)
+    {
+      const Entry *entry = it.second.get();
+
+      if (entry->ref_count)
+        stats.n_referenced++;
+      if (!entry->wav_set.load())
+        stats.n_loading++;
+    }
+  return stats;
+}
+
+vector<WavSetRepo::EntryInfo>
+WavSetRepo::entry_info()
+{
+  std::lock_guard<std::mutex> lock (mutex);
+
+  vector<EntryInfo> result;
+  for (auto& it : entries)
+    {
+      const Entry *entry = it.second.get();
+
+      EntryInfo info;
+      info.filename  = entry->filename;
+      info.loaded    = entry->wav_set.load() != nullptr;
+      info.ref_count = entry->ref_count;
+      info.bytes     = entry->bytes;
+      info.load_time = entry->load_time;
+
+      result.push_back (info);
+    }
+  return result;
 }
@@ -6,19 +6,118 @@
 #include "smwavset.hh"
 
 #include <mutex>
+#include <thread>
+#include <condition_variable>
+#include <memory>
+#include <atomic>
 
 #include <map>
 
 namespace SpectMorph
 {
 
+/*
+ * WavSetRepo loads WavSets in a background thread; a Ref is returned immediately,
+ * and Ref::wav_set() returns nullptr until the WavSet is loaded (so that audio
+ * thread code can simply skip the source while it is not available).
+ *
+ * Each entry is reference counted; WavSets that are no longer referenced stay in
+ * memory until the memory budget is exceeded, and are evicted in LRU order then.
+ *
+ * Copying and releasing a Ref only uses atomics (never the repo mutex), so this can
+ * be done in the audio thread. Eviction is always done by the loader thread, which
+ * is woken up when the last reference to an entry is released.
+ */
 class WavSetRepo {
-  std::mutex mutex;
-  std::map<std::string, WavSet *> wav_set_map;
+  struct Entry
+  {
+    WavSetRepo             *repo = nullptr;
+    std::string             filename;
+    std::unique_ptr<WavSet> wav_set_storage;
+    std::atomic<WavSet *>   wav_set { nullptr }; // set once loading is done
+    std::atomic<int>        ref_count { 0 };     // only incremented from zero with repo mutex locked
+    std::atomic<uint64>     last_use { 0 };      // for LRU eviction
+    size_t                  bytes = 0;
+    double                  load_time = 0;
+  };
+  std::mutex                mutex;
+  std::condition_variable   cond;
+  std::thread               thread;
+  bool                      thread_quit = false;
+
+  std::map<std::string, std::unique_ptr<Entry>> entries;
+  std::vector<Entry *>      load_queue;
+  std::atomic<uint64>       use_counter { 0 };
+  std::atomic<uint64>       n_released { 0 };      // number of entries whose last reference was released
+  std::atomic<bool>         evict_waiting { false }; // loader thread waits for n_released to change
+  size_t                    memory_budget = 0;
+  size_t                    resident_bytes = 0;
+  uint64                    n_loads = 0;
+  uint64                    n_evictions = 0;
+  double                    total_load_time = 0;
+
+  void unref (Entry *entry);
+  bool need_eviction_L();
+  void evict_L (std::vector<std::unique_ptr<WavSet>>& evicted);
+  void run();
 public:
+  class Ref
+  {
+    Entry *entry = nullptr;
+
+    friend class WavSetRepo;
+    explicit Ref (Entry *entry);
+  public:
+    Ref() = default;
+    Ref (const Ref& other);
+    Ref& operator= (const Ref& other);
+    ~Ref();
+
+    WavSet *wav_set() const;   // nullptr if not loaded (yet)
+    void    wait() const;      // block until loaded
+
+    bool
+    operator== (const Ref& other) const
+    {
+      return entry == other.entry;
+    }
+    bool
+    operator!= (const Ref& other) const
+    {
+      return entry != other.entry;
+    }
+  };
+  struct Stats
+  {
+    size_t resident_bytes = 0;   // memory used by all loaded WavSets
+    size_t memory_budget = 0;
+    size_t n_entries = 0;
+    size_t n_referenced = 0;
+    size_t n_loading = 0;
+    uint64 n_loads = 0;
+    uint64 n_evictions = 0;
+    double total_load_time = 0;  // seconds
+  };
+  struct EntryInfo
+  {
+    std::string filename;
+    bool        loaded = false;
+    int         ref_count = 0;
+    size_t      bytes = 0;
+    double      load_time = 0;   // seconds
+  };
+  WavSetRepo();
   ~WavSetRepo();
 
-  WavSet *get (const std::string& filename);
+  Ref     load_async (const std::string& filename);
+  WavSet *get (const std::string& filename, Ref& ref);      // blocks until loaded
+  WavSet *try_get (const std::string& filename, Ref& ref);  // nullptr if not loaded (yet), never blocks
+
+  void    set_memory_budget (size_t bytes);  // 0: no limit
+  void    wait_for_loads();
+
+  Stats                  stats();
+  std::vector<EntryInfo> entry_info();
 
   static WavSetRepo *the(); // Singleton
 };
@@ -1,6 +1,7 @@
 // SpectMorph meta-include (generated by cd lib; make rebuild-spectmorph-hh)
 #include "smadsrenvelope.hh"
 #include "smalignedarray.hh"
+#include "smarenavector.hh"
 #include "smaudio.hh"
 #include "smaudiotool.hh"
 #include "smbinbuffer.hh"
@@ -8,6 +9,7 @@
 #include "smbuilderthread.hh"
 #include "smconfig.hh"
 #include "smdebug.hh"
+#include "smdsptimer.hh"
 #include "smeffectdecoder.hh"
 #include "smencoder.hh"
 #include "smfft.hh"
@@ -29,6 +31,7 @@
 #include "smmath.hh"
 #include "smmemout.hh"
 #include "smmicroconf.hh"
+#include "smmidifile.hh"
 #include "smmidisynth.hh"
 #include "smminiresampler.hh"
 #include "smmmapin.hh"
@@ -59,8 +62,11 @@
 #include "smproject.hh"
 #include "smproperty.hh"
 #include "smrandom.hh"
+#include "smringbuffer.hh"
+#include "smrtthreadpool.hh"
 #include "smsignal.hh"
 #include "smsinedecoder.hh"
+#include "smspscqueue.hh"
 #include "smstdioin.hh"
 #include "smstdioout.hh"
 #include "smstdiosubin.hh"
@@ -79,6 +79,8 @@ struct Options
   bool          loop_unit_seconds;
   string        debug_decode_filename;
   string        config_filename;
+  int           n_threads;
+  bool          streaming;
 
   Options ();
   void parse (int *argc_p, char **argv_p[]);
@@ -103,6 +105,8 @@ Options::Options ()
   loop_end = -1;
   loop_type = Audio::LOOP_NONE;
   loop_unit_seconds = false;
+  n_threads = 1;
+  streaming = false;
 }
 
 void
@@ -216,6 +220,14 @@ Options::parse (int   *argc_p,
         {
           config_filename = opt_arg;
         }
+      else if (check_arg (argc, argv, &i, "-j", &opt_arg) || check_arg (argc, argv, &i, "--threads", &opt_arg))
+        {
+          n_threads = atoi (opt_arg);
+        }
+      else if (check_arg (argc, argv, &i, "--streaming"))
+        {
+          streaming = true;
+        }
      }
 
   /* resort argc/argv */
@@ -250,6 +262,8 @@ Options::print_usage ()
   sm_printf (" -d                          dump encoder debug information\n");
   sm_printf (" --text-input-file <rate>    set input file format to human readable text values\n");
   sm_printf (" --config <config>           set additional parameters for analysis\n");
+  sm_printf (" -j, --threads <n>           analyze frames using <n> threads (0: one per cpu core)\n");
+  sm_printf (" --streaming                 analyze frames in small chunks to reduce memory usage\n");
   sm_printf ("\n");
 }
 
@@ -387,47 +401,18 @@ main (int argc, char **argv)
           exit (1);
         }
     }
-  /* use defaults, but customize window */
+  /* use defaults */
   enc_params.setup_params (wav_data, options.fundamental_freq);
+  enc_params.n_threads = options.n_threads;
+  enc_params.streaming = options.streaming;
+  enc_params.keep_debug_data = !options.strip_models;
 
-  /* compute encoder window */
-  vector<float> window (enc_params.block_size);
-
-  string window_type;
-  if (!enc_params.get_param ("window", window_type))
-    window_type = "hann";
-
-  for (uint i = 0; i < window.size(); i++)
+  /* customize window */
+  if (!enc_params.setup_window())
     {
-      const uint frame_size = enc_params.frame_size;
-
-      if (i < frame_size)
-        {
-          if (window_type == "hann")
-            {
-              window[i] = window_cos (2.0 * i / (frame_size - 1) - 1.0);
-            }
-          else if (window_type == "hamming")
-            {
-              /* probably never a good idea, since the sidelobes of the spectrum
-               * do not roll off fast (as with the hann window)
-               */
-              window[i] = window_hamming (2.0 * i / (frame_size - 1) - 1.0);
-            }
-          else if (window_type == "blackman")
-            {
-              window[i] = window_blackman (2.0 * i / (frame_size - 1) - 1.0);
-            }
-          else
-            {
-              fprintf (stderr, "%s: unsupported window type in config.\n", options.program_name.c_str());
-              exit (1);
-            }
-        }
-      else
-        window[i] = 0;
+      fprintf (stderr, "%s: unsupported window type in config.\n", options.program_name.c_str());
+      exit (1);
     }
-  enc_params.window = window;
 
   int n_channels = wav_data.n_channels();
 
@@ -133,7 +133,7 @@ load_or_die (Audio& audio, const string& filename, const string& mode)
 }
 
 static bool
-find_nan (vector<float>& data)
+find_nan (const ArenaVector<float>& data)
 {
   for (size_t x = 0; x < data.size(); x++)
     if (std::isnan (data[x]))
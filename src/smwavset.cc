@@ -16,9 +16,13 @@
 #include "smwavdata.hh"
 #include "sminstrument.hh"
 #include "smwavsetbuilder.hh"
+#include "smencoder.hh"
 
 #include <string>
 #include <map>
+#include <thread>
+#include <atomic>
+#include <mutex>
 
 using std::string;
 using std::vector;
@@ -59,6 +63,7 @@ struct Options
   int             max_velocity;
   vector<string>  format;
   int             max_jobs;
+  bool            use_smenc = false;
   bool            loop_markers = false;
   bool            loop_markers_ms = false;
   enum { NONE, INIT, ADD, LIST, ENCODE, DECODE, DELTA, LINK, EXTRACT, GET_MARKERS, SET_MARKERS, SET_NAMES, GET_NAMES, BUILD } command;
@@ -122,6 +127,7 @@ Options::parse (int   *argc_p,
       else if (check_arg (argc, argv, &i, "--smenc", &opt_arg))
         {
           smenc = opt_arg;
+          use_smenc = true;
         }
       else if (check_arg (argc, argv, &i, "-d", &opt_arg) ||
                check_arg (argc, argv, &i, "--data-dir", &opt_arg))
@@ -265,8 +271,8 @@ Options::print_usage ()
   sm_printf (" -d, --data-dir <dir>        set data directory for newly created .sm or .wav files\n");
   sm_printf (" -c, --channel <ch>          set channel for added .sm file\n");
   sm_printf (" --format <f1>,...,<fN>      set fields to display in list\n");
-  sm_printf (" -j <jobs>                   run <jobs> commands simultaneously (use multiple cpus for encoding)\n");
-  sm_printf (" --smenc <cmd>               use <cmd> as smenc command\n");
+  sm_printf (" -j <jobs>                   encode <jobs> files simultaneously (use multiple cpus for encoding)\n");
+  sm_printf (" --smenc <cmd>               run <cmd> as smenc command for encoding (instead of encoding in-process)\n");
   sm_printf (" --loop                      also extract loop markers (for smwavset get-markers)\n");
   sm_printf ("\n");
 }
@@ -321,6 +327,133 @@ load_wav_file (const string& filename, vector<float>& data_out)
   return true;
 }
 
+/* smenc options that are supported for in-process encoding */
+struct EncodeArgs
+{
+  int    optimization_level = 0;
+  bool   strip_models = false;
+  bool   keep_samples = false;
+  bool   attack = true;
+  bool   track_sines = true;
+  string config_filename;
+};
+
+static bool
+parse_encode_args (const string& args, EncodeArgs& enc_args)
+{
+  int     argc = 0;
+  char  **argv = nullptr;
+
+  if (args.empty())
+    return true;
+
+  if (!g_shell_parse_argv (args.c_str(), &argc, &argv, nullptr))
+    {
+      fprintf (stderr, "%s: can't parse encoder args '%s'\n", options.program_name.c_str(), args.c_str());
+      return false;
+    }
+
+  bool ok = true;
+  for (int i = 0; i < argc && ok; i++)
+    {
+      string arg = argv[i];
+
+      if (arg == "-O0" || arg == "-O1" || arg == "-O2")
+        {
+          enc_args.optimization_level = arg[2] - '0';
+        }
+      else if (arg == "-O" && i + 1 < argc)
+        {
+          enc_args.optimization_level = atoi (argv[++i]);
+        }
+      else if (arg == "-s")
+        {
+          enc_args.strip_models = true;
+        }
+      else if (arg == "--keep-samples")
+        {
+          enc_args.keep_samples = true;
+        }
+      else if (arg == "--no-attack")
+        {
+          enc_args.attack = false;
+        }
+      else if (arg == "--no-sines")
+        {
+          enc_args.track_sines = false;
+        }
+      else if (arg == "--config" && i + 1 < argc)
+        {
+          enc_args.config_filename = argv[++i];
+        }
+      else
+        {
+          fprintf (stderr, "%s: encoder arg '%s' not supported for in-process encoding (use --smenc smenc)\n",
+                   options.program_name.c_str(), arg.c_str());
+          ok = false;
+        }
+    }
+  g_strfreev (argv);
+  return ok;
+}
+
+/* encode one wave (like smenc -m <midi_note> <path> <smpath> <args>) */
+static bool
+encode_wave (const WavSetWave& wave, const string& smpath, const EncodeArgs& enc_args)
+{
+  EncoderParams enc_params;
+
+  if (enc_args.config_filename != "")
+    {
+      if (!enc_params.load_config (enc_args.config_filename))
+        {
+          fprintf (stderr, "%s: can't open config file '%s'\n", options.program_name.c_str(), enc_args.config_filename.c_str());
+          return false;
+        }
+    }
+
+  WavData wav_data;
+  if (!wav_data.load (wave.path))
+    {
+      fprintf (stderr, "%s: can't open the input file %s: %s\n", options.program_name.c_str(), wave.path.c_str(), wav_data.error_blurb());
+      return false;
+    }
+  if (wav_data.n_channels() != 1)
+    {
+      fprintf (stderr, "%s: input file '%s' has more than one channel\n", options.program_name.c_str(), wave.path.c_str());
+      return false;
+    }
+
+  const float fundamental_freq = 440 * exp (log (2) * (wave.midi_note - 69) / 12.0); /* float: same value as smenc -m */
+
+  enc_params.setup_params (wav_data, fundamental_freq);
+  if (!enc_params.setup_window())
+    {
+      fprintf (stderr, "%s: unsupported window type in config.\n", options.program_name.c_str());
+      return false;
+    }
+
+  Encoder encoder (enc_params);
+  encoder.encode (wav_data, /* channel */ 0, enc_args.optimization_level, enc_args.attack, enc_args.track_sines);
+  if (enc_args.strip_models)
+    {
+      for (auto& block : encoder.audio_blocks)
+        {
+          block.debug_samples.clear();
+          block.original_fft.clear();
+        }
+      if (!enc_args.keep_samples)
+        encoder.original_samples.clear();
+    }
+  Error error = encoder.save (smpath);
+  if (error)
+    {
+      fprintf (stderr, "%s: can't write %s: %s\n", options.program_name.c_str(), smpath.c_str(), error.message());
+      return false;
+    }
+  return true;
+}
+
 double
 delta (vector<float>& d0, vector<float>& d1)
 {
@@ -438,20 +571,63 @@ main (int argc, char **argv)
       WavSet wset, smset;
       load_or_die (wset, argv[1]);
 
-      JobQueue job_queue (options.max_jobs);
-
+      vector<string> smpaths;
       for (vector<WavSetWave>::iterator wi = wset.waves.begin(); wi != wset.waves.end(); wi++)
         {
           string smpath = options.data_dir + "/" + int2str (wi->midi_note) + ".sm";
-          string cmd = options.smenc + " -m " + int2str (wi->midi_note) + " \"" + wi->path.c_str() + "\" " + smpath + " " + options.args;
-          sm_printf ("[%s] ## %s\n", time2str (get_time() - start_time).c_str(), cmd.c_str());
-          job_queue.run (cmd);
+          smpaths.push_back (smpath);
 
           WavSetWave new_wave = *wi;
           new_wave.path = smpath;
           smset.waves.push_back (new_wave);
         }
-      if (!job_queue.wait_for_all())
+      std::atomic<bool> encode_ok { true };
+      if (options.use_smenc)
+        {
+          JobQueue job_queue (options.max_jobs);
+
+          for (size_t i = 0; i < wset.waves.size(); i++)
+            {
+              string cmd = options.smenc + " -m " + int2str (wset.waves[i].midi_note) + " \"" + wset.waves[i].path.c_str() + "\" " + smpaths[i] + " " + options.args;
+              sm_printf ("[%s] ## %s\n", time2str (get_time() - start_time).c_str(), cmd.c_str());
+              job_queue.run (cmd);
+            }
+          encode_ok = job_queue.wait_for_all();
+        }
+      else
+        {
+          EncodeArgs enc_args;
+          if (!parse_encode_args (options.args, enc_args))
+            exit (1);
+
+          /* encode in-process, using max_jobs threads */
+          std::atomic<size_t> next_wave { 0 };
+          std::mutex          print_mutex;
+
+          auto encode_waves = [&]()
+            {
+              size_t i;
+              while ((i = next_wave.fetch_add (1)) < wset.waves.size())
+                {
+                  print_mutex.lock();
+                  sm_printf ("[%s] ## encode %d \"%s\" %s\n", time2str (get_time() - start_time).c_str(),
+                             wset.waves[i].midi_note, wset.waves[i].path.c_str(), smpaths[i].c_str());
+                  print_mutex.unlock();
+
+                  if (!encode_wave (wset.waves[i], smpaths[i], enc_args))
+                    encode_ok = false;
+                }
+            };
+          vector<std::thread> threads;
+          for (int t = 1; t < options.max_jobs; t++)
+            threads.emplace_back (encode_waves);
+
+          encode_waves();
+
+          for (auto& thread : threads)
+            thread.join();
+        }
+      if (!encode_ok)
         {
           g_printerr ("smwavset: encoding commands did not complete successfully\n");
           exit (1);
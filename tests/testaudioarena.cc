@@ -0,0 +1,203 @@
+// Licensed GNU LGPL v2.1 or later: http://www.gnu.org/licenses/lgpl-2.1.html
+
+#include "smaudio.hh"
+#include "smmain.hh"
+#include "smmemout.hh"
+#include "smmmapin.hh"
+#include "smrandom.hh"
+
+#include <stdio.h>
+#include <assert.h>
+#include <unistd.h>
+
+using namespace SpectMorph;
+
+using std::vector;
+
+static void
+fill_random (Random& random, ArenaVector<uint16_t>& v, size_t n)
+{
+  for (size_t i = 0; i < n; i++)
+    v.push_back (random.random_uint32() & 0xffff);
+}
+
+static void
+fill_random (Random& random, ArenaVector<float>& v, size_t n)
+{
+  for (size_t i = 0; i < n; i++)
+    v.push_back (random.random_double_range (-1, 1));
+}
+
+template<class T> static bool
+eq (const ArenaVector<T>& x, const ArenaVector<T>& y)
+{
+  return x.size() == y.size() && std::equal (x.begin(), x.end(), y.begin());
+}
+
+static bool
+blocks_equal (const AudioBlock& a, const AudioBlock& b)
+{
+  return eq (a.noise, b.noise) && eq (a.freqs, b.freqs) && eq (a.mags, b.mags) && eq (a.phases, b.phases) &&
+         eq (a.original_fft, b.original_fft) && eq (a.debug_samples, b.debug_samples);
+}
+
+static void
+check_equal (const Audio& a, const Audio& b)
+{
+  assert (a.contents.size() == b.contents.size());
+  for (size_t f = 0; f < a.contents.size(); f++)
+    assert (blocks_equal (a.contents[f], b.contents[f]));
+}
+
+int
+main (int argc, char **argv)
+{
+  Main main (&argc, &argv);
+
+  Random random;
+  random.set_seed (42);
+
+  Audio audio;
+  audio.mix_freq = 48000;
+  audio.frame_size_ms = 40;
+  audio.frame_step_ms = 10;
+  for (int f = 0; f < 200; f++)
+    {
+      AudioBlock block;
+
+      const size_t n_partials = random.random_uint32() % 50;
+      fill_random (random, block.noise, 32);
+      for (size_t p = 0; p < n_partials; p++)
+        block.freqs.push_back (p * 100 + random.random_uint32() % 100); // sorted
+      fill_random (random, block.mags, n_partials);
+      fill_random (random, block.phases, n_partials);
+      if (f % 2)
+        {
+          fill_random (random, block.original_fft, 64);
+          fill_random (random, block.debug_samples, 32);
+        }
+      audio.contents.push_back (block);
+    }
+
+  /* save / load: loaded blocks are views of the arena */
+  vector<unsigned char> audio_data;
+  MemOut                audio_mo (&audio_data);
+  audio.save (&audio_mo);
+
+  Audio loaded;
+  GenericIn *in = MMapIn::open_mem (&audio_data[0], &audio_data[audio_data.size()]);
+  Error error = loaded.load (in);
+  delete in;
+
+  assert (!error);
+  check_equal (audio, loaded);
+  for (const auto& block : loaded.contents)
+    assert (block.noise.is_view());
+  printf ("load: ok\n");
+
+  /* clone */
+  Audio *clone = loaded.clone();
+  check_equal (audio, *clone);
+  for (const auto& block : clone->contents)
+    assert (block.noise.is_view());
+  delete clone;
+  printf ("clone: ok\n");
+
+  /* growing a block must not affect the data of the next block in the arena */
+  AudioBlock& block = loaded.contents[10];
+  block.freqs.push_back (65535);
+  block.mags.push_back (1);
+  block.phases.push_back (2);
+  block.noise.resize (64);
+  assert (!block.noise.is_view());
+  assert (blocks_equal (audio.contents[11], loaded.contents[11]));
+  assert (block.freqs.size() == audio.contents[10].freqs.size() + 1);
+  assert (std::equal (audio.contents[10].mags.begin(), audio.contents[10].mags.end(), block.mags.begin()));
+  assert (block.noise[32] == 0 && block.noise[63] == 0);
+
+  /* copying a view creates a block that owns its data */
+  AudioBlock copy = loaded.contents[12];
+  assert (!copy.noise.is_view());
+  copy.noise[0]++;
+  assert (copy.noise[0] != loaded.contents[12].noise[0]);
+
+  /* modifying values of a view modifies the arena */
+  loaded.contents[13].mags[0] = 4242;
+  Audio *clone2 = loaded.clone();
+  assert (clone2->contents[13].mags[0] == 4242);
+  delete clone2;
+
+  loaded.contents[14].freqs.clear();
+  assert (loaded.contents[14].freqs.empty());
+  assert (blocks_equal (audio.contents[15], loaded.contents[15]));
+
+  /* shrinking a view creates a block that owns its data, and leaves the arena alone */
+  AudioBlock& shrink_block = loaded.contents[17];
+  shrink_block.noise.resize (8);
+  assert (!shrink_block.noise.is_view() && shrink_block.noise.size() == 8);
+  assert (std::equal (shrink_block.noise.begin(), shrink_block.noise.end(), audio.contents[17].noise.begin()));
+  shrink_block.debug_samples.reserve (4);
+  assert (!shrink_block.debug_samples.is_view());
+  assert (eq (shrink_block.debug_samples, audio.contents[17].debug_samples));
+  assert (blocks_equal (audio.contents[18], loaded.contents[18]));
+  printf ("modify: ok\n");
+
+  /* load from memory mapped file: aligned blocks point into the file, which needs to stay mapped */
+  const char *sm_file = "testaudioarena.tmp.sm";
+  for (auto& block : audio.contents)
+    {
+      block.original_fft.clear();
+      block.debug_samples.clear();
+    }
+  audio.save (sm_file);
+
+  Audio *mapped = new Audio();
+  error = mapped->load (sm_file, AUDIO_MMAP);
+  assert (!error);
+  unlink (sm_file);
+
+  check_equal (audio, *mapped);
+
+  for (const auto& block : mapped->contents)
+    assert (block.noise.is_view());
+
+  /* the mapped file is read-only: modifying a block needs an explicit copy */
+  size_t n_read_only = 0;
+  const uint64_t copies = arena_vector_copies();
+  for (size_t b = 0; b < mapped->contents.size(); b++)
+    {
+      AudioBlock&       mapped_block = mapped->contents[b];
+      const AudioBlock& block = audio.contents[b];
+
+      if (mapped_block.noise.is_read_only())
+        {
+          mapped_block.noise.make_writable();
+          mapped_block.noise[0] = block.noise[0] + 1;
+          assert (!mapped_block.noise.is_view() && !mapped_block.noise.is_read_only());
+          assert (mapped_block.noise.size() == block.noise.size());
+          assert (mapped_block.noise[0] == block.noise[0] + 1);
+          for (size_t i = 1; i < mapped_block.noise.size(); i++)
+            assert (mapped_block.noise[i] == block.noise[i]);
+          n_read_only++;
+        }
+      if (mapped_block.freqs.is_read_only())
+        {
+          mapped_block.freqs.make_writable();
+          for (auto& freq : mapped_block.freqs)
+            freq = 0;
+          assert (!mapped_block.freqs.is_view());
+          assert (mapped_block.freqs.size() == block.freqs.size());
+          n_read_only++;
+        }
+      mapped_block = block;
+    }
+  assert (n_read_only > 0);
+  assert (arena_vector_copies() == copies + n_read_only);
+
+  /* the clone must not reference the mapped file */
+  Audio *mapped_clone = mapped->clone();
+  delete mapped;
+  check_equal (audio, *mapped_clone);
+  delete mapped_clone;
+  printf ("mmap: ok\n");
+}
@@ -0,0 +1,158 @@
+// Licensed GNU LGPL v2.1 or later: http://www.gnu.org/licenses/lgpl-2.1.html
+
+#include "smproject.hh"
+#include "smsynthinterface.hh"
+#include "smmidisynth.hh"
+#include "smmorphoutput.hh"
+#include "smmain.hh"
+
+#include <stdio.h>
+#include <assert.h>
+#include <unistd.h>
+
+#include <thread>
+
+using namespace SpectMorph;
+
+using std::vector;
+
+/* stress test for the control event queue: send lots of events (and plan updates)
+ * from the ui thread while the synthesis thread is rendering
+ */
+static std::atomic<bool> quit;
+static std::atomic<bool> pause_rendering;
+static std::atomic<int>  n_blocks;
+
+static void
+render_thread (Project *project)
+{
+  vector<float> samples (256);
+  int block = 0;
+
+  while (!quit)
+    {
+      if (pause_rendering)
+        {
+          usleep (500);
+          continue;
+        }
+      project->try_update_synth();
+
+      MidiSynth *midi_synth = project->midi_synth();
+      if (block % 50 == 0)
+        {
+          unsigned char note_on[3] = { 0x90, uint8_t (60 + block / 50 % 12), 100 };
+          midi_synth->add_midi_event (0, note_on);
+        }
+      midi_synth->process (samples.data(), samples.size());
+
+      block++;
+      n_blocks++;
+    }
+}
+
+struct EventData
+{
+  std::thread::id          main_thread;
+  static std::atomic<int>  n_deleted;
+
+  ~EventData()
+  {
+    /* data of events must never be freed by the synthesis thread */
+    assert (std::this_thread::get_id() == main_thread);
+    n_deleted++;
+  }
+};
+std::atomic<int> EventData::n_deleted;
+
+static int n_sent = 0;
+static int n_run = 0;
+
+static void
+send_event (Project& project)
+{
+  EventData *data = new EventData();
+  data->main_thread = std::this_thread::get_id();
+
+  const int id = n_sent++;
+  project.synth_interface()->send_control_event (
+    [id] (Project *project)
+      {
+        /* events must arrive in order */
+        assert (id == n_run);
+        n_run++;
+      },
+    data);
+}
+
+static void
+wait_for_events (Project& project)
+{
+  while (EventData::n_deleted < n_sent)
+    {
+      project.voices_active(); // collects garbage
+      usleep (1000);
+    }
+  assert (n_run == n_sent);
+}
+
+int
+main (int argc, char **argv)
+{
+  Main main (&argc, &argv);
+
+  Project project;
+  project.set_mix_freq (48000);
+
+  MorphPlanPtr plan = project.morph_plan();
+
+  MorphOperator *output_op = nullptr;
+  for (auto op : plan->operators())
+    {
+      if (op->type_name() == "Output")
+        output_op = op;
+    }
+  if (!output_op) /* default plan not installed */
+    {
+      output_op = MorphOperator::create ("SpectMorph::MorphOutput", plan.c_ptr());
+      plan->add_operator (output_op);
+    }
+  Property *property = output_op->property (MorphOutput::P_VELOCITY_SENSITIVITY);
+
+  /* first plan change: runs the preload synth in this thread (which initializes global tables) */
+  property->set_float (24);
+
+  std::thread thread (render_thread, &project);
+
+  /* updates while rendering */
+  const double start = get_time();
+  for (int i = 0; i < 20000; i++)
+    {
+      send_event (project);
+      if (i % 10 == 0)
+        property->set_float (i % 20 ? 12 : 24); // plan update
+      if (i % 100 == 0)
+        project.set_volume (i % 200 ? -6 : -12);
+      if (i % 20 == 0)
+        usleep (500);
+    }
+  wait_for_events (project);
+  printf ("%d events, %d blocks rendered, %.2f s: ok\n", n_sent, n_blocks.load(), get_time() - start);
+
+  /* more events than the queue can hold while the synthesis thread is not running */
+  pause_rendering = true;
+  for (int i = 0; i < 10000; i++)
+    send_event (project);
+
+  pause_rendering = false;
+  for (int i = 0; i < 100; i++)
+    {
+      send_event (project);
+      usleep (100);
+    }
+  wait_for_events (project);
+  printf ("%d events, queue overflow: ok\n", n_sent);
+
+  quit = true;
+  thread.join();
+}
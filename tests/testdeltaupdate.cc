@@ -0,0 +1,185 @@
+// Licensed GNU LGPL v2.1 or later: http://www.gnu.org/licenses/lgpl-2.1.html
+
+#include "smmidisynth.hh"
+#include "smmain.hh"
+#include "smproject.hh"
+#include "smsynthinterface.hh"
+#include "smmorphoutput.hh"
+#include "smmorphlinear.hh"
+#include "smmorphgrid.hh"
+#include "smmorphwavsource.hh"
+
+#include "testwavset.hh"
+
+#include <assert.h>
+
+using namespace SpectMorph;
+
+using std::vector;
+
+struct TestPlan
+{
+  MorphPlanPtr plan;
+  MorphLinear *linear = nullptr;
+  MorphOutput *output = nullptr;
+};
+
+/* two sources, morphed by a linear morph operator, output with filter */
+static TestPlan
+build_plan (Project& project)
+{
+  TestPlan test_plan;
+  test_plan.plan = new MorphPlan (project);
+
+  MorphPlanPtr plan = test_plan.plan;
+  MorphWavSource *source[2];
+  for (int s = 0; s < 2; s++)
+    {
+      source[s] = static_cast<MorphWavSource *> (MorphOperator::create ("SpectMorph::MorphWavSource", plan.c_ptr()));
+      source[s]->set_object_id (s + 1);
+      plan->add_operator (source[s]);
+
+      project.add_rebuild_result (s + 1, make_test_wav_set (s ? 2 : 1, s + 1));
+    }
+  test_plan.linear = static_cast<MorphLinear *> (MorphOperator::create ("SpectMorph::MorphLinear", plan.c_ptr()));
+  test_plan.linear->set_left_op (source[0]);
+  test_plan.linear->set_right_op (source[1]);
+  plan->add_operator (test_plan.linear);
+
+  test_plan.output = static_cast<MorphOutput *> (MorphOperator::create ("SpectMorph::MorphOutput", plan.c_ptr()));
+  test_plan.output->set_channel_op (0, test_plan.linear);
+  test_plan.output->property (MorphOutput::P_FILTER)->set_bool (true);
+  plan->add_operator (test_plan.output);
+
+  return test_plan;
+}
+
+/* change parameters while notes are playing; if delta is false, all modules are
+ * reconfigured for every update (as before delta updates were implemented)
+ */
+static vector<float>
+render (TestPlan& test_plan, bool delta)
+{
+  /* noise decoders are seeded from the glib rng on note on */
+  g_random_set_seed (42);
+
+  Property *morphing = test_plan.linear->property (MorphLinear::P_MORPHING);
+  Property *cutoff = test_plan.output->property (MorphOutput::P_FILTER_CUTOFF);
+  morphing->set_float (-1);
+  cutoff->set_float (1000);
+
+  MidiSynth midi_synth (48000, 16 /* voices */);
+  midi_synth.apply_update (midi_synth.prepare_update (test_plan.plan));
+
+  const size_t block_size = 256;
+  vector<float> output;
+  vector<float> block (block_size);
+
+  for (int b = 0; b < 400; b++)
+    {
+      if (b % 100 == 0)
+        {
+          for (int n = 0; n < 3; n++)
+            {
+              unsigned char note_on[3] = { 0x90, (unsigned char) (57 + b / 100 + n * 4), 100 };
+              midi_synth.add_midi_event (n * 11, note_on);
+            }
+        }
+      if (b % 100 == 80)
+        {
+          for (int n = 0; n < 3; n++)
+            {
+              unsigned char note_off[3] = { 0x80, (unsigned char) (57 + b / 100 + n * 4), 0 };
+              midi_synth.add_midi_event (n * 13, note_off);
+            }
+        }
+      if (b % 7 == 3 || b % 11 == 5)
+        {
+          if (b % 7 == 3)
+            morphing->set_float (sin (b * 0.1));
+          else
+            cutoff->set_float (1000 + 500 * sin (b * 0.2));
+
+          auto update = midi_synth.prepare_update (test_plan.plan);
+          assert (update->cheap && update->changed_ops.size() == 1);
+
+          if (!delta)
+            update->base_serial = 0; // not based on the last update: reconfigure all modules
+
+          midi_synth.apply_update (update);
+        }
+      midi_synth.process (block.data(), block_size);
+      output.insert (output.end(), block.begin(), block.end());
+    }
+  return output;
+}
+
+static void
+test_delta_update (Project& project)
+{
+  TestPlan test_plan = build_plan (project);
+
+  vector<float> delta_out = render (test_plan, true);
+  vector<float> full_out = render (test_plan, false);
+
+  assert (delta_out.size() == full_out.size());
+
+  double energy = 0;
+  for (size_t i = 0; i < delta_out.size(); i++)
+    {
+      assert (delta_out[i] == full_out[i]);
+      energy += delta_out[i] * delta_out[i];
+    }
+  assert (energy > 0);
+
+  printf ("delta update: output bit-identical\n");
+}
+
+/* changing the selection or zoom of a grid is no state change (nothing to save or update) */
+static void
+test_grid_selection (Project& project)
+{
+  project.set_mix_freq (48000);
+  project.set_state_changed_notify (true);
+
+  MorphPlanPtr plan = project.morph_plan();
+
+  MorphGrid *grid = static_cast<MorphGrid *> (MorphOperator::create ("SpectMorph::MorphGrid", plan.c_ptr()));
+  plan->add_operator (grid);
+  assert (project.try_update_synth()); // returns (and resets) state changed
+
+  const uint64 config_version = grid->config_version();
+  const uint64 state_version = plan->state_version();
+
+  int            plan_changed = 0;
+  SignalReceiver receiver;
+  receiver.connect (plan->signal_plan_changed, [&]() { plan_changed++; });
+
+  grid->set_selected_x (1);
+  grid->set_selected_y (1);
+  grid->set_zoom (3);
+
+  assert (plan_changed == 3); // user interface needs to redraw
+  assert (grid->config_version() == config_version);
+  assert (plan->state_version() == state_version);
+  assert (!project.try_update_synth());
+
+  grid->set_width (3);
+  assert (plan_changed == 4);
+  assert (grid->config_version() != config_version);
+  assert (plan->state_version() != state_version);
+  assert (project.try_update_synth());
+
+  printf ("grid selection/zoom: ok\n");
+}
+
+int
+main (int argc, char **argv)
+{
+  Main main (&argc, &argv);
+
+  Project project;
+
+  test_delta_update (project);
+  test_grid_selection (project);
+}
@@ -0,0 +1,180 @@
+// Licensed GNU LGPL v2.1 or later: http://www.gnu.org/licenses/lgpl-2.1.html
+
+#include "smdsptimer.hh"
+#include "smmain.hh"
+
+#include <stdio.h>
+#include <assert.h>
+
+#include <thread>
+#include <memory>
+
+using namespace SpectMorph;
+
+using std::vector;
+
+static void
+test_disabled()
+{
+  DSPTimers::reset();
+  {
+    DSPScopedTimer timer (DSPStage::NOISE);
+  }
+  assert (DSPTimers::stats (DSPStage::NOISE).calls == 0);
+
+  DSPOperatorTimer op_timer;
+  {
+    DSPOperatorScope scope (op_timer);
+  }
+  assert (op_timer.calls == 0 && op_timer.ticks == 0);
+
+  printf ("disabled: ok\n");
+}
+
+static void
+test_threads()
+{
+  const int n_threads = 4;
+  const int n_calls = 1000;
+
+  DSPTimers::enable();
+  DSPTimers::reset();
+
+  /* half of the threads use their own counters, the others use the shared counters */
+  vector<std::thread> threads;
+  for (int t = 0; t < n_threads; t++)
+    {
+      threads.emplace_back ([t] {
+        DSPThreadSlot slot;
+        std::unique_ptr<DSPThreadScope> scope;
+        if (t % 2)
+          scope.reset (new DSPThreadScope (slot));
+
+        for (int i = 0; i < n_calls; i++)
+          {
+            DSPScopedTimer timer (DSPStage::IFFT);
+            DSPScopedTimer nested_timer (DSPStage::IFFT); // only outermost scope is counted
+          }
+      });
+    }
+  for (auto& thread : threads)
+    thread.join();
+
+  assert (DSPTimers::stats (DSPStage::IFFT).calls == n_threads * n_calls);
+  assert (DSPTimers::stats (DSPStage::NOISE).calls == 0);
+
+  DSPTimers::reset();
+  assert (DSPTimers::stats (DSPStage::IFFT).calls == 0);
+
+  DSPTimers::disable();
+  printf ("threads: ok\n");
+}
+
+static void
+test_thread_slots()
+{
+  const int n_threads = 200; // more than the number of thread slots
+
+  DSPTimers::enable();
+  DSPTimers::reset();
+
+  const int slots_in_use = DSPTimers::thread_slots_in_use();
+  for (int t = 0; t < n_threads; t++)
+    {
+      std::thread thread ([slots_in_use] {
+        DSPThreadSlot slot;
+        DSPThreadScope scope (slot);
+
+        assert (DSPTimers::thread_slots_in_use() == slots_in_use + 1);
+        DSPScopedTimer timer (DSPStage::FILTER);
+      });
+      thread.join();
+
+      /* released slots are reused, and their counts are kept */
+      assert (DSPTimers::thread_slots_in_use() == slots_in_use);
+      assert (DSPTimers::stats (DSPStage::FILTER).calls == uint64 (t + 1));
+    }
+
+  /* threads that are not registered don't use a slot */
+  std::thread thread ([] {
+    DSPScopedTimer timer (DSPStage::FILTER);
+  });
+  thread.join();
+  assert (DSPTimers::thread_slots_in_use() == slots_in_use);
+  assert (DSPTimers::stats (DSPStage::FILTER).calls == n_threads + 1);
+
+  DSPTimers::disable();
+  printf ("thread slots: ok\n");
+}
+
+static void
+test_operator_timers()
+{
+  DSPOperatorTimers timers;
+
+  for (uintptr_t id = 0; id < DSPOperatorTimers::MAX_OPS + 10; id++)
+    {
+      DSPOperatorTimer timer;
+      timer.calls = 1;
+      timer.ticks = id;
+
+      timers.add (1000 + id, timer);
+      timers.add (1000, timer);
+    }
+  assert (timers.n_ops == DSPOperatorTimers::MAX_OPS); // operators that don't fit are ignored
+  assert (timers.id[0] == 1000 && timers.timer[0].calls == DSPOperatorTimers::MAX_OPS + 11);
+  assert (timers.id[5] == 1005 && timers.timer[5].calls == 1 && timers.timer[5].ticks == 5);
+
+  timers.clear();
+  assert (timers.n_ops == 0);
+  printf ("operator timers: ok\n");
+}
+
+static void
+test_operator_scope()
+{
+  DSPOperatorTimer outer_timer, inner_timer;
+
+  DSPTimers::enable();
+
+  const uint64 start = DSPTimers::now();
+  {
+    DSPOperatorScope outer_scope (outer_timer);
+
+    volatile double x = 0;
+    for (int i = 0; i < 10000; i++)
+      x += i;
+
+    for (int i = 0; i < 3; i++)
+      {
+        DSPOperatorScope inner_scope (inner_timer);
+
+        for (int j = 0; j < 10000; j++)
+          x += j;
+      }
+  }
+  const uint64 total = DSPTimers::now() - start;
+
+  DSPTimers::disable();
+
+  assert (outer_timer.calls == 1);
+  assert (inner_timer.calls == 3);
+
+  /* time of the inner scopes is not counted for the outer scope */
+  assert (inner_timer.ticks > 0);
+  assert (outer_timer.ticks + inner_timer.ticks <= total);
+
+  printf ("operator scope: ok\n");
+}
+
+int
+main (int argc, char **argv)
+{
+  Main main (&argc, &argv);
+
+  test_disabled();
+  test_threads();
+  test_thread_slots();
+  test_operator_timers();
+  test_operator_scope();
+}
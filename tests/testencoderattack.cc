@@ -0,0 +1,305 @@
+// Licensed GNU LGPL v2.1 or later: http://www.gnu.org/licenses/lgpl-2.1.html
+
+#include "smencoder.hh"
+#include "smmain.hh"
+#include "smrandom.hh"
+#include "smutils.hh"
+#include "smmath.hh"
+
+#include <assert.h>
+#include <math.h>
+#include <functional>
+#include <memory>
+
+using namespace SpectMorph;
+using std::vector;
+
+/* encodes a harmonic signal with silence at the start and a linear attack; returns the attack
+ * parameters found by the encoder (relative to the start of the signal)
+ */
+static void
+encode_attack (double silence_ms, double attack_ms, double& start_ms, double& end_ms)
+{
+  const double mix_freq = 44100;
+  const double freq = 220;
+
+  Random random;
+  random.set_seed (42);
+
+  vector<float> signal (mix_freq * 0.5);
+  for (size_t i = 0; i < signal.size(); i++)
+    {
+      const double t_ms = i * 1000 / mix_freq;
+
+      double env = 1;
+      if (t_ms < silence_ms)
+        env = 0;
+      else if (t_ms < silence_ms + attack_ms)
+        env = (t_ms - silence_ms) / attack_ms;
+
+      double value = 0;
+      for (int h = 1; h <= 8; h++)
+        value += 0.3 / h * sin (2 * M_PI * freq * h * t_ms / 1000 + h);
+
+      signal[i] = env * value + random.random_double_range (-0.001, 0.001);
+    }
+  WavData wav_data (signal, 1, mix_freq, 32);
+
+  EncoderParams enc_params;
+  enc_params.setup_params (wav_data, freq);
+  assert (enc_params.setup_window());
+
+  Encoder encoder (enc_params);
+
+  const double start_t = get_time();
+  assert (encoder.encode (wav_data, 0, 0, /* attack */ true, /* track_sines */ true));
+  const double end_t = get_time();
+
+  std::unique_ptr<Audio> audio (encoder.save_as_audio());
+
+  const double zero_values_ms = audio->zero_values_at_start / mix_freq * 1000;
+  start_ms = audio->attack_start_ms - zero_values_ms;
+  end_ms = audio->attack_end_ms - zero_values_ms;
+
+  printf ("  silence=%.1f attack=%.1f => attack_start=%.3f attack_end=%.3f (encoding took %.3f seconds)\n",
+          silence_ms, attack_ms, start_ms, end_ms, end_t - start_t);
+}
+
+/*
+ * Reference: the attack search used before the deterministic search was implemented;
+ * attack_error() decodes all attack frames for each evaluation, and a random local
+ * search runs until 3000 evaluations in a row didn't find a better attack.
+ */
+static const size_t ATTACK_FRAMES = 20;
+
+struct Attack
+{
+  double attack_start_ms;
+  double attack_end_ms;
+};
+
+static double
+attack_error (const EncoderParams& enc_params, const vector<EncoderBlock>& audio_blocks,
+              const vector< vector<double> >& unscaled_signal, const Attack& attack)
+{
+  const size_t frames = unscaled_signal.size();
+  double total_error = 0;
+  vector<double> decoded_signal (enc_params.frame_size + enc_params.frame_step * frames);
+  vector<double> orig_signal (decoded_signal.size());
+  const auto& window = enc_params.window;
+
+  for (size_t f = 0; f < frames; f++)
+    {
+      const vector<double>& frame_signal = unscaled_signal[f];
+      size_t zero_values = 0;
+      double scale = 1.0;
+
+      for (size_t n = 0; n < frame_signal.size(); n++)
+        {
+          const double n_ms = f * enc_params.frame_step_ms + n * 1000.0 / enc_params.mix_freq;
+          double env;
+          if (n_ms < attack.attack_start_ms)
+            {
+              env = 0;
+              zero_values++;
+              size_t samples_in_frame = frame_signal.size() - zero_values;
+              if (samples_in_frame < (frame_signal.size() / 8))
+                scale = 0;
+              else
+                scale = frame_signal.size() / double (samples_in_frame);
+            }
+          else if (n_ms < attack.attack_end_ms)  // during attack
+            {
+              const double attack_len_ms = attack.attack_end_ms - attack.attack_start_ms;
+              env = (n_ms - attack.attack_start_ms) / attack_len_ms;
+            }
+          else // after attack
+            {
+              env = 1.0;
+            }
+          decoded_signal[f * enc_params.frame_step + n] += frame_signal[n] * scale * env * window[n];
+          orig_signal[f * enc_params.frame_step + n] = audio_blocks[f].debug_samples[n];
+        }
+    }
+  for (size_t i = 0; i < decoded_signal.size(); i++)
+    {
+      double error = orig_signal[i] - decoded_signal[i];
+      total_error += error * error;
+    }
+  return total_error;
+}
+
+static Attack
+reference_attack (const EncoderParams& enc_params, const vector<EncoderBlock>& audio_blocks,
+                  const vector< vector<double> >& unscaled_signal, double zero_values_at_start_ms, double& error)
+{
+  Random random;
+  random.set_seed (42);
+
+  Attack attack;
+  attack.attack_start_ms = zero_values_at_start_ms;
+  attack.attack_end_ms = zero_values_at_start_ms + 10;
+  error = 1e7;
+
+  int no_modification = 0;
+  while (no_modification < 3000)
+    {
+      double R;
+      if (no_modification < 500)
+        R = 100;
+      else if (no_modification < 1000)
+        R = 20;
+      else if (no_modification < 1500)
+        R = 1;
+      else if (no_modification < 2000)
+        R = 0.2;
+      else if (no_modification < 2500)
+        R = 0.01;
+      else
+        R = 0.002;
+
+      Attack new_attack = attack;
+      new_attack.attack_start_ms += random.random_double_range (-R, R);
+      new_attack.attack_end_ms += random.random_double_range (-R, R);
+      // constrain attack to at least 5ms to avoid clickiness at start
+      new_attack.attack_end_ms = std::max (new_attack.attack_end_ms, new_attack.attack_start_ms + 5);
+
+      if (new_attack.attack_start_ms < new_attack.attack_end_ms &&
+          new_attack.attack_start_ms >= zero_values_at_start_ms &&
+          new_attack.attack_end_ms < 200)
+        {
+          const double new_error = attack_error (enc_params, audio_blocks, unscaled_signal, new_attack);
+          if (new_error < error)
+            {
+              error = new_error;
+              attack = new_attack;
+              no_modification = 0;
+            }
+          else
+            no_modification++;
+        }
+    }
+  return attack;
+}
+
+static Encoder *
+encode (const EncoderParams& enc_params, const WavData& wav_data, bool attack)
+{
+  Encoder *encoder = new Encoder (enc_params);
+  assert (encoder->encode (wav_data, 0, 0, attack, /* track_sines */ true));
+  return encoder;
+}
+
+/* the error of the attack found by the encoder must not be larger than the error of the
+ * reference search (both errors are computed by the reference attack_error() function)
+ */
+static void
+compare_reference (const char *label, const vector<float>& signal, double mix_freq, double freq)
+{
+  WavData wav_data (signal, 1, mix_freq, 32);
+
+  EncoderParams enc_params;
+  enc_params.setup_params (wav_data, freq);
+  assert (enc_params.setup_window());
+
+  /* partials before the attack envelope is applied (which rescales the magnitudes) */
+  std::unique_ptr<Encoder> plain_encoder (encode (enc_params, wav_data, false));
+  const vector<EncoderBlock>& audio_blocks = plain_encoder->audio_blocks;
+
+  vector< vector<double> > unscaled_signal;
+  for (size_t f = 0; f < std::min (ATTACK_FRAMES, audio_blocks.size()); f++)
+    {
+      const EncoderBlock& audio_block = audio_blocks[f];
+      vector<double> frame_signal (enc_params.frame_size);
+
+      for (size_t partial = 0; partial < audio_block.freqs.size(); partial++)
+        {
+          const double SA = 0.5;
+          double mag   = audio_block.mags[partial] * SA;
+          double f     = audio_block.freqs[partial];
+          double phase = audio_block.phases[partial];
+
+          for (size_t n = 0; n < frame_signal.size(); n++)
+            {
+              frame_signal[n] += sin (phase) * mag;
+              phase += f / mix_freq * 2.0 * M_PI;
+            }
+        }
+      unscaled_signal.push_back (frame_signal);
+    }
+
+  std::unique_ptr<Encoder> attack_encoder (encode (enc_params, wav_data, true));
+  std::unique_ptr<Audio>   audio (attack_encoder->save_as_audio());
+
+  Attack attack;
+  attack.attack_start_ms = audio->attack_start_ms;
+  attack.attack_end_ms = audio->attack_end_ms;
+  const double error = attack_error (enc_params, audio_blocks, unscaled_signal, attack);
+
+  double ref_error;
+  const double zero_values_at_start_ms = audio->zero_values_at_start / mix_freq * 1000;
+  Attack ref = reference_attack (enc_params, audio_blocks, unscaled_signal, zero_values_at_start_ms, ref_error);
+
+  printf ("  %-12s attack=<%.6f, %.6f> error=%.10g   reference attack=<%.6f, %.6f> error=%.10g\n", label,
+          attack.attack_start_ms, attack.attack_end_ms, error, ref.attack_start_ms, ref.attack_end_ms, ref_error);
+
+  /* the partials are summed in a different order by the encoder (and the window is applied
+   * earlier), so we allow a tiny relative difference caused by rounding errors
+   */
+  assert (error <= ref_error * (1 + 1e-9));
+}
+
+static vector<float>
+harmonic_signal (double mix_freq, double freq, const std::function<double (double)>& envelope)
+{
+  Random random;
+  random.set_seed (42);
+
+  vector<float> signal (mix_freq * 0.5);
+  for (size_t i = 0; i < signal.size(); i++)
+    {
+      const double t_ms = i * 1000 / mix_freq;
+
+      double value = 0;
+      for (int h = 1; h <= 8; h++)
+        value += 0.3 / h * sin (2 * M_PI * freq * h * t_ms / 1000 + h);
+
+      signal[i] = envelope (t_ms) * value + random.random_double_range (-0.001, 0.001);
+    }
+  return signal;
+}
+
+int
+main (int argc, char **argv)
+{
+  Main main (&argc, &argv);
+
+  double start_ms, end_ms;
+
+  /* steady signal: attack at start of the signal, using the minimum attack length */
+  encode_attack (0, 0, start_ms, end_ms);
+  assert (start_ms >= 0 && start_ms < 1);
+  assert (end_ms - start_ms < 6);
+
+  /* attack after silence */
+  encode_attack (50, 30, start_ms, end_ms);
+  assert (start_ms > 40 && start_ms < 60);
+  assert (end_ms > start_ms + 5 && end_ms < 90);
+
+  /* search is deterministic */
+  double start2_ms, end2_ms;
+  encode_attack (50, 30, start2_ms, end2_ms);
+  assert (start_ms == start2_ms && end_ms == end2_ms);
+
+  /* compare to reference search */
+  const double mix_freq = 44100;
+  compare_reference ("steady", harmonic_signal (mix_freq, 220, [] (double t_ms) { return 1; }), mix_freq, 220);
+  compare_reference ("linear", harmonic_signal (mix_freq, 220, [] (double t_ms) { return sm_bound (0.0, (t_ms - 50) / 30, 1.0); }),
+                     mix_freq, 220);
+  compare_reference ("slow", harmonic_signal (mix_freq, 330, [] (double t_ms) { return sm_bound (0.0, (t_ms - 20) / 120, 1.0); }),
+                     mix_freq, 330);
+  compare_reference ("pluck", harmonic_signal (mix_freq, 440, [] (double t_ms) { return t_ms < 30 ? 0 : exp (-(t_ms - 30) / 80); }),
+                     mix_freq, 440);
+  compare_reference ("swell", harmonic_signal (mix_freq, 150, [] (double t_ms) { return sm_bound (0.0, pow (t_ms / 60, 2), 1.0); }),
+                     mix_freq, 150);
+}
@@ -0,0 +1,114 @@
+// Licensed GNU LGPL v2.1 or later: http://www.gnu.org/licenses/lgpl-2.1.html
+
+#include "smencoder.hh"
+#include "smmain.hh"
+#include "smrandom.hh"
+#include "smutils.hh"
+
+#include <assert.h>
+#include <math.h>
+#include <memory>
+
+using namespace SpectMorph;
+using std::vector;
+
+/* streaming encoding must produce exactly the same result as encoding all frames at once */
+static Encoder *
+encode (const WavData& wav_data, bool streaming, bool keep_debug_data, int n_threads, int optimization_level)
+{
+  EncoderParams enc_params;
+
+  enc_params.setup_params (wav_data, 220);
+  enc_params.n_threads = n_threads;
+  enc_params.streaming = streaming;
+  enc_params.keep_debug_data = keep_debug_data;
+  assert (enc_params.setup_window());
+
+  Encoder *encoder = new Encoder (enc_params);
+
+  const double start_t = get_time();
+  assert (encoder->encode (wav_data, 0, optimization_level, /* attack */ true, /* track_sines */ true));
+  const double end_t = get_time();
+
+  printf ("  streaming=%d keep_debug_data=%d threads=%d O%d: %.3f seconds, %zd frames\n",
+          streaming, keep_debug_data, n_threads, optimization_level, end_t - start_t, encoder->audio_blocks.size());
+  return encoder;
+}
+
+static void
+assert_same (Encoder *a, Encoder *b, bool compare_debug_data)
+{
+  assert (a->audio_blocks.size() == b->audio_blocks.size());
+  for (size_t i = 0; i < a->audio_blocks.size(); i++)
+    {
+      const EncoderBlock& block_a = a->audio_blocks[i];
+      const EncoderBlock& block_b = b->audio_blocks[i];
+
+      assert (block_a.noise == block_b.noise);
+      assert (block_a.freqs == block_b.freqs);
+      assert (block_a.mags == block_b.mags);
+      assert (block_a.phases == block_b.phases);
+      if (compare_debug_data)
+        {
+          assert (block_a.original_fft == block_b.original_fft);
+          assert (block_a.debug_samples == block_b.debug_samples);
+        }
+      else
+        {
+          assert (block_b.original_fft.empty());
+          assert (block_b.debug_samples.empty());
+        }
+    }
+  std::unique_ptr<Audio> audio_a (a->save_as_audio());
+  std::unique_ptr<Audio> audio_b (b->save_as_audio());
+
+  assert (audio_a->attack_start_ms == audio_b->attack_start_ms);
+  assert (audio_a->attack_end_ms == audio_b->attack_end_ms);
+  assert (audio_a->zero_values_at_start == audio_b->zero_values_at_start);
+  assert (audio_a->sample_count == audio_b->sample_count);
+}
+
+int
+main (int argc, char **argv)
+{
+  Main main (&argc, &argv);
+
+  /* harmonic signal with attack, vibrato, some noise and a new partial in the middle */
+  const double mix_freq = 48000;
+  const double seconds = argc > 1 ? atof (argv[1]) : 3;
+
+  Random random;
+  random.set_seed (42);
+
+  vector<float> signal (mix_freq * seconds);
+  for (size_t i = 0; i < signal.size(); i++)
+    {
+      const double t = i / mix_freq;
+      const double f = 220 * (1 + 0.01 * sin (2 * M_PI * 5 * t));
+
+      double value = 0;
+      for (int h = 1; h <= 10; h++)
+        value += 0.3 / h * sin (2 * M_PI * f * h * t + h);
+
+      if (t > seconds / 2)
+        value += 0.1 * sin (2 * M_PI * 1234 * t);
+
+      signal[i] = std::min (t * 20, 1.0) * value + random.random_double_range (-0.01, 0.01);
+    }
+  WavData wav_data (signal, 1, mix_freq, 32);
+
+  for (int optimization_level = 0; optimization_level <= 1; optimization_level++)
+    {
+      std::unique_ptr<Encoder> batch (encode (wav_data, false, false, 1, optimization_level));
+
+      for (int n_threads : { 1, 3 })
+        {
+          std::unique_ptr<Encoder> stream (encode (wav_data, true, false, n_threads, optimization_level));
+          assert_same (batch.get(), stream.get(), false);
+
+          std::unique_ptr<Encoder> stream_debug (encode (wav_data, true, true, n_threads, optimization_level));
+          assert_same (batch.get(), stream_debug.get(), true);
+        }
+    }
+  printf ("output bit-identical\n");
+}
@@ -0,0 +1,83 @@
+// Licensed GNU LGPL v2.1 or later: http://www.gnu.org/licenses/lgpl-2.1.html
+
+#include "smencoder.hh"
+#include "smmain.hh"
+#include "smrandom.hh"
+#include "smutils.hh"
+
+#include <assert.h>
+#include <math.h>
+
+using namespace SpectMorph;
+using std::vector;
+
+/* frame parallel encoding must produce exactly the same result as serial encoding */
+static vector<EncoderBlock>
+encode (const WavData& wav_data, int n_threads, int optimization_level)
+{
+  EncoderParams enc_params;
+
+  enc_params.setup_params (wav_data, 220);
+  enc_params.n_threads = n_threads;
+  assert (enc_params.setup_window());
+
+  Encoder encoder (enc_params);
+
+  const double start_t = get_time();
+  assert (encoder.encode (wav_data, 0, optimization_level, /* attack */ false, /* track_sines */ true));
+  const double end_t = get_time();
+
+  printf ("  threads=%d O%d: %.3f seconds, %zd frames\n", n_threads, optimization_level, end_t - start_t, encoder.audio_blocks.size());
+  return encoder.audio_blocks;
+}
+
+static void
+assert_same (const vector<EncoderBlock>& a, const vector<EncoderBlock>& b)
+{
+  assert (a.size() == b.size());
+  for (size_t i = 0; i < a.size(); i++)
+    {
+      assert (a[i].noise == b[i].noise);
+      assert (a[i].freqs == b[i].freqs);
+      assert (a[i].mags == b[i].mags);
+      assert (a[i].phases == b[i].phases);
+      assert (a[i].original_fft == b[i].original_fft);
+      assert (a[i].debug_samples == b[i].debug_samples);
+    }
+}
+
+int
+main (int argc, char **argv)
+{
+  Main main (&argc, &argv);
+
+  /* harmonic signal with vibrato and some noise */
+  const double mix_freq = 48000;
+  const double seconds = argc > 1 ? atof (argv[1]) : 2;
+
+  Random random;
+  random.set_seed (42);
+
+  vector<float> signal (mix_freq * seconds);
+  for (size_t i = 0; i < signal.size(); i++)
+    {
+      const double t = i / mix_freq;
+      const double f = 220 * (1 + 0.01 * sin (2 * M_PI * 5 * t));
+
+      double value = 0;
+      for (int h = 1; h <= 10; h++)
+        value += 0.3 / h * sin (2 * M_PI * f * h * t + h);
+
+      signal[i] = value + random.random_double_range (-0.01, 0.01);
+    }
+  WavData wav_data (signal, 1, mix_freq, 32);
+
+  for (int optimization_level = 0; optimization_level <= 1; optimization_level++)
+    {
+      auto serial = encode (wav_data, 1, optimization_level);
+
+      for (int n_threads : { 2, 3, 4, 0 })
+        assert_same (serial, encode (wav_data, n_threads, optimization_level));
+    }
+  printf ("output bit-identical\n");
+}
@@ -7,6 +7,7 @@
 #include "smmain.hh"
 #include "smfft.hh"
 #include "smutils.hh"
+#include "smrandom.hh"
 
 #include <stdio.h>
 #include <assert.h>
@@ -357,6 +358,96 @@ test_saw_perf()
   printf ("LiveDecoder: clocks per sample per partial: %f\n", clocks_per_sec * time / RUNS / PARTIALS / samples.size());
 }
 
+static void
+random_partials (size_t n_partials, double mix_freq, vector<double>& freqs, vector<double>& mags, vector<double>& phases)
+{
+  Random random;
+
+  random.set_seed (42);
+  for (size_t i = 0; i < n_partials; i++)
+    {
+      freqs.push_back (random.random_double_range (0, mix_freq / 2));
+      mags.push_back (random.random_double_range (0, 1));
+      phases.push_back (random.random_double_range (0, 2 * M_PI));
+    }
+}
+
+void
+test_batch()
+{
+  const double mix_freq = 48000;
+  const size_t block_size = 1024;
+
+  /* includes partials close to 0 Hz and nyquist which use the corner case code */
+  vector<double> freqs, mags, phases;
+  random_partials (2000, mix_freq, freqs, mags, phases);
+
+  IFFTSynth synth (block_size, mix_freq, IFFTSynth::WIN_BLACKMAN_HARRIS_92);
+
+  synth.clear_partials();
+  for (size_t i = 0; i < freqs.size(); i++)
+    synth.render_partial (freqs[i], mags[i], phases[i]);
+  vector<float> ref_spectrum (synth.fft_buffer(), synth.fft_buffer() + block_size);
+
+  for (bool sse : { true, false })
+    {
+      sm_enable_sse (sse);
+
+      synth.clear_partials();
+      synth.render_partials (freqs.size(), &freqs[0], &mags[0], &phases[0]);
+      for (size_t i = 0; i < block_size; i++)
+        assert (synth.fft_buffer()[i] == ref_spectrum[i]);
+    }
+  sm_enable_sse (true);
+  printf ("# IFFTSynth: render_partials output matches render_partial\n");
+}
+
+void
+batch_perf_test()
+{
+  const double mix_freq = 48000;
+  const size_t block_size = 1024;
+  const size_t n_partials = 100;
+
+  vector<double> freqs, mags, phases;
+  random_partials (n_partials, mix_freq, freqs, mags, phases);
+
+  IFFTSynth synth (block_size, mix_freq, IFFTSynth::WIN_HANNING);
+
+  const int RUNS = 100000;
+  double start, end, t;
+
+  for (int mode = 0; mode < 3; mode++)
+    {
+      sm_enable_sse (mode != 2);
+
+      t = 1e30;
+      for (int reps = 0; reps < 12; reps++)
+        {
+          synth.clear_partials();
+
+          start = get_time();
+          for (int r = 0; r < RUNS; r++)
+            {
+              if (mode == 0)
+                {
+                  for (size_t i = 0; i < n_partials; i++)
+                    synth.render_partial (freqs[i], mags[i], phases[i]);
+                }
+              else
+                {
+                  synth.render_partials (n_partials, &freqs[0], &mags[0], &phases[0]);
+                }
+            }
+          end = get_time();
+          t = min (t, end - start);
+        }
+      const char *mode_name[] = { "render_partial", "render_partials (sse)", "render_partials (no sse)" };
+      printf ("%-25s %.2f Mpartials/sec\n", mode_name[mode], RUNS * n_partials / t / 1e6);
+    }
+  sm_enable_sse (true);
+}
+
 int
 main (int argc, char **argv)
 {
@@ -368,6 +459,11 @@ main (int argc, char **argv)
       perf_test();
       return 0;
     }
+  if (argc == 2 && strcmp (argv[1], "batch_perf") == 0)
+    {
+      batch_perf_test();
+      return 0;
+    }
   if (argc == 2 && strcmp (argv[1], "saw_perf") == 0)
     {
       test_saw_perf();
@@ -407,4 +503,6 @@ main (int argc, char **argv)
   printf ("# IFFTSynth: max_freq_diff = %.17g\n", max_freq_diff);
   assert (max_output_diff < 9e-5);
   assert (max_freq_diff < 0.1);
+
+  test_batch();
 }
@@ -0,0 +1,181 @@
+// Licensed GNU LGPL v2.1 or later: http://www.gnu.org/licenses/lgpl-2.1.html
+
+#include "sminstenccache.hh"
+#include "smmain.hh"
+#include "smmemout.hh"
+#include "smutils.hh"
+
+#include <assert.h>
+#include <atomic>
+#include <math.h>
+#include <regex>
+#include <stdlib.h>
+#include <sys/stat.h>
+#include <thread>
+#include <unistd.h>
+
+using namespace SpectMorph;
+using std::string;
+using std::vector;
+
+static WavData
+make_wav_data()
+{
+  const double mix_freq = 48000;
+
+  vector<float> signal (mix_freq / 4);
+  for (size_t i = 0; i < signal.size(); i++)
+    {
+      double value = 0;
+      for (int h = 1; h <= 5; h++)
+        value += 0.3 / h * sin (2 * M_PI * 440 * h * i / mix_freq);
+
+      signal[i] = value;
+    }
+  return WavData (signal, 1, mix_freq, 32);
+}
+
+static vector<unsigned char>
+audio_data (const Audio *audio)
+{
+  vector<unsigned char> data;
+  MemOut                mem_out (&data);
+
+  audio->save (&mem_out);
+  return data;
+}
+
+/* encoded data for each note, to verify that cache hits return the same data */
+static std::map<int, vector<unsigned char>> note_data;
+static std::mutex                           note_data_mutex;
+
+/* returns true if the cache returned an entry without encoding */
+static bool
+encode_cached (InstEncCache::Group *group, const WavData& wav_data, int midi_note)
+{
+  Instrument::EncoderConfig cfg;
+
+  int encoder_calls = 0;
+  auto kill_function = [&]() {
+    encoder_calls++;
+    return false;
+  };
+  Audio *audio = InstEncCache::the()->encode (group, wav_data, "wav_data_hash", midi_note, 0, wav_data.n_values(), cfg, kill_function);
+  assert (audio);
+
+  vector<unsigned char> data = audio_data (audio);
+  delete audio;
+
+  std::lock_guard<std::mutex> lg (note_data_mutex);
+  if (note_data.count (midi_note))
+    assert (note_data[midi_note] == data);
+  else
+    note_data[midi_note] = data;
+
+  return encoder_calls == 0;
+}
+
+static vector<string>
+cache_files()
+{
+  vector<string> files;
+  assert (!read_dir (sm_get_user_dir (USER_DIR_CACHE), files));
+  std::sort (files.begin(), files.end());
+  return files;
+}
+
+int
+main (int argc, char **argv)
+{
+  /* use empty cache directory */
+  char tmp_dir[] = "/tmp/testinstenccache.XXXXXX";
+  assert (mkdtemp (tmp_dir));
+  setenv ("XDG_DATA_HOME", tmp_dir, 1);
+
+  string cache_dir;
+  {
+    Main main (&argc, &argv);
+
+    cache_dir = sm_get_user_dir (USER_DIR_CACHE);
+    WavData wav_data = make_wav_data();
+
+    std::unique_ptr<InstEncCache::Group> group1 (InstEncCache::the()->create_group());
+    std::unique_ptr<InstEncCache::Group> group2 (InstEncCache::the()->create_group());
+
+    assert (!encode_cached (group1.get(), wav_data, 69));
+
+    /* entries are shared between groups */
+    assert (encode_cached (group2.get(), wav_data, 69));
+    assert (encode_cached (nullptr, wav_data, 69));
+
+    /* load from disk */
+    InstEncCache::the()->clear();
+    assert (encode_cached (group2.get(), wav_data, 69));
+
+    /* the index is not rewritten after each write, but later (or on exit) */
+    assert (!file_exists (cache_dir + "/inst_enc_index"));
+
+    /* different dependencies (note) produce a different entry, the old one is kept */
+    assert (!encode_cached (group1.get(), wav_data, 70));
+    InstEncCache::the()->clear();
+    assert (encode_cached (group1.get(), wav_data, 69));
+    assert (encode_cached (group1.get(), wav_data, 70));
+
+    /* encode/load in parallel: each note is only encoded once */
+    for (int pass = 0; pass < 3; pass++)
+      {
+        if (pass == 2)
+          InstEncCache::the()->clear();
+
+        std::atomic<int> n_encoded { 0 };
+        vector<std::thread> threads;
+        for (int t = 0; t < 8; t++)
+          {
+            threads.emplace_back ([&, t]() {
+              if (!encode_cached (group1.get(), wav_data, 71 + t % 4))
+                n_encoded++;
+            });
+          }
+        for (auto& thread : threads)
+          thread.join();
+
+        assert (n_encoded == (pass == 0 ? 4 : 0));
+      }
+  }
+
+  /* six cache files (no temporary files) and the index */
+  vector<string> files = cache_files();
+  assert (files.size() == 7);
+  assert (files[6] == "inst_enc_index");
+
+  std::regex cache_file_re ("inst_enc_[0-9a-f]{40}");
+  for (size_t i = 0; i < 6; i++)
+    assert (std::regex_match (files[i], cache_file_re));
+
+  FILE *index = fopen ((cache_dir + "/inst_enc_index").c_str(), "r");
+  assert (index);
+
+  int lines = 0;
+  char line[1024];
+  while (fgets (line, sizeof (line), index))
+    lines++;
+  fclose (index);
+  assert (lines == 7); // header + six entries
+
+  /* without changes, the index is not rewritten (rewriting replaces the file) */
+  struct stat index_stat, new_index_stat;
+  assert (stat ((cache_dir + "/inst_enc_index").c_str(), &index_stat) == 0);
+  {
+    Main main (&argc, &argv);
+  }
+  assert (stat ((cache_dir + "/inst_enc_index").c_str(), &new_index_stat) == 0);
+  assert (index_stat.st_ino == new_index_stat.st_ino);
+
+  for (auto filename : files)
+    unlink ((cache_dir + "/" + filename).c_str());
+  rmdir (cache_dir.c_str());
+  rmdir ((string (tmp_dir) + "/spectmorph").c_str());
+  rmdir (tmp_dir);
+
+  printf ("ok\n");
+}
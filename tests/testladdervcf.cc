@@ -7,6 +7,8 @@
 #include <cstdio>
 
 #include "smladdervcf.hh"
+#include "smmain.hh"
+#include "smutils.hh"
 
 using std::vector;
 using std::string;
@@ -32,6 +34,95 @@ gen_sweep (vector<float>& left, vector<float>& right, vector<float>& freq)
     }
 }
 
+/* filter n_voices blocks of noise with different cutoff / resonance sweeps
+ *
+ * impl: "old" = LadderVCFNonLinear per voice, "voice" = LadderVCFVoice::run_block() per voice,
+ *       "lanes" = LadderVCFVoice::run_voices()
+ */
+static vector<vector<float>>
+perf_run (const string& impl, int n_voices, int n_blocks, double& time)
+{
+  const uint block_size = 256;
+
+  vector<LadderVCFNonLinear> old_filters (n_voices);
+  vector<LadderVCFVoice> filters (n_voices);
+  vector<LadderVCFVoice *> filter_ptrs;
+  for (auto& filter : filters)
+    filter_ptrs.push_back (&filter);
+
+  vector<vector<float>> out (n_voices);
+  vector<vector<float>> samples (n_voices, vector<float> (block_size));
+  vector<vector<float>> freq (n_voices, vector<float> (block_size));
+  vector<vector<float>> reso (n_voices, vector<float> (block_size));
+  vector<vector<float>> mix (n_voices, vector<float> (block_size));
+
+  for (int v = 0; v < n_voices; v++)
+    {
+      old_filters[v].set_drive (v % 4 * 6);
+      filters[v].set_drive (v % 4 * 6);
+    }
+  uint32_t seed = 1;
+  time = 0;
+  for (int b = 0; b < n_blocks; b++)
+    {
+      for (int v = 0; v < n_voices; v++)
+        {
+          for (uint i = 0; i < block_size; i++)
+            {
+              double pos = double (b * block_size + i) / (n_blocks * block_size);
+
+              seed = seed * 1664525 + 1013904223;
+              samples[v][i] = (seed / 4294967296.0 * 2 - 1) * 0.5;
+              freq[v][i] = 100 * pow (100, pos) * (1 + v * 0.05);
+              reso[v][i] = (v % 5) * 0.22;
+              mix[v][i]  = 1 - (v % 3) * 0.25;
+            }
+        }
+      double start = get_time();
+      if (impl == "old")
+        {
+          for (int v = 0; v < n_voices; v++)
+            {
+              const float *inputs[2] = { &samples[v][0], &samples[v][0] };
+              float *outputs[2] = { &samples[v][0], nullptr };
+
+              old_filters[v].set_mix_in (&mix[v][0]);
+              old_filters[v].run_block (block_size, 0, 0, inputs, outputs, true, false, &freq[v][0], &reso[v][0]);
+            }
+        }
+      else
+        {
+          for (int v = 0; v < n_voices; v++)
+            filters[v].set_block (&samples[v][0], &freq[v][0], &reso[v][0], &mix[v][0]);
+
+          if (impl == "voice")
+            {
+              for (auto& filter : filters)
+                filter.run_block (block_size);
+            }
+          else
+            {
+              LadderVCFVoice::run_voices (&filter_ptrs[0], n_voices, block_size);
+            }
+        }
+      time += get_time() - start;
+
+      for (int v = 0; v < n_voices; v++)
+        out[v].insert (out[v].end(), samples[v].begin(), samples[v].end());
+    }
+  return out;
+}
+
+static double
+max_diff (const vector<vector<float>>& a, const vector<vector<float>>& b)
+{
+  double diff = 0;
+  for (size_t v = 0; v < a.size(); v++)
+    for (size_t i = 0; i < a[v].size(); i++)
+      diff = std::max<double> (diff, fabs (a[v][i] - b[v][i]));
+  return diff;
+}
+
 int
 main (int argc, char **argv)
 {
@@ -80,4 +171,30 @@ main (int argc, char **argv)
 
       return 0;
     }
+  if (cmd == "perf")
+    {
+      const int n_voices = argc > 2 ? atoi (argv[2]) : 16;
+      const int n_blocks = 1000;
+
+      double t_old, t_voice, t_lanes, t_scalar;
+      auto out_old   = perf_run ("old", n_voices, n_blocks, t_old);
+      auto out_voice = perf_run ("voice", n_voices, n_blocks, t_voice);
+      auto out_lanes = perf_run ("lanes", n_voices, n_blocks, t_lanes);
+
+      sm_enable_sse (false);
+      auto out_scalar = perf_run ("lanes", n_voices, n_blocks, t_scalar);
+      sm_enable_sse (true);
+
+      const double audio_time = n_voices * n_blocks * 256 / 48000.;
+      printf ("LadderVCFNonLinear:              %6.1f voices per core (realtime @ 48 kHz)\n", audio_time / t_old);
+      printf ("LadderVCFVoice::run_block():     %6.1f voices per core (realtime @ 48 kHz)\n", audio_time / t_voice);
+      printf ("LadderVCFVoice::run_voices():    %6.1f voices per core (realtime @ 48 kHz)\n", audio_time / t_lanes);
+      printf ("LadderVCFVoice::run_voices() C++:%6.1f voices per core (realtime @ 48 kHz)\n", audio_time / t_scalar);
+      printf ("max diff old/lanes:   %g\n", max_diff (out_old, out_lanes));
+      printf ("max diff voice/lanes: %g\n", max_diff (out_voice, out_lanes));
+      printf ("max diff SSE/C++:     %g\n", max_diff (out_scalar, out_lanes));
+      return 0;
+    }
+  printf ("bad command: %s\n", cmd.c_str());
+  return 1;
 }
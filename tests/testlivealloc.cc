@@ -0,0 +1,252 @@
+// Licensed GNU LGPL v2.1 or later: http://www.gnu.org/licenses/lgpl-2.1.html
+
+#include "smlivedecoder.hh"
+#include "smmain.hh"
+#include "smmath.hh"
+#include "smrandom.hh"
+#include "smfft.hh"
+
+#include <stdio.h>
+#include <assert.h>
+#include <errno.h>
+
+#include <new>
+#include <vector>
+
+using namespace SpectMorph;
+
+using std::vector;
+
+/* count heap allocations of the thread calling retrigger/process (other threads may allocate) */
+static thread_local bool count_allocs = false;
+static size_t            n_allocs = 0;
+
+#ifdef __GLIBC__
+/* count all heap allocations: operator new, glib (g_malloc), fftw (fftwf_malloc) and
+ * plain C code all end up in one of these functions, which replace the libc versions
+ */
+extern "C" {
+
+void *__libc_malloc (size_t size);
+void *__libc_calloc (size_t n, size_t size);
+void *__libc_realloc (void *ptr, size_t size);
+void *__libc_memalign (size_t alignment, size_t size);
+
+void *
+malloc (size_t size)
+{
+  if (count_allocs)
+    n_allocs++;
+  return __libc_malloc (size);
+}
+
+void *
+calloc (size_t n, size_t size)
+{
+  if (count_allocs)
+    n_allocs++;
+  return __libc_calloc (n, size);
+}
+
+void *
+realloc (void *ptr, size_t size)
+{
+  if (count_allocs)
+    n_allocs++;
+  return __libc_realloc (ptr, size);
+}
+
+void *
+memalign (size_t alignment, size_t size)
+{
+  if (count_allocs)
+    n_allocs++;
+  return __libc_memalign (alignment, size);
+}
+
+void *
+aligned_alloc (size_t alignment, size_t size)
+{
+  return memalign (alignment, size);
+}
+
+int
+posix_memalign (void **ptr, size_t alignment, size_t size)
+{
+  void *mem = memalign (alignment, size);
+  if (!mem)
+    return ENOMEM;
+
+  *ptr = mem;
+  return 0;
+}
+
+}
+#else
+/* count heap allocations done via operator new (STL containers, new'd objects) */
+void *
+operator new (size_t size)
+{
+  if (count_allocs)
+    n_allocs++;
+
+  void *ptr = malloc (size ? size : 1);
+  if (!ptr)
+    throw std::bad_alloc();
+  return ptr;
+}
+
+void *
+operator new[] (size_t size)
+{
+  return operator new (size);
+}
+
+void
+operator delete (void *ptr) noexcept
+{
+  free (ptr);
+}
+
+void
+operator delete[] (void *ptr) noexcept
+{
+  free (ptr);
+}
+#endif
+
+class TestSource : public LiveDecoderSource
+{
+  Audio      my_audio;
+  AudioBlock my_audio_block;
+public:
+  TestSource()
+  {
+    my_audio.frame_size_ms = 40;
+    my_audio.frame_step_ms = 10;
+    my_audio.attack_start_ms = 10;
+    my_audio.attack_end_ms = 20;
+    my_audio.zeropad = 4;
+    my_audio.loop_type = Audio::LOOP_NONE;
+
+    Random random;
+    random.set_seed (42);
+    for (int i = 0; i < 32; i++)
+      my_audio_block.noise.push_back (sm_factor2idb (random.random_double_range (0.01, 0.1)));
+
+    for (int partial = 1; partial <= 50; partial++)
+      {
+        my_audio_block.freqs.push_back (sm_freq2ifreq (partial));
+        my_audio_block.mags.push_back (sm_factor2idb (1.0 / partial));
+        my_audio_block.phases.push_back (0);
+      }
+  }
+  void
+  retrigger (int channel, float freq, int midi_velocity, float mix_freq) override
+  {
+    my_audio.mix_freq = mix_freq;
+    my_audio.fundamental_freq = freq;
+  }
+  Audio *
+  audio() override
+  {
+    return &my_audio;
+  }
+  AudioBlock *
+  audio_block (size_t index) override
+  {
+    return &my_audio_block;
+  }
+};
+
+static void
+play_notes (LiveDecoder& live_decoder, double mix_freq, vector<float>& samples, vector<float>& freq_in)
+{
+  const size_t n_values = samples.size();
+
+  for (int note = 40; note < 80; note += 7)
+    {
+      const float freq = 440 * pow (2, (note - 69) / 12.0);
+
+      live_decoder.retrigger (0, freq, 100, mix_freq);
+      for (int block = 0; block < 100; block++)
+        {
+          if (block < 50)
+            {
+              live_decoder.process (n_values, nullptr, &samples[0]);
+            }
+          else
+            {
+              /* glide one octave up to exercise the portamento code */
+              for (size_t i = 0; i < n_values; i++)
+                freq_in[i] = freq * (1 + (block - 50 + i / double (n_values)) / 50);
+
+              live_decoder.process (n_values, &freq_in[0], &samples[0]);
+            }
+        }
+    }
+}
+
+static void
+test_alloc (int unison_voices, double mix_freq)
+{
+  TestSource source;
+
+  LiveDecoder live_decoder (&source);
+  live_decoder.set_unison_voices (unison_voices, 10);
+  live_decoder.precompute_tables (mix_freq);
+
+  vector<float> samples (256);
+  vector<float> freq_in (256);
+
+  /* after precompute_tables(), retrigger and process should not allocate memory at all,
+   * starting with the first note
+   */
+  n_allocs = 0;
+  count_allocs = true;
+  play_notes (live_decoder, mix_freq, samples, freq_in);
+  count_allocs = false;
+
+  printf ("unison_voices=%d mix_freq=%.0f: %zd allocations during retrigger/process\n", unison_voices, mix_freq, n_allocs);
+  assert (n_allocs == 0);
+}
+
+/* make sure that allocations from all allocators are counted */
+static void
+test_counting()
+{
+  static void * volatile ptr; // prevent the compiler from optimizing allocations away
+
+  n_allocs = 0;
+  count_allocs = true;
+
+  ptr = malloc (16);
+  free (ptr);
+  ptr = g_malloc (16);
+  g_free (ptr);
+  ptr = FFT::new_array_float (16);
+  FFT::free_array_float ((float *) ptr);
+  ptr = new int[4];
+  delete[] (int *) ptr;
+
+  count_allocs = false;
+
+  printf ("counting: %zd allocations\n", n_allocs);
+#ifdef __GLIBC__
+  assert (n_allocs == 4);
+#else
+  assert (n_allocs >= 1);
+#endif
+}
+
+int
+main (int argc, char **argv)
+{
+  Main main (&argc, &argv);
+
+  test_counting();
+
+  test_alloc (1, 48000);
+  test_alloc (3, 48000);
+  test_alloc (1, 96000);
+}
@@ -0,0 +1,196 @@
+// Licensed GNU LGPL v2.1 or later: http://www.gnu.org/licenses/lgpl-2.1.html
+
+#include "smmidisynth.hh"
+#include "smmain.hh"
+#include "smproject.hh"
+#include "smsynthinterface.hh"
+#include "smwavsetrepo.hh"
+#include "smmorphoutput.hh"
+#include "smmorphsource.hh"
+#include "smmemout.hh"
+#include "smmmapin.hh"
+#include "smutils.hh"
+#include "config.h"
+
+#include "testwavset.hh"
+
+#include <assert.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <thread>
+
+using namespace SpectMorph;
+
+using std::string;
+using std::vector;
+
+/* instruments from the index are loaded via WavSetRepo, which maps the files
+ * (AUDIO_MMAP); the mapped data is shared by all plugin instances, so rendering
+ * must only read it: no ArenaVector copies are made, and after rendering two
+ * instances at the same time, the blocks still point into the mapped file
+ */
+
+static size_t
+count_read_only (const WavSet *wav_set)
+{
+  size_t n_read_only = 0;
+  for (const auto& wave : wav_set->waves)
+    {
+      for (const auto& block : wave.audio->contents)
+        {
+          n_read_only += block.freqs.is_read_only();
+          n_read_only += block.mags.is_read_only();
+          n_read_only += block.phases.is_read_only();
+          n_read_only += block.noise.is_read_only();
+        }
+    }
+  return n_read_only;
+}
+
+static MorphPlanPtr
+build_plan (Project& project)
+{
+  MorphPlanPtr plan (new MorphPlan (project));
+
+  MorphSource *source = static_cast<MorphSource *> (MorphOperator::create ("SpectMorph::MorphSource", plan.c_ptr()));
+  source->set_smset ("test.smset");
+  plan->add_operator (source);
+
+  MorphOutput *output = static_cast<MorphOutput *> (MorphOperator::create ("SpectMorph::MorphOutput", plan.c_ptr()));
+  output->set_channel_op (0, source);
+  plan->add_operator (output);
+
+  /* loading the plan also loads the instrument index */
+  vector<unsigned char> data;
+  MemOut mem_out (&data);
+  plan->save (&mem_out);
+
+  MorphPlanPtr loaded_plan (new MorphPlan (project));
+  GenericIn *in = MMapIn::open_mem (&data[0], &data[data.size()]);
+  loaded_plan->load (in);
+  delete in;
+
+  return loaded_plan;
+}
+
+static double
+render (MidiSynth& midi_synth)
+{
+  const size_t block_size = 256;
+  vector<float> block (block_size);
+
+  double energy = 0;
+  for (int n = 0; n < 4; n++)
+    {
+      unsigned char note_on[3] = { 0x90, (unsigned char) (57 + n * 4), 100 };
+      midi_synth.add_midi_event (n * 13, note_on);
+    }
+  for (int b = 0; b < 100; b++)
+    {
+      if (b == 80)
+        {
+          for (int n = 0; n < 4; n++)
+            {
+              unsigned char note_off[3] = { 0x80, (unsigned char) (57 + n * 4), 0 };
+              midi_synth.add_midi_event (n * 11, note_off);
+            }
+        }
+      midi_synth.process (&block[0], block_size);
+      for (auto f : block)
+        energy += f * f;
+    }
+  return energy;
+}
+
+static vector<const void *>
+block_pointers (const WavSet *wav_set)
+{
+  vector<const void *> pointers;
+  for (const auto& wave : wav_set->waves)
+    {
+      for (const auto& block : wave.audio->contents)
+        {
+          pointers.push_back (block.freqs.data());
+          pointers.push_back (block.mags.data());
+          pointers.push_back (block.phases.data());
+          pointers.push_back (block.noise.data());
+        }
+    }
+  return pointers;
+}
+
+struct Instance
+{
+  Project      project;
+  MorphPlanPtr plan;
+  MidiSynth    midi_synth;
+  double       energy = 0;
+
+  Instance() :
+    midi_synth (48000, 64 /* voices */)
+  {
+    plan = build_plan (project);
+    midi_synth.set_render_threads (1);
+
+    auto update = midi_synth.prepare_update (plan);
+    midi_synth.apply_update (update);
+  }
+};
+
+int
+main (int argc, char **argv)
+{
+  char tmp_dir[] = "/tmp/testmappedrender.XXXXXX";
+  assert (mkdtemp (tmp_dir));
+  setenv ("XDG_DATA_HOME", tmp_dir, 1);
+
+  Main main (&argc, &argv);
+
+  const string inst_dir = sm_get_user_dir (USER_DIR_INSTRUMENTS) + "/standard";
+  const string smset_path = inst_dir + "/test.smset";
+  const string index_path = inst_dir + "/index.smindex";
+  assert (g_mkdir_with_parents (inst_dir.c_str(), 0755) == 0);
+
+  FILE *index_file = fopen (index_path.c_str(), "w");
+  assert (index_file);
+  fprintf (index_file, "version \"%s\"\nsmset_dir \".\"\nsmset test.smset\n", PACKAGE_VERSION);
+  fclose (index_file);
+
+  WavSet *test_wav_set = make_test_wav_set (1, 1);
+  test_wav_set->save (smset_path);
+  delete test_wav_set;
+
+  {
+    Instance instance[2];
+    WavSetRepo::the()->wait_for_loads();
+
+    WavSetRepo::Ref ref;
+    const WavSet *wav_set = WavSetRepo::the()->get (smset_path, ref);
+    assert (wav_set && wav_set->waves.size() == 1);
+
+    const size_t n_read_only = count_read_only (wav_set);
+    assert (n_read_only > 0);
+
+    const vector<const void *> pointers = block_pointers (wav_set);
+    const uint64_t copies = arena_vector_copies();
+
+    std::thread render_thread ([&] { instance[1].energy = render (instance[1].midi_synth); });
+    instance[0].energy = render (instance[0].midi_synth);
+    render_thread.join();
+
+    for (const auto& inst : instance)
+      assert (inst.energy > 0);
+    assert (arena_vector_copies() == copies);
+    assert (count_read_only (wav_set) == n_read_only);
+    assert (block_pointers (wav_set) == pointers);
+
+    printf ("render mapped: ok (%zd read-only blocks, no copies)\n", n_read_only);
+  }
+
+  unlink (smset_path.c_str());
+  unlink (index_path.c_str());
+  rmdir (sm_get_user_dir (USER_DIR_CACHE).c_str());
+  for (string dir = inst_dir; dir != tmp_dir; dir = dir.substr (0, dir.rfind ('/')))
+    rmdir (dir.c_str());
+  rmdir (tmp_dir);
+}
@@ -0,0 +1,186 @@
+// Licensed GNU LGPL v2.1 or later: http://www.gnu.org/licenses/lgpl-2.1.html
+
+#include "smmidifile.hh"
+#include "smmain.hh"
+
+#include <stdio.h>
+#include <assert.h>
+#include <math.h>
+
+using namespace SpectMorph;
+
+using std::vector;
+
+static void
+add_uint (vector<unsigned char>& data, uint32_t value, int n_bytes)
+{
+  for (int i = n_bytes - 1; i >= 0; i--)
+    data.push_back ((value >> (i * 8)) & 0xff);
+}
+
+static void
+add_var_len (vector<unsigned char>& data, uint32_t value)
+{
+  vector<unsigned char> bytes { (unsigned char) (value & 0x7f) };
+  while (value >>= 7)
+    bytes.insert (bytes.begin(), (value & 0x7f) | 0x80);
+  data.insert (data.end(), bytes.begin(), bytes.end());
+}
+
+static void
+add_track (vector<unsigned char>& data, const vector<unsigned char>& track)
+{
+  data.insert (data.end(), { 'M', 'T', 'r', 'k' });
+  add_uint (data, track.size(), 4);
+  data.insert (data.end(), track.begin(), track.end());
+}
+
+static vector<unsigned char>
+header (int format, int n_tracks, int division)
+{
+  vector<unsigned char> data { 'M', 'T', 'h', 'd' };
+  add_uint (data, 6, 4);
+  add_uint (data, format, 2);
+  add_uint (data, n_tracks, 2);
+  add_uint (data, division, 2);
+  return data;
+}
+
+static bool
+near (double a, double b)
+{
+  return fabs (a - b) < 1e-9;
+}
+
+static void
+test_format1()
+{
+  const int ppq = 480;
+
+  /* tempo track: 120 bpm, 60 bpm after 2 quarter notes */
+  vector<unsigned char> tempo_track;
+  add_var_len (tempo_track, 0);
+  tempo_track.insert (tempo_track.end(), { 0xff, 0x51, 0x03 });
+  add_uint (tempo_track, 500000, 3);
+  add_var_len (tempo_track, 2 * ppq);
+  tempo_track.insert (tempo_track.end(), { 0xff, 0x51, 0x03 });
+  add_uint (tempo_track, 1000000, 3);
+  add_var_len (tempo_track, 0);
+  tempo_track.insert (tempo_track.end(), { 0xff, 0x2f, 0x00 });
+
+  /* note track with running status, sysex and a text meta event */
+  vector<unsigned char> note_track;
+  add_var_len (note_track, 0);
+  note_track.insert (note_track.end(), { 0xf0, 0x02, 0x01, 0xf7 });
+  add_var_len (note_track, 0);
+  note_track.insert (note_track.end(), { 0x91, 60, 100 });
+  add_var_len (note_track, ppq);
+  note_track.insert (note_track.end(), { 60, 0 });          // running status: note on, velocity 0
+  add_var_len (note_track, 0);
+  note_track.insert (note_track.end(), { 0xff, 0x01, 0x03, 'a', 'b', 'c' });
+  add_var_len (note_track, 2 * ppq);
+  note_track.insert (note_track.end(), { 0xc1, 5 });        // program change: one data byte
+  add_var_len (note_track, 0);
+  note_track.insert (note_track.end(), { 0xb1, 64, 127 });
+  add_var_len (note_track, 0);
+  note_track.insert (note_track.end(), { 0xff, 0x2f, 0x00 });
+
+  vector<unsigned char> data = header (1, 2, ppq);
+  add_track (data, tempo_track);
+  add_track (data, note_track);
+
+  MidiFile midi_file;
+  Error error = midi_file.load (data);
+  assert (!error);
+  assert (midi_file.n_tracks() == 2);
+
+  const vector<MidiFile::Event>& events = midi_file.events();
+  assert (events.size() == 4);
+
+  assert (events[0].is_note_on() && near (events[0].time, 0));
+  assert (events[0].midi_data[0] == 0x91 && events[0].midi_data[1] == 60);
+  assert (events[1].is_note_off() && near (events[1].time, 0.5));
+  assert (events[1].midi_data[0] == 0x91);
+
+  /* 2 quarter notes at 120 bpm, 1 quarter note at 60 bpm */
+  assert (events[2].midi_data[0] == 0xc1 && events[2].midi_data[1] == 5 && near (events[2].time, 2));
+  assert (events[3].is_controller() && events[3].midi_data[2] == 127 && near (events[3].time, 2));
+  assert (near (midi_file.length(), 2));
+
+  const vector<MidiFile::TempoEvent>& tempo_events = midi_file.tempo_events();
+  assert (tempo_events.size() == 2);
+  assert (near (tempo_events[0].time, 0) && near (tempo_events[0].ppq_pos, 0) && near (tempo_events[0].tempo, 120));
+  assert (near (tempo_events[1].time, 1) && near (tempo_events[1].ppq_pos, 2) && near (tempo_events[1].tempo, 60));
+
+  MidiFile::TempoEvent t = midi_file.tempo_at (0.5);
+  assert (near (t.tempo, 120) && near (t.ppq_pos, 1));
+  t = midi_file.tempo_at (2);
+  assert (near (t.tempo, 60) && near (t.ppq_pos, 3));
+
+  printf ("format 1: ok\n");
+}
+
+static void
+test_smpte()
+{
+  /* 25 frames per second, 40 ticks per frame => 1 ms per tick */
+  vector<unsigned char> track;
+  add_var_len (track, 250);
+  track.insert (track.end(), { 0x90, 69, 100 });
+  add_var_len (track, 750);
+  track.insert (track.end(), { 0x80, 69, 0 });
+
+  vector<unsigned char> data = header (0, 1, (uint8_t (-25) << 8) + 40);
+  add_track (data, track);
+
+  MidiFile midi_file;
+  assert (!midi_file.load (data));
+  assert (midi_file.events().size() == 2);
+  assert (near (midi_file.events()[0].time, 0.25));
+  assert (near (midi_file.events()[1].time, 1));
+  assert (near (midi_file.length(), 1));
+
+  /* no tempo map: default tempo */
+  assert (midi_file.tempo_events().empty());
+  MidiFile::TempoEvent t = midi_file.tempo_at (1);
+  assert (near (t.tempo, 120) && near (t.ppq_pos, 2));
+
+  printf ("smpte: ok\n");
+}
+
+static void
+test_errors()
+{
+  MidiFile midi_file;
+
+  vector<unsigned char> data { 'R', 'I', 'F', 'F' };
+  assert (midi_file.load (data).code() == Error::Code::FORMAT_INVALID);
+
+  data = header (2, 1, 480);
+  assert (midi_file.load (data));
+
+  /* truncated track */
+  data = header (0, 1, 480);
+  add_track (data, { 0x00, 0x90, 60 });
+  assert (midi_file.load (data).code() == Error::Code::PARSE_ERROR);
+  assert (midi_file.events().empty());
+
+  /* running status without status */
+  data = header (0, 1, 480);
+  add_track (data, { 0x00, 60, 100 });
+  assert (midi_file.load (data).code() == Error::Code::PARSE_ERROR);
+
+  assert (midi_file.load ("testmidifile.missing.mid").code() == Error::Code::FILE_NOT_FOUND);
+
+  printf ("errors: ok\n");
+}
+
+int
+main (int argc, char **argv)
+{
+  Main main (&argc, &argv);
+
+  test_format1();
+  test_smpte();
+  test_errors();
+}
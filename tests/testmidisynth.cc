@@ -4,6 +4,7 @@
 #include "smmain.hh"
 #include "smproject.hh"
 #include "smsynthinterface.hh"
+#include "smwavsetrepo.hh"
 
 using namespace SpectMorph;
 
@@ -35,6 +36,7 @@ main (int argc, char **argv)
 
   auto update = midi_synth.prepare_update (plan);
   midi_synth.apply_update (update);
+  WavSetRepo::the()->wait_for_loads();
 
   const unsigned char note = atoi (argv[2]);
   vector<float> output (24000);
@@ -0,0 +1,171 @@
+// Licensed GNU LGPL v2.1 or later: http://www.gnu.org/licenses/lgpl-2.1.html
+
+#include "smmidisynth.hh"
+#include "smmain.hh"
+#include "smproject.hh"
+#include "smsynthinterface.hh"
+#include "smwavsetrepo.hh"
+#include "smmorphoutput.hh"
+#include "smmorphlinear.hh"
+#include "smmorphwavsource.hh"
+#include "smmorphlfo.hh"
+#include "smutils.hh"
+
+#include "testwavset.hh"
+
+#include <assert.h>
+
+using namespace SpectMorph;
+
+using std::vector;
+
+/* renders a few chords using a plan (built here, or loaded from a file), with serial
+ * and multithreaded voice rendering; output must be bit-identical, and we print the
+ * time needed
+ */
+static vector<float>
+render (MorphPlanPtr plan, int threads, double& time)
+{
+  /* noise decoders are seeded from the glib rng on note on */
+  g_random_set_seed (42);
+
+  MidiSynth midi_synth (48000, 64 /* voices */);
+
+  midi_synth.set_render_threads (threads);
+
+  auto update = midi_synth.prepare_update (plan);
+  midi_synth.apply_update (update);
+  WavSetRepo::the()->wait_for_loads();
+
+  const size_t block_size = 256;
+  vector<float> output;
+  vector<float> block (block_size);
+
+  double start = get_time();
+  for (int chord = 0; chord < 4; chord++)
+    {
+      for (int n = 0; n < 8; n++)
+        {
+          unsigned char note_on[3] = { 0x90, (unsigned char) (48 + chord * 2 + n * 5), 100 };
+          midi_synth.add_midi_event (n * 17, note_on);
+        }
+      for (int b = 0; b < 200; b++)
+        {
+          if (b == 150)
+            {
+              for (int n = 0; n < 8; n++)
+                {
+                  unsigned char note_off[3] = { 0x80, (unsigned char) (48 + chord * 2 + n * 5), 0 };
+                  midi_synth.add_midi_event (n * 23, note_off);
+                }
+            }
+          midi_synth.process (&block[0], block_size);
+          output.insert (output.end(), block.begin(), block.end());
+        }
+    }
+  time = get_time() - start;
+  return output;
+}
+
+/* two sources, morphed by a linear morph operator; optionally, the morphing is
+ * controlled by a random lfo which is not synchronized between voices, so that
+ * each voice needs its own random numbers during rendering
+ */
+static void
+build_plan (Project& project, MorphPlanPtr plan, bool random_lfo)
+{
+  MorphWavSource *source[2];
+  for (int s = 0; s < 2; s++)
+    {
+      source[s] = static_cast<MorphWavSource *> (MorphOperator::create ("SpectMorph::MorphWavSource", plan.c_ptr()));
+      source[s]->set_object_id (s + 1);
+      plan->add_operator (source[s]);
+
+      project.add_rebuild_result (s + 1, make_test_wav_set (s ? 2 : 1, s + 1));
+    }
+  MorphLinear *linear = static_cast<MorphLinear *> (MorphOperator::create ("SpectMorph::MorphLinear", plan.c_ptr()));
+  linear->set_left_op (source[0]);
+  linear->set_right_op (source[1]);
+  linear->set_morphing (-0.3);
+  plan->add_operator (linear);
+
+  if (random_lfo)
+    {
+      MorphLFO *lfo = static_cast<MorphLFO *> (MorphOperator::create ("SpectMorph::MorphLFO", plan.c_ptr()));
+      lfo->property (MorphLFO::P_WAVE_TYPE)->set (MorphLFO::WAVE_RANDOM_LINEAR);
+      lfo->property (MorphLFO::P_FREQUENCY)->set_float (8);
+      lfo->set_sync_voices (false);
+      plan->add_operator (lfo);
+
+      Property *morphing = linear->property (MorphLinear::P_MORPHING);
+      morphing->modulation_list()->set_main_control_type_and_op (MorphOperator::CONTROL_OP, lfo);
+    }
+
+  MorphOutput *output = static_cast<MorphOutput *> (MorphOperator::create ("SpectMorph::MorphOutput", plan.c_ptr()));
+  output->set_channel_op (0, linear);
+  plan->add_operator (output);
+}
+
+static void
+check_plan (MorphPlanPtr plan, int threads, const char *label)
+{
+  double serial_time, mt_time;
+  vector<float> serial_out = render (plan, 1, serial_time);
+  vector<float> mt_out = render (plan, threads, mt_time);
+
+  assert (serial_out.size() == mt_out.size());
+  for (size_t i = 0; i < serial_out.size(); i++)
+    assert (serial_out[i] == mt_out[i]);
+
+  /* the plan must actually produce sound */
+  double energy = 0;
+  for (auto f : serial_out)
+    energy += f * f;
+  assert (energy > 0);
+
+  printf ("%s:\n", label);
+  printf ("  serial: %.3f s\n", serial_time);
+  printf ("  %d threads: %.3f s\n", threads, mt_time);
+  printf ("  output bit-identical\n");
+}
+
+int
+main (int argc, char **argv)
+{
+  Main main (&argc, &argv);
+  if (argc > 3)
+    {
+      fprintf (stderr, "usage: testmidisynthmt [<threads> [<plan>]]\n");
+      return 1;
+    }
+
+  const int threads = argc >= 2 ? atoi (argv[1]) : 4;
+
+  if (argc == 3)
+    {
+      Project project;
+      MorphPlanPtr plan (new MorphPlan (project));
+
+      GenericIn *in = StdioIn::open (argv[2]);
+      if (!in)
+        {
+          g_printerr ("Error opening '%s'.\n", argv[2]);
+          exit (1);
+        }
+      plan->load (in);
+      delete in;
+
+      check_plan (plan, threads, argv[2]);
+    }
+  else
+    {
+      for (bool random_lfo : { false, true })
+        {
+          Project project;
+          MorphPlanPtr plan (new MorphPlan (project));
+
+          build_plan (project, plan, random_lfo);
+          check_plan (plan, threads, random_lfo ? "linear + random lfo" : "linear");
+        }
+    }
+}
@@ -0,0 +1,76 @@
+// Licensed GNU LGPL v2.1 or later: http://www.gnu.org/licenses/lgpl-2.1.html
+
+#include "smmorphplan.hh"
+#include "smmorphplanvoice.hh"
+#include "smmorphplansynth.hh"
+#include "smmorphlinear.hh"
+#include "smmain.hh"
+#include "smproject.hh"
+#include "smsynthinterface.hh"
+#include "smwavsetrepo.hh"
+#include "smutils.hh"
+
+using namespace SpectMorph;
+
+using std::string;
+
+int
+main (int argc, char **argv)
+{
+  Main main (&argc, &argv);
+  if (argc != 2)
+    {
+      printf ("usage: %s <plan>\n", argv[0]);
+      exit (1);
+    }
+
+  Project      project;
+  MorphPlanPtr plan = new MorphPlan (project);
+  GenericIn *in = StdioIn::open (argv[1]);
+  if (!in)
+    {
+      g_printerr ("Error opening '%s'.\n", argv[1]);
+      exit (1);
+    }
+  plan->load (in);
+  delete in;
+
+  MorphPlanSynth synth (48000, 1);
+  synth.apply_update (synth.prepare_update (plan));
+  WavSetRepo::the()->wait_for_loads();
+  synth.update_shared_state (TimeInfo());
+
+  MorphPlanVoice *voice = synth.voice (0);
+
+  for (MorphOperator *op : plan->operators())
+    {
+      if (string (op->type()) != "SpectMorph::MorphLinear")
+        continue;
+
+      MorphOperatorPtr op_ptr;
+      op_ptr.set (op);
+
+      MorphOperatorModule *module = voice->module (op_ptr);
+      LiveDecoderSource *source = module->source();
+
+      source->retrigger (0, 440, 100, 48000);
+
+      /* warmup: let the temporary buffers reach their final size */
+      const size_t FRAMES = 1000;
+      for (size_t index = 0; index < FRAMES; index++)
+        source->audio_block (index);
+
+      const int RUNS = 100;
+      double best_time = 1e30;
+      for (int reps = 0; reps < 10; reps++)
+        {
+          const double start = get_time();
+          for (int r = 0; r < RUNS; r++)
+            for (size_t index = 0; index < FRAMES; index++)
+              source->audio_block (index);
+          const double end = get_time();
+          best_time = std::min (best_time, end - start);
+        }
+      printf ("%s: %.2f morph frames per second\n", op->name().c_str(), RUNS * FRAMES / best_time);
+    }
+}
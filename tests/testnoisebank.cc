@@ -0,0 +1,142 @@
+// Licensed GNU LGPL v2.1 or later: http://www.gnu.org/licenses/lgpl-2.1.html
+
+#include "smnoisedecoder.hh"
+#include "smmain.hh"
+#include "smrandom.hh"
+#include "smfft.hh"
+#include "smmath.hh"
+
+#include <assert.h>
+
+using namespace SpectMorph;
+using std::max;
+using std::vector;
+
+/* compares the noise spectra computed with and without the precomputed spectrum bank:
+ * the energy per band should be the same, and consecutive frames should not be correlated
+ */
+static void
+test_noise_bank (double mix_freq)
+{
+  const size_t block_size = NoiseDecoder::preferred_block_size (mix_freq);
+  const int    n_frames = 2000;
+
+  AudioBlock audio_block;
+  Random     random;
+
+  random.set_seed (42);
+  for (int i = 0; i < 32; i++)
+    audio_block.noise.push_back (sm_factor2idb (random.random_double_range (0.01, 1.0)));
+
+  NoiseDecoder::prepare_spectrum_bank (mix_freq, audio_block.noise.size());
+
+  float *spectrum = FFT::new_array_float (block_size);
+  vector<float> last_spectrum (block_size);
+
+  double energy[2][block_size / 2];
+  double max_corr = 0;
+  for (int bank = 0; bank < 2; bank++)
+    {
+      NoiseDecoder noise_dec (mix_freq, block_size);
+
+      noise_dec.set_seed (42);
+      noise_dec.enable_spectrum_bank (bank);
+
+      std::fill (energy[bank], energy[bank] + block_size / 2, 0);
+      for (int frame = 0; frame < n_frames; frame++)
+        {
+          zero_float_block (block_size, spectrum);
+          noise_dec.process (audio_block, spectrum, NoiseDecoder::FFT_SPECTRUM);
+
+          for (size_t i = 2; i < block_size; i += 2)
+            energy[bank][i / 2] += spectrum[i] * spectrum[i] + spectrum[i + 1] * spectrum[i + 1];
+
+          /* correlation between two frames */
+          if (frame > 0)
+            {
+              double xy = 0, xx = 0, yy = 0;
+              for (size_t i = 0; i < block_size; i++)
+                {
+                  xy += spectrum[i] * last_spectrum[i];
+                  xx += spectrum[i] * spectrum[i];
+                  yy += last_spectrum[i] * last_spectrum[i];
+                }
+              max_corr = max (max_corr, fabs (xy) / sqrt (xx * yy));
+            }
+          std::copy (spectrum, spectrum + block_size, last_spectrum.begin());
+        }
+    }
+  FFT::free_array_float (spectrum);
+
+  /* compare energy per noise band: the average energy of the bank entries is normalized,
+   * but the leakage into the neighbour bands depends on the phases of the (few) entries,
+   * so for low level bands next to high level bands the energy is not exactly the same
+   */
+  NoiseBandPartition partition (audio_block.noise.size(), block_size + 2, mix_freq);
+  double total_energy[2] = { 0, 0 };
+  double max_diff_db = 0;
+  for (size_t b = 0; b < partition.n_bands(); b++)
+    {
+      const size_t first = partition.first_bin (b) / 2;
+      const size_t last = first + partition.bins_per_band (b);
+
+      double e[2] = { 0, 0 };
+      for (int bank = 0; bank < 2; bank++)
+        for (size_t i = first; i < last; i++)
+          e[bank] += energy[bank][i];
+
+      total_energy[0] += e[0];
+      total_energy[1] += e[1];
+
+      max_diff_db = max (max_diff_db, fabs (db_from_factor (e[1] / e[0], -200)) / 2);
+    }
+  const double total_diff_db = fabs (db_from_factor (total_energy[1] / total_energy[0], -200)) / 2;
+
+  printf ("noise bank: mix_freq=%.0f total_diff_db=%.3f max_diff_db=%.3f max_corr=%.3f\n", mix_freq, total_diff_db, max_diff_db, max_corr);
+  assert (total_diff_db < 0.01);
+  assert (max_diff_db < 0.3);
+  assert (max_corr < 0.3);
+}
+
+/* without a prepared bank, the noise decoder must generate the noise spectrum per block */
+static void
+test_no_bank (double mix_freq)
+{
+  const size_t block_size = NoiseDecoder::preferred_block_size (mix_freq);
+
+  AudioBlock audio_block;
+  for (int i = 0; i < 32; i++)
+    audio_block.noise.push_back (sm_factor2idb (0.5));
+
+  vector<float> spectra[2];
+  for (int bank = 0; bank < 2; bank++)
+    {
+      NoiseDecoder noise_dec (mix_freq, block_size);
+
+      noise_dec.set_seed (42);
+      noise_dec.enable_spectrum_bank (bank);
+
+      float *spectrum = FFT::new_array_float (block_size);
+      for (int frame = 0; frame < 10; frame++)
+        {
+          zero_float_block (block_size, spectrum);
+          noise_dec.process (audio_block, spectrum, NoiseDecoder::FFT_SPECTRUM);
+          spectra[bank].insert (spectra[bank].end(), spectrum, spectrum + block_size);
+        }
+      FFT::free_array_float (spectrum);
+    }
+  assert (spectra[0] == spectra[1]);
+  printf ("no bank: mix_freq=%.0f ok\n", mix_freq);
+}
+
+int
+main (int argc, char **argv)
+{
+  Main main (&argc, &argv);
+
+  test_no_bank (22050);
+
+  test_noise_bank (44100);
+  test_noise_bank (48000);
+  test_noise_bank (96000);
+}
@@ -0,0 +1,95 @@
+// Licensed GNU LGPL v2.1 or later: http://www.gnu.org/licenses/lgpl-2.1.html
+
+#include "smnoisedecoder.hh"
+#include "smifftsynth.hh"
+#include "smmain.hh"
+#include "smrandom.hh"
+#include "smfft.hh"
+
+#include <assert.h>
+
+using namespace SpectMorph;
+using std::min;
+using std::vector;
+
+/* NoiseDecoder::process throughput (frames per second) for the different output modes
+ * ("fft_bank" is FFT_SPECTRUM output using the precomputed noise spectrum bank)
+ *
+ * "alloc" emulates the old NoiseDecoder implementation, which allocated (and freed)
+ * its work buffers for every frame it synthesized
+ */
+int
+main (int argc, char **argv)
+{
+  Main main (&argc, &argv);
+
+  const double mix_freq = 48000;
+  const size_t block_size = NoiseDecoder::preferred_block_size (mix_freq);
+
+  AudioBlock audio_block;
+  NoiseDecoder noise_dec (mix_freq, block_size);
+  IFFTSynth ifft_synth (block_size, mix_freq, IFFTSynth::WIN_HANNING);
+  Random    random;
+
+  random.set_seed (42);
+  for (int i = 0; i < 32; i++)
+    audio_block.noise.push_back (sm_factor2idb (random.random_double_range (0.1, 1.0)));
+
+  NoiseDecoder::prepare_spectrum_bank (mix_freq, audio_block.noise.size());
+
+  const int RUNS = 20000, REPS = 9;
+
+  float *samples = FFT::new_array_float (block_size);
+  std::fill (samples, samples + block_size, 0);
+
+  struct Mode {
+    NoiseDecoder::OutputMode mode;
+    const char              *name;
+    bool                     bank;
+  } modes[] = {
+    { NoiseDecoder::REPLACE,      "replace",      false },
+    { NoiseDecoder::ADD,          "add",          false },
+    { NoiseDecoder::FFT_SPECTRUM, "fft_spectrum", false },
+    { NoiseDecoder::FFT_SPECTRUM, "fft_bank",     true }
+  };
+  for (auto mode : modes)
+    {
+      double min_time[2] = { 1e20, 1e20 };
+
+      noise_dec.enable_spectrum_bank (mode.bank);
+
+      for (int alloc = 0; alloc < 2; alloc++)
+        {
+          for (int reps = 0; reps < REPS; reps++)
+            {
+              double start = get_time();
+              for (int r = 0; r < RUNS; r++)
+                {
+                  float *spectrum = nullptr, *in = nullptr;
+                  if (alloc)
+                    {
+                      spectrum = FFT::new_array_float (block_size + 18);
+                      if (mode.mode != NoiseDecoder::FFT_SPECTRUM)
+                        in = FFT::new_array_float (block_size);
+                    }
+                  if (mode.mode == NoiseDecoder::FFT_SPECTRUM)
+                    ifft_synth.clear_partials();
+
+                  noise_dec.process (audio_block, mode.mode == NoiseDecoder::FFT_SPECTRUM ? ifft_synth.fft_buffer() : samples, mode.mode);
+
+                  if (alloc)
+                    {
+                      FFT::free_array_float (spectrum);
+                      if (in)
+                        FFT::free_array_float (in);
+                    }
+                }
+              double end = get_time();
+              min_time[alloc] = min (min_time[alloc], end - start);
+            }
+        }
+      printf ("noise decoder (%-12s): %8.0f frames/sec, %8.0f frames/sec with per-frame alloc\n",
+              mode.name, RUNS / min_time[0], RUNS / min_time[1]);
+    }
+  FFT::free_array_float (samples);
+}
@@ -4,6 +4,7 @@
 #include "smmorphplanvoice.hh"
 #include "smmorphplansynth.hh"
 #include "smmorphoutputmodule.hh"
+#include "smmorphoutput.hh"
 #include "smmain.hh"
 #include "smproject.hh"
 #include "smsynthinterface.hh"
@@ -33,6 +34,34 @@ measure_update (MorphPlanPtr plan, size_t n_voices)
   printf ("update (%zd voices): %f updates per ms\n", n_voices, 1 / ((end - start) * 1000 / runs));
 }
 
+static void
+measure_param_update (MorphPlanPtr plan, size_t n_voices)
+{
+  Property *property = nullptr;
+  for (auto op : plan->operators())
+    {
+      if (op->type_name() == "Output")
+        property = op->property (MorphOutput::P_VELOCITY_SENSITIVITY);
+    }
+  if (!property)
+    return;
+
+  MorphPlanSynth synth (44100, n_voices);
+  synth.apply_update (synth.prepare_update (plan));
+
+  /* like moving a slider in the UI: one property changes for each update */
+  size_t runs = 1000000 / n_voices;
+  double start = get_time();
+  for (size_t j = 0; j < runs; j++)
+    {
+      property->set_float ((j & 1) ? 12 : 24);
+      synth.apply_update (synth.prepare_update (plan));
+    }
+  double end = get_time();
+
+  printf ("param update (%zd voices): %f updates per ms\n", n_voices, 1 / ((end - start) * 1000 / runs));
+}
+
 int
 main (int argc, char **argv)
 {
@@ -58,4 +87,6 @@ main (int argc, char **argv)
   preinit_plan (plan);
   measure_update (plan, 1);
   measure_update (plan, 10);
+  measure_param_update (plan, 1);
+  measure_param_update (plan, 10);
 }
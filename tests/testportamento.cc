@@ -0,0 +1,114 @@
+// Licensed GNU LGPL v2.1 or later: http://www.gnu.org/licenses/lgpl-2.1.html
+
+#include "smlivedecoder.hh"
+#include "smmain.hh"
+#include "smrandom.hh"
+
+#include "testwavset.hh"
+
+#include <stdio.h>
+#include <assert.h>
+#include <math.h>
+
+#include <string>
+#include <vector>
+#include <memory>
+
+using namespace SpectMorph;
+
+using std::string;
+using std::vector;
+
+/* renders glides (portamento) through LiveDecoder and compares the output to
+ * reference output (testportamento.ref), which was rendered by the LiveDecoder
+ * before portamento used a RingBuffer
+ *
+ * to create a new reference file, run: testportamento write <ref_file>
+ */
+static const size_t REF_STEP = 16; // only every REF_STEP-th sample is stored
+
+static vector<float>
+render_glides()
+{
+  std::unique_ptr<WavSet> wav_set (make_test_wav_set (1, 1));
+
+  LiveDecoder decoder (wav_set.get());
+  decoder.enable_noise (false); // noise is random
+
+  Random random;
+  random.set_seed (42);
+
+  const double mix_freq = 48000;
+  const double note_freq = 440;
+
+  vector<float> output;
+  size_t n_samples = 0;
+  for (int block = 0; block < 200; block++)
+    {
+      if (block % 100 == 0)
+        decoder.retrigger (0, note_freq, 100, mix_freq);
+
+      const size_t n_values = 1 + random.random_uint32() % 480;
+
+      /* glide up (two octaves), vibrato, glide down (one octave) */
+      float freq_in[n_values];
+      for (size_t i = 0; i < n_values; i++)
+        {
+          double t = (n_samples + i) / mix_freq;
+          freq_in[i] = note_freq * pow (2, 1.5 * sin (t * 3) + 0.5 + 0.1 * sin (t * 40));
+        }
+
+      float out[n_values];
+
+      const bool glide = block % 100 < 80; // no glide = copy path
+      decoder.process (n_values, glide ? freq_in : nullptr, out);
+      output.insert (output.end(), out, out + n_values);
+
+      n_samples += n_values;
+    }
+  return output;
+}
+
+int
+main (int argc, char **argv)
+{
+  Main main (&argc, &argv);
+
+  vector<float> output = render_glides();
+
+  if (argc == 3 && string (argv[1]) == "write")
+    {
+      FILE *ref_file = fopen (argv[2], "w");
+      assert (ref_file);
+      for (size_t i = 0; i < output.size(); i += REF_STEP)
+        fprintf (ref_file, "%.9g\n", output[i]);
+      fclose (ref_file);
+      return 0;
+    }
+
+  const char *srcdir = getenv ("srcdir");
+  const string ref_filename = string (srcdir ? srcdir : ".") + "/testportamento.ref";
+
+  FILE *ref_file = fopen (ref_filename.c_str(), "r");
+  if (!ref_file)
+    {
+      fprintf (stderr, "testportamento: can't open reference file '%s'\n", ref_filename.c_str());
+      return 1;
+    }
+  size_t n_values = 0;
+  double max_diff = 0;
+  float ref_value;
+  while (fscanf (ref_file, "%f", &ref_value) == 1)
+    {
+      const size_t i = n_values++ * REF_STEP;
+      assert (i < output.size());
+
+      max_diff = std::max (max_diff, fabs (double (output[i]) - ref_value));
+    }
+  fclose (ref_file);
+
+  assert (n_values == (output.size() + REF_STEP - 1) / REF_STEP);
+  assert (max_diff < 1e-6);
+
+  printf ("portamento: %zd samples, max diff to reference: %g\n", output.size(), max_diff);
+}
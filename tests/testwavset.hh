@@ -0,0 +1,62 @@
+// Licensed GNU LGPL v2.1 or later: http://www.gnu.org/licenses/lgpl-2.1.html
+
+#ifndef SPECTMORPH_TEST_WAVSET_HH
+#define SPECTMORPH_TEST_WAVSET_HH
+
+#include "smwavset.hh"
+#include "smmath.hh"
+#include "smrandom.hh"
+
+namespace SpectMorph
+{
+
+/* instrument for tests with one looped note: harmonic partials (decaying with 1 / partial^slope) and noise */
+static inline WavSet *
+make_test_wav_set (double slope, int seed)
+{
+  Audio *audio = new Audio();
+  audio->fundamental_freq = 440;
+  audio->mix_freq = 48000;
+  audio->frame_size_ms = 40;
+  audio->frame_step_ms = 10;
+  audio->attack_start_ms = 0;
+  audio->attack_end_ms = 10;
+  audio->zeropad = 4;
+  audio->loop_type = Audio::LOOP_FRAME_FORWARD;
+  audio->loop_start = 20;
+  audio->loop_end = 29;
+  audio->sample_count = 30 * audio->frame_step_ms * audio->mix_freq / 1000;
+
+  Random random;
+  random.set_seed (seed);
+
+  audio->contents.resize (30);
+  for (auto& block : audio->contents)
+    {
+      for (int i = 0; i < 32; i++)
+        block.noise.push_back (sm_factor2idb (random.random_double_range (0.001, 0.01)));
+
+      for (int partial = 1; partial <= 20; partial++)
+        {
+          block.freqs.push_back (sm_freq2ifreq (partial * random.random_double_range (0.999, 1.001)));
+          block.mags.push_back (sm_factor2idb (0.1 / pow (partial, slope)));
+          block.phases.push_back (sm_bound<int> (0, random.random_double_range (0, 65536), 65535));
+        }
+    }
+
+  WavSetWave wave;
+  wave.midi_note = 69;
+  wave.channel = 0;
+  wave.velocity_range_min = 0;
+  wave.velocity_range_max = 127;
+  wave.audio = audio;
+
+  WavSet *wav_set = new WavSet();
+  wav_set->waves.push_back (wave);
+
+  return wav_set;
+}
+
+}
+
+#endif
@@ -0,0 +1,200 @@
+// Licensed GNU LGPL v2.1 or later: http://www.gnu.org/licenses/lgpl-2.1.html
+
+#include "smwavsetrepo.hh"
+#include "smmain.hh"
+#include "smutils.hh"
+
+#include <stdio.h>
+#include <assert.h>
+#include <unistd.h>
+
+#include <thread>
+
+using namespace SpectMorph;
+
+using std::string;
+using std::vector;
+
+static string
+tmp_filename (int i)
+{
+  return string_printf ("testwavsetrepo.tmp%d.smset", i);
+}
+
+static void
+create_wav_set (const string& filename, int n_blocks)
+{
+  Audio *audio = new Audio();
+  audio->mix_freq = 48000;
+  audio->frame_size_ms = 40;
+  audio->frame_step_ms = 10;
+  audio->fundamental_freq = 440;
+  for (int f = 0; f < n_blocks; f++)
+    {
+      AudioBlock block;
+      for (int p = 0; p < 50; p++)
+        {
+          block.freqs.push_back (p * 1000);
+          block.mags.push_back (p);
+          block.phases.push_back (p);
+        }
+      block.noise.resize (32);
+      audio->contents.push_back (block);
+    }
+
+  WavSetWave wave;
+  wave.midi_note = 69;
+  wave.audio = audio;
+
+  WavSet wav_set;
+  wav_set.name = filename;
+  wav_set.waves.push_back (wave);
+  wav_set.save (filename);
+}
+
+static bool
+is_loaded (WavSetRepo& repo, const string& filename)
+{
+  for (auto info : repo.entry_info())
+    if (info.filename == filename)
+      return info.loaded;
+  return false;
+}
+
+/* eviction is done by the loader thread, so we need to wait for it */
+static void
+wait_for_eviction (WavSetRepo& repo, uint64 n_evictions)
+{
+  for (int i = 0; i < 1000 && repo.stats().n_evictions < n_evictions; i++)
+    usleep (10 * 1000);
+}
+
+int
+main (int argc, char **argv)
+{
+  Main main (&argc, &argv);
+
+  const int N = 4;
+  for (int i = 0; i < N; i++)
+    create_wav_set (tmp_filename (i), 100 * (i + 1));
+
+  WavSetRepo repo;
+
+  /* async load: placeholder until loaded */
+  vector<WavSetRepo::Ref> refs;
+  for (int i = 0; i < N; i++)
+    refs.push_back (repo.load_async (tmp_filename (i)));
+
+  assert (repo.load_async (tmp_filename (0)) == refs[0]);
+  assert (refs[0] != refs[1]);
+
+  repo.wait_for_loads();
+  for (int i = 0; i < N; i++)
+    {
+      WavSet *wav_set = refs[i].wav_set();
+      assert (wav_set);
+      assert (wav_set->name == tmp_filename (i));
+      assert (wav_set->waves.size() == 1);
+      assert (wav_set->waves[0].audio->contents.size() == size_t (100 * (i + 1)));
+    }
+
+  WavSetRepo::Stats stats = repo.stats();
+  assert (stats.n_entries == N);
+  assert (stats.n_referenced == N);
+  assert (stats.n_loading == 0);
+  assert (stats.n_loads == N);
+  assert (stats.n_evictions == 0);
+  assert (stats.resident_bytes > 0);
+  printf ("load: ok (%.2f MB, %.2f ms)\n", stats.resident_bytes / 1048576., stats.total_load_time * 1000);
+
+  size_t bytes[N];
+  for (auto info : repo.entry_info())
+    for (int i = 0; i < N; i++)
+      if (info.filename == tmp_filename (i))
+        bytes[i] = info.bytes;
+
+  /* sync load of a loaded entry */
+  WavSetRepo::Ref ref2;
+  assert (repo.get (tmp_filename (2), ref2) == refs[2].wav_set());
+  assert (ref2 == refs[2]);
+  ref2 = WavSetRepo::Ref();
+
+  /* non-blocking lookup of a loaded entry */
+  assert (repo.try_get (tmp_filename (1), ref2) == refs[1].wav_set());
+  ref2 = WavSetRepo::Ref();
+
+  /* copying and releasing references from several threads (lock free) */
+  vector<std::thread> threads;
+  for (int t = 0; t < 4; t++)
+    {
+      threads.emplace_back ([&refs] {
+        for (int i = 0; i < 10000; i++)
+          {
+            WavSetRepo::Ref ref = refs[i % N];
+            WavSetRepo::Ref ref_copy;
+            ref_copy = ref;
+            assert (ref_copy.wav_set());
+          }
+      });
+    }
+  for (auto& thread : threads)
+    thread.join();
+
+  for (auto info : repo.entry_info())
+    assert (info.ref_count == 1);
+  printf ("threads: ok\n");
+
+  /* referenced entries are never evicted */
+  repo.set_memory_budget (1);
+  usleep (50 * 1000);
+  assert (repo.stats().n_evictions == 0);
+
+  /* unreferenced entries are evicted in LRU order: 1 is used last, so 3 and 2 are evicted first */
+  repo.set_memory_budget (bytes[0] + bytes[1] + bytes[2]);
+  refs[3] = WavSetRepo::Ref();
+  refs[2] = WavSetRepo::Ref();
+  refs[1] = WavSetRepo::Ref();
+
+  wait_for_eviction (repo, 1);
+  stats = repo.stats();
+  assert (stats.n_evictions == 1);
+  assert (stats.resident_bytes == bytes[0] + bytes[1] + bytes[2]);
+  assert (!is_loaded (repo, tmp_filename (3)));
+  assert (is_loaded (repo, tmp_filename (2)));
+
+  repo.set_memory_budget (bytes[0]);
+  wait_for_eviction (repo, 3);
+  stats = repo.stats();
+  assert (stats.n_evictions == 3);
+  assert (stats.n_entries == 1);
+  assert (stats.resident_bytes == bytes[0]);
+  assert (refs[0].wav_set()->waves.size() == 1);
+  printf ("evict: ok\n");
+
+  /* evicted entries are loaded again */
+  WavSetRepo::Ref ref3;
+  assert (repo.get (tmp_filename (3), ref3)->waves[0].audio->contents.size() == 400);
+  assert (repo.stats().n_loads == N + 1);
+  printf ("reload: ok\n");
+
+  /* over budget: releasing the last reference wakes up the loader thread */
+  usleep (50 * 1000);
+  assert (repo.stats().n_evictions == 3);
+
+  const double start_time = get_time();
+  ref3 = WavSetRepo::Ref();
+  wait_for_eviction (repo, 4);
+  const double wakeup_time = get_time() - start_time;
+  assert (repo.stats().n_evictions == 4);
+  assert (wakeup_time < 0.5);
+  printf ("wakeup: ok (%.2f ms)\n", wakeup_time * 1000);
+
+  /* missing files produce an empty WavSet */
+  WavSetRepo::Ref ref_missing;
+  WavSet *missing = repo.get ("testwavsetrepo.missing.smset", ref_missing);
+  assert (missing && missing->waves.empty());
+  printf ("missing: ok\n");
+
+  for (int i = 0; i < N; i++)
+    unlink (tmp_filename (i).c_str());
+}
@@ -0,0 +1,412 @@
+// Licensed GNU LGPL v2.1 or later: http://www.gnu.org/licenses/lgpl-2.1.html
+
+#include "smmidisynth.hh"
+#include "smmorphoutput.hh"
+#include "smmain.hh"
+#include "smutils.hh"
+#include "smproject.hh"
+#include "smsynthinterface.hh"
+#include "smwavsetrepo.hh"
+#include "smdsptimer.hh"
+#include "config.h"
+
+#include <assert.h>
+
+#include <map>
+#include <algorithm>
+#include <cinttypes>
+
+using namespace SpectMorph;
+
+using std::vector;
+using std::string;
+using std::map;
+using std::min;
+using std::max;
+
+/// @cond
+struct Options
+{
+  string	      program_name; /* FIXME: what to do with that */
+  string              templates_dir;
+  string              scenario;
+  double              len;
+  int                 runs;
+  int                 rate;
+  bool                compare;
+  double              threshold;
+
+  Options ();
+  void parse (int *argc_p, char **argv_p[]);
+  static void print_usage ();
+} options;
+/// @endcond
+
+#include "stwutils.hh"
+
+Options::Options () :
+  program_name ("smbench"),
+  len (10),
+  runs (3),
+  rate (48000),
+  compare (false),
+  threshold (10)
+{
+}
+
+void
+Options::parse (int   *argc_p,
+                char **argv_p[])
+{
+  guint argc = *argc_p;
+  gchar **argv = *argv_p;
+  unsigned int i, e;
+
+  for (i = 1; i < argc; i++)
+    {
+      const char *opt_arg;
+      if (strcmp (argv[i], "--help") == 0 ||
+          strcmp (argv[i], "-h") == 0)
+	{
+	  print_usage();
+	  exit (0);
+	}
+      else if (strcmp (argv[i], "--version") == 0 || strcmp (argv[i], "-v") == 0)
+	{
+	  printf ("%s %s\n", program_name.c_str(), VERSION);
+	  exit (0);
+	}
+      else if (check_arg (argc, argv, &i, "--templates", &opt_arg) || check_arg (argc, argv, &i, "-t", &opt_arg))
+        {
+          templates_dir = opt_arg;
+        }
+      else if (check_arg (argc, argv, &i, "--scenario", &opt_arg) || check_arg (argc, argv, &i, "-s", &opt_arg))
+        {
+          scenario = opt_arg;
+        }
+      else if (check_arg (argc, argv, &i, "--len", &opt_arg) || check_arg (argc, argv, &i, "-l", &opt_arg))
+        {
+          len = sm_atof (opt_arg);
+        }
+      else if (check_arg (argc, argv, &i, "--runs", &opt_arg) || check_arg (argc, argv, &i, "-n", &opt_arg))
+        {
+          runs = max (atoi (opt_arg), 1);
+        }
+      else if (check_arg (argc, argv, &i, "--rate", &opt_arg) || check_arg (argc, argv, &i, "-r", &opt_arg))
+        {
+          rate = atoi (opt_arg);
+        }
+      else if (check_arg (argc, argv, &i, "--compare"))
+        {
+          compare = true;
+        }
+      else if (check_arg (argc, argv, &i, "--threshold", &opt_arg))
+        {
+          threshold = sm_atof (opt_arg);
+        }
+    }
+
+  /* resort argc/argv */
+  e = 1;
+  for (i = 1; i < argc; i++)
+    if (argv[i])
+      {
+        argv[e++] = argv[i];
+        if (i >= e)
+          argv[i] = NULL;
+      }
+  *argc_p = e;
+}
+
+void
+Options::print_usage ()
+{
+  printf ("usage: %s [ <options> ]\n", options.program_name.c_str());
+  printf ("       %s --compare [ --threshold <percent> ] <old_results> <new_results>\n", options.program_name.c_str());
+  printf ("\n");
+  printf ("options:\n");
+  printf (" -h, --help                  help for %s\n", options.program_name.c_str());
+  printf (" -v, --version               print version\n");
+  printf (" -t, --templates <dir>       directory containing the template plans\n");
+  printf (" -s, --scenario <name>       only run one scenario\n");
+  printf (" -l, --len <seconds>         set length of audio rendered per run\n");
+  printf (" -n, --runs <runs>           set number of runs (the fastest run is reported)\n");
+  printf (" -r, --rate <rate>           set sample rate\n");
+  printf (" --compare                   compare two result files\n");
+  printf (" --threshold <percent>       report slowdowns larger than this as regression (default: 10)\n");
+  printf ("\n");
+}
+
+/*
+ * Each scenario renders a fixed note sequence through MidiSynth; the results are
+ * printed as tab separated values (one line per scenario and stage), the cost is
+ * given as percentage of one cpu core required for realtime rendering.
+ */
+struct Scenario
+{
+  const char *name;
+  const char *plan;
+  bool        filter;
+  bool        portamento;
+};
+
+static const Scenario scenarios[] =
+{
+  { "single",     "1-instrument",             false, false },
+  { "linear",     "2-instruments-linear-gui", false, false },
+  { "lfo",        "2-instruments-linear-lfo", false, false },
+  { "unison",     "2-instruments-unison",     false, false },
+  { "grid",       "2x2-instruments-grid-gui", false, false },
+  { "filter",     "2x2-instruments-grid-gui", true,  false },
+  { "portamento", "1-instrument",             false, true  },
+};
+
+struct NoteEvent
+{
+  size_t        pos;
+  unsigned char midi_data[3];
+};
+
+static vector<NoteEvent>
+note_events (bool mono, size_t n_samples)
+{
+  /* polyphonic: three note chords that overlap with the next chord
+   * mono: legato melody (note on before the note off of the previous note) for portamento
+   */
+  const int    chords[4][3] = { { 48, 55, 64 }, { 53, 57, 65 }, { 50, 57, 62 }, { 55, 59, 67 } };
+  const int    melody[8] = { 60, 62, 64, 67, 69, 67, 64, 62 };
+  const size_t step = options.rate * (mono ? 0.25 : 0.5);
+  const size_t note_len = mono ? step + options.rate / 100 : 2 * step;
+
+  vector<NoteEvent> events;
+  for (size_t pos = 0, i = 0; pos < n_samples; pos += step, i++)
+    {
+      vector<int> notes;
+      if (mono)
+        notes.push_back (melody[i % 8]);
+      else
+        notes.assign (chords[i % 4], chords[i % 4] + 3);
+
+      for (int note : notes)
+        {
+          events.push_back ({ pos, { 0x90, (unsigned char) note, 100 } });
+          events.push_back ({ pos + note_len, { 0x80, (unsigned char) note, 0 } });
+        }
+    }
+  std::stable_sort (events.begin(), events.end(), [] (const NoteEvent& a, const NoteEvent& b) { return a.pos < b.pos; });
+  return events;
+}
+
+struct Result
+{
+  double total_ms = 0;
+  vector<DSPTimers::Stats> stages;
+};
+
+static Result
+run_scenario (const Scenario& scenario, MorphPlanPtr plan)
+{
+  MidiSynth midi_synth (options.rate, 64);
+  midi_synth.set_random_seed (1);
+  midi_synth.apply_update (midi_synth.prepare_update (plan));
+
+  const size_t n_samples = options.len * options.rate;
+  const size_t block_size = 256;
+  vector<NoteEvent> events = note_events (scenario.portamento, n_samples);
+  vector<float> block (block_size);
+
+  DSPTimers::reset();
+
+  double total_time = 0;
+  size_t e = 0;
+  for (size_t pos = 0; pos < n_samples; pos += block_size)
+    {
+      while (e < events.size() && events[e].pos < pos + block_size)
+        {
+          midi_synth.add_midi_event (events[e].pos > pos ? events[e].pos - pos : 0, events[e].midi_data);
+          e++;
+        }
+      const double start_time = get_time();
+      midi_synth.process (block.data(), block_size);
+      total_time += get_time() - start_time;
+    }
+
+  Result result;
+  result.total_ms = total_time * 1000;
+  for (int stage = 0; stage < int (DSPStage::COUNT); stage++)
+    result.stages.push_back (DSPTimers::stats (DSPStage (stage)));
+
+  return result;
+}
+
+static double
+cpu_percent (double ms)
+{
+  return ms / (options.len * 1000) * 100;
+}
+
+static bool
+load_plan (MorphPlanPtr plan, const Scenario& scenario)
+{
+  const string filename = options.templates_dir + "/" + scenario.plan + ".smplan";
+
+  GenericIn *in = StdioIn::open (filename);
+  if (!in)
+    {
+      fprintf (stderr, "%s: error opening '%s'\n", options.program_name.c_str(), filename.c_str());
+      return false;
+    }
+  plan->load (in);
+  delete in;
+
+  for (auto op : plan->operators())
+    {
+      if (op->type_name() == "Output")
+        {
+          if (scenario.filter)
+            op->property (MorphOutput::P_FILTER)->set_bool (true);
+          if (scenario.portamento)
+            op->property (MorphOutput::P_PORTAMENTO)->set_bool (true);
+        }
+    }
+  return true;
+}
+
+static int
+run_benchmarks()
+{
+  if (options.templates_dir.empty())
+    options.templates_dir = sm_get_install_dir (INSTALL_DIR_TEMPLATES);
+
+  DSPTimers::enable();
+
+  printf ("# %s %s\trate=%d\tlen=%g\truns=%d\n", options.program_name.c_str(), VERSION, options.rate, options.len, options.runs);
+  printf ("scenario\tstage\tcalls\tms\tcpu_percent\n");
+
+  for (const auto& scenario : scenarios)
+    {
+      if (!options.scenario.empty() && options.scenario != scenario.name)
+        continue;
+
+      Project      project;
+      MorphPlanPtr plan (new MorphPlan (project));
+      if (!load_plan (plan, scenario))
+        return 1;
+
+      /* load samples, initialize tables */
+      {
+        MidiSynth midi_synth (options.rate, 1);
+        midi_synth.apply_update (midi_synth.prepare_update (plan));
+        WavSetRepo::the()->wait_for_loads();
+      }
+
+      Result best;
+      for (int r = 0; r < options.runs + 1; r++)
+        {
+          Result result = run_scenario (scenario, plan);
+          if (r > 0 && (best.stages.empty() || result.total_ms < best.total_ms)) // first run: warmup
+            best = result;
+        }
+
+      double stage_ms = 0;
+      for (int stage = 0; stage < int (DSPStage::COUNT); stage++)
+        {
+          const DSPTimers::Stats& stats = best.stages[stage];
+          const double ms = stats.ns / 1e6;
+
+          printf ("%s\t%s\t%" PRIu64 "\t%.3f\t%.3f\n", scenario.name, DSPTimers::stage_name (DSPStage (stage)), stats.calls, ms, cpu_percent (ms));
+          stage_ms += ms;
+        }
+      const double other_ms = max (best.total_ms - stage_ms, 0.0);
+      printf ("%s\tother\t-\t%.3f\t%.3f\n", scenario.name, other_ms, cpu_percent (other_ms));
+      printf ("%s\ttotal\t-\t%.3f\t%.3f\n", scenario.name, best.total_ms, cpu_percent (best.total_ms));
+      fflush (stdout);
+    }
+  return 0;
+}
+
+static bool
+load_results (const string& filename, map<string, double>& results, vector<string>& keys)
+{
+  FILE *file = fopen (filename.c_str(), "r");
+  if (!file)
+    {
+      fprintf (stderr, "%s: error opening '%s'\n", options.program_name.c_str(), filename.c_str());
+      return false;
+    }
+  char line[1024];
+  while (fgets (line, sizeof (line), file))
+    {
+      char scenario[256], stage[256], calls[256];
+      double ms, percent;
+
+      if (line[0] == '#')
+        continue;
+      if (sscanf (line, "%255s %255s %255s %lf %lf", scenario, stage, calls, &ms, &percent) == 5)
+        {
+          const string key = string (scenario) + "\t" + stage;
+          if (!results.count (key))
+            keys.push_back (key);
+          results[key] = percent;
+        }
+    }
+  fclose (file);
+  return true;
+}
+
+static int
+compare_results (const string& old_filename, const string& new_filename)
+{
+  map<string, double> old_results, new_results;
+  vector<string> old_keys, new_keys;
+
+  if (!load_results (old_filename, old_results, old_keys) || !load_results (new_filename, new_results, new_keys))
+    return 1;
+
+  /* ignore stages below 0.1% cpu: too small to be measured reliably */
+  const double min_percent = 0.1;
+
+  int n_regressions = 0;
+  printf ("scenario\tstage\told\tnew\tchange\n");
+  for (const auto& key : new_keys)
+    {
+      if (!old_results.count (key))
+        continue;
+
+      const double old_percent = old_results[key];
+      const double new_percent = new_results[key];
+      const double change = old_percent > 0 ? (new_percent / old_percent - 1) * 100 : 0;
+      const bool   regression = change > options.threshold && max (old_percent, new_percent) >= min_percent;
+
+      printf ("%s\t%.3f\t%.3f\t%+.1f%%%s\n", key.c_str(), old_percent, new_percent, change, regression ? "\tREGRESSION" : "");
+      if (regression)
+        n_regressions++;
+    }
+  if (n_regressions)
+    fprintf (stderr, "%s: %d regressions (threshold %.1f%%)\n", options.program_name.c_str(), n_regressions, options.threshold);
+
+  return n_regressions ? 1 : 0;
+}
+
+int
+main (int argc, char **argv)
+{
+  Main main (&argc, &argv);
+  options.parse (&argc, &argv);
+
+  if (options.compare)
+    {
+      if (argc != 3)
+        {
+          options.print_usage();
+          return 1;
+        }
+      return compare_results (argv[1], argv[2]);
+    }
+  if (argc != 1)
+    {
+      options.print_usage();
+      return 1;
+    }
+  return run_benchmarks();
+}
@@ -0,0 +1,465 @@
+// Licensed GNU LGPL v2.1 or later: http://www.gnu.org/licenses/lgpl-2.1.html
+
+#include "smmidisynth.hh"
+#include "smmidifile.hh"
+#include "smmain.hh"
+#include "smutils.hh"
+#include "smproject.hh"
+#include "smsynthinterface.hh"
+#include "smwavsetrepo.hh"
+#include "smwavdata.hh"
+#include "config.h"
+
+#include <assert.h>
+
+#include <thread>
+#include <mutex>
+#include <atomic>
+#include <map>
+
+using namespace SpectMorph;
+
+using std::vector;
+using std::string;
+using std::map;
+using std::min;
+using std::max;
+
+/// @cond
+struct Options
+{
+  string	      program_name; /* FIXME: what to do with that */
+  int                 rate;
+  int                 bits;
+  int                 n_voices;
+  int                 n_threads;
+  int                 shard_index;
+  int                 shard_count;
+  uint32_t            seed;
+  double              min_gap;
+  double              max_tail;
+  double              volume;
+  bool                mix;
+  bool                quiet;
+
+  Options ();
+  void parse (int *argc_p, char **argv_p[]);
+  static void print_usage ();
+} options;
+/// @endcond
+
+#include "stwutils.hh"
+
+Options::Options () :
+  program_name ("smmidirender"),
+  rate (48000),
+  bits (24),
+  n_voices (64),
+  n_threads (1),
+  shard_index (0),
+  shard_count (1),
+  seed (1),
+  min_gap (1),
+  max_tail (10),
+  volume (-6), /* same default as Project */
+  mix (false),
+  quiet (false)
+{
+}
+
+void
+Options::parse (int   *argc_p,
+                char **argv_p[])
+{
+  guint argc = *argc_p;
+  gchar **argv = *argv_p;
+  unsigned int i, e;
+
+  for (i = 1; i < argc; i++)
+    {
+      const char *opt_arg;
+      if (strcmp (argv[i], "--help") == 0 ||
+          strcmp (argv[i], "-h") == 0)
+	{
+	  print_usage();
+	  exit (0);
+	}
+      else if (strcmp (argv[i], "--version") == 0 || strcmp (argv[i], "-v") == 0)
+	{
+	  printf ("%s %s\n", program_name.c_str(), VERSION);
+	  exit (0);
+	}
+      else if (check_arg (argc, argv, &i, "--rate", &opt_arg) || check_arg (argc, argv, &i, "-r", &opt_arg))
+        {
+          rate = atoi (opt_arg);
+        }
+      else if (check_arg (argc, argv, &i, "--bits", &opt_arg))
+        {
+          bits = atoi (opt_arg);
+        }
+      else if (check_arg (argc, argv, &i, "--voices", &opt_arg))
+        {
+          n_voices = max (atoi (opt_arg), 1);
+        }
+      else if (check_arg (argc, argv, &i, "--threads", &opt_arg) || check_arg (argc, argv, &i, "-j", &opt_arg))
+        {
+          n_threads = max (atoi (opt_arg), 1);
+        }
+      else if (check_arg (argc, argv, &i, "--shard", &opt_arg))
+        {
+          if (sscanf (opt_arg, "%d/%d", &shard_index, &shard_count) != 2 ||
+              shard_count < 1 || shard_index < 0 || shard_index >= shard_count)
+            {
+              fprintf (stderr, "%s: bad shard '%s', expected <index>/<count>\n", program_name.c_str(), opt_arg);
+              exit (1);
+            }
+        }
+      else if (check_arg (argc, argv, &i, "--seed", &opt_arg) || check_arg (argc, argv, &i, "-s", &opt_arg))
+        {
+          seed = atoi (opt_arg);
+        }
+      else if (check_arg (argc, argv, &i, "--min-gap", &opt_arg))
+        {
+          min_gap = sm_atof (opt_arg);
+        }
+      else if (check_arg (argc, argv, &i, "--max-tail", &opt_arg))
+        {
+          max_tail = sm_atof (opt_arg);
+        }
+      else if (check_arg (argc, argv, &i, "--volume", &opt_arg))
+        {
+          volume = sm_atof (opt_arg);
+        }
+      else if (check_arg (argc, argv, &i, "--mix"))
+        {
+          mix = true;
+        }
+      else if (check_arg (argc, argv, &i, "--quiet") || check_arg (argc, argv, &i, "-q"))
+        {
+          quiet = true;
+        }
+    }
+
+  /* resort argc/argv */
+  e = 1;
+  for (i = 1; i < argc; i++)
+    if (argv[i])
+      {
+        argv[e++] = argv[i];
+        if (i >= e)
+          argv[i] = NULL;
+      }
+  *argc_p = e;
+}
+
+void
+Options::print_usage ()
+{
+  printf ("usage: %s [ <options> ] <plan> <midi_file> <wav_file>\n", options.program_name.c_str());
+  printf ("       %s --mix <wav_file> <shard_wav_file>...\n", options.program_name.c_str());
+  printf ("\n");
+  printf ("options:\n");
+  printf (" -h, --help                  help for %s\n", options.program_name.c_str());
+  printf (" -v, --version               print version\n");
+  printf (" -r, --rate <rate>           set sample rate\n");
+  printf (" --bits <bits>               set output bit depth\n");
+  printf (" --voices <voices>           set number of voices\n");
+  printf (" -j, --threads <threads>     render sections in parallel\n");
+  printf (" --shard <index>/<count>     only render every <count>-th section (starting at <index>)\n");
+  printf (" -s, --seed <seed>           set random seed\n");
+  printf (" --min-gap <seconds>         minimum silence between notes to start a new section\n");
+  printf (" --max-tail <seconds>        maximum release time after the last note off of a section\n");
+  printf (" --volume <db>               set output volume (default: -6 dB)\n");
+  printf (" --mix                       mix shard output files\n");
+  printf (" -q, --quiet                 don't print statistics\n");
+  printf ("\n");
+}
+
+/*
+ * The MIDI file is split into sections that are rendered independently; a new section
+ * starts at a note on if no notes were active (and no sustain pedal was held) for at
+ * least min_gap seconds. Each section is rendered by its own MidiSynth, seeded with a
+ * per section seed, so the output is the same for any number of threads or shards.
+ *
+ * State from previous sections is carried over by the events at the start of each
+ * section (controllers, pitch bend), and by setting tempo and song position from the
+ * tempo map of the MIDI file for each block (so beat synced LFOs continue in phase).
+ */
+struct Section
+{
+  int                     index = 0;
+  double                  start_time = 0;
+  vector<MidiFile::Event> events;   // time relative to start_time
+  vector<float>           samples;
+  double                  render_time = 0;
+};
+
+static vector<Section>
+split_sections (const MidiFile& midi_file)
+{
+  vector<Section> sections (1);
+
+  /* controller state that applies at the start of the next section */
+  map<int, MidiFile::Event> controllers;
+
+  int    active_notes = 0;
+  int    sustain_channels = 0; // bitmask
+  double silence_start = 0;
+  bool   have_notes = false;
+
+  for (const auto& event : midi_file.events())
+    {
+      const int  channel = event.midi_data[0] & 0x0f;
+      const bool was_silent = active_notes == 0 && !sustain_channels;
+
+      if (event.is_note_on())
+        {
+          if (was_silent && have_notes && event.time - silence_start >= options.min_gap)
+            {
+              Section section;
+              section.index = sections.size();
+              section.start_time = event.time;
+
+              /* the new section starts with a fresh MidiSynth: replay controller/pitch bend state */
+              for (const auto& it : controllers)
+                {
+                  MidiFile::Event cevent = it.second;
+                  cevent.time = 0;
+                  section.events.push_back (cevent);
+                }
+              sections.push_back (section);
+            }
+          active_notes++;
+          have_notes = true;
+        }
+      else if (event.is_note_off())
+        {
+          active_notes = max (active_notes - 1, 0);
+        }
+      else if (event.is_controller() && event.midi_data[1] == 64)
+        {
+          if (event.midi_data[2] >= 64)
+            sustain_channels |= 1 << channel;
+          else
+            sustain_channels &= ~(1 << channel);
+        }
+      if (event.is_controller())
+        controllers[(channel << 8) + event.midi_data[1]] = event;
+      if ((event.midi_data[0] & 0xf0) == 0xe0)
+        controllers[(channel << 8) + 0x80] = event; // pitch bend
+
+      if (!was_silent && active_notes == 0 && !sustain_channels)
+        silence_start = event.time;
+
+      MidiFile::Event section_event = event;
+      section_event.time = max (event.time - sections.back().start_time, 0.0);
+      sections.back().events.push_back (section_event);
+    }
+  return sections;
+}
+
+class Renderer
+{
+  MorphPlanPtr    plan;
+  const MidiFile& midi_file;
+  std::mutex      prepare_mutex;
+public:
+  Renderer (MorphPlanPtr plan, const MidiFile& midi_file) :
+    plan (plan),
+    midi_file (midi_file)
+  {
+  }
+  void render (Section& section);
+};
+
+void
+Renderer::render (Section& section)
+{
+  const double start_time = get_time();
+
+  MidiSynth midi_synth (options.rate, options.n_voices);
+  midi_synth.set_random_seed (options.seed + section.index);
+  midi_synth.set_gain (db_to_factor (options.volume));
+  {
+    std::lock_guard<std::mutex> lock (prepare_mutex);
+    midi_synth.apply_update (midi_synth.prepare_update (plan));
+  }
+
+  const size_t block_size = 256;
+  const size_t max_tail = options.max_tail * options.rate;
+  vector<float> block (block_size);
+
+  size_t pos = 0;
+  size_t e = 0;
+  size_t tail = 0;
+  while (e < section.events.size() || (midi_synth.active_voice_count() > 0 && tail < max_tail))
+    {
+      while (e < section.events.size())
+        {
+          const size_t event_pos = sm_round_positive (section.events[e].time * options.rate);
+          if (event_pos >= pos + block_size)
+            break;
+
+          midi_synth.add_midi_event (event_pos > pos ? event_pos - pos : 0, section.events[e].midi_data);
+          e++;
+        }
+      const MidiFile::TempoEvent tempo = midi_file.tempo_at (section.start_time + pos / double (options.rate));
+      midi_synth.set_tempo (tempo.tempo);
+      midi_synth.set_ppq_pos (tempo.ppq_pos);
+
+      midi_synth.process (block.data(), block_size);
+      section.samples.insert (section.samples.end(), block.begin(), block.end());
+
+      pos += block_size;
+      if (e == section.events.size())
+        tail += block_size;
+    }
+  section.render_time = get_time() - start_time;
+}
+
+static void
+mix_section (vector<float>& output, const Section& section)
+{
+  const size_t offset = sm_round_positive (section.start_time * options.rate);
+
+  if (output.size() < offset + section.samples.size())
+    output.resize (offset + section.samples.size());
+
+  for (size_t i = 0; i < section.samples.size(); i++)
+    output[offset + i] += section.samples[i];
+}
+
+static void
+save_wav (const string& filename, const vector<float>& samples)
+{
+  WavData wav_data (samples, 1, options.rate, options.bits);
+  if (!wav_data.save (filename))
+    {
+      fprintf (stderr, "%s: export to file %s failed: %s\n", options.program_name.c_str(), filename.c_str(), wav_data.error_blurb());
+      exit (1);
+    }
+}
+
+static int
+mix_files (const string& out_filename, const vector<string>& in_filenames)
+{
+  vector<float> output;
+  for (auto filename : in_filenames)
+    {
+      WavData wav_data;
+      if (!wav_data.load_mono (filename))
+        {
+          fprintf (stderr, "%s: can't load %s: %s\n", options.program_name.c_str(), filename.c_str(), wav_data.error_blurb());
+          return 1;
+        }
+      options.rate = wav_data.mix_freq();
+
+      const vector<float>& samples = wav_data.samples();
+      if (output.size() < samples.size())
+        output.resize (samples.size());
+
+      for (size_t i = 0; i < samples.size(); i++)
+        output[i] += samples[i];
+    }
+  save_wav (out_filename, output);
+  return 0;
+}
+
+int
+main (int argc, char **argv)
+{
+  Main main (&argc, &argv);
+  options.parse (&argc, &argv);
+
+  if (options.mix)
+    {
+      if (argc < 3)
+        {
+          options.print_usage();
+          return 1;
+        }
+      return mix_files (argv[1], vector<string> (argv + 2, argv + argc));
+    }
+  if (argc != 4)
+    {
+      options.print_usage();
+      return 1;
+    }
+
+  Project      project;
+  MorphPlanPtr plan (new MorphPlan (project));
+
+  GenericIn *in = StdioIn::open (argv[1]);
+  if (!in)
+    {
+      g_printerr ("Error opening '%s'.\n", argv[1]);
+      return 1;
+    }
+  plan->load (in);
+  delete in;
+
+  MidiFile midi_file;
+  Error error = midi_file.load (argv[2]);
+  if (error)
+    {
+      fprintf (stderr, "%s: can't load midi file %s: %s\n", options.program_name.c_str(), argv[2], error.message());
+      return 1;
+    }
+
+  /* load samples and initialize global tables (which is not thread safe) before rendering */
+  MidiSynth preload_synth (options.rate, 1);
+  preload_synth.apply_update (preload_synth.prepare_update (plan));
+  WavSetRepo::the()->wait_for_loads();
+
+  const unsigned char note_on[3] = { 0x90, 69, 1 };
+  vector<float> preload_samples (256);
+  preload_synth.add_midi_event (0, note_on);
+  preload_synth.process (preload_samples.data(), preload_samples.size());
+
+  vector<Section> sections = split_sections (midi_file);
+  vector<Section *> todo;
+  for (auto& section : sections)
+    if (section.index % options.shard_count == options.shard_index)
+      todo.push_back (&section);
+
+  const double start_time = get_time();
+
+  Renderer renderer (plan, midi_file);
+  std::atomic<size_t> next_section { 0 };
+  vector<std::thread> threads;
+  for (int t = 0; t < min<int> (options.n_threads, todo.size()); t++)
+    {
+      threads.emplace_back ([&] () {
+        size_t s;
+        while ((s = next_section++) < todo.size())
+          renderer.render (*todo[s]);
+      });
+    }
+  for (auto& thread : threads)
+    thread.join();
+
+  const double wall_time = get_time() - start_time;
+
+  vector<float> output;
+  double cpu_time = 0;
+  for (auto section : todo)
+    {
+      mix_section (output, *section);
+      cpu_time += section->render_time;
+    }
+  save_wav (argv[3], output);
+
+  if (!options.quiet)
+    {
+      /* audio time: length of the sections we rendered (without overlap from release tails) */
+      double audio_time = 0;
+      for (auto section : todo)
+        audio_time += section->samples.size() / double (options.rate);
+
+      fprintf (stderr, "%s: %zd/%zd sections, %d threads\n", options.program_name.c_str(), todo.size(), sections.size(), options.n_threads);
+      fprintf (stderr, "  audio    %8.2f s\n", audio_time);
+      fprintf (stderr, "  wall     %8.2f s (%.2fx realtime)\n", wall_time, audio_time / max (wall_time, 1e-9));
+      fprintf (stderr, "  cpu      %8.2f s (%.2fx realtime per thread)\n", cpu_time, audio_time / max (cpu_time, 1e-9));
+    }
+  return 0;
+}
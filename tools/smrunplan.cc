@@ -8,6 +8,7 @@
 #include "smmain.hh"
 #include "smutils.hh"
 #include "smsynthinterface.hh"
+#include "smwavsetrepo.hh"
 #include "config.h"
 
 #include <assert.h>
@@ -216,6 +217,7 @@ Player::load_plan (const string& filename)
   voice = synth.voice (0);
   auto update = synth.prepare_update (plan);
   synth.apply_update (update);
+  WavSetRepo::the()->wait_for_loads();
   assert (voice->output());
 
   /* search operators for --fade, --fade-env */